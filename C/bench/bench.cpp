@@ -0,0 +1,1096 @@
+/**********************************************************************************
+* Benchmark of embedded red-black trees against std::set and sorted array
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* bench.cpp */
+
+/* usage: bench [options]
+  --sizes=1e3,1e4,1e5,1e6              - numbers of keys in a container
+  --structs=prbtree,pcrbtree,stdset,stdmap,array,prbtree_malloc,prbtree_slab,irbtree,trbtree,bptree,bptree_simd,etree
+  --dists=uniform,zipf,seq,rev         - key distributions
+  --ops=1e6                            - number of operations of lookup/mixed workloads
+  --format=csv|json
+  --out=file                           - write results to the file instead of stdout
+  --trace=file1,file2                  - instead of synthetic workloads, replay recorded traces (see btree_trace.h),
+                                         by default into prbtree,pcrbtree,stdmap
+  --record=file                        - record a trace of operations of prbtree/pcrbtree,
+                                         only if compiled with -DBTREE_TRACE,
+                                         to get a consistent trace, select one structure and one size
+
+  workloads:
+  insert      - insert all keys, one by one (for array with > 1e5 keys: append all keys and sort,
+                for etree: insert all keys into a prbtree and build the snapshot)
+  lookup_hit  - search keys which are in the container
+  lookup_miss - search keys which are not in the container
+  scan        - ordered iteration over all keys
+  mixed       - 90% lookups, 10% removes of a key followed by its re-insert
+  remove      - remove all keys, one by one (skipped for array with > 1e5 keys)
+  replay      - operations of a trace, in recorded order (skipped for array if the trace has > 1e5 updates),
+                the name of the trace file is reported as the distribution
+
+  structures:
+  prbtree, pcrbtree - nodes are preallocated in one array
+  prbtree_malloc    - each node is allocated by malloc() and freed by free() on insert/remove
+  prbtree_slab      - nodes are allocated from a slab (see slab.h), insert/remove do not call malloc()/free()
+  irbtree           - nodes are linked by 32-bit indices in a preallocated pool (see irbtree.h)
+  trbtree           - nodes without parent pointers, top-down insert/remove (see trbtree.h)
+  bptree            - B+tree of pointers to preallocated objects, nodes sized to cache lines (see bptree.h)
+  bptree_simd       - same, but nodes are searched by inline SIMD kernels (see btree_simd.h),
+                      selected at compile time: build with -mavx2 or -msse4.2, otherwise they are scalar
+  etree             - read-only snapshot of a prbtree in Eytzinger layout (see etree.h), no updates
+
+  distributions (order of inserts/removes and keys of lookups):
+  uniform - keys are pseudo-random, lookups are uniformly distributed
+  zipf    - keys are pseudo-random, lookups are Zipf-distributed (theta = 0.99)
+  seq     - keys are inserted, looked up and removed in ascending order
+  rev     - keys are inserted, looked up and removed in descending order
+
+  timing: operations are timed in batches of BATCH, the mean and percentiles are computed over
+  the same per-batch averages, so timer overhead is amortized and does not distort the results,
+  a trailing partial batch is not timed (unless it is the only one), keys and kinds of operations
+  are generated before the timed loops
+
+  if compiled with -DBTREE_PERF (together with the library, see btree_perf.h), per-operation averages
+  of hardware performance counters are printed to stderr after each run, timings are not meaningful then
+
+  if compiled with -DBTREE_STATS (together with the library, see btree_stats.h), rebalancing statistics
+  and average search depth are printed to stderr after each run */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <set>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "prbtree.h"
+#include "pcrbtree.h"
+#include "irbtree.h"
+#include "trbtree.h"
+#include "bptree.h"
+#include "etree.h"
+#include "btree_trace.h"
+#include "slab.h"
+
+#define BATCH 16 /* operations per timed sample */
+
+typedef unsigned long long bkey_t;
+
+/* keys present in a container are even, odd keys are used for lookup misses */
+static inline bkey_t make_key(const size_t i, const int scattered)
+{
+	/* multiplication by an odd constant is a bijection modulo 2^63 */
+	const bkey_t v = scattered ? ((bkey_t)i*0x9E3779B97F4A7C15ull) & ~(1ull << 63) : (bkey_t)i;
+	return v << 1;
+}
+
+/* xorshift64* */
+struct rng {
+	bkey_t s;
+	explicit rng(bkey_t seed) : s(seed ? seed : 1) {}
+	bkey_t next() {
+		s ^= s >> 12;
+		s ^= s << 25;
+		s ^= s >> 27;
+		return s*0x2545F4914F6CDD1Dull;
+	}
+	/* 0 <= x < n */
+	size_t below(size_t n) {
+		return (size_t)(next() % n);
+	}
+	double uniform() {
+		return (double)(next() >> 11)*(1.0/9007199254740992.0);
+	}
+};
+
+/* Zipf-distributed ranks 0..n-1, rank 0 - the most popular,
+  see J. Gray et al., "Quickly generating billion-record synthetic databases" */
+struct zipf {
+	size_t n;
+	double theta, alpha, zetan, eta;
+	zipf(size_t n_, double theta_) : n(n_), theta(theta_) {
+		size_t i;
+		double zeta2 = 0;
+		zetan = 0;
+		for (i = 1; i <= n; i++)
+			zetan += 1.0/pow((double)i, theta);
+		for (i = 1; i <= 2 && i <= n; i++)
+			zeta2 += 1.0/pow((double)i, theta);
+		alpha = 1.0/(1.0 - theta);
+		eta = (1.0 - pow(2.0/(double)n, 1.0 - theta))/(1.0 - zeta2/zetan);
+	}
+	size_t next(rng &r) const {
+		const double u = r.uniform();
+		const double uz = u*zetan;
+		size_t x;
+		if (uz < 1.0)
+			return 0;
+		if (uz < 1.0 + pow(0.5, theta))
+			return n > 1;
+		x = (size_t)((double)n*pow(eta*u - eta + 1.0, alpha));
+		return x < n ? x : n - 1;
+	}
+};
+
+/* containers: insert() returns false if key already exists, remove() - if key was not found */
+
+struct pnode {
+	struct prbtree_node n;
+	bkey_t key;
+};
+
+#define PNODE_KEY_OF(o) ((o)->key)
+#define BKEY_CMP(x, y) ((x) < (y) ? -1 : (x) > (y))
+PRBTREE_DEFINE(ptree, struct pnode, n, bkey_t, PNODE_KEY_OF, BKEY_CMP)
+
+struct bench_prbtree {
+	static const size_t max_updates = (size_t)-1;
+	struct prbtree tree;
+	std::vector<struct pnode> pool;
+	std::vector<struct pnode*> free_nodes;
+	explicit bench_prbtree(size_t n) : pool(n) {
+		size_t i = n;
+		prbtree_init(&tree);
+		free_nodes.reserve(n);
+		while (i)
+			free_nodes.push_back(&pool[--i]);
+	}
+	bool insert(bkey_t key) {
+		struct pnode *const o = free_nodes.back();
+		prbtree_init_node(&o->n);
+		o->key = key;
+		if (ptree_insert(&tree, o, /*leaf:*/0))
+			return false;
+		free_nodes.pop_back();
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return ptree_search(&tree, key) != NULL;
+	}
+	bool remove(bkey_t key) {
+		struct pnode *const o = ptree_search(&tree, key);
+		if (!o)
+			return false;
+		ptree_remove(&tree, o);
+		free_nodes.push_back(o);
+		return true;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		const struct prbtree_node *n = tree.root ?
+			prbtree_node_from_btree_node_(btree_first(&tree.root->u.n)) : NULL;
+		for (; n; n = prbtree_next(n))
+			sum += ptree_from_node(n)->key;
+		return sum;
+	}
+};
+
+/* same as bench_prbtree, but each node is allocated by malloc() - as in typical applications */
+struct bench_prbtree_malloc {
+	static const size_t max_updates = (size_t)-1;
+	struct prbtree tree;
+	explicit bench_prbtree_malloc(size_t) {
+		prbtree_init(&tree);
+	}
+	~bench_prbtree_malloc() {
+		size_t s;
+		struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n, *next;
+		btree_delete_stack(prbtree_node_to_btree_node_(tree.root), stack, s, n, next) {
+			free(ptree_from_node(prbtree_node_from_btree_node_(n)));
+		}
+	}
+	bool insert(bkey_t key) {
+		struct pnode *const o = (struct pnode*)malloc(sizeof(*o));
+		if (!o)
+			abort();
+		prbtree_init_node(&o->n);
+		o->key = key;
+		if (ptree_insert(&tree, o, /*leaf:*/0)) {
+			free(o);
+			return false;
+		}
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return ptree_search(&tree, key) != NULL;
+	}
+	bool remove(bkey_t key) {
+		struct pnode *const o = ptree_search(&tree, key);
+		if (!o)
+			return false;
+		ptree_remove(&tree, o);
+		free(o);
+		return true;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		const struct prbtree_node *n = tree.root ?
+			prbtree_node_from_btree_node_(btree_first(&tree.root->u.n)) : NULL;
+		for (; n; n = prbtree_next(n))
+			sum += ptree_from_node(n)->key;
+		return sum;
+	}
+};
+
+/* same as bench_prbtree_malloc, but nodes are allocated from a slab (see slab.h) */
+struct bench_prbtree_slab {
+	static const size_t max_updates = (size_t)-1;
+	struct prbtree tree;
+	struct slab slab;
+	explicit bench_prbtree_slab(size_t) {
+		prbtree_init(&tree);
+		slab_init(&slab, sizeof(struct pnode), 0);
+	}
+	~bench_prbtree_slab() {
+		/* all nodes are freed at once */
+		slab_destroy(&slab);
+	}
+	bool insert(bkey_t key) {
+		struct pnode *const o = (struct pnode*)slab_alloc(&slab);
+		if (!o)
+			abort();
+		prbtree_init_node(&o->n);
+		o->key = key;
+		if (ptree_insert(&tree, o, /*leaf:*/0)) {
+			slab_free(&slab, o);
+			return false;
+		}
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return ptree_search(&tree, key) != NULL;
+	}
+	bool remove(bkey_t key) {
+		struct pnode *const o = ptree_search(&tree, key);
+		if (!o)
+			return false;
+		ptree_remove(&tree, o);
+		slab_free(&slab, o);
+		return true;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		const struct prbtree_node *n = tree.root ?
+			prbtree_node_from_btree_node_(btree_first(&tree.root->u.n)) : NULL;
+		for (; n; n = prbtree_next(n))
+			sum += ptree_from_node(n)->key;
+		return sum;
+	}
+};
+
+struct cnode {
+	struct pcrbtree_node n;
+	bkey_t key;
+};
+
+#define CNODE_KEY_OF(o) ((o)->key)
+PCRBTREE_DEFINE(ctree, struct cnode, n, bkey_t, CNODE_KEY_OF, BKEY_CMP)
+
+struct bench_pcrbtree {
+	static const size_t max_updates = (size_t)-1;
+	struct pcrbtree tree;
+	std::vector<struct cnode> pool;
+	std::vector<struct cnode*> free_nodes;
+	explicit bench_pcrbtree(size_t n) : pool(n) {
+		size_t i = n;
+		pcrbtree_init(&tree);
+		free_nodes.reserve(n);
+		while (i)
+			free_nodes.push_back(&pool[--i]);
+	}
+	bool insert(bkey_t key) {
+		struct cnode *const o = free_nodes.back();
+		pcrbtree_init_node(&o->n);
+		o->key = key;
+		if (ctree_insert(&tree, o, /*leaf:*/0))
+			return false;
+		free_nodes.pop_back();
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return ctree_search(&tree, key) != NULL;
+	}
+	bool remove(bkey_t key) {
+		struct cnode *const o = ctree_search(&tree, key);
+		if (!o)
+			return false;
+		ctree_remove(&tree, o);
+		free_nodes.push_back(o);
+		return true;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		const struct pcrbtree_node *n = tree.root ?
+			pcrbtree_node_from_btree_node_(btree_first(&tree.root->u.n)) : NULL;
+		for (; n; n = pcrbtree_next(n))
+			sum += ctree_from_node(n)->key;
+		return sum;
+	}
+};
+
+/* nodes linked by 32-bit indices: 12 bytes of links per node instead of 24 */
+struct inode {
+	struct irbtree_node n;
+	bkey_t key;
+};
+
+#define INODE_KEY_OF(o) ((o)->key)
+IRBTREE_DEFINE(itree, struct inode, n, bkey_t, INODE_KEY_OF, BKEY_CMP)
+
+struct bench_irbtree {
+	static const size_t max_updates = (size_t)-1;
+	struct irbtree tree;
+	std::vector<struct inode> pool;
+	std::vector<struct inode*> free_nodes;
+	explicit bench_irbtree(size_t n) : pool(n) {
+		size_t i = n;
+		itree_init(&tree, &pool[0]);
+		free_nodes.reserve(n);
+		while (i)
+			free_nodes.push_back(&pool[--i]);
+	}
+	bool insert(bkey_t key) {
+		struct inode *const o = free_nodes.back();
+		irbtree_init_node(&o->n);
+		o->key = key;
+		if (itree_insert(&tree, o, /*leaf:*/0))
+			return false;
+		free_nodes.pop_back();
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return itree_search(&tree, key) != NULL;
+	}
+	bool remove(bkey_t key) {
+		struct inode *const o = itree_search(&tree, key);
+		if (!o)
+			return false;
+		itree_remove(&tree, o);
+		free_nodes.push_back(o);
+		return true;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		const struct inode *o = itree_first(&tree);
+		for (; o; o = itree_next(&tree, o))
+			sum += o->key;
+		return sum;
+	}
+};
+
+/* nodes without parent pointers: 16 bytes of links per node instead of 24 */
+struct tnode {
+	bkey_t key;
+	struct btree_node n;
+};
+
+#define TNODE_KEY_OF(o) ((o)->key)
+TRBTREE_DEFINE(ttree, struct tnode, n, bkey_t, TNODE_KEY_OF, BKEY_CMP)
+
+struct bench_trbtree {
+	static const size_t max_updates = (size_t)-1;
+	struct trbtree tree;
+	std::vector<struct tnode> pool;
+	std::vector<struct tnode*> free_nodes;
+	explicit bench_trbtree(size_t n) : pool(n) {
+		size_t i = n;
+		trbtree_init(&tree);
+		free_nodes.reserve(n);
+		while (i)
+			free_nodes.push_back(&pool[--i]);
+	}
+	bool insert(bkey_t key) {
+		struct tnode *const o = free_nodes.back();
+		trbtree_init_node(&o->n);
+		o->key = key;
+		if (ttree_insert(&tree, o, /*leaf:*/0))
+			return false;
+		free_nodes.pop_back();
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return ttree_search(&tree, key) != NULL;
+	}
+	bool remove(bkey_t key) {
+		struct tnode *const o = ttree_remove(&tree, key);
+		if (!o)
+			return false;
+		free_nodes.push_back(o);
+		return true;
+	}
+	bkey_t scan() const {
+		struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n;
+		size_t s;
+		bkey_t sum = 0;
+		trbtree_walk_stack_forward(tree.root, stack, s, n)
+			sum += ttree_from_node(n)->key;
+		return sum;
+	}
+};
+
+/* B+tree: objects are not linked, leaves point to them */
+struct bobject {
+	bkey_t key;
+};
+
+#define BOBJECT_KEY_OF(o) ((o)->key)
+BPTREE_DEFINE(bplus, struct bobject, bkey_t, BOBJECT_KEY_OF, BKEY_CMP)
+BPTREE_DEFINE_SIMD(bplus_simd, struct bobject, bkey_t, BOBJECT_KEY_OF, u64)
+
+/* both definitions produce the same layout of nodes, only in-node search differs */
+template <bool simd>
+struct bench_bptree {
+	static const size_t max_updates = (size_t)-1;
+	struct bptree tree;
+	std::vector<struct bobject> pool;
+	std::vector<struct bobject*> free_objects;
+	explicit bench_bptree(size_t n) : pool(n) {
+		size_t i = n;
+		bptree_init(&tree);
+		free_objects.reserve(n);
+		while (i)
+			free_objects.push_back(&pool[--i]);
+	}
+	~bench_bptree() {
+		if (simd)
+			bplus_simd_destroy(&tree);
+		else
+			bplus_destroy(&tree);
+	}
+	bool insert(bkey_t key) {
+		struct bobject *const o = free_objects.back();
+		o->key = key;
+		if ((simd ? bplus_simd_insert(&tree, o, NULL) : bplus_insert(&tree, o, NULL)) != 1)
+			return false;
+		free_objects.pop_back();
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return (simd ? bplus_simd_search(&tree, key) : bplus_search(&tree, key)) != NULL;
+	}
+	bool remove(bkey_t key) {
+		struct bobject *const o = simd ? bplus_simd_remove(&tree, key) : bplus_remove(&tree, key);
+		if (!o)
+			return false;
+		free_objects.push_back(o);
+		return true;
+	}
+	bkey_t scan() const {
+		struct bptree_iter it;
+		bkey_t sum = 0;
+		const struct bobject *o = bplus_first(&tree, &it);
+		for (; o; o = bplus_next(&it))
+			sum += o->key;
+		return sum;
+	}
+};
+
+struct bench_stdset {
+	static const size_t max_updates = (size_t)-1;
+	std::set<bkey_t> set;
+	explicit bench_stdset(size_t) {}
+	bool insert(bkey_t key) {
+		return set.insert(key).second;
+	}
+	bool find(bkey_t key) const {
+		return set.find(key) != set.end();
+	}
+	bool remove(bkey_t key) {
+		return set.erase(key) != 0;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		for (std::set<bkey_t>::const_iterator it = set.begin(); it != set.end(); ++it)
+			sum += *it;
+		return sum;
+	}
+};
+
+/* same as std::set, but keys are mapped to values - like objects with keys in embedded trees */
+struct bench_stdmap {
+	static const size_t max_updates = (size_t)-1;
+	std::map<bkey_t, bkey_t> map;
+	explicit bench_stdmap(size_t) {}
+	bool insert(bkey_t key) {
+		return map.insert(std::make_pair(key, key)).second;
+	}
+	bool find(bkey_t key) const {
+		return map.find(key) != map.end();
+	}
+	bool remove(bkey_t key) {
+		return map.erase(key) != 0;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		for (std::map<bkey_t, bkey_t>::const_iterator it = map.begin(); it != map.end(); ++it)
+			sum += it->second;
+		return sum;
+	}
+};
+
+/* flat sorted array: O(log n) lookups, O(n) inserts and removes */
+#define ARRAY_MAX_UPDATES 100000 /* do not insert/remove one by one into bigger arrays */
+
+struct bench_array {
+	static const size_t max_updates = ARRAY_MAX_UPDATES;
+	std::vector<bkey_t> a;
+	explicit bench_array(size_t n) {
+		a.reserve(n);
+	}
+	bool insert(bkey_t key) {
+		std::vector<bkey_t>::iterator it = std::lower_bound(a.begin(), a.end(), key);
+		if (it != a.end() && *it == key)
+			return false;
+		a.insert(it, key);
+		return true;
+	}
+	bool find(bkey_t key) const {
+		return std::binary_search(a.begin(), a.end(), key);
+	}
+	bool remove(bkey_t key) {
+		std::vector<bkey_t>::iterator it = std::lower_bound(a.begin(), a.end(), key);
+		if (it == a.end() || *it != key)
+			return false;
+		a.erase(it);
+		return true;
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		for (size_t i = 0; i < a.size(); i++)
+			sum += a[i];
+		return sum;
+	}
+};
+
+/* frozen snapshot of prbtree: only lookups and scans, filled by bulk_insert() */
+ETREE_DEFINE(psnap, struct pnode, n, bkey_t, PNODE_KEY_OF, BKEY_CMP)
+
+struct bench_etree {
+	static const size_t max_updates = 0;
+	struct etree e;
+	std::vector<struct pnode> pool;
+	explicit bench_etree(size_t n) : pool(n) {
+		etree_init(&e);
+	}
+	~bench_etree() {
+		etree_destroy(&e);
+	}
+	bool insert(bkey_t) {
+		abort(); /* not reached: the snapshot is immutable */
+	}
+	bool find(bkey_t key) const {
+		return psnap_search(&e, key) != NULL;
+	}
+	bool remove(bkey_t) {
+		abort(); /* not reached */
+	}
+	bkey_t scan() const {
+		bkey_t sum = 0;
+		for (size_t pos = etree_first(&e); pos; pos = etree_next(&e, pos))
+			sum += psnap_at(&e, pos)->key;
+		return sum;
+	}
+};
+
+/* fill the container at once, for containers with limited number of updates */
+template <class C>
+static void bulk_insert(C &, const std::vector<bkey_t> &)
+{
+	abort(); /* not reached: max_updates of the container is not limited */
+}
+
+static void bulk_insert(bench_array &c, const std::vector<bkey_t> &keys)
+{
+	c.a.assign(keys.begin(), keys.end());
+	std::sort(c.a.begin(), c.a.end());
+}
+
+static void bulk_insert(bench_etree &c, const std::vector<bkey_t> &keys)
+{
+	struct prbtree tree;
+	prbtree_init(&tree);
+	for (size_t i = 0; i < keys.size(); i++) {
+		prbtree_init_node(&c.pool[i].n);
+		c.pool[i].key = keys[i];
+		(void)ptree_insert(&tree, &c.pool[i], /*leaf:*/0);
+	}
+	if (psnap_build(&c.e, &tree))
+		abort(); /* out of memory */
+}
+
+/* results */
+
+struct result {
+	std::string structure, dist, workload;
+	size_t size;
+	size_t ops;
+	double ns_per_op, p50, p90, p99;
+};
+
+static std::vector<result> results;
+static volatile bkey_t sink; /* prevents optimizing away of results of operations */
+
+typedef std::chrono::steady_clock bench_clock;
+
+/* collects per-batch timings */
+struct timer {
+	std::vector<double> samples; /* ns per operation */
+	size_t ops;                  /* number of timed operations */
+	bench_clock::time_point start;
+	timer() : ops(0) {}
+	void begin() {
+		start = bench_clock::now();
+	}
+	void end(size_t batch_ops) {
+		const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			bench_clock::now() - start).count();
+		/* a short trailing batch would overweight the timer overhead */
+		if (batch_ops && (batch_ops >= BATCH || samples.empty())) {
+			samples.push_back(ns/(double)batch_ops);
+			ops += batch_ops;
+		}
+	}
+};
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+	return sorted[std::min(sorted.size() - 1, (size_t)(p*(double)(sorted.size() - 1) + 0.5))];
+}
+
+static void add_result(const char *structure, const char *dist, const char *workload, size_t size, timer &t)
+{
+	result r;
+	std::vector<double> &s = t.samples;
+	double sum = 0;
+	size_t i;
+	std::sort(s.begin(), s.end());
+	for (i = 0; i < s.size(); i++)
+		sum += s[i];
+	r.structure = structure;
+	r.dist = dist;
+	r.workload = workload;
+	r.size = size;
+	r.ops = t.ops;
+	r.ns_per_op = s.empty() ? 0 : sum/(double)s.size();
+	r.p50 = percentile(s, 0.50);
+	r.p90 = percentile(s, 0.90);
+	r.p99 = percentile(s, 0.99);
+	results.push_back(r);
+	fprintf(stderr, "%-14s %-8s %10zu %-12s %9.1f ns/op\n", structure, dist, size, workload, r.ns_per_op);
+}
+
+/* key distributions */
+
+enum dist_kind { DIST_UNIFORM, DIST_ZIPF, DIST_SEQ, DIST_REV };
+
+static const char *const dist_names[] = {"uniform", "zipf", "seq", "rev"};
+
+/* keys of the container in order of inserts, indices of keys for lookups,
+  and kinds of operations of the mixed workload: 0 - lookup, 1 - remove followed by insert */
+struct workload_keys {
+	std::vector<bkey_t> keys;
+	std::vector<size_t> lookups;
+	std::vector<unsigned char> mixed;
+};
+
+static void make_keys(workload_keys &w, enum dist_kind dist, size_t n, size_t ops)
+{
+	size_t i;
+	rng r(12345);
+	w.keys.resize(n);
+	w.lookups.resize(ops);
+	w.mixed.resize(ops);
+	for (i = 0; i < n; i++)
+		w.keys[i] = make_key(dist == DIST_REV ? n - 1 - i : i, dist == DIST_UNIFORM || dist == DIST_ZIPF);
+	if (dist == DIST_ZIPF) {
+		/* hot keys are spread over the key space, since keys are scattered */
+		const zipf z(n, 0.99);
+		for (i = 0; i < ops; i++)
+			w.lookups[i] = z.next(r);
+	}
+	else {
+		for (i = 0; i < ops; i++)
+			w.lookups[i] = dist == DIST_UNIFORM ? r.below(n) : i % n;
+	}
+	{
+		rng m(777);
+		for (i = 0; i < ops; i++)
+			w.mixed[i] = !m.below(10);
+	}
+}
+
+template <class C>
+static void run(const char *name, enum dist_kind dist, size_t n, const workload_keys &w)
+{
+	const char *const dn = dist_names[dist];
+	const bool updates = n <= C::max_updates;
+	const size_t ops = w.lookups.size();
+	C c(n);
+	size_t i, j;
+	bkey_t sum = 0;
+#ifdef BTREE_PERF
+	btree_perf_reset();
+#endif
+#ifdef BTREE_STATS
+	btree_stats_reset();
+#endif
+	{
+		timer t;
+		if (updates) {
+			for (i = 0; i < n; i += j) {
+				t.begin();
+				for (j = 0; j < BATCH && i + j < n; j++)
+					sum += c.insert(w.keys[i + j]);
+				t.end(j);
+			}
+			add_result(name, dn, "insert", n, t);
+		}
+		else {
+			t.begin();
+			bulk_insert(c, w.keys);
+			t.end(n);
+			add_result(name, dn, "insert_bulk", n, t);
+		}
+	}
+	{
+		timer t;
+		for (i = 0; i < ops; i += j) {
+			t.begin();
+			for (j = 0; j < BATCH && i + j < ops; j++)
+				sum += c.find(w.keys[w.lookups[i + j]]);
+			t.end(j);
+		}
+		add_result(name, dn, "lookup_hit", n, t);
+	}
+	{
+		timer t;
+		for (i = 0; i < ops; i += j) {
+			t.begin();
+			for (j = 0; j < BATCH && i + j < ops; j++)
+				sum += c.find(w.keys[w.lookups[i + j]] + 1);
+			t.end(j);
+		}
+		add_result(name, dn, "lookup_miss", n, t);
+	}
+	{
+		/* repeat scans to iterate over at least ops keys */
+		timer t;
+		for (i = 0; i < ops; i += n) {
+			t.begin();
+			sum += c.scan();
+			t.end(n);
+		}
+		add_result(name, dn, "scan", n, t);
+	}
+	if (updates) {
+		timer t;
+		for (i = 0; i < ops; i += j) {
+			t.begin();
+			for (j = 0; j < BATCH && i + j < ops; j++) {
+				const bkey_t key = w.keys[w.lookups[i + j]];
+				if (!w.mixed[i + j])
+					sum += c.find(key);
+				else {
+					sum += c.remove(key);
+					sum += c.insert(key);
+				}
+			}
+			t.end(j);
+		}
+		add_result(name, dn, "mixed", n, t);
+	}
+	if (updates) {
+		timer t;
+		for (i = 0; i < n; i += j) {
+			t.begin();
+			for (j = 0; j < BATCH && i + j < n; j++)
+				sum += c.remove(w.keys[i + j]);
+			t.end(j);
+		}
+		add_result(name, dn, "remove", n, t);
+	}
+	sink = sink + sum;
+#ifdef BTREE_PERF
+	fprintf(stderr, "%s %s %zu:\n", name, dn, n);
+	btree_perf_report(stderr);
+#endif
+#ifdef BTREE_STATS
+	fprintf(stderr, "%s %s %zu:\n", name, dn, n);
+	btree_stats_report(stderr);
+#endif
+}
+
+/* traces */
+
+struct trace {
+	std::string name;
+	std::vector<struct btree_trace_record> records;
+	size_t inserts;
+	size_t updates; /* inserts + removes */
+};
+
+static bool load_trace(trace &tr, const char *path)
+{
+	size_t count, i;
+	struct btree_trace_record *const r = btree_trace_load(path, &count);
+	if (!r)
+		return false;
+	tr.name = path;
+	tr.records.assign(r, r + count);
+	free(r);
+	tr.inserts = tr.updates = 0;
+	for (i = 0; i < count; i++) {
+		tr.inserts += tr.records[i].op == BTREE_TRACE_INSERT;
+		tr.updates += tr.records[i].op != BTREE_TRACE_SEARCH;
+	}
+	return true;
+}
+
+/* replay operations of the trace at full speed, starting from an empty container */
+template <class C>
+static void replay(const char *name, const trace &tr)
+{
+	const size_t n = tr.records.size();
+	const struct btree_trace_record *const r = n ? &tr.records[0] : NULL;
+	size_t i, j;
+	bkey_t sum = 0;
+	if (tr.updates > C::max_updates)
+		return;
+	{
+		/* every inserted object may be alive at the same time */
+		C c(tr.inserts ? tr.inserts : 1);
+		timer t;
+#ifdef BTREE_PERF
+		btree_perf_reset();
+#endif
+#ifdef BTREE_STATS
+		btree_stats_reset();
+#endif
+		for (i = 0; i < n; i += j) {
+			t.begin();
+			for (j = 0; j < BATCH && i + j < n; j++) {
+				const struct btree_trace_record *const x = &r[i + j];
+				if (x->op == BTREE_TRACE_SEARCH)
+					sum += c.find(x->key);
+				else if (x->op == BTREE_TRACE_INSERT)
+					sum += c.insert(x->key);
+				else
+					sum += c.remove(x->key);
+			}
+			t.end(j);
+		}
+		add_result(name, tr.name.c_str(), "replay", n, t);
+	}
+	/* all containers must report the same number of successful operations */
+	fprintf(stderr, "%s %s: %llu successful operations\n", name, tr.name.c_str(), (unsigned long long)sum);
+	sink = sink + sum;
+#ifdef BTREE_PERF
+	btree_perf_report(stderr);
+#endif
+#ifdef BTREE_STATS
+	btree_stats_report(stderr);
+#endif
+}
+
+/* command line */
+
+static std::vector<std::string> split_list(const char *s)
+{
+	std::vector<std::string> v;
+	std::string cur;
+	for (; *s; s++) {
+		if (*s == ',') {
+			if (!cur.empty())
+				v.push_back(cur);
+			cur.clear();
+		}
+		else
+			cur += *s;
+	}
+	if (!cur.empty())
+		v.push_back(cur);
+	return v;
+}
+
+static bool contains(const std::vector<std::string> &v, const char *s)
+{
+	return std::find(v.begin(), v.end(), std::string(s)) != v.end();
+}
+
+static void print_results(FILE *f, bool json)
+{
+	size_t i;
+	if (json)
+		fprintf(f, "[\n");
+	else
+		fprintf(f, "structure,distribution,size,workload,ops,ns_per_op,p50,p90,p99\n");
+	for (i = 0; i < results.size(); i++) {
+		const result &r = results[i];
+		if (json)
+			fprintf(f, "  {\"structure\": \"%s\", \"distribution\": \"%s\", \"size\": %zu, \"workload\": \"%s\", "
+				"\"ops\": %zu, \"ns_per_op\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f}%s\n",
+				r.structure.c_str(), r.dist.c_str(), r.size, r.workload.c_str(),
+				r.ops, r.ns_per_op, r.p50, r.p90, r.p99, i + 1 < results.size() ? "," : "");
+		else
+			fprintf(f, "%s,%s,%zu,%s,%zu,%.2f,%.2f,%.2f,%.2f\n",
+				r.structure.c_str(), r.dist.c_str(), r.size, r.workload.c_str(),
+				r.ops, r.ns_per_op, r.p50, r.p90, r.p99);
+	}
+	if (json)
+		fprintf(f, "]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> sizes = split_list("1e3,1e4,1e5,1e6");
+	std::vector<std::string> structs = split_list("prbtree,pcrbtree,stdset,array");
+	std::vector<std::string> dists = split_list("uniform,zipf,seq,rev");
+	std::vector<std::string> traces;
+	size_t ops = 1000000;
+	bool json = false;
+	bool structs_set = false;
+	const char *out_name = NULL;
+	const char *record_name = NULL;
+	int i;
+	for (i = 1; i < argc; i++) {
+		const char *const a = argv[i];
+		if (!strncmp(a, "--sizes=", 8))
+			sizes = split_list(a + 8);
+		else if (!strncmp(a, "--structs=", 10)) {
+			structs = split_list(a + 10);
+			structs_set = true;
+		}
+		else if (!strncmp(a, "--dists=", 8))
+			dists = split_list(a + 8);
+		else if (!strncmp(a, "--ops=", 6))
+			ops = (size_t)atof(a + 6);
+		else if (!strcmp(a, "--format=json"))
+			json = true;
+		else if (!strcmp(a, "--format=csv"))
+			json = false;
+		else if (!strncmp(a, "--out=", 6))
+			out_name = a + 6;
+		else if (!strncmp(a, "--trace=", 8))
+			traces = split_list(a + 8);
+		else if (!strncmp(a, "--record=", 9))
+			record_name = a + 9;
+		else {
+			fprintf(stderr, "unknown option: %s, see usage in bench.cpp\n", a);
+			return 2;
+		}
+	}
+	if (!ops) {
+		fprintf(stderr, "--ops must be > 0\n");
+		return 2;
+	}
+#ifdef BTREE_PERF
+	if (!btree_perf_open())
+		fprintf(stderr, "hardware performance counters are not available\n");
+#endif
+	if (record_name) {
+#ifdef BTREE_TRACE
+		if (btree_trace_start(record_name)) {
+			fprintf(stderr, "cannot create trace file '%s'\n", record_name);
+			return 1;
+		}
+#else
+		fprintf(stderr, "--record requires compilation with -DBTREE_TRACE\n");
+		return 2;
+#endif
+	}
+	if (!traces.empty()) {
+		if (!structs_set)
+			structs = split_list("prbtree,pcrbtree,stdmap");
+		for (size_t k = 0; k < traces.size(); k++) {
+			trace tr;
+			if (!load_trace(tr, traces[k].c_str())) {
+				fprintf(stderr, "cannot load trace '%s'\n", traces[k].c_str());
+				return 1;
+			}
+			if (contains(structs, "prbtree"))
+				replay<bench_prbtree>("prbtree", tr);
+			if (contains(structs, "pcrbtree"))
+				replay<bench_pcrbtree>("pcrbtree", tr);
+			if (contains(structs, "prbtree_malloc"))
+				replay<bench_prbtree_malloc>("prbtree_malloc", tr);
+			if (contains(structs, "prbtree_slab"))
+				replay<bench_prbtree_slab>("prbtree_slab", tr);
+			if (contains(structs, "irbtree"))
+				replay<bench_irbtree>("irbtree", tr);
+			if (contains(structs, "trbtree"))
+				replay<bench_trbtree>("trbtree", tr);
+			if (contains(structs, "bptree"))
+				replay<bench_bptree<false> >("bptree", tr);
+			if (contains(structs, "bptree_simd"))
+				replay<bench_bptree<true> >("bptree_simd", tr);
+			if (contains(structs, "stdset"))
+				replay<bench_stdset>("stdset", tr);
+			if (contains(structs, "stdmap"))
+				replay<bench_stdmap>("stdmap", tr);
+			if (contains(structs, "array"))
+				replay<bench_array>("array", tr);
+		}
+		sizes.clear(); /* no synthetic workloads */
+	}
+	for (size_t s = 0; s < sizes.size(); s++) {
+		const size_t n = (size_t)atof(sizes[s].c_str());
+		if (!n) {
+			fprintf(stderr, "bad size: %s\n", sizes[s].c_str());
+			return 2;
+		}
+		for (int d = DIST_UNIFORM; d <= DIST_REV; d++) {
+			workload_keys w;
+			if (!contains(dists, dist_names[d]))
+				continue;
+			make_keys(w, (enum dist_kind)d, n, ops);
+			if (contains(structs, "prbtree"))
+				run<bench_prbtree>("prbtree", (enum dist_kind)d, n, w);
+			if (contains(structs, "pcrbtree"))
+				run<bench_pcrbtree>("pcrbtree", (enum dist_kind)d, n, w);
+			if (contains(structs, "prbtree_malloc"))
+				run<bench_prbtree_malloc>("prbtree_malloc", (enum dist_kind)d, n, w);
+			if (contains(structs, "prbtree_slab"))
+				run<bench_prbtree_slab>("prbtree_slab", (enum dist_kind)d, n, w);
+			if (contains(structs, "irbtree"))
+				run<bench_irbtree>("irbtree", (enum dist_kind)d, n, w);
+			if (contains(structs, "trbtree"))
+				run<bench_trbtree>("trbtree", (enum dist_kind)d, n, w);
+			if (contains(structs, "bptree"))
+				run<bench_bptree<false> >("bptree", (enum dist_kind)d, n, w);
+			if (contains(structs, "bptree_simd"))
+				run<bench_bptree<true> >("bptree_simd", (enum dist_kind)d, n, w);
+			if (contains(structs, "stdset"))
+				run<bench_stdset>("stdset", (enum dist_kind)d, n, w);
+			if (contains(structs, "stdmap"))
+				run<bench_stdmap>("stdmap", (enum dist_kind)d, n, w);
+			if (contains(structs, "array"))
+				run<bench_array>("array", (enum dist_kind)d, n, w);
+			if (contains(structs, "etree"))
+				run<bench_etree>("etree", (enum dist_kind)d, n, w);
+		}
+	}
+#ifdef BTREE_TRACE
+	if (record_name && btree_trace_stop()) {
+		fprintf(stderr, "failed to write trace file '%s'\n", record_name);
+		return 1;
+	}
+#endif
+	{
+		FILE *const f = out_name ? fopen(out_name, "w") : stdout;
+		if (!f) {
+			fprintf(stderr, "cannot open '%s' for writing\n", out_name);
+			return 1;
+		}
+		print_results(f, json);
+		if (f != stdout)
+			fclose(f);
+	}
+	return 0;
+}
@@ -0,0 +1,578 @@
+/**********************************************************************************
+* Multi-threaded benchmark of shared ordered maps
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* mtbench.cpp */
+
+/* usage: mtbench [options]
+  --structs=prbtree_mutex,prbtree_seqlock,lfskiplist,shardmap
+                                              - maps to measure
+  --threads=1,2,4,8,16,32,64                  - numbers of threads
+  --sizes=1e6                                 - numbers of keys in a map
+  --updates=10,50,100                         - percents of updates: half inserts, half removes, the rest are lookups
+  --ms=1000                                   - duration of each run, in milliseconds
+  --shards=64                                 - number of shards of the sharded map
+  --format=csv|json
+  --out=file                                  - write results to the file instead of stdout
+
+  keys are scattered over the key space, the map is prefilled with every second key of 2*size keys,
+  each thread picks keys uniformly and runs until the time is up, operations are counted in batches of BATCH,
+
+  structures:
+  prbtree_mutex   - prbtree protected by one std::mutex
+  prbtree_seqlock - prbtree with optimistic lookups validated by a seqlock (see seqlock.h),
+                    updates are serialized by the write lock of the seqlock
+  lfskiplist      - lock-free skip list (see lfskiplist.h), removed objects are freed through
+                    an epoch domain (see epoch.h): each thread enters a read section per batch of operations
+                    and retires removed objects in groups, under a lock
+  shardmap        - prbtrees selected by a hash of the key, each protected by its own spinlock (see shardmap.h)
+
+  objects are allocated by malloc() on insert and freed on remove in all maps, except prbtree_seqlock:
+  there removed objects may still be read by lookups, so they are kept in per-thread pools and
+  reused by inserts of the same thread, all objects are freed when the map is destroyed */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "prbtree.h"
+#include "seqlock.h"
+#include "lfskiplist.h"
+#include "epoch.h"
+#include "shardmap.h"
+
+#define BATCH 64 /* operations between checks of the stop flag */
+#define RETIRE_GROUP 256 /* removed objects retired under the lock at once */
+
+typedef unsigned long long bkey_t;
+
+/* multiplication by an odd constant is a bijection modulo 2^63 */
+static inline bkey_t make_key(const size_t i)
+{
+	return ((bkey_t)i*0x9E3779B97F4A7C15ull) & ~(1ull << 63);
+}
+
+/* xorshift64* */
+struct rng {
+	bkey_t s;
+	explicit rng(bkey_t seed) : s(seed ? seed : 1) {}
+	bkey_t next() {
+		s ^= s >> 12;
+		s ^= s << 25;
+		s ^= s >> 27;
+		return s*0x2545F4914F6CDD1Dull;
+	}
+};
+
+#define BKEY_CMP(x, y) ((x) < (y) ? -1 : (x) > (y))
+
+/* maps: per-thread state is kept in ctx, operations of a batch are
+  enclosed in batch_begin()/batch_end() */
+
+struct pnode {
+	struct prbtree_node n;
+	bkey_t key;
+};
+
+#define PNODE_KEY_OF(o) ((o)->key)
+PRBTREE_DEFINE(ptree, struct pnode, n, bkey_t, PNODE_KEY_OF, BKEY_CMP)
+
+struct mt_prbtree_mutex {
+	struct ctx {};
+	struct prbtree tree;
+	std::mutex lock;
+	explicit mt_prbtree_mutex() {
+		prbtree_init(&tree);
+	}
+	~mt_prbtree_mutex() {
+		size_t s;
+		struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n, *next;
+		if (tree.root) {
+			btree_delete_stack(&tree.root->u.n, stack, s, n, next) {
+				free(ptree_from_node(prbtree_node_from_btree_node_(n)));
+			}
+		}
+	}
+	void thread_begin(ctx &) {}
+	void thread_end(ctx &) {}
+	void batch_begin(ctx &) {}
+	void batch_end(ctx &) {}
+	bool insert(ctx &, bkey_t key) {
+		struct pnode *const o = (struct pnode*)malloc(sizeof(*o));
+		struct pnode *x;
+		if (!o)
+			abort();
+		prbtree_init_node(&o->n);
+		o->key = key;
+		{
+			std::lock_guard<std::mutex> g(lock);
+			x = ptree_insert(&tree, o, /*leaf:*/0);
+		}
+		if (x)
+			free(o);
+		return !x;
+	}
+	bool remove(ctx &, bkey_t key) {
+		struct pnode *o;
+		{
+			std::lock_guard<std::mutex> g(lock);
+			o = ptree_search(&tree, key);
+			if (o)
+				ptree_remove(&tree, o);
+		}
+		free(o);
+		return o != NULL;
+	}
+	bool find(ctx &, bkey_t key) {
+		std::lock_guard<std::mutex> g(lock);
+		return ptree_search(&tree, key) != NULL;
+	}
+};
+
+SEQLOCK_TREE_DEFINE(pseq, struct prbtree, struct pnode, n, bkey_t, PNODE_KEY_OF, BKEY_CMP)
+
+struct mt_prbtree_seqlock {
+	struct ctx {
+		std::vector<struct pnode*> pool; /* removed objects, may be read by concurrent lookups */
+	};
+	struct prbtree tree;
+	struct seqlock lock;
+	std::mutex pools_lock;
+	std::vector<struct pnode*> pools; /* objects of pools of finished threads */
+	explicit mt_prbtree_seqlock() {
+		prbtree_init(&tree);
+		seqlock_init(&lock);
+	}
+	~mt_prbtree_seqlock() {
+		size_t s;
+		struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n, *next;
+		if (tree.root) {
+			btree_delete_stack(&tree.root->u.n, stack, s, n, next) {
+				free(ptree_from_node(prbtree_node_from_btree_node_(n)));
+			}
+		}
+		for (size_t i = 0; i < pools.size(); i++)
+			free(pools[i]);
+	}
+	void thread_begin(ctx &) {}
+	void thread_end(ctx &c) {
+		/* other threads may still read the objects, free them only with the map */
+		std::lock_guard<std::mutex> g(pools_lock);
+		pools.insert(pools.end(), c.pool.begin(), c.pool.end());
+		c.pool.clear();
+	}
+	void batch_begin(ctx &) {}
+	void batch_end(ctx &) {}
+	bool insert(ctx &c, bkey_t key) {
+		struct pnode *o, *x;
+		if (c.pool.empty()) {
+			o = (struct pnode*)malloc(sizeof(*o));
+			if (!o)
+				abort();
+		}
+		else {
+			o = c.pool.back();
+			c.pool.pop_back();
+		}
+		seqlock_write_lock(&lock);
+		/* a reused object may be read by lookups, modify it only in the write section */
+		prbtree_init_node(&o->n);
+		o->key = key;
+		x = ptree_insert(&tree, o, /*leaf:*/0);
+		seqlock_write_unlock(&lock);
+		if (x)
+			c.pool.push_back(o);
+		return !x;
+	}
+	bool remove(ctx &c, bkey_t key) {
+		struct pnode *o;
+		seqlock_write_lock(&lock);
+		o = ptree_search(&tree, key);
+		if (o)
+			ptree_remove(&tree, o);
+		seqlock_write_unlock(&lock);
+		if (o)
+			c.pool.push_back(o);
+		return o != NULL;
+	}
+	bool find(ctx &, bkey_t key) {
+		return pseq_search(&lock, &tree, key) != NULL;
+	}
+};
+
+struct lnode {
+	struct lfskiplist_node n;
+	bkey_t key;
+};
+
+#define LNODE_KEY_OF(o) ((o)->key)
+LFSKIPLIST_DEFINE(llist, struct lnode, n, bkey_t, LNODE_KEY_OF, BKEY_CMP)
+
+static void free_object(void *ptr, void *ctx)
+{
+	(void)ctx;
+	free(ptr);
+}
+
+struct mt_lfskiplist {
+	struct ctx {
+		struct epoch_reader r;
+		std::vector<struct lnode*> removed;
+	};
+	struct lfskiplist list;
+	struct epoch_domain domain;
+	std::mutex retire_lock;
+	explicit mt_lfskiplist() {
+		lfskiplist_init(&list);
+		epoch_init(&domain);
+	}
+	~mt_lfskiplist() {
+		struct lnode *o = llist_first(&list);
+		while (o) {
+			struct lnode *const next = llist_next(o);
+			free(o);
+			o = next;
+		}
+		epoch_destroy(&domain);
+	}
+	void retire(ctx &c) {
+		std::lock_guard<std::mutex> g(retire_lock);
+		for (size_t i = 0; i < c.removed.size(); i++)
+			epoch_retire(&domain, c.removed[i], free_object, NULL);
+		(void)epoch_reclaim(&domain);
+		c.removed.clear();
+	}
+	void thread_begin(ctx &c) {
+		epoch_register(&domain, &c.r);
+	}
+	void thread_end(ctx &c) {
+		retire(c);
+		std::lock_guard<std::mutex> g(retire_lock);
+		epoch_unregister(&domain, &c.r);
+	}
+	void batch_begin(ctx &c) {
+		epoch_enter(&domain, &c.r);
+	}
+	void batch_end(ctx &c) {
+		epoch_leave(&c.r);
+		if (c.removed.size() >= RETIRE_GROUP)
+			retire(c);
+	}
+	bool insert(ctx &, bkey_t key) {
+		struct lnode *const o = (struct lnode*)malloc(sizeof(*o));
+		if (!o)
+			abort();
+		o->key = key;
+		if (llist_insert(&list, o)) {
+			free(o); /* was not published */
+			return false;
+		}
+		return true;
+	}
+	bool remove(ctx &c, bkey_t key) {
+		struct lnode *const o = llist_remove(&list, key);
+		if (!o)
+			return false;
+		c.removed.push_back(o);
+		return true;
+	}
+	bool find(ctx &, bkey_t key) {
+		return llist_search(&list, key) != NULL;
+	}
+};
+
+struct snode {
+	struct prbtree_node n;
+	bkey_t key;
+};
+
+static size_t shards_count = 64;
+
+#define SNODE_KEY_OF(o) ((o)->key)
+#define SNODE_KEY_HASH(k) ((size_t)((k)*0x9E3779B97F4A7C15ull >> 32))
+SHARDMAP_DEFINE(smap, struct snode, n, bkey_t, SNODE_KEY_OF, BKEY_CMP, SNODE_KEY_HASH)
+
+struct mt_shardmap {
+	struct ctx {};
+	struct shardmap map;
+	explicit mt_shardmap() {
+		if (shardmap_alloc(&map, shards_count))
+			abort();
+	}
+	~mt_shardmap() {
+		for (size_t i = 0; i < shardmap_count(&map); i++) {
+			size_t s;
+			struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n, *next;
+			if (map.shards[i].tree.root) {
+				btree_delete_stack(&map.shards[i].tree.root->u.n, stack, s, n, next) {
+					free(smap_from_node(prbtree_node_from_btree_node_(n)));
+				}
+			}
+		}
+		shardmap_destroy(&map);
+	}
+	void thread_begin(ctx &) {}
+	void thread_end(ctx &) {}
+	void batch_begin(ctx &) {}
+	void batch_end(ctx &) {}
+	bool insert(ctx &, bkey_t key) {
+		struct snode *const o = (struct snode*)malloc(sizeof(*o));
+		if (!o)
+			abort();
+		prbtree_init_node(&o->n);
+		o->key = key;
+		if (smap_insert(&map, o)) {
+			free(o);
+			return false;
+		}
+		return true;
+	}
+	bool remove(ctx &, bkey_t key) {
+		struct snode *const o = smap_remove(&map, key);
+		free(o);
+		return o != NULL;
+	}
+	bool find(ctx &, bkey_t key) {
+		return smap_search(&map, key) != NULL;
+	}
+};
+
+/* results */
+
+struct result {
+	std::string structure;
+	unsigned threads;
+	size_t size;
+	unsigned updates;
+	unsigned long long ops;
+	double mops, ns_per_op;
+};
+
+static std::vector<result> results;
+static std::atomic<unsigned long long> sink; /* prevents optimizing away of results of operations */
+
+typedef std::chrono::steady_clock bench_clock;
+
+template <class M>
+static void worker(M &m, unsigned t, size_t n, unsigned updates, std::atomic<unsigned> &ready,
+	const std::atomic<int> &go, const std::atomic<int> &stop, std::atomic<unsigned long long> &total)
+{
+	typename M::ctx c;
+	rng r(0x1234567ull*(t + 1));
+	unsigned long long ops = 0, found = 0;
+	m.thread_begin(c);
+	ready.fetch_add(1);
+	while (!go.load(std::memory_order_acquire))
+		std::this_thread::yield();
+	while (!stop.load(std::memory_order_relaxed)) {
+		unsigned i;
+		m.batch_begin(c);
+		for (i = 0; i < BATCH; i++) {
+			const bkey_t x = r.next();
+			const bkey_t key = make_key((size_t)(x >> 8) % (2*n));
+			const unsigned p = (unsigned)(x & 0xff)*100u >> 8; /* 0..99 */
+			if (p < updates)
+				found += (p & 1) ? m.insert(c, key) : m.remove(c, key);
+			else
+				found += m.find(c, key);
+		}
+		m.batch_end(c);
+		ops += BATCH;
+	}
+	m.thread_end(c);
+	sink.fetch_add(found);
+	total.fetch_add(ops);
+}
+
+template <class M>
+static void run(const char *name, unsigned threads, size_t n, unsigned updates, unsigned ms)
+{
+	M m;
+	std::vector<std::thread> pool;
+	std::atomic<unsigned> ready(0);
+	std::atomic<int> go(0), stop(0);
+	std::atomic<unsigned long long> total(0);
+	bench_clock::time_point start;
+	double ns;
+	unsigned t;
+	{
+		/* prefill by one thread */
+		typename M::ctx c;
+		size_t i = 0;
+		m.thread_begin(c);
+		while (i < n) {
+			const size_t e = std::min(n, i + BATCH);
+			m.batch_begin(c);
+			for (; i < e; i++)
+				(void)m.insert(c, make_key(2*i));
+			m.batch_end(c);
+		}
+		m.thread_end(c);
+	}
+	for (t = 0; t < threads; t++)
+		pool.push_back(std::thread(worker<M>, std::ref(m), t, n, updates,
+			std::ref(ready), std::cref(go), std::cref(stop), std::ref(total)));
+	while (ready.load() != threads)
+		std::this_thread::yield();
+	start = bench_clock::now();
+	go.store(1, std::memory_order_release);
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	stop.store(1);
+	for (t = 0; t < threads; t++)
+		pool[t].join();
+	ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+	{
+		result res;
+		res.structure = name;
+		res.threads = threads;
+		res.size = n;
+		res.updates = updates;
+		res.ops = total.load();
+		res.mops = (double)res.ops*1e3/ns;
+		res.ns_per_op = res.ops ? ns*threads/(double)res.ops : 0;
+		results.push_back(res);
+		fprintf(stderr, "%-15s %3u threads %10zu keys %3u%% updates %9.2f Mops/s\n",
+			name, threads, n, updates, res.mops);
+	}
+}
+
+/* command line */
+
+static std::vector<std::string> split_list(const char *s)
+{
+	std::vector<std::string> v;
+	std::string cur;
+	for (; *s; s++) {
+		if (*s == ',') {
+			if (!cur.empty())
+				v.push_back(cur);
+			cur.clear();
+		}
+		else
+			cur += *s;
+	}
+	if (!cur.empty())
+		v.push_back(cur);
+	return v;
+}
+
+static bool contains(const std::vector<std::string> &v, const char *s)
+{
+	return std::find(v.begin(), v.end(), std::string(s)) != v.end();
+}
+
+static void print_results(FILE *f, bool json)
+{
+	size_t i;
+	if (json)
+		fprintf(f, "[\n");
+	else
+		fprintf(f, "structure,threads,size,updates,ops,mops_per_s,ns_per_op\n");
+	for (i = 0; i < results.size(); i++) {
+		const result &r = results[i];
+		if (json)
+			fprintf(f, "  {\"structure\": \"%s\", \"threads\": %u, \"size\": %zu, \"updates\": %u, "
+				"\"ops\": %llu, \"mops_per_s\": %.3f, \"ns_per_op\": %.2f}%s\n",
+				r.structure.c_str(), r.threads, r.size, r.updates,
+				r.ops, r.mops, r.ns_per_op, i + 1 < results.size() ? "," : "");
+		else
+			fprintf(f, "%s,%u,%zu,%u,%llu,%.3f,%.2f\n",
+				r.structure.c_str(), r.threads, r.size, r.updates,
+				r.ops, r.mops, r.ns_per_op);
+	}
+	if (json)
+		fprintf(f, "]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> structs = split_list("prbtree_mutex,prbtree_seqlock,lfskiplist,shardmap");
+	std::vector<std::string> threads = split_list("1,2,4,8,16,32,64");
+	std::vector<std::string> sizes = split_list("1e6");
+	std::vector<std::string> updates = split_list("10,50,100");
+	unsigned ms = 1000;
+	bool json = false;
+	const char *out_name = NULL;
+	int i;
+	for (i = 1; i < argc; i++) {
+		const char *const a = argv[i];
+		if (!strncmp(a, "--structs=", 10))
+			structs = split_list(a + 10);
+		else if (!strncmp(a, "--threads=", 10))
+			threads = split_list(a + 10);
+		else if (!strncmp(a, "--sizes=", 8))
+			sizes = split_list(a + 8);
+		else if (!strncmp(a, "--updates=", 10))
+			updates = split_list(a + 10);
+		else if (!strncmp(a, "--ms=", 5))
+			ms = (unsigned)atoi(a + 5);
+		else if (!strncmp(a, "--shards=", 9))
+			shards_count = (size_t)atoi(a + 9);
+		else if (!strcmp(a, "--format=json"))
+			json = true;
+		else if (!strcmp(a, "--format=csv"))
+			json = false;
+		else if (!strncmp(a, "--out=", 6))
+			out_name = a + 6;
+		else {
+			fprintf(stderr, "unknown option: %s, see usage in mtbench.cpp\n", a);
+			return 2;
+		}
+	}
+	if (!ms) {
+		fprintf(stderr, "--ms must be > 0\n");
+		return 2;
+	}
+	if (!shards_count) {
+		fprintf(stderr, "--shards must be > 0\n");
+		return 2;
+	}
+	for (size_t s = 0; s < sizes.size(); s++) {
+		const size_t n = (size_t)atof(sizes[s].c_str());
+		if (!n) {
+			fprintf(stderr, "bad size: %s\n", sizes[s].c_str());
+			return 2;
+		}
+		for (size_t u = 0; u < updates.size(); u++) {
+			const unsigned up = (unsigned)atoi(updates[u].c_str());
+			if (up > 100) {
+				fprintf(stderr, "bad percent of updates: %s\n", updates[u].c_str());
+				return 2;
+			}
+			for (size_t t = 0; t < threads.size(); t++) {
+				const unsigned nt = (unsigned)atoi(threads[t].c_str());
+				if (!nt) {
+					fprintf(stderr, "bad number of threads: %s\n", threads[t].c_str());
+					return 2;
+				}
+				if (contains(structs, "prbtree_mutex"))
+					run<mt_prbtree_mutex>("prbtree_mutex", nt, n, up, ms);
+				if (contains(structs, "prbtree_seqlock"))
+					run<mt_prbtree_seqlock>("prbtree_seqlock", nt, n, up, ms);
+				if (contains(structs, "lfskiplist"))
+					run<mt_lfskiplist>("lfskiplist", nt, n, up, ms);
+				if (contains(structs, "shardmap"))
+					run<mt_shardmap>("shardmap", nt, n, up, ms);
+			}
+		}
+	}
+	{
+		FILE *const f = out_name ? fopen(out_name, "w") : stdout;
+		if (!f) {
+			fprintf(stderr, "cannot open '%s' for writing\n", out_name);
+			return 1;
+		}
+		print_results(f, json);
+		if (f != stdout)
+			fclose(f);
+	}
+	return 0;
+}
@@ -0,0 +1,34 @@
+/**********************************************************************************
+* B+tree of pointers to objects with nodes sized to cache lines
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* bptree.c */
+
+#include <stdlib.h> /* for malloc() */
+#include <stdint.h> /* for uintptr_t */
+#include "collections_config.h"
+#include "bptree.h"
+
+/* pointer returned by malloc() is stored just before the aligned node */
+BPTREE_EXPORTS void *bptree_alloc_node(
+	const size_t size)
+{
+	const size_t extra = BPTREE_CACHE_LINE - 1 + sizeof(void*);
+	char *const p = size <= (size_t)-1 - extra ? (char*)malloc(size + extra) : (char*)0;
+	if (p) {
+		const size_t a = (size_t)((uintptr_t)(p + sizeof(void*)) % BPTREE_CACHE_LINE);
+		char *const node = p + sizeof(void*) + (a ? BPTREE_CACHE_LINE - a : 0);
+		((void**)node)[-1] = p;
+		return node;
+	}
+	return (void*)0;
+}
+
+BPTREE_EXPORTS void bptree_free_node(
+	void *const node/*!=NULL*/)
+{
+	BPTREE_ASSERT_PTR(node);
+	free(((void**)node)[-1]);
+}
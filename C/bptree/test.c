@@ -0,0 +1,352 @@
+/**********************************************************************************
+* B+tree of pointers to objects with nodes sized to cache lines
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* test.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "bptree.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define N 20000
+#define RANGE 50000
+
+struct obj {
+	unsigned key;
+	int inserted;
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+BPTREE_DEFINE(otree, struct obj, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+
+/* same, but nodes are searched by SIMD kernels */
+struct sobj {
+	uint64_t key;
+};
+
+#define SOBJ_KEY_OF(o) ((o)->key)
+BPTREE_DEFINE_SIMD(stree, struct sobj, uint64_t, SOBJ_KEY_OF, u64)
+
+static struct obj objs[N];
+static struct sobj sobjs[N];
+static struct obj *by_key[RANGE]; /* reference: object with given key */
+
+/* check order of keys, node fill and depth of leaves,
+  lo <= keys of the subtree < hi, returns number of objects, or -1 on error */
+static long check_subtree(const void *const n, const unsigned h, const int root,
+	const unsigned lo, const unsigned hi)
+{
+	unsigned i;
+	if (h > 1) {
+		const struct otree_inner_ *const in = (const struct otree_inner_*)n;
+		long count = 0;
+		if (in->count > otree_inner_keys_ || (root ? !in->count : in->count < otree_inner_min_))
+			return -1;
+		for (i = 0; i <= in->count; i++) {
+			const long c = check_subtree(in->children[i], h - 1, 0,
+				i ? in->keys[i - 1] : lo, i < in->count ? in->keys[i] : hi);
+			if (c < 0 || (i < in->count && (in->keys[i] < lo || in->keys[i] >= hi)))
+				return -1;
+			count += c;
+		}
+		return count;
+	}
+	{
+		const struct otree_leaf_ *const lf = (const struct otree_leaf_*)n;
+		if (lf->count > otree_leaf_keys_ || (root ? !lf->count : lf->count < otree_leaf_min_))
+			return -1;
+		for (i = 0; i < lf->count; i++) {
+			if (lf->keys[i] < lo || lf->keys[i] >= hi || lf->objects[i]->key != lf->keys[i] ||
+				(i && lf->keys[i - 1] >= lf->keys[i]))
+			{
+				return -1;
+			}
+		}
+		return (long)lf->count;
+	}
+}
+
+static int check_tree(const struct bptree *const tree)
+{
+	if (!tree->root)
+		return !tree->height && !tree->count;
+	return 0 == (size_t)tree->root % BPTREE_CACHE_LINE &&
+		check_subtree(tree->root, tree->height, 1, 0, RANGE) == (long)tree->count;
+}
+
+/* iterate forward and backward, compare with the reference */
+static int check_iterate(const struct bptree *const tree)
+{
+	struct bptree_iter it;
+	const struct obj *o;
+	unsigned k = 0;
+	size_t found = 0;
+	for (o = otree_first(tree, &it); o; o = otree_next(&it)) {
+		while (k < RANGE && !by_key[k])
+			k++;
+		if (k == RANGE || by_key[k] != o)
+			return 0;
+		k++;
+		found++;
+	}
+	if (found != tree->count)
+		return 0;
+	for (o = otree_last(tree, &it); o; o = otree_prev(&it))
+		found--;
+	return !found;
+}
+
+/* count objects in range [a, b) with lower_bound, compare with the reference */
+static int check_range(const struct bptree *const tree, const unsigned a, const unsigned b)
+{
+	struct bptree_iter it;
+	const struct obj *o;
+	unsigned k = a, expected = 0, found = 0;
+	for (; k < b; k++)
+		expected += (by_key[k] != NULL);
+	for (o = otree_lower_bound(tree, a, &it); o && o->key < b; o = otree_next(&it))
+		found++;
+	if (found != expected)
+		return 0;
+	o = otree_upper_bound(tree, a, &it);
+	for (k = a + 1; k < RANGE && !by_key[k]; k++);
+	return o == (k < RANGE ? by_key[k] : NULL);
+}
+
+/* random keys, with extreme values */
+static uint64_t rand_key(void)
+{
+	static const uint64_t extremes[] = {0, 1, 0x7FFFFFFFu, 0x80000000u, 0xFFFFFFFFu,
+		0x7FFFFFFFFFFFFFFFull, 0x8000000000000000ull, 0xFFFFFFFFFFFFFFFFull};
+	const unsigned r = (unsigned)rand();
+	if (!(r % 4))
+		return extremes[(r >> 2) % (sizeof(extremes)/sizeof(extremes[0]))];
+	return ((uint64_t)(unsigned)rand() << 33) ^ ((uint64_t)(unsigned)rand() << 11) ^ (uint64_t)(unsigned)rand();
+}
+
+/* compare kernels of the selected level with a brute force count */
+static int check_kernels(void)
+{
+	int32_t i32[40];
+	uint32_t u32[40];
+	int64_t i64[40];
+	uint64_t u64[40];
+	unsigned n = 0, iter = 0;
+	for (; iter < 2000; iter++) {
+		const uint64_t k = rand_key();
+		size_t lt[4] = {0, 0, 0, 0}, le[4] = {0, 0, 0, 0};
+		unsigned i = 0;
+		n = iter % 40;
+		for (; i < n; i++) {
+			const uint64_t v = (iter & 1) ? rand_key() : k + (uint64_t)(rand() % 3) - 1;
+			i32[i] = (int32_t)(uint32_t)v;
+			u32[i] = (uint32_t)v;
+			i64[i] = (int64_t)v;
+			u64[i] = v;
+			lt[0] += i32[i] < (int32_t)(uint32_t)k;
+			le[0] += i32[i] <= (int32_t)(uint32_t)k;
+			lt[1] += u32[i] < (uint32_t)k;
+			le[1] += u32[i] <= (uint32_t)k;
+			lt[2] += i64[i] < (int64_t)k;
+			le[2] += i64[i] <= (int64_t)k;
+			lt[3] += u64[i] < k;
+			le[3] += u64[i] <= k;
+		}
+		if (btree_rank_lt_i32(i32, n, (int32_t)(uint32_t)k) != lt[0] ||
+			btree_rank_le_i32(i32, n, (int32_t)(uint32_t)k) != le[0] ||
+			btree_rank_lt_u32(u32, n, (uint32_t)k) != lt[1] ||
+			btree_rank_le_u32(u32, n, (uint32_t)k) != le[1] ||
+			btree_rank_lt_i64(i64, n, (int64_t)k) != lt[2] ||
+			btree_rank_le_i64(i64, n, (int64_t)k) != le[2] ||
+			btree_rank_lt_u64(u64, n, k) != lt[3] ||
+			btree_rank_le_u64(u64, n, k) != le[3] ||
+			btree_rank_lt_i32_inline(i32, n, (int32_t)(uint32_t)k) != lt[0] ||
+			btree_rank_le_i32_inline(i32, n, (int32_t)(uint32_t)k) != le[0] ||
+			btree_rank_lt_u32_inline(u32, n, (uint32_t)k) != lt[1] ||
+			btree_rank_le_u32_inline(u32, n, (uint32_t)k) != le[1] ||
+			btree_rank_lt_i64_inline(i64, n, (int64_t)k) != lt[2] ||
+			btree_rank_le_i64_inline(i64, n, (int64_t)k) != le[2] ||
+			btree_rank_lt_u64_inline(u64, n, k) != lt[3] ||
+			btree_rank_le_u64_inline(u64, n, k) != le[3])
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bptree tree;
+	struct bptree_iter it;
+	struct obj *existing = NULL;
+	unsigned i;
+	(void)argc, (void)argv;
+	TEST(sizeof(struct otree_inner_) <= BPTREE_NODE_SIZE);
+	TEST(sizeof(struct otree_leaf_) <= BPTREE_NODE_SIZE);
+	bptree_init(&tree);
+	TEST(!otree_first(&tree, &it) && !it.leaf);
+	TEST(!otree_last(&tree, &it));
+	TEST(!otree_search(&tree, 1));
+	TEST(!otree_remove(&tree, 1));
+	TEST(!otree_lower_bound(&tree, 1, &it));
+	{
+		/* small tree: root is a leaf */
+		objs[0].key = 30;
+		objs[1].key = 10;
+		objs[2].key = 20;
+		for (i = 0; i < 3; i++)
+			TEST(1 == otree_insert(&tree, &objs[i], NULL));
+		objs[3].key = 20;
+		TEST(0 == otree_insert(&tree, &objs[3], &existing) && existing == &objs[2]);
+		TEST(tree.height == 1 && tree.count == 3);
+		TEST(otree_search(&tree, 20) == &objs[2]);
+		TEST(otree_lower_bound(&tree, 11, &it) == &objs[2]);
+		TEST(otree_next(&it) == &objs[0]);
+		TEST(!otree_next(&it));
+		TEST(otree_upper_bound(&tree, 30, &it) == NULL);
+		TEST(otree_last(&tree, &it) == &objs[0]);
+		TEST(otree_prev(&it) == &objs[2]);
+		TEST(otree_prev(&it) == &objs[1]);
+		TEST(!otree_prev(&it));
+		TEST(otree_remove(&tree, 20) == &objs[2]);
+		TEST(otree_remove(&tree, 20) == NULL);
+		TEST(otree_remove(&tree, 10) == &objs[1]);
+		TEST(otree_remove(&tree, 30) == &objs[0]);
+		TEST(!tree.root && !tree.height && !tree.count);
+	}
+	{
+		/* random keys: insert all, then remove or re-insert every second object, several times */
+		int ok = 1;
+		unsigned round = 0;
+		srand(1);
+		for (i = 0; i < N; i++) {
+			objs[i].key = (unsigned)rand() % RANGE;
+			objs[i].inserted = otree_insert(&tree, &objs[i], NULL) == 1;
+			if (objs[i].inserted)
+				by_key[objs[i].key] = &objs[i];
+			if (!(i % 500) && !check_tree(&tree))
+				ok = 0;
+		}
+		TEST(ok);
+		TEST(tree.height > 2);
+		TEST(check_tree(&tree));
+		TEST(check_iterate(&tree));
+		TEST(check_range(&tree, 0, RANGE));
+		TEST(check_range(&tree, 100, 1000));
+		for (; round < 4; round++) {
+			for (i = round; i < N; i += 2) {
+				if (objs[i].inserted) {
+					if (otree_remove(&tree, objs[i].key) != &objs[i])
+						ok = 0;
+					by_key[objs[i].key] = NULL;
+					objs[i].inserted = 0;
+				}
+				else {
+					objs[i].key = (unsigned)rand() % RANGE;
+					objs[i].inserted = otree_insert(&tree, &objs[i], NULL) == 1;
+					if (objs[i].inserted)
+						by_key[objs[i].key] = &objs[i];
+				}
+				if (!(i % 250) && !check_tree(&tree))
+					ok = 0;
+			}
+			TEST(ok);
+			TEST(check_tree(&tree));
+			TEST(check_iterate(&tree));
+			TEST(check_range(&tree, 12345, 23456));
+			for (i = 0; i < RANGE && ok; i++) {
+				if (otree_search(&tree, i) != by_key[i])
+					ok = 0;
+			}
+			TEST(ok);
+		}
+		for (i = 0; i < N; i++) {
+			if (objs[i].inserted) {
+				if (otree_remove(&tree, objs[i].key) != &objs[i])
+					ok = 0;
+				by_key[objs[i].key] = NULL;
+				objs[i].inserted = 0;
+				if (!(i % 100) && !check_tree(&tree))
+					ok = 0;
+			}
+		}
+		TEST(ok);
+		TEST(!tree.root && !tree.height && !tree.count);
+	}
+	{
+		/* sequential keys, then free all nodes at once */
+		int ok = 1;
+		for (i = 0; i < N; i++) {
+			objs[i].key = i;
+			if (1 != otree_insert(&tree, &objs[i], NULL))
+				ok = 0;
+		}
+		TEST(ok);
+		TEST(check_tree(&tree));
+		TEST(otree_lower_bound(&tree, N/2, &it) == &objs[N/2]);
+		otree_destroy(&tree);
+		TEST(!tree.root && !tree.height && !tree.count);
+	}
+	{
+		/* SIMD kernels of all levels supported by the CPU */
+		const enum btree_simd_level best = btree_simd_detect();
+		int level = BTREE_SIMD_SCALAR;
+		for (; level <= (int)best; level++) {
+			TEST(btree_simd_select((enum btree_simd_level)level) == (enum btree_simd_level)level);
+			TEST(btree_simd_level() == (enum btree_simd_level)level);
+			printf("%s kernels:\n", btree_simd_level_name((enum btree_simd_level)level));
+			TEST(check_kernels());
+		}
+		TEST(btree_simd_select(BTREE_SIMD_LEVELS) == best);
+		printf("inline kernels: %s\n", btree_simd_level_name(BTREE_SIMD_INLINE_LEVEL));
+	}
+	{
+		/* tree of integer keys, searched by SIMD kernels */
+		int ok = 1;
+		for (i = 0; i < N; i++) {
+			sobjs[i].key = rand_key();
+			if (stree_insert(&tree, &sobjs[i], NULL) < 0)
+				ok = 0;
+		}
+		TEST(ok);
+		for (i = 0; i < N && ok; i++) {
+			const struct sobj *const o = stree_search(&tree, sobjs[i].key);
+			if (!o || o->key != sobjs[i].key || stree_lower_bound(&tree, sobjs[i].key, &it) != o)
+				ok = 0;
+		}
+		TEST(ok);
+		{
+			const struct sobj *o = stree_first(&tree, &it), *prev = NULL;
+			size_t count = 0;
+			for (; o; o = stree_next(&it), count++) {
+				if (prev && prev->key >= o->key)
+					ok = 0;
+				prev = o;
+			}
+			TEST(ok && count == tree.count);
+		}
+		for (i = 0; i < N; i++) {
+			const struct sobj *const o = stree_remove(&tree, sobjs[i].key);
+			if (o && o->key != sobjs[i].key)
+				ok = 0;
+		}
+		TEST(ok);
+		TEST(!tree.root && !tree.count);
+	}
+	printf("all tests OK\n");
+	return 0;
+}
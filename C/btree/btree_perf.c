@@ -0,0 +1,262 @@
+/**********************************************************************************
+* Hardware performance counters instrumentation of tree operations
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_perf.c */
+
+#if defined BTREE_PERF && defined __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for syscall() */
+#endif
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include <string.h> /* for memset() */
+#include "collections_config.h"
+#include "btree_perf.h"
+
+#define BTREE_PERF_CALIBRATION_LOOPS 1000
+
+static struct btree_perf_stat btree_perf_stats_[BTREE_PERF_OPS];
+
+/* measurement overhead: counters values of empty begin/end pair */
+static unsigned long long btree_perf_overhead_[BTREE_PERF_COUNTERS];
+
+/* bit mask of opened counters */
+static unsigned btree_perf_opened_ = 0;
+
+#if defined BTREE_PERF && defined __linux__
+
+/* all counters are in one group - to be scheduled together and read by one syscall */
+static int btree_perf_leader_ = -1;
+static int btree_perf_fds_[BTREE_PERF_COUNTERS] = {-1, -1, -1, -1};
+
+/* index of the counter in the group read buffer */
+static unsigned btree_perf_index_[BTREE_PERF_COUNTERS];
+static unsigned btree_perf_nr_ = 0;
+
+static int btree_perf_event_open_(
+	const unsigned type,
+	const unsigned long long config,
+	const int group_fd)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = group_fd == -1; /* group is enabled by the leader */
+	attr.exclude_kernel = 1; /* do not count syscalls made for reading counters */
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	/* measure the calling thread on any cpu */
+	return (int)syscall(__NR_perf_event_open, &attr, 0/*pid*/, -1/*cpu*/, group_fd, 0/*flags*/);
+}
+
+/* returns 0 on success, -1 if the counters cannot be read */
+static int btree_perf_read_(
+	unsigned long long values[BTREE_PERF_COUNTERS]/*out*/)
+{
+	/* PERF_FORMAT_GROUP: nr, values[nr] */
+	unsigned long long buf[1 + BTREE_PERF_COUNTERS];
+	unsigned i = 0;
+	if ((ssize_t)sizeof(buf[0])*(1 + btree_perf_nr_) !=
+		read(btree_perf_leader_, buf, sizeof(buf[0])*(1 + btree_perf_nr_)))
+	{
+		return -1;
+	}
+	for (; i < BTREE_PERF_COUNTERS; i++)
+		values[i] = (btree_perf_opened_ & (1u << i)) ? buf[1 + btree_perf_index_[i]] : 0;
+	return 0;
+}
+
+#endif /* BTREE_PERF && __linux__ */
+
+/* marks start values that could not be read, the operation is then not accounted */
+#define BTREE_PERF_INVALID_ (~0ull)
+
+BTREE_PERF_EXPORTS void btree_perf_begin_(
+	unsigned long long start[BTREE_PERF_COUNTERS]/*out*/)
+{
+#if defined BTREE_PERF && defined __linux__
+	if (btree_perf_opened_ && !btree_perf_read_(start))
+		return;
+#endif
+	{
+		unsigned i = 0;
+		for (; i < BTREE_PERF_COUNTERS; i++)
+			start[i] = BTREE_PERF_INVALID_;
+	}
+}
+
+BTREE_PERF_EXPORTS void btree_perf_end_(
+	const enum btree_perf_op op,
+	const unsigned long long start[BTREE_PERF_COUNTERS])
+{
+#if defined BTREE_PERF && defined __linux__
+	unsigned long long values[BTREE_PERF_COUNTERS];
+	/* skip the sample if either read has failed */
+	if (btree_perf_opened_ && start[0] != BTREE_PERF_INVALID_ && !btree_perf_read_(values)) {
+		struct btree_perf_stat *const st = &btree_perf_stats_[op];
+		unsigned i = 0;
+		for (; i < BTREE_PERF_COUNTERS; i++)
+			st->sum[i] += values[i] - start[i];
+		st->calls++;
+	}
+#else
+	(void)op, (void)start;
+#endif
+}
+
+BTREE_PERF_EXPORTS void btree_perf_reset(void)
+{
+	memset(btree_perf_stats_, 0, sizeof(btree_perf_stats_));
+}
+
+BTREE_PERF_EXPORTS void btree_perf_close(void)
+{
+#if defined BTREE_PERF && defined __linux__
+	unsigned i = 0;
+	for (; i < BTREE_PERF_COUNTERS; i++) {
+		if (btree_perf_fds_[i] != -1) {
+			(void)close(btree_perf_fds_[i]);
+			btree_perf_fds_[i] = -1;
+		}
+	}
+	btree_perf_leader_ = -1;
+	btree_perf_nr_ = 0;
+#endif
+	btree_perf_opened_ = 0;
+}
+
+BTREE_PERF_EXPORTS unsigned btree_perf_open(void)
+{
+	btree_perf_close();
+	btree_perf_reset();
+	memset(btree_perf_overhead_, 0, sizeof(btree_perf_overhead_));
+#if defined BTREE_PERF && defined __linux__
+	{
+		static const struct {
+			unsigned type;
+			unsigned long long config;
+		} events[BTREE_PERF_COUNTERS] = {
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+			{PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+				(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+			{PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+		};
+		unsigned i = 0;
+		for (; i < BTREE_PERF_COUNTERS; i++) {
+			/* the first successfully opened counter becomes the leader of the group */
+			const int fd = btree_perf_event_open_(events[i].type, events[i].config, btree_perf_leader_);
+			if (fd != -1) {
+				if (btree_perf_leader_ == -1)
+					btree_perf_leader_ = fd;
+				btree_perf_fds_[i] = fd;
+				btree_perf_index_[i] = btree_perf_nr_++;
+				btree_perf_opened_ |= 1u << i;
+			}
+		}
+		if (btree_perf_opened_) {
+			if (ioctl(btree_perf_leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1)
+				btree_perf_close();
+			else {
+				/* calibrate: measure empty operation, take the minimum */
+				struct btree_perf_stat *const st = &btree_perf_stats_[BTREE_PERF_SEARCH];
+				unsigned j = 0;
+				for (i = 0; i < BTREE_PERF_COUNTERS; i++)
+					btree_perf_overhead_[i] = ~0ull;
+				for (; j < BTREE_PERF_CALIBRATION_LOOPS; j++) {
+					unsigned long long s[BTREE_PERF_COUNTERS];
+					btree_perf_begin_(s);
+					btree_perf_end_(BTREE_PERF_SEARCH, s);
+					for (i = 0; i < BTREE_PERF_COUNTERS && st->calls; i++) {
+						if (btree_perf_overhead_[i] > st->sum[i])
+							btree_perf_overhead_[i] = st->sum[i];
+					}
+					btree_perf_reset();
+				}
+				/* no sample has been taken */
+				for (i = 0; i < BTREE_PERF_COUNTERS; i++) {
+					if (btree_perf_overhead_[i] == ~0ull)
+						btree_perf_overhead_[i] = 0;
+				}
+			}
+		}
+	}
+#endif
+	return btree_perf_opened_;
+}
+
+BTREE_PERF_EXPORTS unsigned btree_perf_snapshot(
+	struct btree_perf_stat stats[BTREE_PERF_OPS]/*out*/)
+{
+	unsigned op = 0;
+	for (; op < BTREE_PERF_OPS; op++) {
+		const struct btree_perf_stat *const st = &btree_perf_stats_[op];
+		unsigned i = 0;
+		stats[op].calls = st->calls;
+		for (; i < BTREE_PERF_COUNTERS; i++) {
+			const unsigned long long overhead = st->calls*btree_perf_overhead_[i];
+			stats[op].sum[i] = st->sum[i] > overhead ? st->sum[i] - overhead : 0;
+		}
+	}
+	return btree_perf_opened_;
+}
+
+BTREE_PERF_EXPORTS const char *btree_perf_op_name(
+	const enum btree_perf_op op)
+{
+	static const char *const names[BTREE_PERF_OPS] = {
+		"btree_search",
+		"btree_search_parent",
+		"prbtree_rebalance",
+		"prbtree_remove",
+		"pcrbtree_rebalance",
+		"pcrbtree_remove"
+	};
+	return (unsigned)op < BTREE_PERF_OPS ? names[op] : "?";
+}
+
+BTREE_PERF_EXPORTS const char *btree_perf_counter_name(
+	const enum btree_perf_counter counter)
+{
+	static const char *const names[BTREE_PERF_COUNTERS] = {
+		"cycles",
+		"l1d_misses",
+		"llc_misses",
+		"branch_misses"
+	};
+	return (unsigned)counter < BTREE_PERF_COUNTERS ? names[counter] : "?";
+}
+
+BTREE_PERF_EXPORTS void btree_perf_report(
+	FILE *const f/*!=NULL*/)
+{
+	struct btree_perf_stat stats[BTREE_PERF_OPS];
+	const unsigned opened = btree_perf_snapshot(stats);
+	unsigned op = 0, i;
+	fprintf(f, "%-20s %12s", "operation", "calls");
+	for (i = 0; i < BTREE_PERF_COUNTERS; i++)
+		fprintf(f, " %14s", btree_perf_counter_name((enum btree_perf_counter)i));
+	fprintf(f, "\n");
+	for (; op < BTREE_PERF_OPS; op++) {
+		const struct btree_perf_stat *const st = &stats[op];
+		if (!st->calls)
+			continue;
+		fprintf(f, "%-20s %12llu", btree_perf_op_name((enum btree_perf_op)op), st->calls);
+		for (i = 0; i < BTREE_PERF_COUNTERS; i++) {
+			if (opened & (1u << i))
+				fprintf(f, " %14.2f", (double)st->sum[i]/(double)st->calls);
+			else
+				fprintf(f, " %14s", "n/a");
+		}
+		fprintf(f, "\n");
+	}
+}
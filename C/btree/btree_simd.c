@@ -0,0 +1,230 @@
+/**********************************************************************************
+* SIMD search of integer keys in arrays of tree nodes
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_simd.c */
+
+#include "collections_config.h"
+#include "btree_simd.h"
+
+#ifdef BTREE_SIMD_X86_
+#ifdef _MSC_VER
+#include <intrin.h> /* for __cpuid() */
+#endif
+#if defined __GNUC__ || defined __clang__
+#define BTREE_SIMD_TARGET_(t) __attribute__((target(t)))
+#else
+#define BTREE_SIMD_TARGET_(t)
+#endif
+#endif /* BTREE_SIMD_X86_ */
+
+/* kernels of one implementation level, see btree_simd.h */
+struct btree_simd_kernels_ {
+	size_t (*lt32)(const int32_t *keys, size_t count, int32_t key, uint32_t bias); /* keys < key */
+	size_t (*gt32)(const int32_t *keys, size_t count, int32_t key, uint32_t bias); /* keys > key */
+	size_t (*lt64)(const int64_t *keys, size_t count, int64_t key, uint64_t bias);
+	size_t (*gt64)(const int64_t *keys, size_t count, int64_t key, uint64_t bias);
+	enum btree_simd_level level;
+};
+
+static const struct btree_simd_kernels_ btree_simd_scalar_ = {
+	btree_simd_lt32_scalar_,
+	btree_simd_gt32_scalar_,
+	btree_simd_lt64_scalar_,
+	btree_simd_gt64_scalar_,
+	BTREE_SIMD_SCALAR
+};
+
+#ifdef BTREE_SIMD_X86_
+
+#define BTREE_SIMD_SSE42_ BTREE_SIMD_TARGET_("sse4.2") static
+#define BTREE_SIMD_AVX2_  BTREE_SIMD_TARGET_("avx2") static
+
+BTREE_SIMD_SSE_KERNEL_(BTREE_SIMD_SSE42_, btree_simd_lt32_sse42_, int32_t, uint32_t, 4,
+	_mm_set1_epi32, _mm_cmpgt_epi32, _mm_sub_epi32, 0, btree_simd_lt32_scalar_)
+BTREE_SIMD_SSE_KERNEL_(BTREE_SIMD_SSE42_, btree_simd_gt32_sse42_, int32_t, uint32_t, 4,
+	_mm_set1_epi32, _mm_cmpgt_epi32, _mm_sub_epi32, 1, btree_simd_gt32_scalar_)
+BTREE_SIMD_SSE_KERNEL_(BTREE_SIMD_SSE42_, btree_simd_lt64_sse42_, int64_t, uint64_t, 2,
+	_mm_set1_epi64x, _mm_cmpgt_epi64, _mm_sub_epi64, 0, btree_simd_lt64_scalar_)
+BTREE_SIMD_SSE_KERNEL_(BTREE_SIMD_SSE42_, btree_simd_gt64_sse42_, int64_t, uint64_t, 2,
+	_mm_set1_epi64x, _mm_cmpgt_epi64, _mm_sub_epi64, 1, btree_simd_gt64_scalar_)
+
+BTREE_SIMD_AVX2_KERNEL_(BTREE_SIMD_AVX2_, btree_simd_lt32_avx2_, int32_t, uint32_t, 8,
+	_mm256_set1_epi32, _mm256_cmpgt_epi32, _mm256_sub_epi32, 0, btree_simd_lt32_scalar_)
+BTREE_SIMD_AVX2_KERNEL_(BTREE_SIMD_AVX2_, btree_simd_gt32_avx2_, int32_t, uint32_t, 8,
+	_mm256_set1_epi32, _mm256_cmpgt_epi32, _mm256_sub_epi32, 1, btree_simd_gt32_scalar_)
+BTREE_SIMD_AVX2_KERNEL_(BTREE_SIMD_AVX2_, btree_simd_lt64_avx2_, int64_t, uint64_t, 4,
+	_mm256_set1_epi64x, _mm256_cmpgt_epi64, _mm256_sub_epi64, 0, btree_simd_lt64_scalar_)
+BTREE_SIMD_AVX2_KERNEL_(BTREE_SIMD_AVX2_, btree_simd_gt64_avx2_, int64_t, uint64_t, 4,
+	_mm256_set1_epi64x, _mm256_cmpgt_epi64, _mm256_sub_epi64, 1, btree_simd_gt64_scalar_)
+
+static const struct btree_simd_kernels_ btree_simd_sse42_ = {
+	btree_simd_lt32_sse42_,
+	btree_simd_gt32_sse42_,
+	btree_simd_lt64_sse42_,
+	btree_simd_gt64_sse42_,
+	BTREE_SIMD_SSE42
+};
+
+static const struct btree_simd_kernels_ btree_simd_avx2_ = {
+	btree_simd_lt32_avx2_,
+	btree_simd_gt32_avx2_,
+	btree_simd_lt64_avx2_,
+	btree_simd_gt64_avx2_,
+	BTREE_SIMD_AVX2
+};
+
+#endif /* BTREE_SIMD_X86_ */
+
+BTREE_SIMD_EXPORTS enum btree_simd_level btree_simd_detect(void)
+{
+#ifdef BTREE_SIMD_X86_
+#ifdef _MSC_VER
+	int r[4];
+	__cpuid(r, 1);
+	if (!((r[2] >> 20) & 1))
+		return BTREE_SIMD_SCALAR;
+	/* AVX: OSXSAVE and AVX bits, the OS saves YMM registers */
+	if (((r[2] >> 27) & 1) && ((r[2] >> 28) & 1) && 6 == (_xgetbv(0) & 6)) {
+		__cpuidex(r, 7, 0);
+		if ((r[1] >> 5) & 1)
+			return BTREE_SIMD_AVX2;
+	}
+	return BTREE_SIMD_SSE42;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return BTREE_SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return BTREE_SIMD_SSE42;
+#endif
+#endif /* BTREE_SIMD_X86_ */
+	return BTREE_SIMD_SCALAR;
+}
+
+/* the pointer to selected kernels is published atomically: threads calling the kernels
+  for the first time may select them concurrently, each stores the same pointer */
+#if defined __GNUC__ || defined __clang__
+#define btree_simd_load_kernels_(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define btree_simd_store_kernels_(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#elif defined _MSC_VER
+/* aligned volatile accesses are atomic, kernels are constant, so only the pointer must not be torn */
+#define btree_simd_load_kernels_(p)     (*(const struct btree_simd_kernels_ *const volatile*)(p))
+#define btree_simd_store_kernels_(p, v) (*(const struct btree_simd_kernels_ *volatile*)(p) = (v))
+#else
+#define btree_simd_load_kernels_(p)     (*(p))
+#define btree_simd_store_kernels_(p, v) (*(p) = (v))
+#endif
+
+/* selected at the first call of a kernel, the selection is idempotent */
+static const struct btree_simd_kernels_ *btree_simd_kernels_ = NULL;
+
+BTREE_SIMD_EXPORTS enum btree_simd_level btree_simd_select(
+	const enum btree_simd_level level)
+{
+	const enum btree_simd_level supported = btree_simd_detect();
+	const enum btree_simd_level l = level < supported ? level : supported;
+#ifdef BTREE_SIMD_X86_
+	btree_simd_store_kernels_(&btree_simd_kernels_,
+		BTREE_SIMD_AVX2 == l ? &btree_simd_avx2_ :
+		BTREE_SIMD_SSE42 == l ? &btree_simd_sse42_ : &btree_simd_scalar_);
+#else
+	btree_simd_store_kernels_(&btree_simd_kernels_, &btree_simd_scalar_);
+#endif
+	return l;
+}
+
+static inline const struct btree_simd_kernels_ *btree_simd_get_(void)
+{
+	const struct btree_simd_kernels_ *k = btree_simd_load_kernels_(&btree_simd_kernels_);
+	if (!k) {
+		(void)btree_simd_select(BTREE_SIMD_LEVELS);
+		k = btree_simd_load_kernels_(&btree_simd_kernels_);
+	}
+	return k;
+}
+
+BTREE_SIMD_EXPORTS enum btree_simd_level btree_simd_level(void)
+{
+	return btree_simd_get_()->level;
+}
+
+BTREE_SIMD_EXPORTS const char *btree_simd_level_name(
+	const enum btree_simd_level level)
+{
+	switch (level) {
+		case BTREE_SIMD_SCALAR: return "scalar";
+		case BTREE_SIMD_SSE42:  return "sse4.2";
+		case BTREE_SIMD_AVX2:   return "avx2";
+		case BTREE_SIMD_LEVELS:
+		default:                break;
+	}
+	return "unknown";
+}
+
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_i32(
+	const int32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int32_t key)
+{
+	return btree_simd_get_()->lt32(keys, count, key, 0);
+}
+
+BTREE_SIMD_EXPORTS size_t btree_rank_le_i32(
+	const int32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int32_t key)
+{
+	return count - btree_simd_get_()->gt32(keys, count, key, 0);
+}
+
+/* signed and unsigned variants of a type may alias each other */
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_u32(
+	const uint32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint32_t key)
+{
+	return btree_simd_get_()->lt32((const int32_t*)keys, count, (int32_t)key, BTREE_SIMD_SIGN32_);
+}
+
+BTREE_SIMD_EXPORTS size_t btree_rank_le_u32(
+	const uint32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint32_t key)
+{
+	return count - btree_simd_get_()->gt32((const int32_t*)keys, count, (int32_t)key, BTREE_SIMD_SIGN32_);
+}
+
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_i64(
+	const int64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int64_t key)
+{
+	return btree_simd_get_()->lt64(keys, count, key, 0);
+}
+
+BTREE_SIMD_EXPORTS size_t btree_rank_le_i64(
+	const int64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int64_t key)
+{
+	return count - btree_simd_get_()->gt64(keys, count, key, 0);
+}
+
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_u64(
+	const uint64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint64_t key)
+{
+	return btree_simd_get_()->lt64((const int64_t*)keys, count, (int64_t)key, BTREE_SIMD_SIGN64_);
+}
+
+BTREE_SIMD_EXPORTS size_t btree_rank_le_u64(
+	const uint64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint64_t key)
+{
+	return count - btree_simd_get_()->gt64((const int64_t*)keys, count, (int64_t)key, BTREE_SIMD_SIGN64_);
+}
@@ -0,0 +1,94 @@
+/**********************************************************************************
+* Rebalancing statistics of tree operations
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_stats.c */
+
+#include <string.h> /* for memset() */
+#include "collections_config.h"
+#include "btree_stats.h"
+
+BTREE_STATS_EXPORTS struct btree_stats btree_stats_[BTREE_STATS_TREES];
+
+BTREE_STATS_EXPORTS void btree_stats_reset(void)
+{
+	memset(btree_stats_, 0, sizeof(btree_stats_));
+}
+
+BTREE_STATS_EXPORTS void btree_stats_snapshot(
+	const enum btree_stats_tree tree,
+	struct btree_stats *const stats/*!=NULL,out*/)
+{
+	if ((unsigned)tree < BTREE_STATS_TREES)
+		*stats = btree_stats_[tree];
+	else
+		memset(stats, 0, sizeof(*stats));
+}
+
+BTREE_STATS_EXPORTS const char *btree_stats_tree_name(
+	const enum btree_stats_tree tree)
+{
+	static const char *const names[BTREE_STATS_TREES] = {
+		"btree",
+		"prbtree",
+		"pcrbtree"
+	};
+	return (unsigned)tree < BTREE_STATS_TREES ? names[tree] : "?";
+}
+
+static double btree_stats_avg_(
+	const unsigned long long sum,
+	const unsigned long long count)
+{
+	return count ? (double)sum/(double)count : 0.0;
+}
+
+static void btree_stats_report_cases_(
+	FILE *const f/*!=NULL*/,
+	const unsigned long long cases[],
+	const unsigned n,
+	const char *const names[],
+	const unsigned long long count)
+{
+	unsigned i = 0;
+	for (; i < n; i++) {
+		if (cases[i])
+			fprintf(f, "  case %-5s %14llu %10.4f per op\n", names[i], cases[i], btree_stats_avg_(cases[i], count));
+	}
+}
+
+BTREE_STATS_EXPORTS void btree_stats_report(
+	FILE *const f/*!=NULL*/)
+{
+	static const char *const insert_cases[BTREE_STATS_INSERT_CASES] = {
+		"1", "2", "3,4"
+	};
+	static const char *const remove_cases[BTREE_STATS_REMOVE_CASES] = {
+		"1", "2", "3", "4", "5", "6", "4,7", "5,8", "6,9"
+	};
+	unsigned t = 0;
+	for (; t < BTREE_STATS_TREES; t++) {
+		const struct btree_stats *const st = &btree_stats_[t];
+		if (!st->searches && !st->inserts && !st->removes)
+			continue;
+		fprintf(f, "%s:\n", btree_stats_tree_name((enum btree_stats_tree)t));
+		if (st->searches) {
+			fprintf(f, " searches %14llu, average depth %.2f\n",
+				st->searches, btree_stats_avg_(st->search_depth, st->searches));
+		}
+		if (st->inserts) {
+			fprintf(f, " inserts  %14llu, rotations %.4f, recolors %.4f per op\n", st->inserts,
+				btree_stats_avg_(st->insert_rotations, st->inserts),
+				btree_stats_avg_(st->insert_recolors, st->inserts));
+			btree_stats_report_cases_(f, st->insert_cases, BTREE_STATS_INSERT_CASES, insert_cases, st->inserts);
+		}
+		if (st->removes) {
+			fprintf(f, " removes  %14llu, rotations %.4f, recolors %.4f per op\n", st->removes,
+				btree_stats_avg_(st->remove_rotations, st->removes),
+				btree_stats_avg_(st->remove_recolors, st->removes));
+			btree_stats_report_cases_(f, st->remove_cases, BTREE_STATS_REMOVE_CASES, remove_cases, st->removes);
+		}
+	}
+}
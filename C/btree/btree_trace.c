@@ -0,0 +1,144 @@
+/**********************************************************************************
+* Recording and loading of traces of tree operations
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_trace.c */
+
+#include <stdio.h>
+#include <stdlib.h> /* for malloc() */
+#include <string.h> /* for memcmp() */
+#include "collections_config.h"
+#include "btree_trace.h"
+
+#define BTREE_TRACE_BUFFER_RECORDS 4096
+
+BTREE_TRACE_EXPORTS int btree_trace_active_ = 0;
+
+static FILE *btree_trace_file_ = NULL;
+static int btree_trace_error_ = 0;
+
+/* buffered records */
+static unsigned char btree_trace_buf_[BTREE_TRACE_BUFFER_RECORDS*BTREE_TRACE_RECORD_SIZE];
+static size_t btree_trace_filled_ = 0; /* in bytes */
+
+static void btree_trace_flush_(void)
+{
+	if (btree_trace_filled_ != fwrite(btree_trace_buf_, 1, btree_trace_filled_, btree_trace_file_))
+		btree_trace_error_ = 1;
+	btree_trace_filled_ = 0;
+}
+
+BTREE_TRACE_EXPORTS int btree_trace_start(
+	const char *const path/*!=NULL*/)
+{
+	if (btree_trace_file_)
+		return -1; /* already started */
+	btree_trace_file_ = fopen(path, "wb");
+	if (!btree_trace_file_)
+		return -1;
+	btree_trace_error_ = 0;
+	btree_trace_filled_ = 0;
+	if (BTREE_TRACE_HEADER_SIZE != fwrite(BTREE_TRACE_MAGIC, 1, BTREE_TRACE_HEADER_SIZE, btree_trace_file_)) {
+		(void)fclose(btree_trace_file_);
+		btree_trace_file_ = NULL;
+		return -1;
+	}
+	btree_trace_active_ = 1;
+	return 0;
+}
+
+BTREE_TRACE_EXPORTS int btree_trace_stop(void)
+{
+	if (!btree_trace_file_)
+		return -1; /* not started */
+	btree_trace_active_ = 0;
+	btree_trace_flush_();
+	if (fclose(btree_trace_file_))
+		btree_trace_error_ = 1;
+	btree_trace_file_ = NULL;
+	return btree_trace_error_ ? -1 : 0;
+}
+
+BTREE_TRACE_EXPORTS void btree_trace_record(
+	const enum btree_trace_op op,
+	const unsigned long long key)
+{
+	if (btree_trace_active_) {
+		unsigned char *const r = &btree_trace_buf_[btree_trace_filled_];
+		unsigned i = 0;
+		r[0] = (unsigned char)op;
+		for (; i < 8; i++)
+			r[1 + i] = (unsigned char)(key >> 8*i);
+		btree_trace_filled_ += BTREE_TRACE_RECORD_SIZE;
+		if (btree_trace_filled_ == sizeof(btree_trace_buf_))
+			btree_trace_flush_();
+	}
+}
+
+BTREE_TRACE_EXPORTS struct btree_trace_record *btree_trace_load(
+	const char *const path/*!=NULL*/,
+	size_t *const count/*!=NULL,out*/)
+{
+	struct btree_trace_record *records = NULL;
+	size_t n = 0, capacity = 0;
+	unsigned char buf[BTREE_TRACE_RECORD_SIZE];
+	FILE *const f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+	if (BTREE_TRACE_HEADER_SIZE != fread(buf, 1, BTREE_TRACE_HEADER_SIZE, f) ||
+		memcmp(buf, BTREE_TRACE_MAGIC, BTREE_TRACE_HEADER_SIZE))
+	{
+		(void)fclose(f);
+		return NULL;
+	}
+	for (;;) {
+		const size_t read = fread(buf, 1, BTREE_TRACE_RECORD_SIZE, f);
+		unsigned long long key = 0;
+		unsigned i = 8;
+		if (read != BTREE_TRACE_RECORD_SIZE) {
+			if (read || ferror(f))
+				goto err; /* truncated record */
+			break;
+		}
+		if (buf[0] >= BTREE_TRACE_OPS)
+			goto err;
+		if (n == capacity) {
+			struct btree_trace_record *const r = (struct btree_trace_record*)realloc(records,
+				sizeof(*records)*(capacity = capacity ? capacity*2 : 1024));
+			if (!r)
+				goto err;
+			records = r;
+		}
+		while (i)
+			key = (key << 8) | buf[i--];
+		records[n].key = key;
+		records[n].op = (enum btree_trace_op)buf[0];
+		n++;
+	}
+	(void)fclose(f);
+	if (!records) {
+		/* empty trace */
+		records = (struct btree_trace_record*)malloc(sizeof(*records));
+		if (!records)
+			return NULL;
+	}
+	*count = n;
+	return records;
+err:
+	free(records);
+	(void)fclose(f);
+	return NULL;
+}
+
+BTREE_TRACE_EXPORTS const char *btree_trace_op_name(
+	const enum btree_trace_op op)
+{
+	static const char *const names[BTREE_TRACE_OPS] = {
+		"search",
+		"insert",
+		"remove"
+	};
+	return (unsigned)op < BTREE_TRACE_OPS ? names[op] : "?";
+}
@@ -370,6 +370,64 @@ int main(int argc, char *argv[])
 		TEST(c > 0);
 		TEST(parent == &n1.node);
 	}
+	{
+		union search_test1_key k0 = {0}, k7 = {7}, k15 = {15}, k16 = {16};
+		struct btree_node *u;
+		TEST(btree_lower_bound(tree, &k0.key, test1_comparator) == &n1.node);
+		TEST(btree_lower_bound(tree, &k7.key, test1_comparator) == &n7.node);
+		TEST(btree_lower_bound(tree, &k16.key, test1_comparator) == NULL);
+		TEST(btree_upper_bound(tree, &k0.key, test1_comparator) == &n1.node);
+		TEST(btree_upper_bound(tree, &k7.key, test1_comparator) == &n8.node);
+		TEST(btree_upper_bound(tree, &k15.key, test1_comparator) == NULL);
+		TEST(btree_equal_range(tree, &k7.key, test1_comparator, &u) == &n7.node);
+		TEST(u == &n8.node);
+		TEST(btree_equal_range(tree, &k0.key, test1_comparator, &u) == &n1.node);
+		TEST(u == &n1.node);
+		TEST(btree_equal_range(tree, &k16.key, test1_comparator, &u) == NULL);
+		TEST(u == NULL);
+	}
+	{
+		const struct btree_node *r, *u, *n = tree;
+		BTREE_LOWER_BOUND(r, n, BTREE_KEY_COMPARATOR(tree_node_from_btree_node(n)->key, 12));
+		TEST(r == &n12.node);
+		n = tree;
+		BTREE_UPPER_BOUND(r, n, BTREE_KEY_COMPARATOR(tree_node_from_btree_node(n)->key, 12));
+		TEST(r == &n13.node);
+		n = tree;
+		BTREE_EQUAL_RANGE(r, u, n, BTREE_KEY_COMPARATOR(tree_node_from_btree_node(n)->key, 12));
+		TEST(r == &n12.node);
+		TEST(u == &n13.node);
+		n = tree;
+		BTREE_EQUAL_RANGE(r, u, n, BTREE_KEY_COMPARATOR(tree_node_from_btree_node(n)->key, 16));
+		TEST(r == NULL);
+		TEST(u == NULL);
+	}
+	{
+		/* tree with non-unique keys:
+		      2
+		   2     2
+		 1         3 */
+		struct tree_node d1  = {{{NULL,NULL}}, 1};
+		struct tree_node d3  = {{{NULL,NULL}}, 3};
+		struct tree_node d2a = {{{NULL,NULL}}, 2};
+		struct tree_node d2c = {{{NULL,NULL}}, 2};
+		struct tree_node d2b = {{{NULL,NULL}}, 2};
+		union search_test1_key k = {2};
+		struct btree_node *u;
+		const struct btree_node *r_, *u_, *n;
+		d2a.node.btree_left = &d1.node;
+		d2c.node.btree_right = &d3.node;
+		d2b.node.btree_left = &d2a.node;
+		d2b.node.btree_right = &d2c.node;
+		TEST(btree_lower_bound(&d2b.node, &k.key, test1_comparator) == &d2a.node);
+		TEST(btree_upper_bound(&d2b.node, &k.key, test1_comparator) == &d3.node);
+		TEST(btree_equal_range(&d2b.node, &k.key, test1_comparator, &u) == &d2a.node);
+		TEST(u == &d3.node);
+		n = &d2b.node;
+		BTREE_EQUAL_RANGE(r_, u_, n, BTREE_KEY_COMPARATOR(tree_node_from_btree_node(n)->key, 2));
+		TEST(r_ == &d2a.node);
+		TEST(u_ == &d3.node);
+	}
 	{
 		/* find any node in range [2..5] */
 		const struct btree_node *n = tree;
@@ -0,0 +1,184 @@
+/**********************************************************************************
+* Epoch-based reclamation of memory read by concurrent lock-free readers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* epoch.c */
+
+#include <stdlib.h> /* for realloc() */
+#include <string.h> /* for memmove() */
+#include "collections_config.h"
+#include "epoch.h"
+
+#if defined __GNUC__ || defined __clang__
+
+#define epoch_load_ptr_(p)        __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define epoch_store_ptr_(p, v)    __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define epoch_cas_ptr_(p, old, v) __atomic_compare_exchange_n(p, &(old), v, 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)
+#define epoch_increment_(p)       __atomic_add_fetch(p, (size_t)1, __ATOMIC_SEQ_CST)
+
+#elif defined _MSC_VER
+
+#define epoch_load_ptr_(p)        (*(struct epoch_reader *const volatile*)(p))
+#define epoch_store_ptr_(p, v)    (_ReadWriteBarrier(), *(struct epoch_reader *volatile*)(p) = (v))
+#define epoch_cas_ptr_(p, old, v) epoch_cas_reader_((struct epoch_reader *volatile*)(p), &(old), v)
+#ifdef _M_X64
+#define epoch_increment_(p)       ((size_t)_InterlockedIncrement64((volatile __int64*)(p)))
+#else
+#define epoch_increment_(p)       ((size_t)_InterlockedIncrement((volatile long*)(p)))
+#endif
+
+/* on failure, store the observed value into *old - as __atomic_compare_exchange_n() does */
+static int epoch_cas_reader_(
+	struct epoch_reader *volatile *const p/*!=NULL*/,
+	struct epoch_reader **const old/*!=NULL,in,out*/,
+	struct epoch_reader *const v)
+{
+	struct epoch_reader *const x = (struct epoch_reader*)_InterlockedCompareExchangePointer(
+		(void *volatile*)p, v, *old);
+	if (x == *old)
+		return 1;
+	*old = x;
+	return 0;
+}
+
+#endif
+
+EPOCH_EXPORTS void epoch_register(
+	struct epoch_domain *const d/*!=NULL*/,
+	struct epoch_reader *const r/*!=NULL,out*/)
+{
+	struct epoch_reader *head;
+	EPOCH_ASSERT_PTR(d);
+	EPOCH_ASSERT_PTR(r);
+	r->epoch = 0;
+	do {
+		head = epoch_load_ptr_(&d->readers);
+		r->next = head;
+	} while (!epoch_cas_ptr_(&d->readers, head, r));
+}
+
+EPOCH_EXPORTS void epoch_unregister(
+	struct epoch_domain *const d/*!=NULL*/,
+	struct epoch_reader *const r/*!=NULL*/)
+{
+	struct epoch_reader *head = r;
+	EPOCH_ASSERT_PTR(d);
+	EPOCH_ASSERT_PTR(r);
+	BTREE_ASSERT(!r->epoch);
+	/* new readers are pushed to the head concurrently, other links are changed only by writers */
+	if (!epoch_cas_ptr_(&d->readers, head, r->next)) {
+		struct epoch_reader *p = head;
+		while (p->next != r)
+			p = p->next;
+		epoch_store_ptr_(&p->next, r->next);
+	}
+	r->next = (struct epoch_reader*)0;
+}
+
+/* the oldest epoch announced by readers, (size_t)-1 if there are no readers in read sections */
+static size_t epoch_oldest_(
+	const struct epoch_domain *const d/*!=NULL*/)
+{
+	size_t oldest = (size_t)-1;
+	const struct epoch_reader *r = epoch_load_ptr_(&d->readers);
+	for (; r; r = epoch_load_ptr_(&r->next)) {
+		const size_t e = epoch_load_acquire_(&r->epoch); /* pairs with epoch_leave() */
+		if (e && e < oldest)
+			oldest = e;
+	}
+	return oldest;
+}
+
+/* destroy retired memory of first n entries */
+static void epoch_free_(
+	struct epoch_domain *const d/*!=NULL*/,
+	const size_t n)
+{
+	size_t i = 0;
+	for (; i < n; i++)
+		d->retired[i].destroy(d->retired[i].ptr, d->retired[i].ctx);
+	d->retired_count -= n;
+	if (d->retired_count)
+		memmove(d->retired, d->retired + n, d->retired_count*sizeof(*d->retired));
+}
+
+EPOCH_EXPORTS void epoch_retire(
+	struct epoch_domain *const d/*!=NULL*/,
+	void *const ptr,
+	void (*const destroy)(void *ptr, void *ctx)/*!=NULL*/,
+	void *const ctx)
+{
+	struct epoch_retired *x;
+	EPOCH_ASSERT_PTR(d);
+	EPOCH_ASSERT_PTR(destroy);
+	if (d->retired_count == d->retired_capacity) {
+		const size_t c = d->retired_capacity ? 2*d->retired_capacity : 64;
+		x = c <= (size_t)-1/sizeof(*x) ?
+			(struct epoch_retired*)realloc(d->retired, c*sizeof(*x)) : (struct epoch_retired*)0;
+		if (!x) {
+			/* cannot defer: wait for readers that may reference the memory */
+			epoch_synchronize(d);
+			destroy(ptr, ctx);
+			return;
+		}
+		d->retired = x;
+		d->retired_capacity = c;
+	}
+	x = &d->retired[d->retired_count++];
+	x->ptr = ptr;
+	x->destroy = destroy;
+	x->ctx = ctx;
+	x->epoch = epoch_load_(&d->epoch);
+}
+
+EPOCH_EXPORTS size_t epoch_reclaim(
+	struct epoch_domain *const d/*!=NULL*/)
+{
+	size_t oldest, n = 0;
+	EPOCH_ASSERT_PTR(d);
+	if (!d->retired_count)
+		return 0;
+	/* readers entering from now announce the new epoch and cannot reach retired memory */
+	(void)epoch_increment_(&d->epoch);
+	epoch_fence_();
+	oldest = epoch_oldest_(d);
+	while (n < d->retired_count && d->retired[n].epoch < oldest)
+		n++;
+	if (n)
+		epoch_free_(d, n);
+	return d->retired_count;
+}
+
+EPOCH_EXPORTS void epoch_synchronize(
+	struct epoch_domain *const d/*!=NULL*/)
+{
+	const struct epoch_reader *r;
+	size_t e;
+	EPOCH_ASSERT_PTR(d);
+	e = epoch_increment_(&d->epoch);
+	epoch_fence_();
+	/* wait for readers that entered before the increment */
+	for (r = epoch_load_ptr_(&d->readers); r; r = epoch_load_ptr_(&r->next)) {
+		for (;;) {
+			const size_t x = epoch_load_acquire_(&r->epoch);
+			if (!x || x >= e)
+				break;
+			EPOCH_PAUSE();
+		}
+	}
+	if (d->retired_count)
+		epoch_free_(d, d->retired_count);
+}
+
+EPOCH_EXPORTS void epoch_destroy(
+	struct epoch_domain *const d/*!=NULL*/)
+{
+	EPOCH_ASSERT_PTR(d);
+	if (d->retired_count)
+		epoch_free_(d, d->retired_count);
+	free(d->retired);
+	d->retired = (struct epoch_retired*)0;
+	d->retired_capacity = 0;
+}
@@ -0,0 +1,53 @@
+/**********************************************************************************
+* Frozen snapshot of a prbtree in Eytzinger (BFS) layout
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* etree.c */
+
+#include <stdlib.h> /* for malloc() */
+#include <stdint.h> /* for uintptr_t */
+#include "collections_config.h"
+#include "etree.h"
+
+/* one block: pointer returned by malloc(), padding, aligned keys, objects */
+ETREE_EXPORTS int etree_alloc(
+	struct etree *const e/*!=NULL,out*/,
+	const size_t key_size,
+	const size_t count)
+{
+	const size_t extra = ETREE_CACHE_LINE - 1 + sizeof(void*);
+	size_t keys_size;
+	char *p = (char*)0;
+	ETREE_ASSERT_PTR(e);
+	etree_init(e);
+	if (!count)
+		return 0;
+	/* keys are followed by objects, aligned on the cache line too */
+	keys_size = (count + 1)*key_size;
+	keys_size += (ETREE_CACHE_LINE - keys_size % ETREE_CACHE_LINE) % ETREE_CACHE_LINE;
+	if (count < ((size_t)-1 - extra)/(key_size + sizeof(void*)) - ETREE_CACHE_LINE)
+		p = (char*)malloc(extra + keys_size + (count + 1)*sizeof(void*));
+	if (!p)
+		return -1;
+	{
+		const size_t a = (size_t)((uintptr_t)(p + sizeof(void*)) % ETREE_CACHE_LINE);
+		char *const keys = p + sizeof(void*) + (a ? ETREE_CACHE_LINE - a : 0);
+		((void**)keys)[-1] = p;
+		e->keys = keys;
+		e->objs = (void**)(keys + keys_size);
+		e->objs[0] = (void*)0;
+		e->count = count;
+	}
+	return 0;
+}
+
+ETREE_EXPORTS void etree_destroy(
+	struct etree *const e/*!=NULL*/)
+{
+	ETREE_ASSERT_PTR(e);
+	if (e->keys)
+		free(((void**)e->keys)[-1]);
+	etree_init(e);
+}
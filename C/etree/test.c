@@ -0,0 +1,123 @@
+/**********************************************************************************
+* Frozen snapshot of a prbtree in Eytzinger (BFS) layout
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* test.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "etree.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define N 20000
+#define RANGE 50000
+
+struct obj {
+	struct prbtree_node n;
+	unsigned key;
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+PRBTREE_DEFINE(otree, struct obj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+ETREE_DEFINE(osnap, struct obj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+
+static struct obj objs[N];
+
+/* snapshot must have the same objects as the tree, in the same order */
+static int check_iterate(const struct etree *const e, const struct prbtree *const tree)
+{
+	const struct prbtree_node *n = tree->root ?
+		prbtree_node_from_btree_node_(btree_first(&tree->root->u.n)) : (struct prbtree_node*)0;
+	size_t pos = etree_first(e), count = 0;
+	for (; n; n = prbtree_next(n), pos = etree_next(e, pos), count++) {
+		if (osnap_at(e, pos) != otree_from_node(n))
+			return 0;
+	}
+	if (pos || count != e->count)
+		return 0;
+	n = tree->root ? prbtree_node_from_btree_node_(btree_last(&tree->root->u.n)) : (struct prbtree_node*)0;
+	for (pos = etree_last(e); n; n = prbtree_prev(n), pos = etree_prev(e, pos)) {
+		if (osnap_at(e, pos) != otree_from_node(n))
+			return 0;
+	}
+	return !pos;
+}
+
+/* lookups in the snapshot must give the same results as in the tree */
+static int check_lookups(const struct etree *const e, const struct prbtree *const tree)
+{
+	unsigned key;
+	for (key = 0; key <= RANGE; key++) {
+		if (osnap_search(e, key) != otree_search(tree, key) ||
+			osnap_at(e, osnap_lower_bound(e, key)) != otree_lower_bound(tree, key) ||
+			osnap_at(e, osnap_upper_bound(e, key)) != otree_upper_bound(tree, key))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct prbtree tree;
+	struct etree e;
+	size_t i, size;
+	unsigned seed = 0;
+
+	(void)argc, (void)argv;
+
+	prbtree_init(&tree);
+	etree_init(&e);
+
+	/* empty snapshot */
+	TEST(!osnap_build(&e, &tree));
+	TEST(!e.count && !etree_first(&e) && !etree_last(&e));
+	TEST(!osnap_search(&e, 1) && !osnap_lower_bound(&e, 0) && !osnap_upper_bound(&e, 0));
+	etree_destroy(&e);
+
+	srand(seed);
+
+	/* snapshots of trees of all sizes up to 130 - complete and incomplete last levels,
+	  then of bigger trees */
+	for (i = 0, size = 1; size <= N; size = size < 130 ? size + 1 : size == N ? N + 1 : size*4 < N ? size*4 : N) {
+		for (; i < size; i++) {
+			do {
+				objs[i].key = 1 + (unsigned)rand() % (RANGE - 1);
+				prbtree_init_node(&objs[i].n);
+			} while (otree_insert(&tree, &objs[i], /*leaf:*/0));
+		}
+		TEST(!osnap_build(&e, &tree));
+		TEST(e.count == size);
+		TEST(!((size_t)e.keys % ETREE_CACHE_LINE));
+		TEST(check_iterate(&e, &tree));
+		TEST(check_lookups(&e, &tree));
+		etree_destroy(&e);
+		TEST(!e.count && !e.keys);
+	}
+
+	/* the snapshot does not depend on the tree */
+	TEST(!osnap_build(&e, &tree));
+	for (i = 0; i < N/2; i++)
+		otree_remove(&tree, &objs[i]);
+	for (i = 0; i < N && osnap_search(&e, objs[i].key) == &objs[i];)
+		i++;
+	TEST(i == N);
+	TEST(osnap_search(&e, 0) == NULL);
+	TEST(osnap_search(&e, RANGE) == NULL);
+	etree_destroy(&e);
+
+	printf("all tests OK\n");
+	return 0;
+}
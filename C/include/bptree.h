@@ -0,0 +1,639 @@
+#ifndef BPTREE_H_INCLUDED
+#define BPTREE_H_INCLUDED
+
+/**********************************************************************************
+* B+tree of pointers to objects with nodes sized to cache lines
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* bptree.h */
+
+/* B+tree: unlike embedded binary trees, nodes are allocated by the tree, leaves hold keys
+  and pointers to objects, inner nodes hold only keys and pointers to child nodes,
+  keys of a node are stored in one array, so a node is searched by a branchless scan
+  that compilers may vectorize, or by SIMD kernels for integer keys (see BPTREE_DEFINE_SIMD()),
+  a node takes BPTREE_NODE_SIZE bytes and is aligned on BPTREE_CACHE_LINE bytes:
+  with 64-bit keys, an inner node has up to 64 children and a leaf holds up to 62 objects,
+  so a tree of 100M keys has 5 levels instead of ~27 levels of a red-black tree, the upper
+  2-3 levels (up to ~1.3MB) usually stay in cache, keys of a node are read sequentially, so
+  the hardware prefetcher overlaps misses on them: a lookup costs ~4-5 dependent cache misses,
+  one for the keys and one for the pointer to the child (or object) per uncached level,
+  leaves are doubly-linked for range iteration,
+  keys are unique, objects are not modified by the tree */
+
+#include <string.h> /* for memmove() */
+#include "btree.h"
+#include "btree_simd.h"
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef BPTREE_EXPORTS
+#define BPTREE_EXPORTS
+#endif
+
+/* expr - do not compares pointers */
+#ifndef BPTREE_ASSERT
+#define BPTREE_ASSERT(expr) BTREE_ASSERT(expr)
+#endif
+
+/* check that pointer is not NULL */
+#ifndef BPTREE_ASSERT_PTR
+#define BPTREE_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+/* alignment of nodes */
+#ifndef BPTREE_CACHE_LINE
+#define BPTREE_CACHE_LINE 64
+#endif
+
+/* size of a node, a multiple of BPTREE_CACHE_LINE: all keys of a node are compared, bigger nodes
+  give fewer levels, but more lines to read per node and longer memmove() on insert/remove */
+#ifndef BPTREE_NODE_SIZE
+#define BPTREE_NODE_SIZE (16*BPTREE_CACHE_LINE)
+#endif
+
+/* maximum number of levels of the tree: each inner node has at least 2 children */
+#define BPTREE_MAX_HEIGHT (8*sizeof(size_t))
+
+/* number of keys in an inner node: count + keys + one more child than keys */
+#define BPTREE_INNER_KEYS(key_type) \
+	((BPTREE_NODE_SIZE - 2*sizeof(void*))/(sizeof(key_type) + sizeof(void*)))
+
+/* number of keys in a leaf: count + prev + next + keys + objects */
+#define BPTREE_LEAF_KEYS(key_type) \
+	((BPTREE_NODE_SIZE - 3*sizeof(void*))/(sizeof(key_type) + sizeof(void*)))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct bptree {
+	void *root;      /* NULL if tree is empty */
+	unsigned height; /* number of levels: 0 - tree is empty, 1 - root is a leaf */
+	size_t count;    /* number of objects in the tree */
+};
+
+/* position of an object in a leaf, for range iteration */
+struct bptree_iter {
+	void *leaf; /* NULL - past the end/before the beginning */
+	unsigned pos;
+};
+
+static inline void bptree_init(
+	struct bptree *const tree/*!=NULL,out*/)
+{
+	BPTREE_ASSERT_PTR(tree);
+	tree->root = (void*)0;
+	tree->height = 0;
+	tree->count = 0;
+}
+
+/* allocate a node of given size, aligned on BPTREE_CACHE_LINE, returns NULL if out of memory */
+BPTREE_EXPORTS void *bptree_alloc_node(
+	const size_t size);
+
+/* free a node allocated by bptree_alloc_node() */
+BPTREE_EXPORTS void bptree_free_node(
+	void *const node/*!=NULL*/);
+
+/* define type-specialized B+tree of pointers to objects of given type, e.g.:
+   type *name_search(const struct bptree *tree, key_type key);                           - NULL if not found
+   int name_insert(struct bptree *tree, type *o, type **existing);                       - 1 if inserted,
+                                                         0 if there is an object with the same key (*existing set),
+                                                         -1 if out of memory
+   type *name_remove(struct bptree *tree, key_type key);                                 - NULL if not found
+   void name_destroy(struct bptree *tree);                                               - free all nodes
+   type *name_first(const struct bptree *tree, struct bptree_iter *it);                  - NULL if the tree is empty
+   type *name_last(const struct bptree *tree, struct bptree_iter *it);                   - NULL if the tree is empty
+   type *name_lower_bound(const struct bptree *tree, key_type key, struct bptree_iter *it); - first object with key >= given one
+   type *name_upper_bound(const struct bptree *tree, key_type key, struct bptree_iter *it); - first object with key > given one
+   type *name_next(struct bptree_iter *it);                                              - NULL after the last object
+   type *name_prev(struct bptree_iter *it);                                              - NULL before the first object
+  key_cmp - returns difference of two keys (a - b), e.g. BTREE_KEY_COMPARATOR,
+  note: iterators are invalidated by insert/remove */
+#if 0 /* example */
+struct my_struct {
+	int key;
+	int data;
+};
+#define MY_KEY_OF(o) (o)->key
+BPTREE_DEFINE(my_tree, struct my_struct, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  struct bptree tree;
+  struct bptree_iter it;
+  struct my_struct *s;
+  bptree_init(&tree);
+  ...
+  for (s = my_tree_lower_bound(&tree, 10, &it); s && s->key < 20; s = my_tree_next(&it))
+    process(s);
+  ...
+  my_tree_destroy(&tree);
+#endif
+#define BPTREE_DEFINE(name, type, key_type, key_of, key_cmp)                                   \
+	BPTREE_RANK_(name, key_type, key_cmp)                                                      \
+	BPTREE_DEFINE_(name, type, key_type, key_of, key_cmp)
+
+/* same as BPTREE_DEFINE(), but for integer keys: nodes are searched by inline SIMD kernels of
+  btree_simd.h, selected at compile time: build with -mavx2 or -msse4.2 (/arch:AVX2), otherwise
+  the kernels are scalar, kt - kernel suffix matching the key type: i32, u32, i64 or u64, e.g.:
+  BPTREE_DEFINE_SIMD(my_tree, struct my_struct, uint64_t, MY_KEY_OF, u64) */
+#define BPTREE_DEFINE_SIMD(name, type, key_type, key_of, kt)                                   \
+	BPTREE_SIMD_RANK_(name, key_type, kt)                                                      \
+	BPTREE_DEFINE_(name, type, key_type, key_of, BTREE_KEY_COMPARATOR)
+
+/* generic in-node search: branchless scan, that compilers may vectorize */
+#define BPTREE_RANK_(name, key_type, key_cmp)                                                  \
+/* number of keys less than the key */                                                         \
+static inline unsigned name##_rank_lt_(                                                        \
+	const key_type *const keys/*!=NULL*/,                                                      \
+	const unsigned count,                                                                      \
+	const key_type key)                                                                        \
+{                                                                                              \
+	unsigned i = 0, r = 0;                                                                     \
+	for (; i < count; i++)                                                                     \
+		r += (key_cmp(keys[i], key) < 0);                                                      \
+	return r;                                                                                  \
+}                                                                                              \
+/* number of keys less than or equal to the key */                                             \
+static inline unsigned name##_rank_le_(                                                        \
+	const key_type *const keys/*!=NULL*/,                                                      \
+	const unsigned count,                                                                      \
+	const key_type key)                                                                        \
+{                                                                                              \
+	unsigned i = 0, r = 0;                                                                     \
+	for (; i < count; i++)                                                                     \
+		r += (key_cmp(keys[i], key) <= 0);                                                     \
+	return r;                                                                                  \
+}
+
+/* in-node search by inline SIMD kernels of btree_simd.h, kt - kernel suffix: i32, u32, i64 or u64 */
+#define BPTREE_SIMD_RANK_(name, key_type, kt)                                                  \
+static inline unsigned name##_rank_lt_(                                                        \
+	const key_type *const keys/*!=NULL*/,                                                      \
+	const unsigned count,                                                                      \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *const k = keys;                                                                \
+	(void)sizeof(int[1-2*(sizeof(key_type) != sizeof(BTREE_SIMD_KEY_##kt))]);                  \
+	return (unsigned)btree_rank_lt_##kt##_inline((const BTREE_SIMD_KEY_##kt*)k, count,         \
+		(BTREE_SIMD_KEY_##kt)key);                                                             \
+}                                                                                              \
+static inline unsigned name##_rank_le_(                                                        \
+	const key_type *const keys/*!=NULL*/,                                                      \
+	const unsigned count,                                                                      \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *const k = keys;                                                                \
+	return (unsigned)btree_rank_le_##kt##_inline((const BTREE_SIMD_KEY_##kt*)k, count,         \
+		(BTREE_SIMD_KEY_##kt)key);                                                             \
+}
+
+#define BPTREE_DEFINE_(name, type, key_type, key_of, key_cmp)                                  \
+enum {                                                                                         \
+	name##_inner_keys_ = BPTREE_INNER_KEYS(key_type),                                          \
+	name##_leaf_keys_ = BPTREE_LEAF_KEYS(key_type),                                            \
+	name##_inner_min_ = name##_inner_keys_/2, /* minimum number of keys of a non-root node */  \
+	name##_leaf_min_ = name##_leaf_keys_/2,                                                    \
+	/* BPTREE_NODE_SIZE is too small for the key type */                                       \
+	name##_check_ = 0*sizeof(int[1-2*(name##_inner_keys_ < 3 || name##_leaf_keys_ < 2)])       \
+};                                                                                             \
+struct name##_inner_ {                                                                         \
+	unsigned count; /* number of keys, number of children is count + 1 */                      \
+	key_type keys[name##_inner_keys_]; /* keys of children[i + 1] are >= keys[i] */            \
+	void *children[name##_inner_keys_ + 1];                                                    \
+};                                                                                             \
+struct name##_leaf_ {                                                                          \
+	unsigned count;                                                                            \
+	struct name##_leaf_ *prev;                                                                 \
+	struct name##_leaf_ *next;                                                                 \
+	key_type keys[name##_leaf_keys_];                                                          \
+	type *objects[name##_leaf_keys_];                                                          \
+};                                                                                             \
+/* find the leaf which may contain the key */                                                  \
+static inline struct name##_leaf_ *name##_find_leaf_(                                          \
+	const struct bptree *const tree/*!=NULL*/,                                                 \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *n = tree->root;                                                                \
+	unsigned h = tree->height;                                                                 \
+	for (; h > 1; h--) {                                                                       \
+		const struct name##_inner_ *const in = (const struct name##_inner_*)n;                 \
+		n = in->children[name##_rank_le_(in->keys, in->count, key)];                           \
+	}                                                                                          \
+	return (struct name##_leaf_*)n; /* NULL? */                                                \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct bptree *const tree/*!=NULL*/,                                                 \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const struct name##_leaf_ *lf;                                                             \
+	BPTREE_ASSERT_PTR(tree);                                                                   \
+	BTREE_TRACE_(BTREE_TRACE_SEARCH, key);                                                     \
+	lf = name##_find_leaf_(tree, key);                                                         \
+	if (lf) {                                                                                  \
+		const unsigned i = name##_rank_lt_(lf->keys, lf->count, key);                          \
+		if (i < lf->count && !key_cmp(lf->keys[i], key))                                       \
+			return lf->objects[i];                                                             \
+	}                                                                                          \
+	return (type*)0;                                                                           \
+}                                                                                              \
+/* set iterator to position i of the leaf, or to the first object of the next leaf */          \
+static inline type *name##_iter_at_(                                                           \
+	struct bptree_iter *const it/*!=NULL,out*/,                                                \
+	const struct name##_leaf_ *lf/*NULL?*/,                                                    \
+	unsigned i)                                                                                \
+{                                                                                              \
+	if (lf && i == lf->count) {                                                                \
+		lf = lf->next;                                                                         \
+		i = 0;                                                                                 \
+	}                                                                                          \
+	it->leaf = (void*)lf;                                                                      \
+	it->pos = i;                                                                               \
+	return lf ? lf->objects[i] : (type*)0;                                                     \
+}                                                                                              \
+static inline type *name##_lower_bound(                                                        \
+	const struct bptree *const tree/*!=NULL*/,                                                 \
+	const key_type key,                                                                        \
+	struct bptree_iter *const it/*!=NULL,out*/)                                                \
+{                                                                                              \
+	const struct name##_leaf_ *lf;                                                             \
+	BPTREE_ASSERT_PTR(tree);                                                                   \
+	BPTREE_ASSERT_PTR(it);                                                                     \
+	lf = name##_find_leaf_(tree, key);                                                         \
+	return name##_iter_at_(it, lf, lf ? name##_rank_lt_(lf->keys, lf->count, key) : 0);        \
+}                                                                                              \
+static inline type *name##_upper_bound(                                                        \
+	const struct bptree *const tree/*!=NULL*/,                                                 \
+	const key_type key,                                                                        \
+	struct bptree_iter *const it/*!=NULL,out*/)                                                \
+{                                                                                              \
+	const struct name##_leaf_ *lf;                                                             \
+	BPTREE_ASSERT_PTR(tree);                                                                   \
+	BPTREE_ASSERT_PTR(it);                                                                     \
+	lf = name##_find_leaf_(tree, key);                                                         \
+	return name##_iter_at_(it, lf, lf ? name##_rank_le_(lf->keys, lf->count, key) : 0);        \
+}                                                                                              \
+static inline type *name##_first(                                                              \
+	const struct bptree *const tree/*!=NULL*/,                                                 \
+	struct bptree_iter *const it/*!=NULL,out*/)                                                \
+{                                                                                              \
+	const void *n = tree->root;                                                                \
+	unsigned h = tree->height;                                                                 \
+	for (; h > 1; h--)                                                                         \
+		n = ((const struct name##_inner_*)n)->children[0];                                     \
+	return name##_iter_at_(it, (const struct name##_leaf_*)n, 0);                              \
+}                                                                                              \
+static inline type *name##_last(                                                               \
+	const struct bptree *const tree/*!=NULL*/,                                                 \
+	struct bptree_iter *const it/*!=NULL,out*/)                                                \
+{                                                                                              \
+	const void *n = tree->root;                                                                \
+	unsigned h = tree->height;                                                                 \
+	for (; h > 1; h--)                                                                         \
+		n = ((const struct name##_inner_*)n)->children[                                        \
+			((const struct name##_inner_*)n)->count];                                          \
+	it->leaf = (void*)n;                                                                       \
+	it->pos = n ? ((const struct name##_leaf_*)n)->count - 1 : 0;                              \
+	return n ? ((const struct name##_leaf_*)n)->objects[it->pos] : (type*)0;                   \
+}                                                                                              \
+static inline type *name##_next(                                                               \
+	struct bptree_iter *const it/*!=NULL*/)                                                    \
+{                                                                                              \
+	BPTREE_ASSERT_PTR(it);                                                                     \
+	return it->leaf ?                                                                          \
+		name##_iter_at_(it, (const struct name##_leaf_*)it->leaf, it->pos + 1) : (type*)0;     \
+}                                                                                              \
+static inline type *name##_prev(                                                               \
+	struct bptree_iter *const it/*!=NULL*/)                                                    \
+{                                                                                              \
+	const struct name##_leaf_ *lf;                                                             \
+	BPTREE_ASSERT_PTR(it);                                                                     \
+	lf = (const struct name##_leaf_*)it->leaf;                                                 \
+	if (!lf)                                                                                   \
+		return (type*)0;                                                                       \
+	if (!it->pos) {                                                                            \
+		lf = lf->prev;                                                                         \
+		it->leaf = (void*)lf;                                                                  \
+		if (!lf)                                                                               \
+			return (type*)0;                                                                   \
+		it->pos = lf->count;                                                                   \
+	}                                                                                          \
+	return lf->objects[--it->pos];                                                             \
+}                                                                                              \
+static inline int name##_insert(                                                               \
+	struct bptree *const tree/*!=NULL*/,                                                       \
+	type *const o/*!=NULL*/,                                                                   \
+	type **const existing/*NULL?,out*/)                                                        \
+{                                                                                              \
+	struct name##_inner_ *path[BPTREE_MAX_HEIGHT];                                             \
+	unsigned idx[BPTREE_MAX_HEIGHT];                                                           \
+	void *spare[BPTREE_MAX_HEIGHT + 1];                                                        \
+	const key_type key = key_of(o);                                                            \
+	struct name##_leaf_ *lf;                                                                   \
+	unsigned level = 0, i, need = 1;                                                           \
+	BPTREE_ASSERT_PTR(tree);                                                                   \
+	BPTREE_ASSERT_PTR(o);                                                                      \
+	BTREE_TRACE_(BTREE_TRACE_INSERT, key);                                                     \
+	if (!tree->root) {                                                                         \
+		lf = (struct name##_leaf_*)bptree_alloc_node(sizeof(*lf));                             \
+		if (!lf)                                                                               \
+			return -1;                                                                         \
+		lf->count = 1;                                                                         \
+		lf->prev = (struct name##_leaf_*)0;                                                    \
+		lf->next = (struct name##_leaf_*)0;                                                    \
+		lf->keys[0] = key;                                                                     \
+		lf->objects[0] = o;                                                                    \
+		tree->root = lf;                                                                       \
+		tree->height = 1;                                                                      \
+		tree->count = 1;                                                                       \
+		return 1;                                                                              \
+	}                                                                                          \
+	{                                                                                          \
+		void *n = tree->root;                                                                  \
+		for (; level + 1 < tree->height; level++) {                                            \
+			struct name##_inner_ *const in = (struct name##_inner_*)n;                         \
+			path[level] = in;                                                                  \
+			idx[level] = name##_rank_le_(in->keys, in->count, key);                            \
+			n = in->children[idx[level]];                                                      \
+		}                                                                                      \
+		lf = (struct name##_leaf_*)n;                                                          \
+	}                                                                                          \
+	i = name##_rank_lt_(lf->keys, lf->count, key);                                             \
+	if (i < lf->count && !key_cmp(lf->keys[i], key)) {                                         \
+		if (existing)                                                                          \
+			*existing = lf->objects[i];                                                        \
+		return 0;                                                                              \
+	}                                                                                          \
+	if (lf->count < name##_leaf_keys_) {                                                       \
+		memmove(&lf->keys[i + 1], &lf->keys[i], (lf->count - i)*sizeof(key_type));             \
+		memmove(&lf->objects[i + 1], &lf->objects[i], (lf->count - i)*sizeof(type*));          \
+		lf->keys[i] = key;                                                                     \
+		lf->objects[i] = o;                                                                    \
+		lf->count++;                                                                           \
+		tree->count++;                                                                         \
+		return 1;                                                                              \
+	}                                                                                          \
+	/* allocate all nodes needed for splits beforehand,                                        \
+	  so the tree is not modified on failure */                                                \
+	for (; level && path[level - 1]->count == name##_inner_keys_; level--)                     \
+		need++;                                                                                \
+	need += !level; /* new root */                                                             \
+	for (level = 0; level < need; level++) {                                                   \
+		spare[level] = bptree_alloc_node(level ? sizeof(struct name##_inner_) : sizeof(*lf));  \
+		if (!spare[level]) {                                                                   \
+			while (level)                                                                      \
+				bptree_free_node(spare[--level]);                                              \
+			return -1;                                                                         \
+		}                                                                                      \
+	}                                                                                          \
+	{                                                                                          \
+		/* split the leaf: the new right leaf gets the upper half of keys */                   \
+		key_type tk[name##_leaf_keys_ + 1];                                                    \
+		type *to[name##_leaf_keys_ + 1];                                                       \
+		struct name##_leaf_ *const nl = (struct name##_leaf_*)spare[0];                        \
+		const unsigned sl = (name##_leaf_keys_ + 1)/2;                                         \
+		void *child = nl;                                                                      \
+		key_type sep;                                                                          \
+		memcpy(tk, lf->keys, i*sizeof(key_type));                                              \
+		memcpy(to, lf->objects, i*sizeof(type*));                                              \
+		tk[i] = key;                                                                           \
+		to[i] = o;                                                                             \
+		memcpy(&tk[i + 1], &lf->keys[i], (name##_leaf_keys_ - i)*sizeof(key_type));            \
+		memcpy(&to[i + 1], &lf->objects[i], (name##_leaf_keys_ - i)*sizeof(type*));            \
+		memcpy(lf->keys, tk, sl*sizeof(key_type));                                             \
+		memcpy(lf->objects, to, sl*sizeof(type*));                                             \
+		lf->count = sl;                                                                        \
+		nl->count = name##_leaf_keys_ + 1 - sl;                                                \
+		memcpy(nl->keys, &tk[sl], nl->count*sizeof(key_type));                                 \
+		memcpy(nl->objects, &to[sl], nl->count*sizeof(type*));                                 \
+		nl->prev = lf;                                                                         \
+		nl->next = lf->next;                                                                   \
+		if (nl->next)                                                                          \
+			nl->next->prev = nl;                                                               \
+		lf->next = nl;                                                                         \
+		sep = nl->keys[0];                                                                     \
+		/* insert separator key and the new node into parents, splitting full ones */          \
+		for (level = tree->height - 1, need = 1; level; need++) {                              \
+			struct name##_inner_ *const in = path[--level];                                    \
+			const unsigned j = idx[level];                                                     \
+			key_type ik[name##_inner_keys_ + 1];                                               \
+			void *ic[name##_inner_keys_ + 2];                                                  \
+			struct name##_inner_ *ni;                                                          \
+			unsigned si;                                                                       \
+			if (in->count < name##_inner_keys_) {                                              \
+				memmove(&in->keys[j + 1], &in->keys[j], (in->count - j)*sizeof(key_type));     \
+				memmove(&in->children[j + 2], &in->children[j + 1],                            \
+					(in->count - j)*sizeof(void*));                                            \
+				in->keys[j] = sep;                                                             \
+				in->children[j + 1] = child;                                                   \
+				in->count++;                                                                   \
+				tree->count++;                                                                 \
+				return 1;                                                                      \
+			}                                                                                  \
+			memcpy(ik, in->keys, j*sizeof(key_type));                                          \
+			ik[j] = sep;                                                                       \
+			memcpy(&ik[j + 1], &in->keys[j], (name##_inner_keys_ - j)*sizeof(key_type));       \
+			memcpy(ic, in->children, (j + 1)*sizeof(void*));                                   \
+			ic[j + 1] = child;                                                                 \
+			memcpy(&ic[j + 2], &in->children[j + 1], (name##_inner_keys_ - j)*sizeof(void*));  \
+			/* left node keeps si keys, key at si goes up, the right node gets the rest */     \
+			si = (name##_inner_keys_ + 1)/2;                                                   \
+			ni = (struct name##_inner_*)spare[need];                                           \
+			memcpy(in->keys, ik, si*sizeof(key_type));                                         \
+			memcpy(in->children, ic, (si + 1)*sizeof(void*));                                  \
+			in->count = si;                                                                    \
+			ni->count = name##_inner_keys_ - si;                                               \
+			memcpy(ni->keys, &ik[si + 1], ni->count*sizeof(key_type));                         \
+			memcpy(ni->children, &ic[si + 1], (ni->count + 1)*sizeof(void*));                  \
+			sep = ik[si];                                                                      \
+			child = ni;                                                                        \
+		}                                                                                      \
+		{                                                                                      \
+			/* the root was split */                                                           \
+			struct name##_inner_ *const r = (struct name##_inner_*)spare[need];                \
+			r->count = 1;                                                                      \
+			r->keys[0] = sep;                                                                  \
+			r->children[0] = tree->root;                                                       \
+			r->children[1] = child;                                                            \
+			tree->root = r;                                                                    \
+			tree->height++;                                                                    \
+			tree->count++;                                                                     \
+			return 1;                                                                          \
+		}                                                                                      \
+	}                                                                                          \
+}                                                                                              \
+/* remove key j and child j + 1 from the inner node */                                         \
+static inline void name##_inner_erase_(                                                        \
+	struct name##_inner_ *const in/*!=NULL*/,                                                  \
+	const unsigned j)                                                                          \
+{                                                                                              \
+	memmove(&in->keys[j], &in->keys[j + 1], (in->count - j - 1)*sizeof(key_type));             \
+	memmove(&in->children[j + 1], &in->children[j + 2], (in->count - j - 1)*sizeof(void*));    \
+	in->count--;                                                                               \
+}                                                                                              \
+static inline type *name##_remove(                                                             \
+	struct bptree *const tree/*!=NULL*/,                                                       \
+	const key_type key)                                                                        \
+{                                                                                              \
+	struct name##_inner_ *path[BPTREE_MAX_HEIGHT];                                             \
+	unsigned idx[BPTREE_MAX_HEIGHT];                                                           \
+	struct name##_leaf_ *lf;                                                                   \
+	type *o;                                                                                   \
+	unsigned level = 0, i;                                                                     \
+	BPTREE_ASSERT_PTR(tree);                                                                   \
+	BTREE_TRACE_(BTREE_TRACE_REMOVE, key);                                                     \
+	if (!tree->root)                                                                           \
+		return (type*)0;                                                                       \
+	{                                                                                          \
+		void *n = tree->root;                                                                  \
+		for (; level + 1 < tree->height; level++) {                                            \
+			struct name##_inner_ *const in = (struct name##_inner_*)n;                         \
+			path[level] = in;                                                                  \
+			idx[level] = name##_rank_le_(in->keys, in->count, key);                            \
+			n = in->children[idx[level]];                                                      \
+		}                                                                                      \
+		lf = (struct name##_leaf_*)n;                                                          \
+	}                                                                                          \
+	i = name##_rank_lt_(lf->keys, lf->count, key);                                             \
+	if (i == lf->count || key_cmp(lf->keys[i], key))                                           \
+		return (type*)0;                                                                       \
+	o = lf->objects[i];                                                                        \
+	lf->count--;                                                                               \
+	memmove(&lf->keys[i], &lf->keys[i + 1], (lf->count - i)*sizeof(key_type));                 \
+	memmove(&lf->objects[i], &lf->objects[i + 1], (lf->count - i)*sizeof(type*));              \
+	tree->count--;                                                                             \
+	if (!level) {                                                                              \
+		/* the root leaf */                                                                    \
+		if (!lf->count) {                                                                      \
+			bptree_free_node(lf);                                                              \
+			bptree_init(tree);                                                                 \
+		}                                                                                      \
+		return o;                                                                              \
+	}                                                                                          \
+	if (lf->count >= name##_leaf_min_)                                                         \
+		return o;                                                                              \
+	{                                                                                          \
+		/* borrow a key from a sibling leaf or merge with it */                                \
+		struct name##_inner_ *const p = path[level - 1];                                       \
+		const unsigned j = idx[level - 1];                                                     \
+		struct name##_leaf_ *const ls = j ?                                                    \
+			(struct name##_leaf_*)p->children[j - 1] : (struct name##_leaf_*)0;                \
+		struct name##_leaf_ *const rs = j < p->count ?                                         \
+			(struct name##_leaf_*)p->children[j + 1] : (struct name##_leaf_*)0;                \
+		if (ls && ls->count > name##_leaf_min_) {                                              \
+			memmove(&lf->keys[1], &lf->keys[0], lf->count*sizeof(key_type));                   \
+			memmove(&lf->objects[1], &lf->objects[0], lf->count*sizeof(type*));                \
+			ls->count--;                                                                       \
+			lf->keys[0] = ls->keys[ls->count];                                                 \
+			lf->objects[0] = ls->objects[ls->count];                                           \
+			lf->count++;                                                                       \
+			p->keys[j - 1] = lf->keys[0];                                                      \
+			return o;                                                                          \
+		}                                                                                      \
+		if (rs && rs->count > name##_leaf_min_) {                                              \
+			lf->keys[lf->count] = rs->keys[0];                                                 \
+			lf->objects[lf->count] = rs->objects[0];                                           \
+			lf->count++;                                                                       \
+			rs->count--;                                                                       \
+			memmove(&rs->keys[0], &rs->keys[1], rs->count*sizeof(key_type));                   \
+			memmove(&rs->objects[0], &rs->objects[1], rs->count*sizeof(type*));                \
+			p->keys[j] = rs->keys[0];                                                          \
+			return o;                                                                          \
+		}                                                                                      \
+		{                                                                                      \
+			/* merge the right leaf of the pair into the left one */                           \
+			struct name##_leaf_ *const l = ls ? ls : lf;                                       \
+			struct name##_leaf_ *const r = ls ? lf : rs;                                       \
+			memcpy(&l->keys[l->count], r->keys, r->count*sizeof(key_type));                    \
+			memcpy(&l->objects[l->count], r->objects, r->count*sizeof(type*));                 \
+			l->count += r->count;                                                              \
+			l->next = r->next;                                                                 \
+			if (l->next)                                                                       \
+				l->next->prev = l;                                                             \
+			bptree_free_node(r);                                                               \
+			name##_inner_erase_(p, ls ? j - 1 : j);                                            \
+		}                                                                                      \
+	}                                                                                          \
+	/* rebalance inner nodes up to the root */                                                 \
+	for (level--; level; level--) {                                                            \
+		struct name##_inner_ *const in = path[level];                                          \
+		struct name##_inner_ *const p = path[level - 1];                                       \
+		const unsigned j = idx[level - 1];                                                     \
+		struct name##_inner_ *const ls = j ?                                                   \
+			(struct name##_inner_*)p->children[j - 1] : (struct name##_inner_*)0;              \
+		struct name##_inner_ *const rs = j < p->count ?                                        \
+			(struct name##_inner_*)p->children[j + 1] : (struct name##_inner_*)0;              \
+		if (in->count >= name##_inner_min_)                                                    \
+			return o;                                                                          \
+		if (ls && ls->count > name##_inner_min_) {                                             \
+			/* rotate the last child of the left sibling through the parent */                 \
+			memmove(&in->keys[1], &in->keys[0], in->count*sizeof(key_type));                   \
+			memmove(&in->children[1], &in->children[0], (in->count + 1)*sizeof(void*));        \
+			in->keys[0] = p->keys[j - 1];                                                      \
+			in->children[0] = ls->children[ls->count];                                         \
+			in->count++;                                                                       \
+			p->keys[j - 1] = ls->keys[--ls->count];                                            \
+			return o;                                                                          \
+		}                                                                                      \
+		if (rs && rs->count > name##_inner_min_) {                                             \
+			/* rotate the first child of the right sibling through the parent */               \
+			in->keys[in->count] = p->keys[j];                                                  \
+			in->children[in->count + 1] = rs->children[0];                                     \
+			in->count++;                                                                       \
+			p->keys[j] = rs->keys[0];                                                          \
+			rs->count--;                                                                       \
+			memmove(&rs->keys[0], &rs->keys[1], rs->count*sizeof(key_type));                   \
+			memmove(&rs->children[0], &rs->children[1], (rs->count + 1)*sizeof(void*));        \
+			return o;                                                                          \
+		}                                                                                      \
+		{                                                                                      \
+			/* merge the right node of the pair and the separator key into the left one */     \
+			struct name##_inner_ *const l = ls ? ls : in;                                      \
+			struct name##_inner_ *const r = ls ? in : rs;                                      \
+			const unsigned k = ls ? j - 1 : j;                                                 \
+			l->keys[l->count] = p->keys[k];                                                    \
+			memcpy(&l->keys[l->count + 1], r->keys, r->count*sizeof(key_type));                \
+			memcpy(&l->children[l->count + 1], r->children, (r->count + 1)*sizeof(void*));     \
+			l->count += r->count + 1;                                                          \
+			bptree_free_node(r);                                                               \
+			name##_inner_erase_(p, k);                                                         \
+		}                                                                                      \
+	}                                                                                          \
+	{                                                                                          \
+		/* the root with one child is replaced by the child */                                 \
+		struct name##_inner_ *const r = path[0];                                               \
+		if (!r->count) {                                                                       \
+			tree->root = r->children[0];                                                       \
+			tree->height--;                                                                    \
+			bptree_free_node(r);                                                               \
+		}                                                                                      \
+	}                                                                                          \
+	return o;                                                                                  \
+}                                                                                              \
+static inline void name##_free_(                                                               \
+	void *const n/*!=NULL*/,                                                                   \
+	const unsigned h)                                                                          \
+{                                                                                              \
+	if (h > 1) {                                                                               \
+		const struct name##_inner_ *const in = (const struct name##_inner_*)n;                 \
+		unsigned i = 0;                                                                        \
+		for (; i <= in->count; i++)                                                            \
+			name##_free_(in->children[i], h - 1);                                              \
+	}                                                                                          \
+	bptree_free_node(n);                                                                       \
+}                                                                                              \
+static inline void name##_destroy(                                                             \
+	struct bptree *const tree/*!=NULL*/)                                                       \
+{                                                                                              \
+	BPTREE_ASSERT_PTR(tree);                                                                   \
+	if (tree->root)                                                                            \
+		name##_free_(tree->root, tree->height);                                                \
+	bptree_init(tree);                                                                         \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BPTREE_H_INCLUDED */
@@ -28,6 +28,51 @@
 #endif
 #endif
 
+/* BTREE_PREFETCH - hint to load the memory at given address into the cache, address may be NULL */
+#ifndef BTREE_PREFETCH
+#if defined __GNUC__ || defined __clang__
+#define BTREE_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+#include <xmmintrin.h>
+#define BTREE_PREFETCH(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#define BTREE_PREFETCH(addr) ((void)(addr))
+#endif
+#endif
+
+/* hooks of instrumentation of tree operations by hardware performance counters, see btree_perf.h:
+  BTREE_PERF_BEGIN_() - must follow declarations of the block */
+#ifdef BTREE_PERF
+#include "btree_perf.h"
+#define BTREE_PERF_BEGIN_(s)   unsigned long long s[BTREE_PERF_COUNTERS]; btree_perf_begin_(s)
+#define BTREE_PERF_END_(op, s) btree_perf_end_(op, s)
+#else
+#define BTREE_PERF_BEGIN_(s)   ((void)0)
+#define BTREE_PERF_END_(op, s) ((void)0)
+#endif
+
+/* hooks of counting of tree operations statistics, see btree_stats.h:
+  BTREE_STATS_ADD_(tree, field, n) - add n to a field of struct btree_stats of given kind of trees */
+#ifdef BTREE_STATS
+#include "btree_stats.h"
+#define BTREE_STATS_ADD_(t, field, n) ((void)(btree_stats_[t].field += (unsigned long long)(n)))
+#else
+#define BTREE_STATS_ADD_(t, field, n) ((void)0)
+#endif
+#define BTREE_STATS_INC_(t, field)    BTREE_STATS_ADD_(t, field, 1)
+
+/* hooks of recording of trace of tree operations, see btree_trace.h:
+  BTREE_TRACE_(op, key) - record the operation, if recording is started by btree_trace_start() */
+#ifdef BTREE_TRACE
+#include "btree_trace.h"
+#ifndef BTREE_TRACE_KEY
+#define BTREE_TRACE_KEY(key) ((unsigned long long)(key))
+#endif
+#define BTREE_TRACE_(op, key) ((void)(btree_trace_active_ && (btree_trace_record(op, BTREE_TRACE_KEY(key)), 0)))
+#else
+#define BTREE_TRACE_(op, key) ((void)0)
+#endif
+
 /* expr - do not compares pointers */
 #ifndef BTREE_ASSERT
 #ifdef ASSERT
@@ -199,6 +244,12 @@ typedef int btree_comparator(
 	const struct btree_node *node/*!=NULL*/,
 	const struct btree_key *key/*!=NULL*/);
 
+/* binary tree nodes comparator callback - compare keys of two nodes,
+  must return a difference (a - b), see BTREE_KEY_COMPARATOR() macro */
+typedef int btree_node_comparator(
+	const struct btree_node *a/*!=NULL*/,
+	const struct btree_node *b/*!=NULL*/);
+
 /* search node in the tree ordered by keys,
   returns NULL if node with given key was not found */
 /* int comparator(node, key) - returns (node - key) difference */
@@ -209,8 +260,10 @@ static inline struct btree_node *btree_search(
 {
 	BTREE_ASSERT(!tree || key);
 	BTREE_ASSERT(!tree || comparator);
+	BTREE_STATS_INC_(BTREE_STATS_BTREE, searches);
 	while (tree) {
 		const int c = (*comparator)(tree, key); /* c = tree - key */
+		BTREE_STATS_INC_(BTREE_STATS_BTREE, search_depth);
 		if (c == 0)
 			break;
 		tree = tree->leaves[c < 0];
@@ -223,12 +276,20 @@ static inline struct btree_node *btree_search(
   cmp - arbitrary comparator expression using n, e.g.:
    BTREE_KEY_COMPARATOR(my_node_from_btree_node(n)->my_key, search_key) */
 #define BTREE_SEARCH(n/*NULL?*/, cmp) do { \
+	BTREE_PERF_BEGIN_(btree_perf_s_);      \
+	BTREE_STATS_INC_(BTREE_STATS_BTREE,    \
+		searches);                         \
 	while (n) {                            \
 		const int c = cmp;                 \
+		BTREE_STATS_INC_(                  \
+			BTREE_STATS_BTREE,             \
+			search_depth);                 \
 		if (c == 0)                        \
 			break;                         \
 		n = n->leaves[c < 0];              \
 	}                                      \
+	BTREE_PERF_END_(BTREE_PERF_SEARCH,     \
+		btree_perf_s_);                    \
 } while (0)
 
 #if 0 /* example */
@@ -274,6 +335,141 @@ static const struct my_struct *my_search(
 
 #endif /* end of example */
 
+/* find the first node of the tree ordered by keys, which key is >= given one,
+  returns NULL if all keys of the tree are less than given one */
+/* int comparator(node, key) - returns (node - key) difference */
+static inline struct btree_node *btree_lower_bound(
+	const struct btree_node *tree/*NULL?*/,
+	const struct btree_key *const key/*!=NULL if tree!=NULL*/,
+	btree_comparator *const comparator/*!=NULL if tree!=NULL*/)
+{
+	const struct btree_node *r = (const struct btree_node*)0;
+	BTREE_ASSERT(!tree || key);
+	BTREE_ASSERT(!tree || comparator);
+	while (tree) {
+		const int c = (*comparator)(tree, key); /* c = tree - key */
+		if (c >= 0)
+			r = tree;
+		tree = tree->leaves[c < 0];
+	}
+	return btree_const_cast(r); /* NULL? */
+}
+
+/* find the first node of the tree ordered by keys, which key is > given one,
+  returns NULL if all keys of the tree are less than or equal to given one */
+/* int comparator(node, key) - returns (node - key) difference */
+static inline struct btree_node *btree_upper_bound(
+	const struct btree_node *tree/*NULL?*/,
+	const struct btree_key *const key/*!=NULL if tree!=NULL*/,
+	btree_comparator *const comparator/*!=NULL if tree!=NULL*/)
+{
+	const struct btree_node *r = (const struct btree_node*)0;
+	BTREE_ASSERT(!tree || key);
+	BTREE_ASSERT(!tree || comparator);
+	while (tree) {
+		const int c = (*comparator)(tree, key); /* c = tree - key */
+		if (c > 0)
+			r = tree;
+		tree = tree->leaves[c <= 0];
+	}
+	return btree_const_cast(r); /* NULL? */
+}
+
+/* find the range of nodes of the tree ordered by keys, which keys are equal to given one:
+  returns lower bound - the first node which key is >= given one (NULL?),
+  *upper - receives upper bound - the first node which key is > given one (NULL?),
+  range is empty if returned node == *upper,
+  both bounds are found by one descent from the root to the first node with equal key,
+  then separately in left and right subtrees of that node */
+/* int comparator(node, key) - returns (node - key) difference */
+static inline struct btree_node *btree_equal_range(
+	const struct btree_node *tree/*NULL?*/,
+	const struct btree_key *const key/*!=NULL if tree!=NULL*/,
+	btree_comparator *const comparator/*!=NULL if tree!=NULL*/,
+	struct btree_node **const upper/*out:!=NULL*/)
+{
+	const struct btree_node *r = (const struct btree_node*)0;
+	BTREE_ASSERT(!tree || key);
+	BTREE_ASSERT(!tree || comparator);
+	BTREE_ASSERT_PTR(upper);
+	while (tree) {
+		const int c = (*comparator)(tree, key); /* c = tree - key */
+		if (c == 0) {
+			*upper = btree_upper_bound(tree->btree_right, key, comparator);
+			if (!*upper)
+				*upper = btree_const_cast(r);
+			r = btree_lower_bound(tree->btree_left, key, comparator);
+			return r ? btree_const_cast(r) : btree_const_cast(tree);
+		}
+		if (c > 0)
+			r = tree;
+		tree = tree->leaves[c < 0];
+	}
+	*upper = btree_const_cast(r); /* NULL? */
+	return btree_const_cast(r); /* NULL? */
+}
+
+/* same as btree_lower_bound(), but implemented as macro:
+  r   - struct btree_node *, result of this search,
+  n   - struct btree_node *, initially root of the tree, NULL at end,
+  cmp - arbitrary comparator expression using n, e.g.:
+   BTREE_KEY_COMPARATOR(my_node_from_btree_node(n)->my_key, search_key) */
+#define BTREE_LOWER_BOUND(r, n/*NULL?*/, cmp) do { \
+	r = (struct btree_node*)0;                     \
+	while (n) {                                    \
+		const int c = cmp;                         \
+		if (c >= 0)                                \
+			r = n;                                 \
+		n = n->leaves[c < 0];                      \
+	}                                              \
+} while (0)
+
+/* same as btree_upper_bound(), but implemented as macro:
+  r   - struct btree_node *, result of this search,
+  n   - struct btree_node *, initially root of the tree, NULL at end,
+  cmp - arbitrary comparator expression using n */
+#define BTREE_UPPER_BOUND(r, n/*NULL?*/, cmp) do { \
+	r = (struct btree_node*)0;                     \
+	while (n) {                                    \
+		const int c = cmp;                         \
+		if (c > 0)                                 \
+			r = n;                                 \
+		n = n->leaves[c <= 0];                     \
+	}                                              \
+} while (0)
+
+/* same as btree_equal_range(), but implemented as macro:
+  r   - struct btree_node *, lower bound - the first node which key is >= given one,
+  u   - struct btree_node *, upper bound - the first node which key is > given one,
+  n   - struct btree_node *, initially root of the tree, NULL at end,
+  cmp - arbitrary comparator expression using n */
+#define BTREE_EQUAL_RANGE(r, u, n/*NULL?*/, cmp) do {                 \
+	r = u = (struct btree_node*)0;                                    \
+	while (n) {                                                       \
+		const int c = cmp;                                            \
+		if (c == 0) {                                                 \
+			struct btree_node *const x_ = btree_const_cast(n);        \
+			r = x_;                                                   \
+			for (n = x_->btree_left; n;) {                            \
+				const int c_ = cmp;                                   \
+				if (c_ >= 0)                                          \
+					r = n;                                            \
+				n = n->leaves[c_ < 0];                                \
+			}                                                         \
+			for (n = x_->btree_right; n;) {                           \
+				const int c_ = cmp;                                   \
+				if (c_ > 0)                                           \
+					u = n;                                            \
+				n = n->leaves[c_ <= 0];                               \
+			}                                                         \
+			break;                                                    \
+		}                                                             \
+		if (c > 0)                                                    \
+			r = u = n;                                                \
+		n = n->leaves[c < 0];                                         \
+	}                                                                 \
+} while (0)
+
 /* abstract object that is passed to checker callback */
 struct btree_object {
 	char o_; /* placeholder, must be never accessed, char, so object data may be arbitrary aligned */
@@ -340,6 +536,19 @@ typedef void btree_deleter(
 	struct btree_node *node/*!=NULL*/,
 	struct btree_object *obj);
 
+/* binary tree mover callback - move the object containing node 'from' to the memory of the object
+  containing node 'to' (e.g. by memcpy()) and update references to the object from outside of the tree */
+typedef void btree_mover(
+	struct btree_node *to/*!=NULL*/,
+	struct btree_node *from/*!=NULL*/,
+	struct btree_object *obj);
+
+/* order of nodes in memory after relocation of a tree */
+enum btree_layout {
+	BTREE_LAYOUT_BFS, /* breadth-first: level by level, from the root */
+	BTREE_LAYOUT_VEB  /* van Emde Boas: recursively, the top half of levels, then subtrees below it */
+};
+
 /* walk over all nodes of unordered tree calling callback to delete each node */
 static inline void btree_delete_recursive(
 	struct btree_node *tree/*NULL?*/,
@@ -735,11 +944,13 @@ static inline int btree_search_parent(
 	BTREE_ASSERT_PTR(comparator);
 	{
 		struct btree_node *p = *parent;
+		BTREE_STATS_INC_(BTREE_STATS_BTREE, searches);
 		if (!p)
 			return 1; /* tree is empty, parent is NULL */
 		for (;;) {
 			const int c = (*comparator)(p, key); /* c = p - key */
 			struct btree_node *const p_ = p;
+			BTREE_STATS_INC_(BTREE_STATS_BTREE, search_depth);
 			if (c != 0) {
 				p = p->leaves[c < 0];
 				if (p)
@@ -760,10 +971,13 @@ static inline int btree_search_parent(
    BTREE_KEY_COMPARATOR(my_node_from_btree_node(p)->my_key, search_key) */
 /* NOTE: if tree allows nodes with non-unique keys, 'leaf' must be non-zero */
 #define BTREE_SEARCH_PARENT(c, p, cmp, leaf) do {                                               \
+	BTREE_PERF_BEGIN_(btree_perf_s_);                                                           \
+	BTREE_STATS_INC_(BTREE_STATS_BTREE, searches);                                              \
 	if (!p)                                                                                     \
 		c = 1; /* tree is empty, parent is NULL */                                              \
 	else for (;;) {                                                                             \
 		c = cmp; /* c = (*parent) - key */                                                      \
+		BTREE_STATS_INC_(BTREE_STATS_BTREE, search_depth);                                      \
 		if (c != 0) {                                                                           \
 			struct btree_node *const p_ = p->leaves[c < 0];                                     \
 			if (p_) {                                                                           \
@@ -778,6 +992,7 @@ static inline int btree_search_parent(
 		}                                                                                       \
 		break; /* if c == 0, then p - references found node, else p - references leaf parent */ \
 	}                                                                                           \
+	BTREE_PERF_END_(BTREE_PERF_SEARCH_PARENT, btree_perf_s_);                                   \
 } while (0)
 
 /* recursively count nodes in the tree */
@@ -893,6 +1108,40 @@ static inline struct btree_node *btree_fill_stack_right(
 	for (s = 0, n = (tree), n = n ? btree_fill_stack_right(n, stack, &s) : NULL; n ? next = ( \
 		n->btree_left ? btree_fill_stack_right(n->btree_left, stack, &s) : s ? stack[--s] : NULL), n : (next = NULL); n = next)
 
+#ifdef BTREE_PERF
+
+/* instrumented versions of btree_search() and btree_search_parent() */
+
+static inline struct btree_node *btree_search_perf_(
+	const struct btree_node *tree/*NULL?*/,
+	const struct btree_key *const key/*!=NULL if tree!=NULL*/,
+	btree_comparator *const comparator/*!=NULL if tree!=NULL*/)
+{
+	struct btree_node *n;
+	BTREE_PERF_BEGIN_(s);
+	n = btree_search(tree, key, comparator);
+	BTREE_PERF_END_(BTREE_PERF_SEARCH, s);
+	return n; /* NULL? */
+}
+
+static inline int btree_search_parent_perf_(
+	struct btree_node **const parent/*in:*NULL?,out*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	const int leaf)
+{
+	int c;
+	BTREE_PERF_BEGIN_(s);
+	c = btree_search_parent(parent, key, comparator, leaf);
+	BTREE_PERF_END_(BTREE_PERF_SEARCH_PARENT, s);
+	return c;
+}
+
+#define btree_search(tree, key, comparator)               btree_search_perf_(tree, key, comparator)
+#define btree_search_parent(parent, key, comparator, leaf) btree_search_parent_perf_(parent, key, comparator, leaf)
+
+#endif /* BTREE_PERF */
+
 #ifdef __cplusplus
 }
 #endif
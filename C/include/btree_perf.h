@@ -0,0 +1,102 @@
+#ifndef BTREE_PERF_H_INCLUDED
+#define BTREE_PERF_H_INCLUDED
+
+/**********************************************************************************
+* Hardware performance counters instrumentation of tree operations
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_perf.h */
+
+/* opt-in instrumentation: if both the library and the application are compiled with -DBTREE_PERF,
+  next operations are measured with Linux perf_event counters of the calling thread:
+   btree_search(), BTREE_SEARCH(), name_search() of PRBTREE_DEFINE()/PCRBTREE_DEFINE(),
+   btree_search_parent(), BTREE_SEARCH_PARENT(), name_insert() of PRBTREE_DEFINE()/PCRBTREE_DEFINE(),
+   prbtree_rebalance(), prbtree_remove(), pcrbtree_rebalance(), pcrbtree_remove(),
+  counting is started by btree_perf_open(),
+  single thread only: counters measure the thread that called btree_perf_open(), statistics
+  are collected in global variables without synchronization, so while counters are open, no
+  other thread may perform instrumented operations (on any tree) - compile with -DBTREE_PERF
+  a benchmark or a single-threaded program, not a multi-threaded production binary,
+  an operation is not accounted if counters could not be read at its start or end,
+  without -DBTREE_PERF the instrumentation is not compiled in at all */
+
+/* functions of this header are available regardless of BTREE_PERF definition,
+  but without it (or on non-Linux platforms) btree_perf_open() just returns 0 */
+
+#include <stdio.h> /* for FILE */
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef BTREE_PERF_EXPORTS
+#define BTREE_PERF_EXPORTS
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* measured operations */
+enum btree_perf_op {
+	BTREE_PERF_SEARCH,              /* btree_search() */
+	BTREE_PERF_SEARCH_PARENT,       /* btree_search_parent() */
+	BTREE_PERF_PRBTREE_REBALANCE,   /* prbtree_rebalance() */
+	BTREE_PERF_PRBTREE_REMOVE,      /* prbtree_remove() */
+	BTREE_PERF_PCRBTREE_REBALANCE,  /* pcrbtree_rebalance() */
+	BTREE_PERF_PCRBTREE_REMOVE,     /* pcrbtree_remove() */
+	BTREE_PERF_OPS
+};
+
+/* hardware counters */
+enum btree_perf_counter {
+	BTREE_PERF_CYCLES,
+	BTREE_PERF_L1D_MISSES,          /* L1 data cache read misses */
+	BTREE_PERF_LLC_MISSES,          /* last level cache misses */
+	BTREE_PERF_BRANCH_MISSES,
+	BTREE_PERF_COUNTERS
+};
+
+struct btree_perf_stat {
+	unsigned long long calls;
+	unsigned long long sum[BTREE_PERF_COUNTERS]; /* totals over all calls, measurement overhead excluded */
+};
+
+/* open counters, reset statistics and calibrate measurement overhead,
+  returns bit mask of opened counters: (1u << BTREE_PERF_CYCLES) | ..., 0 if none of them is available */
+BTREE_PERF_EXPORTS unsigned btree_perf_open(void);
+
+/* close counters opened by btree_perf_open(), collected statistics are preserved */
+BTREE_PERF_EXPORTS void btree_perf_close(void);
+
+/* zero collected statistics */
+BTREE_PERF_EXPORTS void btree_perf_reset(void);
+
+/* copy collected statistics, returns bit mask of opened counters - as btree_perf_open() */
+BTREE_PERF_EXPORTS unsigned btree_perf_snapshot(
+	struct btree_perf_stat stats[BTREE_PERF_OPS]/*out*/);
+
+/* print per-operation averages of counters */
+BTREE_PERF_EXPORTS void btree_perf_report(
+	FILE *const f/*!=NULL*/);
+
+BTREE_PERF_EXPORTS const char *btree_perf_op_name(
+	const enum btree_perf_op op);
+
+BTREE_PERF_EXPORTS const char *btree_perf_counter_name(
+	const enum btree_perf_counter counter);
+
+/* read counters at the start of measured operation */
+BTREE_PERF_EXPORTS void btree_perf_begin_(
+	unsigned long long start[BTREE_PERF_COUNTERS]/*out*/);
+
+/* read counters at the end of measured operation and account the difference */
+BTREE_PERF_EXPORTS void btree_perf_end_(
+	const enum btree_perf_op op,
+	const unsigned long long start[BTREE_PERF_COUNTERS]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTREE_PERF_H_INCLUDED */
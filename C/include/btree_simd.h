@@ -0,0 +1,247 @@
+#ifndef BTREE_SIMD_H_INCLUDED
+#define BTREE_SIMD_H_INCLUDED
+
+/**********************************************************************************
+* SIMD search of integer keys in arrays of tree nodes
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_simd.h */
+
+/* kernels that count keys of an array less than (rank_lt) or less than or equal to (rank_le)
+  given key, without comparator calls and without branches on keys:
+  for a sorted array, rank_lt is the index of the lower bound of the key, and rank_le -
+  the index of the child of a B-tree node to descend into,
+  all keys of the array are compared, so the kernels are intended for small arrays - keys of
+  a node of a B-tree (see BPTREE_DEFINE_SIMD() in bptree.h) or a block of a static index,
+  keys do not need to be sorted, no alignment of the array is required,
+  implementations: AVX2, SSE4.2 (x86/x86_64) and scalar; the best implementation supported
+  by the CPU is selected at the first call,
+  for searches in inner loops there are inline kernels, see btree_rank_lt_i32_inline() */
+
+#include <stddef.h> /* for size_t */
+#include <stdint.h> /* for int32_t */
+
+#if defined __x86_64__ || defined __i386__ || defined _M_X64 || defined _M_IX86
+#define BTREE_SIMD_X86_
+#include <immintrin.h>
+#endif
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef BTREE_SIMD_EXPORTS
+#define BTREE_SIMD_EXPORTS
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum btree_simd_level {
+	BTREE_SIMD_SCALAR,
+	BTREE_SIMD_SSE42,
+	BTREE_SIMD_AVX2,
+	BTREE_SIMD_LEVELS
+};
+
+/* get the best implementation supported by the CPU */
+BTREE_SIMD_EXPORTS enum btree_simd_level btree_simd_detect(void);
+
+/* get currently selected implementation */
+BTREE_SIMD_EXPORTS enum btree_simd_level btree_simd_level(void);
+
+/* select implementation, e.g. to compare them in a benchmark,
+  if the level is not supported by the CPU, the best supported one is selected,
+  returns selected level,
+  note: kernels called concurrently use either the previously selected implementation or the new one */
+BTREE_SIMD_EXPORTS enum btree_simd_level btree_simd_select(
+	const enum btree_simd_level level);
+
+BTREE_SIMD_EXPORTS const char *btree_simd_level_name(
+	const enum btree_simd_level level);
+
+/* number of keys < key */
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_i32(
+	const int32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int32_t key);
+
+/* number of keys <= key */
+BTREE_SIMD_EXPORTS size_t btree_rank_le_i32(
+	const int32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int32_t key);
+
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_u32(
+	const uint32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint32_t key);
+
+BTREE_SIMD_EXPORTS size_t btree_rank_le_u32(
+	const uint32_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint32_t key);
+
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_i64(
+	const int64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int64_t key);
+
+BTREE_SIMD_EXPORTS size_t btree_rank_le_i64(
+	const int64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const int64_t key);
+
+BTREE_SIMD_EXPORTS size_t btree_rank_lt_u64(
+	const uint64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint64_t key);
+
+BTREE_SIMD_EXPORTS size_t btree_rank_le_u64(
+	const uint64_t *const keys/*!=NULL if count*/,
+	const size_t count,
+	const uint64_t key);
+
+/* kernels of the library and inline kernels:
+  keys and the key are xor-ed with bias, then compared as signed integers,
+  bias is 0 for signed keys and the sign bit for unsigned keys */
+
+#define BTREE_SIMD_SIGN32_ 0x80000000u
+#define BTREE_SIMD_SIGN64_ 0x8000000000000000ull
+
+/* scalar: compare as unsigned integers, flipping the sign bit of signed ones */
+#define BTREE_SIMD_SCALAR_KERNEL_(name, type, utype, sign, op)                                 \
+static inline size_t name(                                                                     \
+	const type *const keys, const size_t count, const type key, const utype bias)              \
+{                                                                                              \
+	const utype flip = bias ^ sign;                                                            \
+	const utype k = (utype)key ^ flip;                                                         \
+	size_t i = 0, r = 0;                                                                       \
+	for (; i < count; i++)                                                                     \
+		r += (((utype)keys[i] ^ flip) op k);                                                   \
+	return r;                                                                                  \
+}
+
+BTREE_SIMD_SCALAR_KERNEL_(btree_simd_lt32_scalar_, int32_t, uint32_t, BTREE_SIMD_SIGN32_, <)
+BTREE_SIMD_SCALAR_KERNEL_(btree_simd_gt32_scalar_, int32_t, uint32_t, BTREE_SIMD_SIGN32_, >)
+BTREE_SIMD_SCALAR_KERNEL_(btree_simd_lt64_scalar_, int64_t, uint64_t, BTREE_SIMD_SIGN64_, <)
+BTREE_SIMD_SCALAR_KERNEL_(btree_simd_gt64_scalar_, int64_t, uint64_t, BTREE_SIMD_SIGN64_, >)
+
+#ifdef BTREE_SIMD_X86_
+
+/* comparison results (-1 or 0 in each lane) are subtracted from per-lane counters,
+  counters are summed after the loop, remaining keys are compared by the scalar kernel,
+  decl - storage class and target attributes of the kernel */
+
+#define BTREE_SIMD_SSE_KERNEL_(decl, name, type, utype, lanes, set1, cmpgt, sub, gt, scalar)   \
+decl size_t name(                                                                              \
+	const type *const keys, const size_t count, const type key, const utype bias)              \
+{                                                                                              \
+	const __m128i b = set1((type)bias);                                                        \
+	const __m128i k = _mm_xor_si128(set1(key), b);                                             \
+	__m128i acc = _mm_setzero_si128();                                                         \
+	type t[lanes];                                                                             \
+	size_t i = 0, r = 0, j = 0;                                                                \
+	for (; i + lanes <= count; i += lanes) {                                                   \
+		const __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i*)&keys[i]), b);         \
+		acc = sub(acc, gt ? cmpgt(x, k) : cmpgt(k, x));                                        \
+	}                                                                                          \
+	_mm_storeu_si128((__m128i*)t, acc);                                                        \
+	for (; j < lanes; j++)                                                                     \
+		r += (size_t)t[j];                                                                     \
+	return r + scalar(&keys[i], count - i, key, bias);                                         \
+}
+
+#define BTREE_SIMD_AVX2_KERNEL_(decl, name, type, utype, lanes, set1, cmpgt, sub, gt, scalar)  \
+decl size_t name(                                                                              \
+	const type *const keys, const size_t count, const type key, const utype bias)              \
+{                                                                                              \
+	const __m256i b = set1((type)bias);                                                        \
+	const __m256i k = _mm256_xor_si256(set1(key), b);                                          \
+	__m256i acc = _mm256_setzero_si256();                                                      \
+	type t[lanes];                                                                             \
+	size_t i = 0, r = 0, j = 0;                                                                \
+	for (; i + lanes <= count; i += lanes) {                                                   \
+		const __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)&keys[i]), b);   \
+		acc = sub(acc, gt ? cmpgt(x, k) : cmpgt(k, x));                                        \
+	}                                                                                          \
+	_mm256_storeu_si256((__m256i*)t, acc);                                                     \
+	for (; j < lanes; j++)                                                                     \
+		r += (size_t)t[j];                                                                     \
+	return r + scalar(&keys[i], count - i, key, bias);                                         \
+}
+
+#endif /* BTREE_SIMD_X86_ */
+
+/* inline kernels: the implementation is selected at compile time by the instruction set of
+  the including translation unit (-mavx2, -msse4.2, /arch:AVX2), for loops where a call of
+  the kernel selected at run time costs more than the comparisons, e.g. a search of a B-tree
+  (see BPTREE_DEFINE_SIMD() in bptree.h):
+   size_t btree_rank_lt_i32_inline(const int32_t *keys, size_t count, int32_t key); - same as btree_rank_lt_i32()
+   size_t btree_rank_le_i32_inline(const int32_t *keys, size_t count, int32_t key); - same as btree_rank_le_i32()
+  and so on for u32, i64 and u64,
+  BTREE_SIMD_INLINE_LEVEL - the implementation of inline kernels */
+#if defined BTREE_SIMD_X86_ && defined __AVX2__
+#define BTREE_SIMD_INLINE_LEVEL BTREE_SIMD_AVX2
+BTREE_SIMD_AVX2_KERNEL_(static inline, btree_simd_lt32_inline_, int32_t, uint32_t, 8,
+	_mm256_set1_epi32, _mm256_cmpgt_epi32, _mm256_sub_epi32, 0, btree_simd_lt32_scalar_)
+BTREE_SIMD_AVX2_KERNEL_(static inline, btree_simd_gt32_inline_, int32_t, uint32_t, 8,
+	_mm256_set1_epi32, _mm256_cmpgt_epi32, _mm256_sub_epi32, 1, btree_simd_gt32_scalar_)
+BTREE_SIMD_AVX2_KERNEL_(static inline, btree_simd_lt64_inline_, int64_t, uint64_t, 4,
+	_mm256_set1_epi64x, _mm256_cmpgt_epi64, _mm256_sub_epi64, 0, btree_simd_lt64_scalar_)
+BTREE_SIMD_AVX2_KERNEL_(static inline, btree_simd_gt64_inline_, int64_t, uint64_t, 4,
+	_mm256_set1_epi64x, _mm256_cmpgt_epi64, _mm256_sub_epi64, 1, btree_simd_gt64_scalar_)
+#elif defined BTREE_SIMD_X86_ && defined __SSE4_2__
+#define BTREE_SIMD_INLINE_LEVEL BTREE_SIMD_SSE42
+BTREE_SIMD_SSE_KERNEL_(static inline, btree_simd_lt32_inline_, int32_t, uint32_t, 4,
+	_mm_set1_epi32, _mm_cmpgt_epi32, _mm_sub_epi32, 0, btree_simd_lt32_scalar_)
+BTREE_SIMD_SSE_KERNEL_(static inline, btree_simd_gt32_inline_, int32_t, uint32_t, 4,
+	_mm_set1_epi32, _mm_cmpgt_epi32, _mm_sub_epi32, 1, btree_simd_gt32_scalar_)
+BTREE_SIMD_SSE_KERNEL_(static inline, btree_simd_lt64_inline_, int64_t, uint64_t, 2,
+	_mm_set1_epi64x, _mm_cmpgt_epi64, _mm_sub_epi64, 0, btree_simd_lt64_scalar_)
+BTREE_SIMD_SSE_KERNEL_(static inline, btree_simd_gt64_inline_, int64_t, uint64_t, 2,
+	_mm_set1_epi64x, _mm_cmpgt_epi64, _mm_sub_epi64, 1, btree_simd_gt64_scalar_)
+#else
+#define BTREE_SIMD_INLINE_LEVEL BTREE_SIMD_SCALAR
+#define btree_simd_lt32_inline_ btree_simd_lt32_scalar_
+#define btree_simd_gt32_inline_ btree_simd_gt32_scalar_
+#define btree_simd_lt64_inline_ btree_simd_lt64_scalar_
+#define btree_simd_gt64_inline_ btree_simd_gt64_scalar_
+#endif
+
+/* signed and unsigned variants of a type may alias each other */
+#define BTREE_SIMD_INLINE_RANK_(kt, type, bits, bias)                                          \
+static inline size_t btree_rank_lt_##kt##_inline(                                              \
+	const type *const keys/*!=NULL if count*/,                                                 \
+	const size_t count,                                                                        \
+	const type key)                                                                            \
+{                                                                                              \
+	return btree_simd_lt##bits##_inline_((const int##bits##_t*)keys, count,                    \
+		(int##bits##_t)key, bias);                                                             \
+}                                                                                              \
+static inline size_t btree_rank_le_##kt##_inline(                                              \
+	const type *const keys/*!=NULL if count*/,                                                 \
+	const size_t count,                                                                        \
+	const type key)                                                                            \
+{                                                                                              \
+	return count - btree_simd_gt##bits##_inline_((const int##bits##_t*)keys, count,            \
+		(int##bits##_t)key, bias);                                                             \
+}
+
+BTREE_SIMD_INLINE_RANK_(i32, int32_t, 32, 0)
+BTREE_SIMD_INLINE_RANK_(u32, uint32_t, 32, BTREE_SIMD_SIGN32_)
+BTREE_SIMD_INLINE_RANK_(i64, int64_t, 64, 0)
+BTREE_SIMD_INLINE_RANK_(u64, uint64_t, 64, BTREE_SIMD_SIGN64_)
+
+/* key types of the kernels, by suffix, for macros */
+#define BTREE_SIMD_KEY_i32 int32_t
+#define BTREE_SIMD_KEY_u32 uint32_t
+#define BTREE_SIMD_KEY_i64 int64_t
+#define BTREE_SIMD_KEY_u64 uint64_t
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTREE_SIMD_H_INCLUDED */
@@ -0,0 +1,101 @@
+#ifndef BTREE_STATS_H_INCLUDED
+#define BTREE_STATS_H_INCLUDED
+
+/**********************************************************************************
+* Rebalancing statistics of tree operations
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_stats.h */
+
+/* opt-in statistics: if both the library and the application are compiled with -DBTREE_STATS,
+  next events are counted separately for each kind of tree:
+   searches and number of nodes visited by them:
+    btree_search(), BTREE_SEARCH(), btree_search_parent(), BTREE_SEARCH_PARENT() - for BTREE_STATS_BTREE,
+    name_search() and name_insert() of PRBTREE_DEFINE() - for BTREE_STATS_PRBTREE,
+    name_search() and name_insert() of PCRBTREE_DEFINE() - for BTREE_STATS_PCRBTREE,
+   rebalancing cases, rotations and recolorings after insert or remove of a node
+    (of prbtree or pcrbtree, including augmented ones, e.g. psrbtree or pcitree),
+  statistics are collected in global variables without synchronization,
+  so only one thread should perform counted operations,
+  without -DBTREE_STATS the counting is not compiled in at all */
+
+#include <stdio.h> /* for FILE */
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef BTREE_STATS_EXPORTS
+#define BTREE_STATS_EXPORTS
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* kinds of trees */
+enum btree_stats_tree {
+	BTREE_STATS_BTREE,    /* searches of btree.h */
+	BTREE_STATS_PRBTREE,
+	BTREE_STATS_PCRBTREE,
+	BTREE_STATS_TREES
+};
+
+/* cases of rebalancing after insert, see diagrams in prbtree_rebalance_a_() */
+enum btree_stats_insert_case {
+	BTREE_STATS_INSERT_1,       /* case 1: rotate (final) */
+	BTREE_STATS_INSERT_2,       /* case 2: double rotate (final) */
+	BTREE_STATS_INSERT_3_4,     /* cases 3,4: recolor (continue) */
+	BTREE_STATS_INSERT_CASES
+};
+
+/* cases of rebalancing after remove of a black leaf, see diagrams in prbtree_remove_() */
+enum btree_stats_remove_case {
+	BTREE_STATS_REMOVE_1,       /* black parent, black brother: case 1: recolor (continue) */
+	BTREE_STATS_REMOVE_2,       /* black parent, black brother: case 2 */
+	BTREE_STATS_REMOVE_3,       /* black parent, black brother: case 3 */
+	BTREE_STATS_REMOVE_4,       /* black parent, red brother: case 4 */
+	BTREE_STATS_REMOVE_5,       /* black parent, red brother: case 5 */
+	BTREE_STATS_REMOVE_6,       /* black parent, red brother: case 6 */
+	BTREE_STATS_REMOVE_4_7,     /* red parent: cases 4,7 (10,13): recolor */
+	BTREE_STATS_REMOVE_5_8,     /* red parent: cases 5,8 (11,14) */
+	BTREE_STATS_REMOVE_6_9,     /* red parent: cases 6,9 (12,15) */
+	BTREE_STATS_REMOVE_CASES
+};
+
+struct btree_stats {
+	unsigned long long searches;
+	unsigned long long search_depth;       /* total number of nodes visited by searches */
+	unsigned long long inserts;            /* inserted nodes, including the root of an empty tree */
+	unsigned long long insert_cases[BTREE_STATS_INSERT_CASES];
+	unsigned long long insert_rotations;
+	unsigned long long insert_recolors;    /* changes of node color, a node may be recolored more than once */
+	unsigned long long removes;            /* removed nodes */
+	unsigned long long remove_cases[BTREE_STATS_REMOVE_CASES];
+	unsigned long long remove_rotations;
+	unsigned long long remove_recolors;    /* changes of node color made by rebalancing */
+};
+
+/* counters, do not access directly - use btree_stats_snapshot() */
+BTREE_STATS_EXPORTS extern struct btree_stats btree_stats_[BTREE_STATS_TREES];
+
+/* zero collected statistics of all trees */
+BTREE_STATS_EXPORTS void btree_stats_reset(void);
+
+/* copy collected statistics of given kind of trees */
+BTREE_STATS_EXPORTS void btree_stats_snapshot(
+	const enum btree_stats_tree tree,
+	struct btree_stats *const stats/*!=NULL,out*/);
+
+/* print collected statistics with averages per operation */
+BTREE_STATS_EXPORTS void btree_stats_report(
+	FILE *const f/*!=NULL*/);
+
+BTREE_STATS_EXPORTS const char *btree_stats_tree_name(
+	const enum btree_stats_tree tree);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTREE_STATS_H_INCLUDED */
@@ -0,0 +1,86 @@
+#ifndef BTREE_TRACE_H_INCLUDED
+#define BTREE_TRACE_H_INCLUDED
+
+/**********************************************************************************
+* Recording and loading of traces of tree operations
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* btree_trace.h */
+
+/* trace - binary file of (operation, key) records, to replay captured production traffic in benchmarks,
+  file format:
+   header  - 8 bytes: "BTRACE01",
+   records - 9 bytes each: 1 byte - enum btree_trace_op, 8 bytes - key, least significant byte first,
+  recording:
+   an application calls btree_trace_record() directly or, if the application is compiled
+   with -DBTREE_TRACE, operations are recorded automatically by next functions (hooks are
+   in the macros of the headers, so the library itself needs no -DBTREE_TRACE):
+    name_search(), name_insert(), name_remove() of PRBTREE_DEFINE()/PCRBTREE_DEFINE(),
+   keys are converted to unsigned long long via BTREE_TRACE_KEY(key) macro, which must be defined
+   before including btree.h if keys are not of integral type,
+   records are written only between btree_trace_start() and btree_trace_stop(),
+   recording is not synchronized, so only one thread should perform traced operations,
+  replaying: see bench.cpp --trace option */
+
+#include <stddef.h> /* for size_t */
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef BTREE_TRACE_EXPORTS
+#define BTREE_TRACE_EXPORTS
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum btree_trace_op {
+	BTREE_TRACE_SEARCH,
+	BTREE_TRACE_INSERT,
+	BTREE_TRACE_REMOVE,
+	BTREE_TRACE_OPS
+};
+
+#define BTREE_TRACE_MAGIC       "BTRACE01"
+#define BTREE_TRACE_HEADER_SIZE 8
+#define BTREE_TRACE_RECORD_SIZE 9
+
+struct btree_trace_record {
+	unsigned long long key;
+	enum btree_trace_op op;
+};
+
+/* non-zero while recording, do not access directly - used by BTREE_TRACE_() hook */
+BTREE_TRACE_EXPORTS extern int btree_trace_active_;
+
+/* create trace file and start recording,
+  returns 0 on success, -1 if failed to create the file or recording is already started */
+BTREE_TRACE_EXPORTS int btree_trace_start(
+	const char *const path/*!=NULL*/);
+
+/* flush buffered records and close the trace file,
+  returns 0 on success, -1 if failed to write records or recording was not started */
+BTREE_TRACE_EXPORTS int btree_trace_stop(void);
+
+/* append a record to the trace, does nothing if recording is not started */
+BTREE_TRACE_EXPORTS void btree_trace_record(
+	const enum btree_trace_op op,
+	const unsigned long long key);
+
+/* read all records of the trace file,
+  returns array of records allocated by malloc() or NULL on error: failed to read the file,
+  bad header, bad record or out of memory, (*count) - number of records in the returned array */
+BTREE_TRACE_EXPORTS struct btree_trace_record *btree_trace_load(
+	const char *const path/*!=NULL*/,
+	size_t *const count/*!=NULL,out*/);
+
+BTREE_TRACE_EXPORTS const char *btree_trace_op_name(
+	const enum btree_trace_op op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BTREE_TRACE_H_INCLUDED */
@@ -0,0 +1,175 @@
+#ifndef EPOCH_H_INCLUDED
+#define EPOCH_H_INCLUDED
+
+/**********************************************************************************
+* Epoch-based reclamation of memory read by concurrent lock-free readers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* epoch.h */
+
+/* epoch domain - defers freeing of memory unlinked from a shared structure until
+  no reader may reference it:
+  a reader announces the global epoch on entering a read section and clears
+  the announcement on leaving it, readers never wait and never write shared memory
+  except their own announcement,
+  a writer, after unlinking memory, retires it - memory is tagged by the global epoch,
+  then epoch_reclaim() advances the global epoch and frees retired memory tagged by
+  epochs older than the oldest epoch announced by readers,
+
+  writer-side functions: epoch_retire(), epoch_reclaim(), epoch_synchronize(), epoch_unregister()
+  and epoch_destroy() must be serialized by the caller, e.g. by the lock of writers of the structure,
+  reader-side functions: epoch_register(), epoch_enter() and epoch_leave() - may be called concurrently,
+  each reading thread uses its own struct epoch_reader, read sections must not be nested */
+
+#include <stddef.h> /* for size_t */
+#include "btree.h"
+
+#if defined _MSC_VER && !defined __clang__
+#include <intrin.h> /* for _InterlockedCompareExchangePointer(), _mm_mfence() */
+#endif
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef EPOCH_EXPORTS
+#define EPOCH_EXPORTS
+#endif
+
+/* check that pointer is not NULL */
+#ifndef EPOCH_ASSERT_PTR
+#define EPOCH_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+/* spin-wait hint to the CPU */
+#ifndef EPOCH_PAUSE
+#if (defined __GNUC__ || defined __clang__) && (defined __i386__ || defined __x86_64__)
+#define EPOCH_PAUSE() __builtin_ia32_pause()
+#elif (defined __GNUC__ || defined __clang__) && (defined __aarch64__ || defined __arm__)
+#define EPOCH_PAUSE() __asm__ __volatile__("yield")
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+#define EPOCH_PAUSE() _mm_pause()
+#else
+#define EPOCH_PAUSE() ((void)0)
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined __GNUC__ || defined __clang__
+
+#define epoch_load_(p)           __atomic_load_n(p, __ATOMIC_RELAXED)
+#define epoch_load_acquire_(p)   __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define epoch_store_(p, v)       __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define epoch_store_release_(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define epoch_fence_()           __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+
+/* x86 is TSO: aligned volatile accesses are atomic, only the store-load order needs a fence */
+#define epoch_load_(p)           (*(const volatile size_t*)(p))
+#define epoch_load_acquire_(p)   (*(const volatile size_t*)(p))
+#define epoch_store_(p, v)       (*(volatile size_t*)(p) = (v))
+#define epoch_store_release_(p, v) (_ReadWriteBarrier(), *(volatile size_t*)(p) = (v))
+#define epoch_fence_()           _mm_mfence()
+
+#else
+#error "atomic operations are not defined for this compiler"
+#endif
+
+/* reader of a domain, one per reading thread,
+  to avoid false sharing, readers should not share a cache line with frequently written data */
+struct epoch_reader {
+	struct epoch_reader *next; /* in the list of readers of the domain */
+	size_t epoch;              /* announced epoch, 0 - not in a read section */
+};
+
+/* memory waiting for reclamation */
+struct epoch_retired {
+	void *ptr;
+	void (*destroy)(void *ptr, void *ctx);
+	void *ctx;
+	size_t epoch; /* global epoch at the time of retirement */
+};
+
+struct epoch_domain {
+	size_t epoch;                  /* global epoch, starts from 1 */
+	struct epoch_reader *readers;  /* registered readers */
+	struct epoch_retired *retired; /* array of retired memory, in order of retirement */
+	size_t retired_count;
+	size_t retired_capacity;
+};
+
+static inline void epoch_init(
+	struct epoch_domain *const d/*!=NULL,out*/)
+{
+	EPOCH_ASSERT_PTR(d);
+	d->epoch = 1;
+	d->readers = (struct epoch_reader*)0;
+	d->retired = (struct epoch_retired*)0;
+	d->retired_count = 0;
+	d->retired_capacity = 0;
+}
+
+/* add a reader to the domain, may be called concurrently with other functions */
+EPOCH_EXPORTS void epoch_register(
+	struct epoch_domain *const d/*!=NULL*/,
+	struct epoch_reader *const r/*!=NULL,out*/);
+
+/* remove the reader, which is not in a read section, from the domain (writer-side) */
+EPOCH_EXPORTS void epoch_unregister(
+	struct epoch_domain *const d/*!=NULL*/,
+	struct epoch_reader *const r/*!=NULL*/);
+
+/* enter read section: memory reachable from the shared structure after this call
+  will not be freed until epoch_leave() */
+static inline void epoch_enter(
+	const struct epoch_domain *const d/*!=NULL*/,
+	struct epoch_reader *const r/*!=NULL*/)
+{
+	EPOCH_ASSERT_PTR(d);
+	EPOCH_ASSERT_PTR(r);
+	BTREE_ASSERT(!r->epoch);
+	epoch_store_(&r->epoch, epoch_load_(&d->epoch));
+	/* the announcement must be visible to writers before the structure is read */
+	epoch_fence_();
+}
+
+/* leave read section: pointers read in the section must not be used after this call */
+static inline void epoch_leave(
+	struct epoch_reader *const r/*!=NULL*/)
+{
+	EPOCH_ASSERT_PTR(r);
+	epoch_store_release_(&r->epoch, (size_t)0);
+}
+
+/* retire memory unlinked from the shared structure (writer-side):
+  destroy(ptr, ctx) is called when no reader may reference the memory,
+  if out of memory - waits for readers and destroys the memory immediately */
+EPOCH_EXPORTS void epoch_retire(
+	struct epoch_domain *const d/*!=NULL*/,
+	void *const ptr,
+	void (*const destroy)(void *ptr, void *ctx)/*!=NULL*/,
+	void *const ctx);
+
+/* advance the global epoch and destroy retired memory which is not referenced by readers (writer-side),
+  does not wait for readers, returns the number of retired objects still waiting for reclamation */
+EPOCH_EXPORTS size_t epoch_reclaim(
+	struct epoch_domain *const d/*!=NULL*/);
+
+/* wait until all current read sections are left, then destroy all retired memory (writer-side) */
+EPOCH_EXPORTS void epoch_synchronize(
+	struct epoch_domain *const d/*!=NULL*/);
+
+/* destroy all retired memory and free internal arrays of the domain,
+  there must be no readers in read sections */
+EPOCH_EXPORTS void epoch_destroy(
+	struct epoch_domain *const d/*!=NULL*/);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EPOCH_H_INCLUDED */
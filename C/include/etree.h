@@ -0,0 +1,299 @@
+#ifndef ETREE_H_INCLUDED
+#define ETREE_H_INCLUDED
+
+/**********************************************************************************
+* Frozen snapshot of a prbtree in Eytzinger (BFS) layout
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* etree.h */
+
+/* etree - immutable array of keys and pointers to objects, built from a prbtree:
+  keys are stored in Eytzinger order - as nodes of a complete binary tree enumerated level by level:
+  the root at position 1, children of position k - at positions 2k and 2k+1,
+  so the top levels of the tree share a few cache lines, a lookup is branchless and
+  the next levels of the tree are prefetched while comparing keys of the current one,
+  a lookup in a snapshot does not touch the objects - keys are copied into the array,
+  a position is an iterator: 0 - past the end/before the beginning,
+  the snapshot does not depend on the source tree after the build,
+  but objects must not be freed while the snapshot is used */
+
+#include <stddef.h> /* for size_t, offsetof() */
+#include "btree.h"
+#include "prbtree.h"
+
+#if defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+#include <intrin.h> /* for _BitScanForward(), _mm_prefetch() */
+#endif
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef ETREE_EXPORTS
+#define ETREE_EXPORTS
+#endif
+
+/* expr - do not compares pointers */
+#ifndef ETREE_ASSERT
+#define ETREE_ASSERT(expr) BTREE_ASSERT(expr)
+#endif
+
+/* check that pointer is not NULL */
+#ifndef ETREE_ASSERT_PTR
+#define ETREE_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+/* alignment of the array of keys */
+#ifndef ETREE_CACHE_LINE
+#define ETREE_CACHE_LINE 64
+#endif
+
+/* prefetch a cache line for reading, addr may point past the array */
+#ifndef ETREE_PREFETCH
+#if defined __GNUC__ || defined __clang__
+#define ETREE_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+#define ETREE_PREFETCH(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+#define ETREE_PREFETCH(addr) ((void)0)
+#endif
+#endif
+
+/* number of keys in a cache line: the lookup prefetches keys of the level log2 of it below the current one */
+#define ETREE_PREFETCH_KEYS(key_type) \
+	((ETREE_CACHE_LINE + sizeof(key_type) - 1)/sizeof(key_type))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct etree {
+	void *keys;   /* count + 1 keys, keys[0] is not used, NULL if count == 0 */
+	void **objs;  /* objects, in the same order as keys */
+	size_t count; /* number of objects */
+};
+
+static inline void etree_init(
+	struct etree *const e/*!=NULL,out*/)
+{
+	ETREE_ASSERT_PTR(e);
+	e->keys = (void*)0;
+	e->objs = (void**)0;
+	e->count = 0;
+}
+
+/* allocate arrays for count keys of given size and objects, keys are aligned on ETREE_CACHE_LINE,
+  returns 0 on success, -1 if out of memory (the snapshot is left empty) */
+ETREE_EXPORTS int etree_alloc(
+	struct etree *const e/*!=NULL,out*/,
+	const size_t key_size,
+	const size_t count);
+
+/* free arrays of the snapshot, the snapshot becomes empty */
+ETREE_EXPORTS void etree_destroy(
+	struct etree *const e/*!=NULL*/);
+
+/* position of the leftmost object, 0 if the snapshot is empty */
+static inline size_t etree_first(
+	const struct etree *const e/*!=NULL*/)
+{
+	size_t k = 1;
+	ETREE_ASSERT_PTR(e);
+	if (!e->count)
+		return 0;
+	while (2*k <= e->count)
+		k = 2*k;
+	return k;
+}
+
+/* position of the rightmost object, 0 if the snapshot is empty */
+static inline size_t etree_last(
+	const struct etree *const e/*!=NULL*/)
+{
+	size_t k = 1;
+	ETREE_ASSERT_PTR(e);
+	if (!e->count)
+		return 0;
+	while (2*k + 1 <= e->count)
+		k = 2*k + 1;
+	return k;
+}
+
+/* position of the next object in order of keys, 0 after the rightmost one */
+static inline size_t etree_next(
+	const struct etree *const e/*!=NULL*/,
+	size_t k/*!=0*/)
+{
+	ETREE_ASSERT_PTR(e);
+	ETREE_ASSERT(k && k <= e->count);
+	if (2*k + 1 <= e->count) {
+		/* the leftmost position of the right subtree */
+		for (k = 2*k + 1; 2*k <= e->count;)
+			k = 2*k;
+		return k;
+	}
+	/* climb while k is a right child (odd), then to the parent */
+	while (k & 1)
+		k >>= 1;
+	return k >> 1;
+}
+
+/* position of the previous object in order of keys, 0 before the leftmost one */
+static inline size_t etree_prev(
+	const struct etree *const e/*!=NULL*/,
+	size_t k/*!=0*/)
+{
+	ETREE_ASSERT_PTR(e);
+	ETREE_ASSERT(k && k <= e->count);
+	if (2*k <= e->count) {
+		/* the rightmost position of the left subtree */
+		for (k = 2*k; 2*k + 1 <= e->count;)
+			k = 2*k + 1;
+		return k;
+	}
+	/* climb while k is a left child (even), then to the parent */
+	while (!(k & 1))
+		k >>= 1;
+	return k >> 1;
+}
+
+/* lookup descends to past a leaf, choosing the right child for keys less than the searched one:
+  bits of k record the path, the last left turn - at the found position, after it - only right turns,
+  so the found position is k without trailing ones and one more bit, 0 - if there was no left turn */
+static inline size_t etree_found_(
+	const size_t k)
+{
+#if defined __GNUC__ || defined __clang__
+	return k >> (__builtin_ctzll(~(unsigned long long)k) + 1);
+#elif defined _MSC_VER && defined _M_X64
+	unsigned long i;
+	(void)_BitScanForward64(&i, ~(unsigned __int64)k);
+	return k >> (i + 1);
+#elif defined _MSC_VER && defined _M_IX86
+	unsigned long i;
+	(void)_BitScanForward(&i, ~(unsigned long)k);
+	return k >> (i + 1);
+#else
+	size_t r = k;
+	while (r & 1)
+		r >>= 1;
+	return r >> 1;
+#endif
+}
+
+/* define type-specialized snapshot of a prbtree of objects of given type:
+  name       - prefix of names of defined functions,
+  type       - type of objects, e.g. struct my_struct,
+  member     - name of struct prbtree_node member of the type,
+  key_type   - type of keys, keys are copied into the snapshot,
+  key_of     - function-like macro returning the key of the object: key_of(const type *o),
+  key_cmp    - function-like macro returning (a - b) difference of keys: key_cmp(key_type a, key_type b),
+  defines next functions:
+   int name_build(struct etree *e, const struct prbtree *tree);        - 0 on success, -1 if out of memory,
+                                                                         e - must be empty, e.g. after etree_init()
+   type *name_at(const struct etree *e, size_t pos);                   - NULL if pos is 0
+   type *name_search(const struct etree *e, key_type key);             - NULL if not found
+   size_t name_lower_bound(const struct etree *e, key_type key);       - position of the first object with key >= given one
+   size_t name_upper_bound(const struct etree *e, key_type key);       - position of the first object with key > given one
+  positions are iterated by etree_next()/etree_prev(),
+  note: <stddef.h> must be included for offsetof() */
+#if 0 /* example */
+struct my_struct {
+	struct prbtree_node n;
+	int key;
+};
+#define MY_KEY_OF(o) (o)->key
+ETREE_DEFINE(my_snapshot, struct my_struct, n, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  struct etree e;
+  size_t pos;
+  etree_init(&e);
+  if (my_snapshot_build(&e, &tree))
+    error();
+  for (pos = my_snapshot_lower_bound(&e, 10); pos && my_snapshot_at(&e, pos)->key < 20; pos = etree_next(&e, pos))
+    process(my_snapshot_at(&e, pos));
+  ...
+  etree_destroy(&e);
+#endif
+#define ETREE_DEFINE(name, type, member, key_type, key_of, key_cmp)                            \
+enum { name##_prefetch_ = ETREE_PREFETCH_KEYS(key_type) };                                     \
+static inline int name##_build(                                                                \
+	struct etree *const e/*!=NULL,out*/,                                                       \
+	const struct prbtree *const tree/*!=NULL*/)                                                \
+{                                                                                              \
+	struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n;                             \
+	const struct btree_node *root;                                                             \
+	size_t s, k;                                                                               \
+	key_type *keys;                                                                            \
+	ETREE_ASSERT_PTR(e);                                                                       \
+	ETREE_ASSERT_PTR(tree);                                                                    \
+	ETREE_ASSERT(!e->count);                                                                   \
+	root = prbtree_node_to_btree_node_(tree->root);                                            \
+	if (!root)                                                                                 \
+		return 0;                                                                              \
+	if (etree_alloc(e, sizeof(key_type), btree_size(root)))                                    \
+		return -1;                                                                             \
+	keys = (key_type*)e->keys;                                                                 \
+	/* in-order walk of the source tree visits positions of the snapshot in order of keys */   \
+	k = etree_first(e);                                                                        \
+	btree_walk_stack_forward(btree_const_cast(root), stack, s, n) {                            \
+		type *const o = (type*)((char*)n - offsetof(type, member));                            \
+		keys[k] = key_of(o);                                                                   \
+		e->objs[k] = o;                                                                        \
+		k = etree_next(e, k);                                                                  \
+	}                                                                                          \
+	return 0;                                                                                  \
+}                                                                                              \
+static inline type *name##_at(                                                                 \
+	const struct etree *const e/*!=NULL*/,                                                     \
+	const size_t pos)                                                                          \
+{                                                                                              \
+	ETREE_ASSERT_PTR(e);                                                                       \
+	ETREE_ASSERT(pos <= e->count);                                                             \
+	return pos ? (type*)e->objs[pos] : (type*)0;                                               \
+}                                                                                              \
+static inline size_t name##_lower_bound(                                                       \
+	const struct etree *const e/*!=NULL*/,                                                     \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const key_type *keys;                                                                      \
+	size_t k = 1;                                                                              \
+	ETREE_ASSERT_PTR(e);                                                                       \
+	keys = (const key_type*)e->keys;                                                           \
+	BTREE_TRACE_(BTREE_TRACE_SEARCH, key);                                                     \
+	while (k <= e->count) {                                                                    \
+		const size_t p = k*name##_prefetch_;                                                   \
+		ETREE_PREFETCH(keys + (p <= e->count ? p : 0));                                        \
+		k = 2*k + (key_cmp(keys[k], key) < 0);                                                 \
+	}                                                                                          \
+	return etree_found_(k);                                                                    \
+}                                                                                              \
+static inline size_t name##_upper_bound(                                                       \
+	const struct etree *const e/*!=NULL*/,                                                     \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const key_type *keys;                                                                      \
+	size_t k = 1;                                                                              \
+	ETREE_ASSERT_PTR(e);                                                                       \
+	keys = (const key_type*)e->keys;                                                           \
+	while (k <= e->count) {                                                                    \
+		const size_t p = k*name##_prefetch_;                                                   \
+		ETREE_PREFETCH(keys + (p <= e->count ? p : 0));                                        \
+		k = 2*k + (key_cmp(keys[k], key) <= 0);                                                \
+	}                                                                                          \
+	return etree_found_(k);                                                                    \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct etree *const e/*!=NULL*/,                                                     \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const size_t pos = name##_lower_bound(e, key);                                             \
+	return (pos && !key_cmp(((const key_type*)e->keys)[pos], key)) ?                           \
+		(type*)e->objs[pos] : (type*)0;                                                        \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ETREE_H_INCLUDED */
@@ -0,0 +1,422 @@
+#ifndef IRBTREE_H_INCLUDED
+#define IRBTREE_H_INCLUDED
+
+/**********************************************************************************
+* Embedded red-black binary tree of nodes linked by 32-bit indices
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* irbtree.h */
+
+/* compact variant of prbtree: objects are elements of a pool (an array of objects),
+  tree nodes reference each other by 32-bit indices of objects in the pool instead of pointers:
+  on 64-bit hosts a node takes 12 bytes instead of 24 bytes of struct prbtree_node,
+  the pool may be moved in memory (e.g. by realloc()) without touching the nodes - then
+  irbtree_set_pool() must be called,
+  up to IRBTREE_MAX_NODES objects may be linked into a tree */
+
+#include <stdint.h> /* for uint32_t */
+#include "btree.h"
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef IRBTREE_EXPORTS
+#define IRBTREE_EXPORTS
+#endif
+
+/* expr - do not compares pointers */
+#ifndef IRBTREE_ASSERT
+#define IRBTREE_ASSERT(expr) BTREE_ASSERT(expr)
+#endif
+
+/* check that pointer is not NULL */
+#ifndef IRBTREE_ASSERT_PTR
+#define IRBTREE_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* index of an object in the pool */
+typedef uint32_t irbtree_index_t;
+
+/* no node: empty tree, missing child or parent of the root */
+#define IRBTREE_NIL       ((irbtree_index_t)0x7FFFFFFF)
+
+/* valid indices are 0..IRBTREE_MAX_NODES-1, the highest bit of an index is reserved for the color */
+#define IRBTREE_MAX_NODES IRBTREE_NIL
+
+struct irbtree_node {
+	irbtree_index_t leaves[2];    /* left, right, IRBTREE_NIL if there is no child */
+	irbtree_index_t parent_color; /* parent index << 1 + red/black color, parent is IRBTREE_NIL for the root */
+};
+
+/* left/right leaves */
+#define irbtree_left  leaves[0]
+#define irbtree_right leaves[1]
+
+/* tree - index of the root node and location of the pool of objects */
+struct irbtree {
+	char *nodes;          /* address of the node of the object with index 0 */
+	size_t stride;        /* distance between nodes of adjacent objects - the size of an object */
+	irbtree_index_t root; /* IRBTREE_NIL if tree is empty */
+};
+
+/* set the location of the pool, e.g.:
+  irbtree_set_pool(tree, &pool[0].node, sizeof(pool[0])); */
+static inline void irbtree_set_pool(
+	struct irbtree *const tree/*!=NULL*/,
+	struct irbtree_node *const first/*!=NULL*/,
+	const size_t stride)
+{
+	IRBTREE_ASSERT_PTR(tree);
+	IRBTREE_ASSERT_PTR(first);
+	tree->nodes = (char*)first;
+	tree->stride = stride;
+}
+
+/* initialize an empty tree of objects of the pool */
+static inline void irbtree_init(
+	struct irbtree *const tree/*!=NULL,out*/,
+	struct irbtree_node *const first/*!=NULL*/,
+	const size_t stride)
+{
+	irbtree_set_pool(tree, first, stride);
+	tree->root = IRBTREE_NIL;
+}
+
+static inline void irbtree_init_node(
+	struct irbtree_node *const e/*!=NULL,out*/)
+{
+	IRBTREE_ASSERT_PTR(e);
+	e->irbtree_left = IRBTREE_NIL;
+	e->irbtree_right = IRBTREE_NIL;
+	e->parent_color = (irbtree_index_t)(IRBTREE_NIL << 1);
+}
+
+/* get node of the object by its index in the pool */
+static inline struct irbtree_node *irbtree_node(
+	const struct irbtree *const tree/*!=NULL*/,
+	const irbtree_index_t i/*!=IRBTREE_NIL*/)
+{
+	IRBTREE_ASSERT_PTR(tree);
+	IRBTREE_ASSERT(i < IRBTREE_MAX_NODES);
+	{
+		void *const n = tree->nodes + (size_t)i*tree->stride;
+		return (struct irbtree_node*)n;
+	}
+}
+
+/* get index of the object in the pool by its node */
+static inline irbtree_index_t irbtree_index(
+	const struct irbtree *const tree/*!=NULL*/,
+	const struct irbtree_node *const n/*!=NULL*/)
+{
+	IRBTREE_ASSERT_PTR(tree);
+	IRBTREE_ASSERT_PTR(n);
+	return (irbtree_index_t)((size_t)((const char*)n - tree->nodes)/tree->stride);
+}
+
+static inline irbtree_index_t irbtree_get_parent(
+	const struct irbtree_node *const n/*!=NULL*/)
+{
+	IRBTREE_ASSERT_PTR(n);
+	return n->parent_color >> 1; /* IRBTREE_NIL? */
+}
+
+/* returns: 0 or 1 */
+static inline unsigned irbtree_get_color_(
+	const struct irbtree_node *const n/*!=NULL*/)
+{
+	IRBTREE_ASSERT_PTR(n);
+	return (unsigned)(n->parent_color & 1u);
+}
+
+static inline irbtree_index_t irbtree_make_parent_color_(
+	const irbtree_index_t p/*IRBTREE_NIL?*/,
+	const unsigned c/*0,1*/)
+{
+	IRBTREE_ASSERT(p <= IRBTREE_NIL);
+	IRBTREE_ASSERT(c <= 1);
+	return (irbtree_index_t)((p << 1) | c);
+}
+
+/* check that new node is not linked into the tree */
+static inline void irbtree_check_new_node(
+	const struct irbtree_node *const e/*!=NULL*/)
+{
+	(void)e;
+	IRBTREE_ASSERT_PTR(e);
+	IRBTREE_ASSERT(IRBTREE_NIL == e->irbtree_left);
+	IRBTREE_ASSERT(IRBTREE_NIL == e->irbtree_right);
+	IRBTREE_ASSERT(IRBTREE_NIL == irbtree_get_parent(e));
+}
+
+IRBTREE_EXPORTS void irbtree_rebalance(
+	struct irbtree *const tree/*!=NULL*/,
+	irbtree_index_t p/*!=IRBTREE_NIL*/,
+	irbtree_index_t e/*!=IRBTREE_NIL*/);
+
+/* insert new node with index e into the tree,
+  c - result of comparison of the keys of the parent and e:
+  c  < 0: parent key  < e's key, insert e at right of the parent;
+  c >= 0: parent key >= e's key, insert e at left of the parent */
+/* if p is IRBTREE_NIL, assume the tree is empty - e becomes the root node */
+static inline void irbtree_insert(
+	struct irbtree *const tree/*!=NULL*/,
+	const irbtree_index_t p/*IRBTREE_NIL?*/,
+	const irbtree_index_t e/*!=IRBTREE_NIL*/,
+	int c)
+{
+	IRBTREE_ASSERT_PTR(tree);
+	IRBTREE_ASSERT(p != e);
+	irbtree_check_new_node(irbtree_node(tree, e)); /* new node must have no children and parent */
+	if (IRBTREE_NIL != p) {
+		struct irbtree_node *const n = irbtree_node(tree, p);
+		IRBTREE_ASSERT(IRBTREE_NIL == n->leaves[c < 0]);
+		n->leaves[c < 0] = e;
+		irbtree_rebalance(tree, p, e);
+	}
+	else {
+		IRBTREE_ASSERT(IRBTREE_NIL == tree->root);
+		tree->root = e; /* black node */
+	}
+}
+
+/* remove node with index e from the tree */
+IRBTREE_EXPORTS void irbtree_remove(
+	struct irbtree *const tree/*!=NULL*/,
+	const irbtree_index_t e/*!=IRBTREE_NIL*/);
+
+/* non-recursive iteration over nodes of the tree */
+
+/* get the leftmost node of the subtree, returns IRBTREE_NIL if the subtree is empty */
+static inline irbtree_index_t irbtree_first(
+	const struct irbtree *const tree/*!=NULL*/,
+	irbtree_index_t i/*IRBTREE_NIL?*/)
+{
+	if (IRBTREE_NIL != i) {
+		irbtree_index_t l;
+		while (IRBTREE_NIL != (l = irbtree_node(tree, i)->irbtree_left))
+			i = l;
+	}
+	return i; /* IRBTREE_NIL? */
+}
+
+/* get the rightmost node of the subtree, returns IRBTREE_NIL if the subtree is empty */
+static inline irbtree_index_t irbtree_last(
+	const struct irbtree *const tree/*!=NULL*/,
+	irbtree_index_t i/*IRBTREE_NIL?*/)
+{
+	if (IRBTREE_NIL != i) {
+		irbtree_index_t r;
+		while (IRBTREE_NIL != (r = irbtree_node(tree, i)->irbtree_right))
+			i = r;
+	}
+	return i; /* IRBTREE_NIL? */
+}
+
+/* get next node, returns IRBTREE_NIL for the rightmost node */
+static inline irbtree_index_t irbtree_next(
+	const struct irbtree *const tree/*!=NULL*/,
+	irbtree_index_t i/*!=IRBTREE_NIL*/)
+{
+	const struct irbtree_node *n = irbtree_node(tree, i);
+	if (IRBTREE_NIL != n->irbtree_right)
+		return irbtree_first(tree, n->irbtree_right);
+	for (;;) {
+		const irbtree_index_t p = irbtree_get_parent(n);
+		if (IRBTREE_NIL == p)
+			return IRBTREE_NIL;
+		n = irbtree_node(tree, p);
+		if (i == n->irbtree_left)
+			return p;
+		i = p;
+	}
+}
+
+/* get previous node, returns IRBTREE_NIL for the leftmost node */
+static inline irbtree_index_t irbtree_prev(
+	const struct irbtree *const tree/*!=NULL*/,
+	irbtree_index_t i/*!=IRBTREE_NIL*/)
+{
+	const struct irbtree_node *n = irbtree_node(tree, i);
+	if (IRBTREE_NIL != n->irbtree_left)
+		return irbtree_last(tree, n->irbtree_left);
+	for (;;) {
+		const irbtree_index_t p = irbtree_get_parent(n);
+		if (IRBTREE_NIL == p)
+			return IRBTREE_NIL;
+		n = irbtree_node(tree, p);
+		if (i == n->irbtree_right)
+			return p;
+		i = p;
+	}
+}
+
+/* define type-specialized functions for the tree of objects of the pool of given type, e.g.:
+   void name_init(struct irbtree *tree, type *pool);                  - initialize empty tree of objects of the pool
+   void name_set_pool(struct irbtree *tree, type *pool);              - the pool was moved in memory
+   type *name_at(const struct irbtree *tree, irbtree_index_t i);      - NULL for IRBTREE_NIL
+   irbtree_index_t name_index_of(const struct irbtree *tree, const type *o);
+   type *name_search(const struct irbtree *tree, key_type key);       - NULL if not found
+   type *name_lower_bound(const struct irbtree *tree, key_type key);  - first object with key >= given one
+   type *name_upper_bound(const struct irbtree *tree, key_type key);  - first object with key > given one
+   type *name_insert(struct irbtree *tree, type *o, int leaf);        - NULL if inserted, else existing object
+   void name_remove(struct irbtree *tree, type *o);
+   type *name_first(const struct irbtree *tree);                      - NULL if the tree is empty
+   type *name_last(const struct irbtree *tree);                       - NULL if the tree is empty
+   type *name_next(const struct irbtree *tree, const type *o);        - NULL for the rightmost object
+   type *name_prev(const struct irbtree *tree, const type *o);        - NULL for the leftmost object
+  objects passed to name_insert() must be elements of the pool, initialized by irbtree_init_node(),
+  note: <stddef.h> must be included for offsetof() */
+#if 0 /* example */
+struct my_struct {
+	struct irbtree_node n;
+	int key;
+};
+#define MY_KEY_OF(o) (o)->key
+IRBTREE_DEFINE(my_tree, struct my_struct, n, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  struct my_struct *pool = (struct my_struct*)malloc(sizeof(*pool)*N);
+  struct irbtree tree;
+  my_tree_init(&tree, pool);
+  ...
+  struct my_struct *s = my_tree_search(&tree, 10);
+#endif
+#define IRBTREE_DEFINE(name, type, member, key_type, key_of, key_cmp)                          \
+static inline void name##_set_pool(                                                            \
+	struct irbtree *const tree/*!=NULL*/,                                                      \
+	type *const pool/*!=NULL*/)                                                                \
+{                                                                                              \
+	IRBTREE_ASSERT_PTR(pool);                                                                  \
+	irbtree_set_pool(tree, &pool->member, sizeof(type));                                       \
+}                                                                                              \
+static inline void name##_init(                                                                \
+	struct irbtree *const tree/*!=NULL,out*/,                                                  \
+	type *const pool/*!=NULL*/)                                                                \
+{                                                                                              \
+	IRBTREE_ASSERT_PTR(pool);                                                                  \
+	irbtree_init(tree, &pool->member, sizeof(type));                                           \
+}                                                                                              \
+static inline type *name##_at(                                                                 \
+	const struct irbtree *const tree/*!=NULL*/,                                                \
+	const irbtree_index_t i/*IRBTREE_NIL?*/)                                                   \
+{                                                                                              \
+	return IRBTREE_NIL != i ?                                                                  \
+		(type*)((char*)irbtree_node(tree, i) - offsetof(type, member)) : (type*)0;             \
+}                                                                                              \
+static inline irbtree_index_t name##_index_of(                                                 \
+	const struct irbtree *const tree/*!=NULL*/,                                                \
+	const type *const o/*!=NULL*/)                                                             \
+{                                                                                              \
+	IRBTREE_ASSERT_PTR(tree);                                                                  \
+	IRBTREE_ASSERT_PTR(o);                                                                     \
+	IRBTREE_ASSERT(tree->stride == sizeof(type));                                              \
+	/* division by the constant compiles to a multiplication, unlike the one by stride */      \
+	return (irbtree_index_t)(                                                                  \
+		(size_t)((const char*)&o->member - tree->nodes)/sizeof(type));                         \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct irbtree *const tree/*!=NULL*/,                                                \
+	const key_type key)                                                                        \
+{                                                                                              \
+	irbtree_index_t i;                                                                         \
+	IRBTREE_ASSERT_PTR(tree);                                                                  \
+	BTREE_TRACE_(BTREE_TRACE_SEARCH, key);                                                     \
+	for (i = tree->root; IRBTREE_NIL != i;) {                                                  \
+		const int c = key_cmp(key_of(name##_at(tree, i)), key); /* c = n - key */              \
+		if (c == 0)                                                                            \
+			break;                                                                             \
+		i = irbtree_node(tree, i)->leaves[c < 0];                                              \
+	}                                                                                          \
+	return name##_at(tree, i); /* NULL? */                                                     \
+}                                                                                              \
+static inline type *name##_lower_bound(                                                        \
+	const struct irbtree *const tree/*!=NULL*/,                                                \
+	const key_type key)                                                                        \
+{                                                                                              \
+	irbtree_index_t i, r = IRBTREE_NIL;                                                        \
+	IRBTREE_ASSERT_PTR(tree);                                                                  \
+	for (i = tree->root; IRBTREE_NIL != i;) {                                                  \
+		const int c = key_cmp(key_of(name##_at(tree, i)), key); /* c = n - key */              \
+		if (c >= 0)                                                                            \
+			r = i;                                                                             \
+		i = irbtree_node(tree, i)->leaves[c < 0];                                              \
+	}                                                                                          \
+	return name##_at(tree, r); /* NULL? */                                                     \
+}                                                                                              \
+static inline type *name##_upper_bound(                                                        \
+	const struct irbtree *const tree/*!=NULL*/,                                                \
+	const key_type key)                                                                        \
+{                                                                                              \
+	irbtree_index_t i, r = IRBTREE_NIL;                                                        \
+	IRBTREE_ASSERT_PTR(tree);                                                                  \
+	for (i = tree->root; IRBTREE_NIL != i;) {                                                  \
+		const int c = key_cmp(key_of(name##_at(tree, i)), key); /* c = n - key */              \
+		if (c > 0)                                                                             \
+			r = i;                                                                             \
+		i = irbtree_node(tree, i)->leaves[c <= 0];                                             \
+	}                                                                                          \
+	return name##_at(tree, r); /* NULL? */                                                     \
+}                                                                                              \
+static inline type *name##_insert(                                                             \
+	struct irbtree *const tree/*!=NULL*/,                                                      \
+	type *const o/*!=NULL*/,                                                                   \
+	const int leaf)                                                                            \
+{                                                                                              \
+	irbtree_index_t p = IRBTREE_NIL, i;                                                        \
+	int c = 1;                                                                                 \
+	IRBTREE_ASSERT_PTR(tree);                                                                  \
+	IRBTREE_ASSERT_PTR(o);                                                                     \
+	BTREE_TRACE_(BTREE_TRACE_INSERT, key_of(o));                                               \
+	for (i = tree->root; IRBTREE_NIL != i; i = irbtree_node(tree, i)->leaves[c < 0]) {         \
+		p = i;                                                                                 \
+		c = key_cmp(key_of(name##_at(tree, i)), key_of(o)); /* c = n - key */                  \
+		if (c == 0) {                                                                          \
+			if (!leaf)                                                                         \
+				return name##_at(tree, i);                                                     \
+			c = -1; /* insert after nodes with the same key */                                 \
+		}                                                                                      \
+	}                                                                                          \
+	irbtree_insert(tree, p, name##_index_of(tree, o), c);                                      \
+	return (type*)0;                                                                           \
+}                                                                                              \
+static inline void name##_remove(                                                              \
+	struct irbtree *const tree/*!=NULL*/,                                                      \
+	type *const o/*!=NULL*/)                                                                   \
+{                                                                                              \
+	IRBTREE_ASSERT_PTR(o);                                                                     \
+	BTREE_TRACE_(BTREE_TRACE_REMOVE, key_of(o));                                               \
+	irbtree_remove(tree, name##_index_of(tree, o));                                            \
+}                                                                                              \
+static inline type *name##_first(                                                              \
+	const struct irbtree *const tree/*!=NULL*/)                                                \
+{                                                                                              \
+	return name##_at(tree, irbtree_first(tree, tree->root)); /* NULL? */                       \
+}                                                                                              \
+static inline type *name##_last(                                                               \
+	const struct irbtree *const tree/*!=NULL*/)                                                \
+{                                                                                              \
+	return name##_at(tree, irbtree_last(tree, tree->root)); /* NULL? */                        \
+}                                                                                              \
+static inline type *name##_next(                                                               \
+	const struct irbtree *const tree/*!=NULL*/,                                                \
+	const type *const o/*!=NULL*/)                                                             \
+{                                                                                              \
+	return name##_at(tree, irbtree_next(tree, name##_index_of(tree, o))); /* NULL? */          \
+}                                                                                              \
+static inline type *name##_prev(                                                               \
+	const struct irbtree *const tree/*!=NULL*/,                                                \
+	const type *const o/*!=NULL*/)                                                             \
+{                                                                                              \
+	return name##_at(tree, irbtree_prev(tree, name##_index_of(tree, o))); /* NULL? */          \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRBTREE_H_INCLUDED */
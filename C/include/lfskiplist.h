@@ -0,0 +1,294 @@
+#ifndef LFSKIPLIST_H_INCLUDED
+#define LFSKIPLIST_H_INCLUDED
+
+/**********************************************************************************
+* Lock-free embedded skip list
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* lfskiplist.h */
+
+/* lock-free ordered map with embedded nodes: insert, remove and lookups may be called
+  concurrently from any number of threads, no thread blocks the others (except that remove
+  of a node waits until its concurrent insert links it at all levels),
+
+  a node is removed logically by marking its links (the lowest bit of next pointers),
+  then physically unlinked by any thread passing by (Harris list, Herlihy-Shavit skip list),
+  the height of a node is derived from its address, so there is no shared random generator,
+
+  restrictions:
+  - removed node may still be referenced by concurrent operations: all operations must
+    be called within epoch read sections (see epoch.h), and removed objects must be freed
+    only through epoch_retire() - after their removal is complete,
+  - keys are unique, keys of inserted objects must not be changed,
+  - iteration by lfskiplist_first()/lfskiplist_next() is weakly consistent: it does not return
+    removed nodes, may or may not return nodes inserted or removed during the iteration */
+
+#include <stddef.h> /* for size_t */
+#include <stdint.h> /* for uintptr_t */
+#include "btree.h"  /* for struct btree_key */
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef LFSKIPLIST_EXPORTS
+#define LFSKIPLIST_EXPORTS
+#endif
+
+/* expr - do not compares pointers */
+#ifndef LFSKIPLIST_ASSERT
+#define LFSKIPLIST_ASSERT(expr) BTREE_ASSERT(expr)
+#endif
+
+/* check that pointer is not NULL */
+#ifndef LFSKIPLIST_ASSERT_PTR
+#define LFSKIPLIST_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+/* maximum number of levels: with the probability 1/4 of a node to rise one level up,
+  the list is balanced up to 4^LFSKIPLIST_MAX_HEIGHT nodes,
+  must be the same for the library and the application */
+#ifndef LFSKIPLIST_MAX_HEIGHT
+#define LFSKIPLIST_MAX_HEIGHT 12
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined __GNUC__ || defined __clang__
+
+#define lfskiplist_load_(p)           __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define lfskiplist_store_(p, v)       __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define lfskiplist_cas_(p, old, v)    __atomic_compare_exchange_n(p, old, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+
+#include <intrin.h> /* for _InterlockedCompareExchangePointer(), _ReadWriteBarrier() */
+
+/* x86 is TSO: aligned volatile accesses are atomic, only reordering by the compiler must be prevented */
+#define lfskiplist_load_(p)           (*(void *const volatile*)(p))
+#define lfskiplist_store_(p, v)       (*(void *volatile*)(p) = (v))
+#define lfskiplist_cas_(p, old, v)    lfskiplist_cas_ptr_((void *volatile*)(p), (void**)(old), v)
+
+static inline int lfskiplist_cas_ptr_(
+	void *volatile *const p/*!=NULL*/,
+	void **const old/*!=NULL,in,out*/,
+	void *const v)
+{
+	void *const x = _InterlockedCompareExchangePointer(p, v, *old);
+	if (x == *old)
+		return 1;
+	*old = x;
+	return 0;
+}
+
+#else
+#error "atomic operations are not defined for this compiler"
+#endif
+
+struct lfskiplist_node {
+	struct lfskiplist_node *next[LFSKIPLIST_MAX_HEIGHT]; /* lowest bit: the node is removed at the level */
+	unsigned height;      /* number of levels the node is linked at, 1..LFSKIPLIST_MAX_HEIGHT */
+	unsigned linked;      /* non-zero when the node is linked at all levels */
+};
+
+struct lfskiplist {
+	struct lfskiplist_node head; /* sentinel, precedes all nodes at all levels */
+};
+
+/* returns (a - b) difference of keys of the node and the key,
+  same as btree_comparator, but for lfskiplist nodes */
+typedef int lfskiplist_comparator(
+	const struct lfskiplist_node *node/*!=NULL*/,
+	const struct btree_key *key/*!=NULL*/);
+
+static inline int lfskiplist_is_marked_(
+	const struct lfskiplist_node *const p/*NULL?*/)
+{
+	return (int)((uintptr_t)p & 1u);
+}
+
+static inline struct lfskiplist_node *lfskiplist_unmark_(
+	const struct lfskiplist_node *const p/*NULL?*/)
+{
+	return (struct lfskiplist_node*)((uintptr_t)p & ~(uintptr_t)1); /* NULL? */
+}
+
+static inline void lfskiplist_init(
+	struct lfskiplist *const list/*!=NULL,out*/)
+{
+	unsigned l = 0;
+	LFSKIPLIST_ASSERT_PTR(list);
+	for (; l < LFSKIPLIST_MAX_HEIGHT; l++)
+		list->head.next[l] = (struct lfskiplist_node*)0;
+	list->head.height = LFSKIPLIST_MAX_HEIGHT;
+	list->head.linked = 1;
+}
+
+/* insert node into the list, node is initialized by the function,
+  returns NULL if the node was inserted, else - existing node with the same key */
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_insert(
+	struct lfskiplist *const list/*!=NULL*/,
+	struct lfskiplist_node *const node/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/);
+
+/* remove a node with given key from the list,
+  returns removed node, NULL if not found (or removed concurrently by another thread),
+  after the return, the node is not reachable from the list, so it may be retired */
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_remove(
+	struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/);
+
+/* lookups, do not write shared memory */
+
+/* returns NULL if not found */
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_search(
+	const struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/);
+
+/* returns first node with key >= given one, NULL if there is no such node */
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_lower_bound(
+	const struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/);
+
+/* returns first node with key > given one, NULL if there is no such node */
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_upper_bound(
+	const struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/);
+
+/* returns first not removed node following given one at the lowest level, NULL if there is no such node */
+static inline struct lfskiplist_node *lfskiplist_next(
+	const struct lfskiplist_node *const node/*!=NULL*/)
+{
+	struct lfskiplist_node *n;
+	LFSKIPLIST_ASSERT_PTR(node);
+	n = lfskiplist_unmark_((const struct lfskiplist_node*)lfskiplist_load_(&node->next[0]));
+	while (n) {
+		const struct lfskiplist_node *const next = (const struct lfskiplist_node*)lfskiplist_load_(&n->next[0]);
+		if (!lfskiplist_is_marked_(next))
+			break;
+		n = lfskiplist_unmark_(next);
+	}
+	return n; /* NULL? */
+}
+
+/* returns first node of the list, NULL if the list is empty */
+static inline struct lfskiplist_node *lfskiplist_first(
+	const struct lfskiplist *const list/*!=NULL*/)
+{
+	LFSKIPLIST_ASSERT_PTR(list);
+	return lfskiplist_next(&list->head); /* NULL? */
+}
+
+/* define type-specialized functions for the list of objects of given type:
+  name       - prefix of names of defined functions,
+  type       - type of objects, e.g. struct my_struct,
+  member     - name of struct lfskiplist_node member of the type,
+  key_type   - type of keys, keys are passed by value,
+  key_of     - function-like macro returning the key of the object: key_of(const type *o),
+  key_cmp    - function-like macro returning (a - b) difference of keys: key_cmp(key_type a, key_type b),
+  defines next functions (to be called within epoch read sections):
+   type *name_from_node(const struct lfskiplist_node *n);                    - NULL if n is NULL
+   type *name_search(const struct lfskiplist *list, key_type key);           - NULL if not found
+   type *name_lower_bound(const struct lfskiplist *list, key_type key);      - first object with key >= given one, NULL?
+   type *name_upper_bound(const struct lfskiplist *list, key_type key);      - first object with key > given one, NULL?
+   type *name_first(const struct lfskiplist *list);                          - NULL if the list is empty
+   type *name_next(const type *o);                                           - NULL if o is the last one
+   type *name_insert(struct lfskiplist *list, type *o);                      - NULL if inserted, else - existing object
+   type *name_remove(struct lfskiplist *list, key_type key);                 - removed object, NULL if not found
+  note: <stddef.h> must be included for offsetof() */
+#if 0 /* example */
+struct my_struct {
+	struct lfskiplist_node n;
+	int key;
+};
+#define MY_KEY_OF(o) (o)->key
+LFSKIPLIST_DEFINE(my_list, struct my_struct, n, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  epoch_enter(&domain, &reader);
+  s = my_list_remove(&list, 10);
+  epoch_leave(&reader);
+  if (s) {
+    lock(&retire_lock);
+    epoch_retire(&domain, s, my_free, NULL);
+    unlock(&retire_lock);
+  }
+#endif
+#define LFSKIPLIST_DEFINE(name, type, member, key_type, key_of, key_cmp)                       \
+static inline type *name##_from_node(                                                          \
+	const struct lfskiplist_node *const n/*NULL?*/)                                            \
+{                                                                                              \
+	return n ? (type*)((char*)(struct lfskiplist_node*)n - offsetof(type, member)) : (type*)0; \
+}                                                                                              \
+static inline int name##_comparator_(                                                          \
+	const struct lfskiplist_node *const n/*!=NULL*/,                                           \
+	const struct btree_key *const k/*!=NULL*/)                                                 \
+{                                                                                              \
+	const void *const key = k;                                                                 \
+	return key_cmp(key_of(name##_from_node(n)), *(const key_type*)key); /* n - key */          \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct lfskiplist *const list/*!=NULL*/,                                             \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *const k = &key;                                                                \
+	return name##_from_node(                                                                   \
+		lfskiplist_search(list, (const struct btree_key*)k, name##_comparator_));              \
+}                                                                                              \
+static inline type *name##_lower_bound(                                                        \
+	const struct lfskiplist *const list/*!=NULL*/,                                             \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *const k = &key;                                                                \
+	return name##_from_node(                                                                   \
+		lfskiplist_lower_bound(list, (const struct btree_key*)k, name##_comparator_));         \
+}                                                                                              \
+static inline type *name##_upper_bound(                                                        \
+	const struct lfskiplist *const list/*!=NULL*/,                                             \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *const k = &key;                                                                \
+	return name##_from_node(                                                                   \
+		lfskiplist_upper_bound(list, (const struct btree_key*)k, name##_comparator_));         \
+}                                                                                              \
+static inline type *name##_first(                                                              \
+	const struct lfskiplist *const list/*!=NULL*/)                                             \
+{                                                                                              \
+	return name##_from_node(lfskiplist_first(list));                                           \
+}                                                                                              \
+static inline type *name##_next(                                                               \
+	const type *const o/*!=NULL*/)                                                             \
+{                                                                                              \
+	return name##_from_node(lfskiplist_next(&o->member));                                      \
+}                                                                                              \
+static inline type *name##_insert(                                                             \
+	struct lfskiplist *const list/*!=NULL*/,                                                   \
+	type *const o/*!=NULL*/)                                                                   \
+{                                                                                              \
+	const key_type key = key_of(o);                                                            \
+	const void *const k = &key;                                                                \
+	BTREE_TRACE_(BTREE_TRACE_INSERT, key);                                                     \
+	return name##_from_node(                                                                   \
+		lfskiplist_insert(list, &o->member, (const struct btree_key*)k, name##_comparator_));  \
+}                                                                                              \
+static inline type *name##_remove(                                                             \
+	struct lfskiplist *const list/*!=NULL*/,                                                   \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *const k = &key;                                                                \
+	BTREE_TRACE_(BTREE_TRACE_REMOVE, key);                                                     \
+	return name##_from_node(                                                                   \
+		lfskiplist_remove(list, (const struct btree_key*)k, name##_comparator_));              \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LFSKIPLIST_H_INCLUDED */
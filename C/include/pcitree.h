@@ -0,0 +1,213 @@
+#ifndef PCITREE_H_INCLUDED
+#define PCITREE_H_INCLUDED
+
+/**********************************************************************************
+* Embedded interval tree based on red-black binary tree of nodes with parent pointers
+* Copyright (C) 2018-2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* pcitree.h */
+
+/* interval tree: nodes are ordered by interval start, each node also stores
+  the maximum interval end over its subtree - this allows to skip whole subtrees
+  which cannot contain an overlapping interval: finding the first interval
+  overlapping given one costs O(log(n)), each next one - O(log(n)) in the worst case
+  (the walk may climb and re-descend past non-overlapping nodes), so finding all k
+  overlapping intervals costs O((k + 1)*log(n)), but not more than O(n) */
+
+/* intervals are closed: [start, end], start <= end,
+  for half-open intervals of integers [start, end) use [start, end - 1] */
+
+#include "pcrbtree.h"
+
+/* type of interval points, must support < and <= operators,
+  note: library must be compiled with the same definition */
+#ifndef PCITREE_POINT
+#define PCITREE_POINT long long
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef PCITREE_POINT pcitree_point_t;
+
+struct pcitree_node {
+	struct pcrbtree_node n;
+	pcitree_point_t start;
+	pcitree_point_t end;
+	pcitree_point_t max_end; /* maximum end over the subtree, including this node */
+};
+
+static inline struct pcitree_node *pcitree_node_from_pcrbtree_node_(
+	const struct pcrbtree_node *const n/*NULL?*/)
+{
+	void *const x = pcrbtree_node_to_btree_node_(n/*NULL?*/);
+	return (struct pcitree_node*)x;
+}
+
+/* tree - just a pointer to the root node */
+struct pcitree {
+	struct pcitree_node *root; /* NULL if tree is empty */
+};
+
+static inline void pcitree_init(
+	struct pcitree *const tree/*!=NULL,out*/)
+{
+	PCRBTREE_ASSERT_PTR(tree);
+	tree->root = (struct pcitree_node*)0;
+}
+
+static inline void pcitree_init_node(
+	struct pcitree_node *const e/*!=NULL,out*/,
+	const pcitree_point_t start,
+	const pcitree_point_t end)
+{
+	PCRBTREE_ASSERT_PTR(e);
+	PCRBTREE_ASSERT(!(end < start));
+	pcrbtree_init_node(&e->n);
+	e->start = start;
+	e->end = end;
+	e->max_end = end;
+}
+
+static inline struct pcitree_node *pcitree_get_parent(
+	const struct pcitree_node *const n/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(n);
+	return pcitree_node_from_pcrbtree_node_(pcrbtree_get_parent(&n->n)); /* NULL? */
+}
+
+static inline struct pcitree_node *pcitree_left_(
+	const struct pcitree_node *const n/*!=NULL*/)
+{
+	return pcitree_node_from_pcrbtree_node_(n->n.pcrbtree_left); /* NULL? */
+}
+
+static inline struct pcitree_node *pcitree_right_(
+	const struct pcitree_node *const n/*!=NULL*/)
+{
+	return pcitree_node_from_pcrbtree_node_(n->n.pcrbtree_right); /* NULL? */
+}
+
+/* insert new node into the tree, node must be initialized by pcitree_init_node(),
+  nodes with equal starts are allowed - new node is inserted after existing ones */
+PCRBTREE_EXPORTS void pcitree_insert(
+	struct pcitree *const tree/*!=NULL*/,
+	struct pcitree_node *PCRBTREE_RESTRICT const e/*!=NULL*/);
+
+/* remove node from the tree */
+PCRBTREE_EXPORTS void pcitree_remove(
+	struct pcitree *const tree/*!=NULL*/,
+	struct pcitree_node *PCRBTREE_RESTRICT e/*!=NULL*/);
+
+/* get next node (ordered by interval start), returns NULL for the rightmost node */
+static inline struct pcitree_node *pcitree_next(
+	const struct pcitree_node *const current/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(current);
+	return pcitree_node_from_pcrbtree_node_(pcrbtree_next(&current->n)); /* NULL? */
+}
+
+/* get previous node (ordered by interval start), returns NULL for the leftmost node */
+static inline struct pcitree_node *pcitree_prev(
+	const struct pcitree_node *const current/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(current);
+	return pcitree_node_from_pcrbtree_node_(pcrbtree_prev(&current->n)); /* NULL? */
+}
+
+/* find the leftmost node of the subtree which interval overlaps [from, to],
+  subtree max_end must be >= from */
+static inline struct pcitree_node *pcitree_subtree_overlap_(
+	const struct pcitree_node *n/*!=NULL*/,
+	const pcitree_point_t from,
+	const pcitree_point_t to)
+{
+	for (;;) {
+		const struct pcitree_node *const l = pcitree_left_(n);
+		PCRBTREE_ASSERT(!(n->max_end < from));
+		if (l && !(l->max_end < from))
+			n = l; /* if there is no overlap in the left subtree, then there is no overlap at all */
+		else if (to < n->start)
+			return (struct pcitree_node*)0; /* n and all nodes of the right subtree start after the 'to' */
+		else if (!(n->end < from))
+			return (struct pcitree_node*)n;
+		else {
+			n = pcitree_right_(n);
+			if (!n || n->max_end < from)
+				return (struct pcitree_node*)0;
+		}
+	}
+}
+
+/* find the first (ordered by interval start) node which interval overlaps [from, to], from <= to,
+  returns NULL if there are no such nodes */
+#if 0 /* example */
+  struct pcitree_node *n = pcitree_first_overlap(tree, from, to);
+  for (; n; n = pcitree_next_overlap(n, from, to)) {
+    ...
+  }
+#endif
+static inline struct pcitree_node *pcitree_first_overlap(
+	const struct pcitree *const tree/*!=NULL*/,
+	const pcitree_point_t from,
+	const pcitree_point_t to)
+{
+	PCRBTREE_ASSERT_PTR(tree);
+	PCRBTREE_ASSERT(!(to < from));
+	if (!tree->root || tree->root->max_end < from)
+		return (struct pcitree_node*)0;
+	return pcitree_subtree_overlap_(tree->root, from, to); /* NULL? */
+}
+
+/* find the node next to the current one, which interval overlaps [from, to],
+  current - node returned by pcitree_first_overlap() or pcitree_next_overlap() for the same [from, to],
+  returns NULL if there are no more such nodes */
+static inline struct pcitree_node *pcitree_next_overlap(
+	const struct pcitree_node *current/*!=NULL*/,
+	const pcitree_point_t from,
+	const pcitree_point_t to)
+{
+	PCRBTREE_ASSERT_PTR(current);
+	PCRBTREE_ASSERT(!(to < from));
+	{
+		const struct pcitree_node *r = pcitree_right_(current);
+		for (;;) {
+			const struct pcitree_node *p;
+			if (r && !(r->max_end < from))
+				return pcitree_subtree_overlap_(r, from, to); /* NULL? */
+			/* go up while coming from the right */
+			for (;;) {
+				p = pcitree_get_parent(current);
+				if (!p)
+					return (struct pcitree_node*)0;
+				r = pcitree_right_(p);
+				if (current != r)
+					break;
+				current = p;
+			}
+			current = p;
+			if (to < current->start)
+				return (struct pcitree_node*)0;
+			if (!(current->end < from))
+				return (struct pcitree_node*)current;
+		}
+	}
+}
+
+/* stabbing query: find the first (ordered by interval start) node which interval contains the point,
+  use pcitree_next_overlap(n, point, point) to get the next one */
+static inline struct pcitree_node *pcitree_stab(
+	const struct pcitree *const tree/*!=NULL*/,
+	const pcitree_point_t point)
+{
+	return pcitree_first_overlap(tree, point, point); /* NULL? */
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PCITREE_H_INCLUDED */
@@ -330,6 +330,7 @@ static inline void pcrbtree_insert(
 	}
 	else {
 		PCRBTREE_ASSERT(!tree->root);
+		BTREE_STATS_INC_(BTREE_STATS_PCRBTREE, inserts);
 		tree->root = e; /* black node */
 	}
 }
@@ -403,6 +404,192 @@ PCRBTREE_EXPORTS void pcrbtree_remove(
 	struct pcrbtree *const tree/*!=NULL*/,
 	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/);
 
+/* augmented tree: each node may store augmented data, computed from the data of the node and
+  augmented data of its children, for example, an aggregate (sum, min, max, ...) over the subtree,
+  next callbacks are called to keep augmented data up to date during insertion and removal */
+struct pcrbtree_augment {
+	/* recompute augmented data of nodes on the path from n up to stop (excluding), if stop is NULL - up to the root,
+	  note: must not stop early - augmented data of each node on the path must be recomputed from its children */
+	void (*propagate)(struct pcrbtree_node *n/*!=NULL*/, const struct pcrbtree_node *stop/*NULL?*/);
+	/* called after rotation: new top of the subtree n takes augmented data of the old top o,
+	  then augmented data of o must be recomputed from its children */
+	void (*rotate)(struct pcrbtree_node *o/*!=NULL*/, struct pcrbtree_node *n/*!=NULL*/);
+	/* copy augmented data of the node o to the node n which has replaced o in the tree */
+	void (*copy)(const struct pcrbtree_node *o/*!=NULL*/, struct pcrbtree_node *n/*!=NULL*/);
+};
+
+#if 0 /* example */
+struct my_node {
+	struct pcrbtree_node n;
+	int value;
+	int max_value; /* augmented data: maximum of values of the subtree */
+};
+static void my_compute(struct pcrbtree_node *n)
+{
+	struct my_node *m = CONTAINER_OF(n, struct my_node, n);
+	int max = m->value;
+	if (n->pcrbtree_left && CONTAINER_OF(n->pcrbtree_left, struct my_node, n)->max_value > max)
+		max = CONTAINER_OF(n->pcrbtree_left, struct my_node, n)->max_value;
+	if (n->pcrbtree_right && CONTAINER_OF(n->pcrbtree_right, struct my_node, n)->max_value > max)
+		max = CONTAINER_OF(n->pcrbtree_right, struct my_node, n)->max_value;
+	m->max_value = max;
+}
+static void my_propagate(struct pcrbtree_node *n, const struct pcrbtree_node *stop)
+{
+	for (; n != stop; n = pcrbtree_get_parent(n))
+		my_compute(n);
+}
+static void my_rotate(struct pcrbtree_node *o, struct pcrbtree_node *n)
+{
+	CONTAINER_OF(n, struct my_node, n)->max_value = CONTAINER_OF(o, struct my_node, n)->max_value;
+	my_compute(o);
+}
+static void my_copy(const struct pcrbtree_node *o, struct pcrbtree_node *n)
+{
+	CONTAINER_OF(n, struct my_node, n)->max_value = CONTAINER_OF(o, const struct my_node, n)->max_value;
+}
+static const struct pcrbtree_augment my_augment = {my_propagate, my_rotate, my_copy};
+#endif
+
+/* same as pcrbtree_insert(), but also maintains augmented data of nodes,
+  augmented data of e is initialized via aug->propagate() */
+PCRBTREE_EXPORTS void pcrbtree_insert_augmented(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const p/*NULL?*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const e/*!=NULL*/,
+	const int c,
+	const struct pcrbtree_augment *const aug/*!=NULL*/);
+
+/* same as pcrbtree_remove(), but also maintains augmented data of nodes */
+PCRBTREE_EXPORTS void pcrbtree_remove_augmented(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/,
+	const struct pcrbtree_augment *const aug/*!=NULL*/);
+
+/* same as pcrbtree_replace(), but also copies augmented data of the old node to the new one */
+static inline void pcrbtree_replace_augmented(
+	struct pcrbtree *const tree/*!=NULL*/,
+	const struct pcrbtree_node *PCRBTREE_RESTRICT const o/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const e/*!=NULL,out*/,
+	const struct pcrbtree_augment *const aug/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(aug);
+	pcrbtree_replace(tree, o, e);
+	(*aug->copy)(o, e);
+}
+
+/* build the tree from an array of nodes sorted by keys in ascending order,
+  nodes are linked in O(count) without key comparisons,
+  previous contents of the tree (if any) are discarded,
+  nodes need not be initialized */
+#if 0 /* example */
+  struct pcrbtree_node *nodes[N]; /* filled in key order, e.g. by iterating a sorted dlist */
+  pcrbtree_build_sorted(tree, nodes, N);
+#endif
+PCRBTREE_EXPORTS void pcrbtree_build_sorted(
+	struct pcrbtree *const tree/*!=NULL,out*/,
+	struct pcrbtree_node *const nodes[]/*!=NULL if count>0*/,
+	const size_t count);
+
+/* insert nodes of the array into the tree, in order of the array,
+  search of the place for a node starts from the previously inserted one:
+  inserting of a (nearly) sorted array costs amortized O(1) comparisons per node,
+  leaf - non-zero if the tree allows nodes with non-unique keys,
+  returns count if all nodes were inserted, else - the index of the first node
+  which key is equal to the key of a node in the tree (possible only if leaf == 0),
+  nodes starting from that index are not inserted,
+  nodes must be initialized by pcrbtree_init_node() */
+PCRBTREE_EXPORTS size_t pcrbtree_insert_batch(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *const nodes[]/*!=NULL if count>0*/,
+	const size_t count,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	const int leaf);
+
+/* join two trees using pivot node: all keys of the left tree must be <= the key of the pivot,
+  the key of the pivot must be <= all keys of the right tree,
+  the result is stored in the left tree, the right tree becomes empty,
+  costs O(log n), pivot node need not be initialized,
+  note: augmented data of nodes is not maintained */
+PCRBTREE_EXPORTS void pcrbtree_join(
+	struct pcrbtree *const left/*!=NULL,in,out*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const pivot/*!=NULL*/,
+	struct pcrbtree *const right/*!=NULL,in,out*/);
+
+/* same as pcrbtree_join(), but without pivot: the leftmost node of the right tree is used as the pivot */
+PCRBTREE_EXPORTS void pcrbtree_concat(
+	struct pcrbtree *const left/*!=NULL,in,out*/,
+	struct pcrbtree *const right/*!=NULL,in,out*/);
+
+/* split the tree in O(log n): nodes with keys < given one are moved to the left tree,
+  others - to the right tree, previous contents of the left and right trees are discarded,
+  tree may be the same as left or right one,
+  note: augmented data of nodes is not maintained */
+#if 0 /* example: remove nodes with keys in range [from, to) in O(log n) */
+  struct pcrbtree mid, right;
+  pcrbtree_split(tree, &from.k, comparator, tree, &mid);
+  pcrbtree_split(&mid, &to.k, comparator, &mid, &right);
+  pcrbtree_concat(tree, &right);
+  /* walk over removed nodes of the mid tree... */
+#endif
+PCRBTREE_EXPORTS void pcrbtree_split(
+	struct pcrbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	struct pcrbtree *const left/*!=NULL,out*/,
+	struct pcrbtree *const right/*!=NULL,out*/);
+
+/* set operations on trees with unique keys: nodes are re-linked in place, without allocation,
+  cost O(m*log(n/m + 1)), where m and n - sizes of smaller and bigger trees,
+  the result is stored in tree1, nodes which are not in the result are passed to the deleter (if not NULL),
+  if the library is compiled with OpenMP support, big subtrees are processed in parallel tasks,
+  then the deleter may be called concurrently from different threads,
+  note: augmented data of nodes is not maintained */
+
+/* union: all nodes of tree2 are moved to tree1, except nodes which keys are already in tree1,
+  tree2 becomes empty */
+PCRBTREE_EXPORTS void pcrbtree_union(
+	struct pcrbtree *const tree1/*!=NULL,in,out*/,
+	struct pcrbtree *const tree2/*!=NULL,in,out*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj);
+
+/* intersection: remove nodes of tree1 which keys are not in tree2, tree2 is not changed */
+PCRBTREE_EXPORTS void pcrbtree_intersection(
+	struct pcrbtree *const tree1/*!=NULL,in,out*/,
+	const struct pcrbtree *const tree2/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj);
+
+/* difference: remove nodes of tree1 which keys are in tree2, tree2 is not changed */
+PCRBTREE_EXPORTS void pcrbtree_difference(
+	struct pcrbtree *const tree1/*!=NULL,in,out*/,
+	const struct pcrbtree *const tree2/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj);
+
+/* relocate all nodes of the tree into a contiguous buffer of objects, in given layout,
+  so that nodes visited one after another by searches are close in memory,
+  buf - array of capacity objects, each of object_size bytes, must not overlap objects of the tree,
+  node_offset - offset of the tree node in an object, e.g. offsetof(struct my_object, node),
+  mover - called for each node, parents before children, to move the object to its place in the buffer,
+  links of the moved node are fixed after the call, the old object is not accessed after the call,
+  returns number of relocated nodes, 0 if the tree is empty or has more than capacity nodes,
+  then the tree is not changed,
+  note: augmented data (e.g. of pcitree) is moved together with objects by the mover */
+PCRBTREE_EXPORTS size_t pcrbtree_relocate(
+	struct pcrbtree *const tree/*!=NULL,in,out*/,
+	void *const buf/*!=NULL if capacity>0*/,
+	const size_t capacity,
+	const size_t object_size,
+	const size_t node_offset,
+	const enum btree_layout layout,
+	btree_mover *const mover/*!=NULL*/,
+	struct btree_object *const obj);
+
 /* non-recursive iteration over nodes of the tree */
 
 /* find right parent */
@@ -457,6 +644,221 @@ static inline struct pcrbtree_node *pcrbtree_prev(
 	return pcrbtree_left_parent(current); /* NULL? */
 }
 
+/* same as pcrbtree_right_parent(), but climbing, prefetch the grandparent before checking
+  the parent, and prefetch the right child of the found parent - it is the root of the subtree
+  visited next */
+static inline struct pcrbtree_node *pcrbtree_right_parent_prefetch_(
+	const struct pcrbtree_node *current/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(current);
+	for (;;) {
+		struct pcrbtree_node *const p = pcrbtree_get_parent(current);
+		if (!p)
+			return NULL;
+		BTREE_PREFETCH(pcrbtree_get_parent(p)/*NULL?*/);
+		if (current == p->pcrbtree_left) {
+			BTREE_PREFETCH(p->pcrbtree_right/*NULL?*/);
+			return p;
+		}
+		current = p;
+	}
+}
+
+/* same as pcrbtree_left_parent(), but prefetches like pcrbtree_right_parent_prefetch_() */
+static inline struct pcrbtree_node *pcrbtree_left_parent_prefetch_(
+	const struct pcrbtree_node *current/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(current);
+	for (;;) {
+		struct pcrbtree_node *const p = pcrbtree_get_parent(current);
+		if (!p)
+			return NULL;
+		BTREE_PREFETCH(pcrbtree_get_parent(p)/*NULL?*/);
+		if (current == p->pcrbtree_right) {
+			BTREE_PREFETCH(p->pcrbtree_left/*NULL?*/);
+			return p;
+		}
+		current = p;
+	}
+}
+
+/* same as pcrbtree_next(), but also prefetches nodes which will be visited by the next calls:
+  descending to the leftmost node of the right subtree, prefetch right children of the nodes of
+  the left spine - they are roots of subtrees which are visited next, so iteration over a tree
+  which does not fit into the cache does not stall on each of them; climbing up, prefetch
+  the grandparent before checking the parent */
+static inline struct pcrbtree_node *pcrbtree_next_prefetch(
+	const struct pcrbtree_node *const current/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(current);
+	{
+		struct pcrbtree_node *n = current->pcrbtree_right;
+		if (n) {
+			for (;;) {
+				struct pcrbtree_node *const l = n->pcrbtree_left;
+				BTREE_PREFETCH(n->pcrbtree_right/*NULL?*/);
+				if (!l)
+					return n;
+				n = l;
+			}
+		}
+	}
+	return pcrbtree_right_parent_prefetch_(current); /* NULL? */
+}
+
+/* same as pcrbtree_prev(), but also prefetches nodes which will be visited by the next calls */
+static inline struct pcrbtree_node *pcrbtree_prev_prefetch(
+	const struct pcrbtree_node *const current/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(current);
+	{
+		struct pcrbtree_node *n = current->pcrbtree_left;
+		if (n) {
+			for (;;) {
+				struct pcrbtree_node *const r = n->pcrbtree_right;
+				BTREE_PREFETCH(n->pcrbtree_left/*NULL?*/);
+				if (!r)
+					return n;
+				n = r;
+			}
+		}
+	}
+	return pcrbtree_left_parent_prefetch_(current); /* NULL? */
+}
+
+/* define type-specialized functions for the tree of objects of given type,
+  with comparison of keys inlined (no calls via comparator pointer):
+  name       - prefix of names of defined functions,
+  type       - type of objects, e.g. struct my_struct,
+  member     - name of struct pcrbtree_node member of the type,
+  key_type   - type of keys, keys are passed by value,
+  key_of     - function-like macro returning the key of the object: key_of(const type *o),
+  key_cmp    - function-like macro returning (a - b) difference of keys: key_cmp(key_type a, key_type b),
+  defines next functions:
+   type *name_from_node(const struct pcrbtree_node *n);                - NULL if n is NULL
+   type *name_search(const struct pcrbtree *tree, key_type key);       - NULL if not found
+   type *name_lower_bound(const struct pcrbtree *tree, key_type key);  - first object with key >= given one, NULL?
+   type *name_upper_bound(const struct pcrbtree *tree, key_type key);  - first object with key > given one, NULL?
+   type *name_insert(struct pcrbtree *tree, type *o, int leaf);        - insert initialized object, returns NULL,
+                                                                         if leaf == 0 and the tree already has an
+                                                                         object with the same key - returns that object
+   void name_remove(struct pcrbtree *tree, type *o);
+   type *name_next(const type *o);                                     - NULL for the rightmost object
+   type *name_prev(const type *o);                                     - NULL for the leftmost object
+  note: <stddef.h> must be included for offsetof() */
+#if 0 /* example */
+struct my_struct {
+	struct pcrbtree_node n;
+	int key;
+};
+#define MY_KEY_OF(o) (o)->key
+PCRBTREE_DEFINE(my_tree, struct my_struct, n, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  struct my_struct *s = my_tree_search(&tree, 10);
+#endif
+#define PCRBTREE_DEFINE(name, type, member, key_type, key_of, key_cmp)                         \
+static inline type *name##_from_node(                                                          \
+	const struct pcrbtree_node *const n/*NULL?*/)                                              \
+{                                                                                              \
+	return n ? (type*)((char*)btree_const_cast(pcrbtree_node_to_btree_node_(n)) -              \
+		offsetof(type, member)) : (type*)0;                                                    \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct pcrbtree *const tree/*!=NULL*/,                                               \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const struct pcrbtree_node *n;                                                             \
+	BTREE_PERF_BEGIN_(perf_s_);                                                                \
+	PCRBTREE_ASSERT_PTR(tree);                                                                 \
+	BTREE_TRACE_(BTREE_TRACE_SEARCH, key);                                                     \
+	BTREE_STATS_INC_(BTREE_STATS_PCRBTREE, searches);                                          \
+	for (n = tree->root; n;) {                                                                 \
+		const int c = key_cmp(key_of(name##_from_node(n)), key); /* c = n - key */             \
+		BTREE_STATS_INC_(BTREE_STATS_PCRBTREE, search_depth);                                  \
+		if (c == 0)                                                                            \
+			break;                                                                             \
+		n = n->u.leaves[c < 0];                                                                \
+	}                                                                                          \
+	BTREE_PERF_END_(BTREE_PERF_SEARCH, perf_s_);                                               \
+	return name##_from_node(n); /* NULL? */                                                    \
+}                                                                                              \
+static inline type *name##_lower_bound(                                                        \
+	const struct pcrbtree *const tree/*!=NULL*/,                                               \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const struct pcrbtree_node *n, *r = (const struct pcrbtree_node*)0;                        \
+	PCRBTREE_ASSERT_PTR(tree);                                                                 \
+	for (n = tree->root; n;) {                                                                 \
+		const int c = key_cmp(key_of(name##_from_node(n)), key); /* c = n - key */             \
+		if (c >= 0)                                                                            \
+			r = n;                                                                             \
+		n = n->u.leaves[c < 0];                                                                \
+	}                                                                                          \
+	return name##_from_node(r); /* NULL? */                                                    \
+}                                                                                              \
+static inline type *name##_upper_bound(                                                        \
+	const struct pcrbtree *const tree/*!=NULL*/,                                               \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const struct pcrbtree_node *n, *r = (const struct pcrbtree_node*)0;                        \
+	PCRBTREE_ASSERT_PTR(tree);                                                                 \
+	for (n = tree->root; n;) {                                                                 \
+		const int c = key_cmp(key_of(name##_from_node(n)), key); /* c = n - key */             \
+		if (c > 0)                                                                             \
+			r = n;                                                                             \
+		n = n->u.leaves[c <= 0];                                                               \
+	}                                                                                          \
+	return name##_from_node(r); /* NULL? */                                                    \
+}                                                                                              \
+static inline type *name##_insert(                                                             \
+	struct pcrbtree *const tree/*!=NULL*/,                                                     \
+	type *const o/*!=NULL*/,                                                                   \
+	const int leaf)                                                                            \
+{                                                                                              \
+	struct pcrbtree_node *p = (struct pcrbtree_node*)0, *n;                                    \
+	int c = 1;                                                                                 \
+	BTREE_PERF_BEGIN_(perf_s_);                                                                \
+	PCRBTREE_ASSERT_PTR(tree);                                                                 \
+	PCRBTREE_ASSERT_PTR(o);                                                                    \
+	BTREE_TRACE_(BTREE_TRACE_INSERT, key_of(o));                                               \
+	BTREE_STATS_INC_(BTREE_STATS_PCRBTREE, searches);                                          \
+	for (n = tree->root; n; n = n->u.leaves[c < 0]) {                                          \
+		p = n;                                                                                 \
+		BTREE_STATS_INC_(BTREE_STATS_PCRBTREE, search_depth);                                  \
+		c = key_cmp(key_of(name##_from_node(n)), key_of(o)); /* c = n - key */                 \
+		if (c == 0) {                                                                          \
+			if (!leaf) {                                                                       \
+				BTREE_PERF_END_(BTREE_PERF_SEARCH_PARENT, perf_s_);                            \
+				return name##_from_node(n);                                                    \
+			}                                                                                  \
+			c = -1; /* insert after nodes with the same key */                                 \
+		}                                                                                      \
+	}                                                                                          \
+	BTREE_PERF_END_(BTREE_PERF_SEARCH_PARENT, perf_s_);                                        \
+	pcrbtree_insert(tree, p, &o->member, c);                                                   \
+	return (type*)0;                                                                           \
+}                                                                                              \
+static inline void name##_remove(                                                              \
+	struct pcrbtree *const tree/*!=NULL*/,                                                     \
+	type *const o/*!=NULL*/)                                                                   \
+{                                                                                              \
+	PCRBTREE_ASSERT_PTR(o);                                                                    \
+	BTREE_TRACE_(BTREE_TRACE_REMOVE, key_of(o));                                               \
+	pcrbtree_remove(tree, &o->member);                                                         \
+}                                                                                              \
+static inline type *name##_next(                                                               \
+	const type *const o/*!=NULL*/)                                                             \
+{                                                                                              \
+	PCRBTREE_ASSERT_PTR(o);                                                                    \
+	return name##_from_node(pcrbtree_next(&o->member)); /* NULL? */                            \
+}                                                                                              \
+static inline type *name##_prev(                                                               \
+	const type *const o/*!=NULL*/)                                                             \
+{                                                                                              \
+	PCRBTREE_ASSERT_PTR(o);                                                                    \
+	return name##_from_node(pcrbtree_prev(&o->member)); /* NULL? */                            \
+}
+
 #ifdef __cplusplus
 }
 #endif
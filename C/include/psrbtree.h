@@ -0,0 +1,239 @@
+#ifndef PSRBTREE_H_INCLUDED
+#define PSRBTREE_H_INCLUDED
+
+/**********************************************************************************
+* Embedded red-black binary tree of nodes with parent pointers and subtree sizes
+* Copyright (C) 2012-2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* psrbtree.h */
+
+/* order-statistic tree: each node also stores the number of nodes in its subtree,
+  this allows to find a node by its index in the tree (select),
+  get the index of a node (rank) and count nodes in a range of keys in O(log(n)) */
+
+#include "prbtree.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct psrbtree_node {
+	struct prbtree_node n;
+	size_t size; /* number of nodes in the subtree, including this node */
+};
+
+static inline struct psrbtree_node *psrbtree_node_from_prbtree_node_(
+	const struct prbtree_node *const n/*NULL?*/)
+{
+	void *const x = prbtree_node_to_btree_node_(n/*NULL?*/);
+	return (struct psrbtree_node*)x;
+}
+
+static inline struct psrbtree_node *psrbtree_node_from_btree_node_(
+	const struct btree_node *const n/*NULL?*/)
+{
+	return psrbtree_node_from_prbtree_node_(prbtree_node_from_btree_node_(n/*NULL?*/));
+}
+
+static inline struct btree_node *psrbtree_node_to_btree_node_(
+	const struct psrbtree_node *const p/*NULL?*/)
+{
+	const void *const x = p;
+	return btree_const_cast((const struct btree_node*)x/*NULL?*/);
+}
+
+/* tree - just a pointer to the root node */
+struct psrbtree {
+	struct psrbtree_node *root; /* NULL if tree is empty */
+};
+
+static inline void psrbtree_init(
+	struct psrbtree *const tree/*!=NULL,out*/)
+{
+	PRBTREE_ASSERT_PTR(tree);
+	tree->root = (struct psrbtree_node*)0;
+}
+
+static inline void psrbtree_init_node(
+	struct psrbtree_node *const e/*!=NULL,out*/)
+{
+	PRBTREE_ASSERT_PTR(e);
+	prbtree_init_node(&e->n);
+	e->size = 1;
+}
+
+/* returns number of nodes in the subtree, 0 if n is NULL */
+static inline size_t psrbtree_size(
+	const struct psrbtree_node *const n/*NULL?*/)
+{
+	return n ? n->size : 0;
+}
+
+/* returns number of nodes in the subtree, 0 if n is NULL */
+static inline size_t psrbtree_size_(
+	const struct prbtree_node *const n/*NULL?*/)
+{
+	return psrbtree_size(psrbtree_node_from_prbtree_node_(n/*NULL?*/));
+}
+
+/* returns number of nodes in the tree */
+static inline size_t psrbtree_count(
+	const struct psrbtree *const tree/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(tree);
+	return psrbtree_size(tree->root);
+}
+
+static inline struct psrbtree_node *psrbtree_get_parent(
+	const struct psrbtree_node *const n/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(n);
+	return psrbtree_node_from_prbtree_node_(prbtree_get_parent(&n->n)); /* NULL? */
+}
+
+/* returns: 0 or 1 */
+static inline unsigned psrbtree_get_color_(
+	const struct psrbtree_node *const n/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(n);
+	return prbtree_get_color_(&n->n);
+}
+
+/* insert new node into the tree, same as prbtree_insert(),
+  also updates subtree sizes */
+PRBTREE_EXPORTS void psrbtree_insert(
+	struct psrbtree *const tree/*!=NULL*/,
+	struct psrbtree_node *PRBTREE_RESTRICT const p/*NULL?*/,
+	struct psrbtree_node *PRBTREE_RESTRICT const e/*!=NULL*/,
+	int c);
+
+/* replace old node in the tree with a new one */
+static inline void psrbtree_replace(
+	struct psrbtree *const tree/*!=NULL*/,
+	const struct psrbtree_node *PRBTREE_RESTRICT const o/*!=NULL*/,
+	struct psrbtree_node *PRBTREE_RESTRICT const e/*!=NULL,out*/)
+{
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT_PTR(tree->root);
+	PRBTREE_ASSERT_PTR(o);
+	PRBTREE_ASSERT_PTR(e);
+	PRBTREE_ASSERT_PTRS(o != e);
+	{
+		struct prbtree t;
+		t.root = &tree->root->n;
+		prbtree_replace(&t, &o->n, &e->n);
+		tree->root = psrbtree_node_from_prbtree_node_(t.root);
+		e->size = o->size;
+	}
+}
+
+/* remove node from the tree, also updates subtree sizes */
+PRBTREE_EXPORTS void psrbtree_remove(
+	struct psrbtree *const tree/*!=NULL*/,
+	struct psrbtree_node *PRBTREE_RESTRICT e/*!=NULL*/);
+
+/* get next node, returns NULL for the rightmost node */
+static inline struct psrbtree_node *psrbtree_next(
+	const struct psrbtree_node *const current/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(current);
+	return psrbtree_node_from_prbtree_node_(prbtree_next(&current->n)); /* NULL? */
+}
+
+/* get previous node, returns NULL for the leftmost node */
+static inline struct psrbtree_node *psrbtree_prev(
+	const struct psrbtree_node *const current/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(current);
+	return psrbtree_node_from_prbtree_node_(prbtree_prev(&current->n)); /* NULL? */
+}
+
+/* get node by its index in the tree (0 - the leftmost node),
+  returns NULL if index >= number of nodes in the tree */
+static inline struct psrbtree_node *psrbtree_select(
+	const struct psrbtree *const tree/*!=NULL*/,
+	size_t index)
+{
+	const struct prbtree_node *n;
+	PRBTREE_ASSERT_PTR(tree);
+	n = tree->root ? &tree->root->n : (const struct prbtree_node*)0;
+	while (n) {
+		const size_t s = psrbtree_size_(n->prbtree_left);
+		if (index < s)
+			n = n->prbtree_left;
+		else if (index == s)
+			break;
+		else {
+			index -= s + 1;
+			n = n->prbtree_right;
+		}
+	}
+	return psrbtree_node_from_prbtree_node_(n); /* NULL? */
+}
+
+/* get index of the node in the tree (0 - for the leftmost node) */
+static inline size_t psrbtree_rank(
+	const struct psrbtree_node *const e/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(e);
+	{
+		const struct prbtree_node *n = &e->n;
+		size_t index = psrbtree_size_(n->prbtree_left);
+		for (;;) {
+			const struct prbtree_node *const p = prbtree_get_parent(n);
+			if (!p)
+				return index;
+			if (n == p->prbtree_right)
+				index += psrbtree_size_(p->prbtree_left) + 1;
+			n = p;
+		}
+	}
+}
+
+/* count nodes of the tree ordered by keys, which keys are less than (or equal to, if or_equal != 0) given one */
+/* int comparator(node, key) - returns (node - key) difference */
+static inline size_t psrbtree_count_less(
+	const struct psrbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	const int or_equal)
+{
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT_PTR(key);
+	PRBTREE_ASSERT_PTR(comparator);
+	{
+		const struct prbtree_node *n = tree->root ? &tree->root->n : (const struct prbtree_node*)0;
+		size_t count = 0;
+		while (n) {
+			const int c = (*comparator)(&n->u.n, key); /* c = n - key */
+			if (c < 0 || (!c && or_equal)) {
+				count += psrbtree_size_(n->prbtree_left) + 1;
+				n = n->prbtree_right;
+			}
+			else
+				n = n->prbtree_left;
+		}
+		return count;
+	}
+}
+
+/* count nodes of the tree ordered by keys, which keys are in range [from, to) */
+/* int comparator(node, key) - returns (node - key) difference */
+static inline size_t psrbtree_count_range(
+	const struct psrbtree *const tree/*!=NULL*/,
+	const struct btree_key *const from/*!=NULL*/,
+	const struct btree_key *const to/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/)
+{
+	const size_t l = psrbtree_count_less(tree, from, comparator, /*or_equal:*/0);
+	const size_t r = psrbtree_count_less(tree, to, comparator, /*or_equal:*/0);
+	return r > l ? r - l : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PSRBTREE_H_INCLUDED */
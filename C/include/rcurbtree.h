@@ -0,0 +1,297 @@
+#ifndef RCURBTREE_H_INCLUDED
+#define RCURBTREE_H_INCLUDED
+
+/**********************************************************************************
+* Persistent red-black tree of pointers to objects for lock-free readers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* rcurbtree.h */
+
+/* read-copy-update red-black tree: published nodes are never modified,
+  an update copies nodes on the path from the root to the changed node (and siblings
+  recolored or rotated on the way), links the copies into a new version of the tree and
+  publishes the new root by one atomic store, so:
+  - readers never lock, never retry and never write shared memory: a reader takes the current
+    root - a snapshot, which stays consistent while writers proceed, e.g. for long scans,
+  - replaced nodes are retired into an epoch domain (see epoch.h) and freed when no reader
+    may reference them, so readers must access snapshots only within epoch read sections,
+  - writers must be serialized by the caller, e.g. by a mutex,
+  an update copies O(log n) nodes, so the tree is for structures that are read
+  much more often than updated: configuration, routing tables, etc.,
+  like in bptree.h, nodes are allocated by the tree, objects are not modified by the tree,
+  keys are unique */
+
+#include <stddef.h> /* for size_t */
+#include "btree.h"
+#include "epoch.h"
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef RCURBTREE_EXPORTS
+#define RCURBTREE_EXPORTS
+#endif
+
+/* expr - do not compares pointers */
+#ifndef RCURBTREE_ASSERT
+#define RCURBTREE_ASSERT(expr) BTREE_ASSERT(expr)
+#endif
+
+/* check that pointer is not NULL */
+#ifndef RCURBTREE_ASSERT_PTR
+#define RCURBTREE_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* node of the tree, immutable after publishing */
+struct rcurbtree_node {
+	union {
+		struct btree_node n;
+		struct rcurbtree_node *leaves[2]; /* left, right */
+	} u;
+	void *obj;           /* object */
+	unsigned char color; /* 1 - red, 0 - black */
+	unsigned char fresh; /* non-zero while the node is a not yet published copy */
+};
+
+/* left/right leaves */
+#define rcurbtree_left  u.leaves[0]
+#define rcurbtree_right u.leaves[1]
+
+struct rcurbtree {
+	struct rcurbtree_node *root;    /* published root, NULL if the tree is empty */
+	size_t count;                   /* number of objects in the tree */
+	struct epoch_domain *epoch;     /* domain of readers, retired nodes are freed through it */
+	struct rcurbtree_node *reserve; /* spare nodes, so an update cannot fail in the middle */
+	size_t reserved;                /* number of spare nodes */
+};
+
+static inline void rcurbtree_init(
+	struct rcurbtree *const tree/*!=NULL,out*/,
+	struct epoch_domain *const epoch/*!=NULL*/)
+{
+	RCURBTREE_ASSERT_PTR(tree);
+	RCURBTREE_ASSERT_PTR(epoch);
+	tree->root = (struct rcurbtree_node*)0;
+	tree->count = 0;
+	tree->epoch = epoch;
+	tree->reserve = (struct rcurbtree_node*)0;
+	tree->reserved = 0;
+}
+
+/* get a snapshot of the tree: the root of the current version,
+  must be called by a reader within an epoch read section, the snapshot may be used until leaving it */
+static inline const struct rcurbtree_node *rcurbtree_snapshot(
+	const struct rcurbtree *const tree/*!=NULL*/)
+{
+	RCURBTREE_ASSERT_PTR(tree);
+#if defined __GNUC__ || defined __clang__
+	return __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE); /* NULL? */
+#else
+	return *(struct rcurbtree_node *const volatile*)&tree->root; /* NULL? */
+#endif
+}
+
+/* nodes of a snapshot are plain binary tree nodes: snapshots may be iterated by
+  btree_walk_stack_forward()/btree_walk_stack_backward() of btree.h, e.g.:
+  size_t s;
+  struct btree_node *stack[rbtree_height(32)], *n;
+  btree_walk_stack_forward(rcurbtree_node_to_btree_node_(snapshot), stack, s, n) {
+    process(my_tree_from_node(n));
+  }
+*/
+static inline struct btree_node *rcurbtree_node_to_btree_node_(
+	const struct rcurbtree_node *const n/*NULL?*/)
+{
+	const void *const x = n;
+	return btree_const_cast((const struct btree_node*)x/*NULL?*/);
+}
+
+/* insert object into the tree (writer-side),
+  key - key of the object, comparator - compares keys of objects of nodes with the key,
+  if there is an object with the same key: if replace is zero - the tree is not changed,
+  else the object replaces it, in both cases *existing is set to the found object,
+  returns 1 if the object was inserted, 0 if an object with the same key was found, -1 if out of memory,
+  note: a replaced object may be referenced by readers of older snapshots */
+RCURBTREE_EXPORTS int rcurbtree_insert(
+	struct rcurbtree *const tree/*!=NULL*/,
+	void *const obj,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	const int replace,
+	void **const existing/*!=NULL,out*/);
+
+/* remove an object with given key from the tree (writer-side),
+  returns 1 if the object was removed (*removed is set), 0 if not found, -1 if out of memory,
+  note: the removed object may be referenced by readers of older snapshots,
+  so it may be freed only through epoch_retire() */
+RCURBTREE_EXPORTS int rcurbtree_remove(
+	struct rcurbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	void **const removed/*!=NULL,out*/);
+
+/* free all nodes of the tree (not the objects), the tree becomes empty,
+  there must be no readers of the tree, retired nodes are freed by the epoch domain */
+RCURBTREE_EXPORTS void rcurbtree_destroy(
+	struct rcurbtree *const tree/*!=NULL*/);
+
+/* define type-specialized functions for the tree of pointers to objects of given type:
+  name       - prefix of names of defined functions,
+  type       - type of objects, e.g. struct my_struct,
+  key_type   - type of keys, keys are passed by value,
+  key_of     - function-like macro returning the key of the object: key_of(const type *o),
+  key_cmp    - function-like macro returning (a - b) difference of keys: key_cmp(key_type a, key_type b),
+  defines next functions:
+  readers (called within epoch read sections, snap - result of rcurbtree_snapshot()):
+   type *name_from_node(const struct btree_node *n);                        - NULL if n is NULL
+   type *name_search(const struct rcurbtree_node *snap, key_type key);      - NULL if not found
+   type *name_lower_bound(const struct rcurbtree_node *snap, key_type key); - first object with key >= given one, NULL?
+   type *name_upper_bound(const struct rcurbtree_node *snap, key_type key); - first object with key > given one, NULL?
+   type *name_first(const struct rcurbtree_node *snap);                     - NULL if the snapshot is empty
+   type *name_last(const struct rcurbtree_node *snap);                      - NULL if the snapshot is empty
+  writers:
+   int name_insert(struct rcurbtree *tree, type *o, type **existing);       - see rcurbtree_insert()
+   int name_replace(struct rcurbtree *tree, type *o, type **replaced);      - see rcurbtree_insert()
+   int name_remove(struct rcurbtree *tree, key_type key, type **removed);   - see rcurbtree_remove() */
+#if 0 /* example */
+struct my_struct {
+	int key;
+	int data;
+};
+#define MY_KEY_OF(o) (o)->key
+RCURBTREE_DEFINE(my_tree, struct my_struct, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  reader thread:
+  epoch_register(&domain, &reader);
+  ...
+  epoch_enter(&domain, &reader);
+  s = my_tree_search(rcurbtree_snapshot(&tree), 10);
+  if (s)
+    use(s->data);
+  epoch_leave(&reader);
+  ...
+  writer thread, under the lock of writers:
+  if (my_tree_remove(&tree, 10, &s) > 0)
+    epoch_retire(&domain, s, my_free, NULL);
+  epoch_reclaim(&domain);
+#endif
+#define RCURBTREE_DEFINE(name, type, key_type, key_of, key_cmp)                                \
+static inline type *name##_from_node(                                                          \
+	const struct btree_node *const n/*NULL?*/)                                                 \
+{                                                                                              \
+	const void *const x = n;                                                                   \
+	return n ? (type*)((const struct rcurbtree_node*)x)->obj : (type*)0;                       \
+}                                                                                              \
+static inline int name##_comparator_(                                                          \
+	const struct btree_node *const n/*!=NULL*/,                                                \
+	const struct btree_key *const k/*!=NULL*/)                                                 \
+{                                                                                              \
+	const void *const key = k;                                                                 \
+	return key_cmp(key_of(name##_from_node(n)), *(const key_type*)key); /* n - key */          \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct rcurbtree_node *n/*NULL?*/,                                                   \
+	const key_type key)                                                                        \
+{                                                                                              \
+	BTREE_TRACE_(BTREE_TRACE_SEARCH, key);                                                     \
+	while (n) {                                                                                \
+		const int c = key_cmp(key_of((const type*)n->obj), key); /* c = n - key */             \
+		if (c == 0)                                                                            \
+			return (type*)n->obj;                                                              \
+		n = n->u.leaves[c < 0];                                                                \
+	}                                                                                          \
+	return (type*)0;                                                                           \
+}                                                                                              \
+static inline type *name##_lower_bound(                                                        \
+	const struct rcurbtree_node *n/*NULL?*/,                                                   \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const struct rcurbtree_node *r = (const struct rcurbtree_node*)0;                          \
+	while (n) {                                                                                \
+		const int c = key_cmp(key_of((const type*)n->obj), key); /* c = n - key */             \
+		if (c >= 0)                                                                            \
+			r = n;                                                                             \
+		n = n->u.leaves[c < 0];                                                                \
+	}                                                                                          \
+	return r ? (type*)r->obj : (type*)0;                                                       \
+}                                                                                              \
+static inline type *name##_upper_bound(                                                        \
+	const struct rcurbtree_node *n/*NULL?*/,                                                   \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const struct rcurbtree_node *r = (const struct rcurbtree_node*)0;                          \
+	while (n) {                                                                                \
+		const int c = key_cmp(key_of((const type*)n->obj), key); /* c = n - key */             \
+		if (c > 0)                                                                             \
+			r = n;                                                                             \
+		n = n->u.leaves[c <= 0];                                                               \
+	}                                                                                          \
+	return r ? (type*)r->obj : (type*)0;                                                       \
+}                                                                                              \
+static inline type *name##_first(                                                              \
+	const struct rcurbtree_node *const snap/*NULL?*/)                                          \
+{                                                                                              \
+	return snap ?                                                                              \
+		name##_from_node(btree_first(rcurbtree_node_to_btree_node_(snap))) : (type*)0;         \
+}                                                                                              \
+static inline type *name##_last(                                                               \
+	const struct rcurbtree_node *const snap/*NULL?*/)                                          \
+{                                                                                              \
+	return snap ?                                                                              \
+		name##_from_node(btree_last(rcurbtree_node_to_btree_node_(snap))) : (type*)0;          \
+}                                                                                              \
+static inline int name##_insert(                                                               \
+	struct rcurbtree *const tree/*!=NULL*/,                                                    \
+	type *const o/*!=NULL*/,                                                                   \
+	type **const existing/*!=NULL,out*/)                                                       \
+{                                                                                              \
+	const key_type key = key_of(o);                                                            \
+	const void *const k = &key;                                                                \
+	void *x = (void*)0;                                                                        \
+	int r;                                                                                     \
+	RCURBTREE_ASSERT_PTR(existing);                                                            \
+	BTREE_TRACE_(BTREE_TRACE_INSERT, key);                                                     \
+	r = rcurbtree_insert(tree, o, (const struct btree_key*)k, name##_comparator_, 0, &x);      \
+	*existing = (type*)x;                                                                      \
+	return r;                                                                                  \
+}                                                                                              \
+static inline int name##_replace(                                                              \
+	struct rcurbtree *const tree/*!=NULL*/,                                                    \
+	type *const o/*!=NULL*/,                                                                   \
+	type **const replaced/*!=NULL,out*/)                                                       \
+{                                                                                              \
+	const key_type key = key_of(o);                                                            \
+	const void *const k = &key;                                                                \
+	void *x = (void*)0;                                                                        \
+	int r;                                                                                     \
+	RCURBTREE_ASSERT_PTR(replaced);                                                            \
+	BTREE_TRACE_(BTREE_TRACE_INSERT, key);                                                     \
+	r = rcurbtree_insert(tree, o, (const struct btree_key*)k, name##_comparator_, 1, &x);      \
+	*replaced = (type*)x;                                                                      \
+	return r;                                                                                  \
+}                                                                                              \
+static inline int name##_remove(                                                               \
+	struct rcurbtree *const tree/*!=NULL*/,                                                    \
+	const key_type key,                                                                        \
+	type **const removed/*!=NULL,out*/)                                                        \
+{                                                                                              \
+	const void *const k = &key;                                                                \
+	void *x = (void*)0;                                                                        \
+	int r;                                                                                     \
+	RCURBTREE_ASSERT_PTR(removed);                                                             \
+	BTREE_TRACE_(BTREE_TRACE_REMOVE, key);                                                     \
+	r = rcurbtree_remove(tree, (const struct btree_key*)k, name##_comparator_, &x);            \
+	*removed = (type*)x;                                                                       \
+	return r;                                                                                  \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RCURBTREE_H_INCLUDED */
@@ -0,0 +1,259 @@
+#ifndef SEQLOCK_H_INCLUDED
+#define SEQLOCK_H_INCLUDED
+
+/**********************************************************************************
+* Sequence lock: optimistic concurrent reads of prbtree/pcrbtree
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* seqlock.h */
+
+/* seqlock - sequence counter, odd while a writer modifies the protected data:
+  writers are serialized by the counter itself, readers do not write shared memory:
+  a reader remembers the (even) counter, reads the data, then checks that the counter
+  did not change, else repeats the read, so readers do not block each other or writers,
+
+  SEQLOCK_TREE_DEFINE() defines optimistic lookups in a prbtree or pcrbtree:
+  top-down descents from the root, reading tree pointers by atomic loads, validated
+  by the seqlock, writers modify the tree by usual functions, under seqlock_write_lock(),
+
+  restrictions:
+  - a reader may see a node being relinked or just removed, so removed objects must not be
+    returned to the system while readers may still reach them: keep them in a pool or a slab
+    (see slab.h), where memory stays mapped and is reused only for objects of the same type,
+  - keys of objects are read by readers without synchronization, a key changed while a reader
+    compares it (e.g. of a reused object) gives a wrong result, which is then discarded by the
+    validation of the seqlock,
+  - writers must not block, and write sections must be short: readers spin while the counter is odd,
+  - writers modify pointers of nodes by plain (non-atomic) stores of prbtree_insert()/prbtree_remove()
+    and the like, so readers never see torn pointers only because an aligned store of a pointer is
+    one instruction on supported targets (x86, x86_64, ARM, AArch64 with GCC, Clang or MSVC) -
+    by the C11 memory model, such concurrent accesses are still a data race */
+
+#include <stddef.h> /* for size_t, offsetof() */
+#include "btree.h"
+
+#if defined _MSC_VER && !defined __clang__
+#include <intrin.h> /* for _InterlockedCompareExchange(), _ReadWriteBarrier(), _mm_pause() */
+#endif
+
+/* check that pointer is not NULL */
+#ifndef SEQLOCK_ASSERT_PTR
+#define SEQLOCK_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+/* spin-wait hint to the CPU */
+#ifndef SEQLOCK_PAUSE
+#if (defined __GNUC__ || defined __clang__) && (defined __i386__ || defined __x86_64__)
+#define SEQLOCK_PAUSE() __builtin_ia32_pause()
+#elif (defined __GNUC__ || defined __clang__) && (defined __aarch64__ || defined __arm__)
+#define SEQLOCK_PAUSE() __asm__ __volatile__("yield")
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+#define SEQLOCK_PAUSE() _mm_pause()
+#else
+#define SEQLOCK_PAUSE() ((void)0)
+#endif
+#endif
+
+/* maximum number of steps of a lookup: a red-black tree cannot be higher,
+  more steps - the tree was modified during the lookup, possibly with a transient cycle */
+#define SEQLOCK_TREE_MAX_STEPS rbtree_height(8*sizeof(size_t))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined __GNUC__ || defined __clang__
+
+typedef unsigned seqlock_seq_t;
+
+#define seqlock_load_seq_(p, mo)       __atomic_load_n(p, mo)
+#define seqlock_store_seq_(p, v, mo)   __atomic_store_n(p, v, mo)
+#define seqlock_cas_seq_(p, old, v)    __atomic_compare_exchange_n(p, &(old), v, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)
+#define seqlock_fence_acquire_()       __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define seqlock_fence_release_()       __atomic_thread_fence(__ATOMIC_RELEASE)
+#define SEQLOCK_RELAXED_               __ATOMIC_RELAXED
+#define SEQLOCK_ACQUIRE_               __ATOMIC_ACQUIRE
+#define SEQLOCK_RELEASE_               __ATOMIC_RELEASE
+
+/* atomic load of a pointer: pointer cannot be torn */
+static inline void *seqlock_load_ptr(
+	const void *const p/*!=NULL, address of a pointer*/)
+{
+	return __atomic_load_n((void *const*)p, __ATOMIC_RELAXED);
+}
+
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+
+typedef long seqlock_seq_t;
+
+/* x86 is TSO: aligned volatile accesses are atomic, only reordering by the compiler must be prevented */
+#define seqlock_load_seq_(p, mo)       (*(const volatile long*)(p))
+#define seqlock_store_seq_(p, v, mo)   (_ReadWriteBarrier(), *(volatile long*)(p) = (v), _ReadWriteBarrier())
+#define seqlock_cas_seq_(p, old, v)    (_InterlockedCompareExchange(p, v, old) == (old))
+#define seqlock_fence_acquire_()       _ReadWriteBarrier()
+#define seqlock_fence_release_()       _ReadWriteBarrier()
+#define SEQLOCK_RELAXED_               0
+#define SEQLOCK_ACQUIRE_               0
+#define SEQLOCK_RELEASE_               0
+
+static inline void *seqlock_load_ptr(
+	const void *const p/*!=NULL, address of a pointer*/)
+{
+	return *(void *const volatile*)p;
+}
+
+#else
+#error "atomic operations are not defined for this compiler"
+#endif
+
+struct seqlock {
+	seqlock_seq_t seq; /* odd while the data is being modified */
+};
+
+static inline void seqlock_init(
+	struct seqlock *const l/*!=NULL,out*/)
+{
+	SEQLOCK_ASSERT_PTR(l);
+	l->seq = 0;
+}
+
+/* enter write section: wait for other writers, make the counter odd */
+static inline void seqlock_write_lock(
+	struct seqlock *const l/*!=NULL*/)
+{
+	SEQLOCK_ASSERT_PTR(l);
+	for (;;) {
+		seqlock_seq_t s = seqlock_load_seq_(&l->seq, SEQLOCK_RELAXED_);
+		if (!(s & 1) && seqlock_cas_seq_(&l->seq, s, s + 1))
+			break;
+		SEQLOCK_PAUSE();
+	}
+	/* modifications of the data must not become visible before the odd counter */
+	seqlock_fence_release_();
+}
+
+/* leave write section: make the counter even, publish modifications of the data */
+static inline void seqlock_write_unlock(
+	struct seqlock *const l/*!=NULL*/)
+{
+	SEQLOCK_ASSERT_PTR(l);
+	BTREE_ASSERT(l->seq & 1);
+	seqlock_store_seq_(&l->seq, seqlock_load_seq_(&l->seq, SEQLOCK_RELAXED_) + 1, SEQLOCK_RELEASE_);
+}
+
+/* begin optimistic read: wait while a writer is active, returns the counter to validate the read */
+static inline seqlock_seq_t seqlock_read_begin(
+	const struct seqlock *const l/*!=NULL*/)
+{
+	SEQLOCK_ASSERT_PTR(l);
+	for (;;) {
+		const seqlock_seq_t s = seqlock_load_seq_(&l->seq, SEQLOCK_ACQUIRE_);
+		if (!(s & 1))
+			return s;
+		SEQLOCK_PAUSE();
+	}
+}
+
+/* end optimistic read: returns non-zero if the data was modified and the read must be repeated */
+static inline int seqlock_read_retry(
+	const struct seqlock *const l/*!=NULL*/,
+	const seqlock_seq_t s)
+{
+	SEQLOCK_ASSERT_PTR(l);
+	/* reads of the data must complete before the counter is checked */
+	seqlock_fence_acquire_();
+	return seqlock_load_seq_(&l->seq, SEQLOCK_RELAXED_) != s;
+}
+
+/* define optimistic lookups in a tree of objects of given type, protected by a seqlock:
+  name       - prefix of names of defined functions,
+  tree_type  - type of the tree: struct prbtree or struct pcrbtree,
+  type       - type of objects, e.g. struct my_struct,
+  member     - name of struct prbtree_node or struct pcrbtree_node member of the type,
+  key_type   - type of keys, keys are passed by value,
+  key_of     - function-like macro returning the key of the object: key_of(const type *o),
+  key_cmp    - function-like macro returning (a - b) difference of keys: key_cmp(key_type a, key_type b),
+  defines next functions, which may be called concurrently with writers:
+   type *name_search(const struct seqlock *l, const tree_type *tree, key_type key);      - NULL if not found
+   type *name_lower_bound(const struct seqlock *l, const tree_type *tree, key_type key); - first object with key >= given one, NULL?
+   type *name_upper_bound(const struct seqlock *l, const tree_type *tree, key_type key); - first object with key > given one, NULL?
+  a returned object may be removed from the tree right after the lookup,
+  note: <stddef.h> must be included for offsetof() */
+#if 0 /* example */
+struct my_struct {
+	struct prbtree_node n;
+	int key;
+};
+#define MY_KEY_OF(o) (o)->key
+PRBTREE_DEFINE(my_tree, struct my_struct, n, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+SEQLOCK_TREE_DEFINE(my_seq, struct prbtree, struct my_struct, n, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  readers:
+  struct my_struct *s = my_seq_search(&lock, &tree, 10);
+  writers:
+  seqlock_write_lock(&lock);
+  my_tree_insert(&tree, o, 0);
+  seqlock_write_unlock(&lock);
+#endif
+#define SEQLOCK_TREE_DEFINE(name, tree_type, type, member, key_type, key_of, key_cmp)          \
+static inline const type *name##_obj_(                                                         \
+	const struct btree_node *const n/*!=NULL*/)                                                \
+{                                                                                              \
+	return (const type*)((const char*)n - offsetof(type, member));                             \
+}                                                                                              \
+/* mode: 0 - search, 1 - lower bound, 2 - upper bound */                                       \
+static inline type *name##_lookup_(                                                            \
+	const struct seqlock *const l/*!=NULL*/,                                                   \
+	const tree_type *const tree/*!=NULL*/,                                                     \
+	const key_type key,                                                                        \
+	const int mode)                                                                            \
+{                                                                                              \
+	for (;;) {                                                                                 \
+		const seqlock_seq_t s = seqlock_read_begin(l);                                         \
+		const struct btree_node *n = (const struct btree_node*)seqlock_load_ptr(&tree->root);  \
+		const struct btree_node *r = (const struct btree_node*)0;                              \
+		size_t steps = SEQLOCK_TREE_MAX_STEPS;                                                 \
+		for (; n && steps; steps--) {                                                          \
+			const int c = key_cmp(key_of(name##_obj_(n)), key); /* c = n - key */              \
+			const int right = (mode == 2) ? c <= 0 : c < 0;                                    \
+			if (mode ? !right : c == 0) {                                                      \
+				r = n;                                                                         \
+				if (!mode)                                                                     \
+					break;                                                                     \
+			}                                                                                  \
+			n = (const struct btree_node*)seqlock_load_ptr(&n->leaves[right]);                 \
+		}                                                                                      \
+		if (!seqlock_read_retry(l, s))                                                         \
+			return r ? (type*)((char*)btree_const_cast(r) - offsetof(type, member)) :          \
+				(type*)0;                                                                      \
+	}                                                                                          \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct seqlock *const l/*!=NULL*/,                                                   \
+	const tree_type *const tree/*!=NULL*/,                                                     \
+	const key_type key)                                                                        \
+{                                                                                              \
+	return name##_lookup_(l, tree, key, 0);                                                    \
+}                                                                                              \
+static inline type *name##_lower_bound(                                                        \
+	const struct seqlock *const l/*!=NULL*/,                                                   \
+	const tree_type *const tree/*!=NULL*/,                                                     \
+	const key_type key)                                                                        \
+{                                                                                              \
+	return name##_lookup_(l, tree, key, 1);                                                    \
+}                                                                                              \
+static inline type *name##_upper_bound(                                                        \
+	const struct seqlock *const l/*!=NULL*/,                                                   \
+	const tree_type *const tree/*!=NULL*/,                                                     \
+	const key_type key)                                                                        \
+{                                                                                              \
+	return name##_lookup_(l, tree, key, 2);                                                    \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEQLOCK_H_INCLUDED */
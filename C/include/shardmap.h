@@ -0,0 +1,348 @@
+#ifndef SHARDMAP_H_INCLUDED
+#define SHARDMAP_H_INCLUDED
+
+/**********************************************************************************
+* Sharded ordered map: prbtrees with per-shard spinlocks
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* shardmap.h */
+
+/* shardmap - array of prbtrees (shards), each protected by its own spinlock:
+  an object is placed into the shard selected by the low bits of a hash of its key,
+  so operations on different keys mostly lock different shards and do not contend,
+  each shard takes a whole cache line - locks of neighbouring shards do not share it,
+
+  keys are ordered only within a shard, an ordered walk over all objects merges the shards
+  by a binary heap of current nodes of the shards (k-way merge), O(log(shards)) per step,
+
+  restrictions:
+  - an object returned by a lookup is not protected after the shard is unlocked: the application
+    must not free objects while other threads may use them (e.g. free them through epoch.h),
+  - the iterator reads all shards: it must be used either while no thread modifies the map,
+    or between shardmap_lock_all() and shardmap_unlock_all(),
+  - keys are unique, keys of inserted objects must not be changed */
+
+#include <stddef.h> /* for size_t, offsetof() */
+#include "btree.h"
+#include "prbtree.h"
+
+#if defined _MSC_VER && !defined __clang__
+#include <intrin.h> /* for _InterlockedExchange(), _ReadWriteBarrier(), _mm_pause() */
+#endif
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef SHARDMAP_EXPORTS
+#define SHARDMAP_EXPORTS
+#endif
+
+/* expr - do not compares pointers */
+#ifndef SHARDMAP_ASSERT
+#define SHARDMAP_ASSERT(expr) BTREE_ASSERT(expr)
+#endif
+
+/* check that pointer is not NULL */
+#ifndef SHARDMAP_ASSERT_PTR
+#define SHARDMAP_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+/* size and alignment of a shard */
+#ifndef SHARDMAP_CACHE_LINE
+#define SHARDMAP_CACHE_LINE 64
+#endif
+
+/* number of spins waiting for a locked shard before the waiting thread starts to yield the CPU,
+  used by the library */
+#ifndef SHARDMAP_SPIN_COUNT
+#define SHARDMAP_SPIN_COUNT 128
+#endif
+
+/* spin-wait hint to the CPU */
+#ifndef SHARDMAP_PAUSE
+#if (defined __GNUC__ || defined __clang__) && (defined __i386__ || defined __x86_64__)
+#define SHARDMAP_PAUSE() __builtin_ia32_pause()
+#elif (defined __GNUC__ || defined __clang__) && (defined __aarch64__ || defined __arm__)
+#define SHARDMAP_PAUSE() __asm__ __volatile__("yield")
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+#define SHARDMAP_PAUSE() _mm_pause()
+#else
+#define SHARDMAP_PAUSE() ((void)0)
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined __GNUC__ || defined __clang__
+
+typedef unsigned shardmap_lock_t;
+
+#define shardmap_lock_load_(p)         __atomic_load_n(p, __ATOMIC_RELAXED)
+#define shardmap_lock_xchg_(p, v)      __atomic_exchange_n(p, v, __ATOMIC_ACQUIRE)
+#define shardmap_lock_release_(p)      __atomic_store_n(p, 0, __ATOMIC_RELEASE)
+
+#elif defined _MSC_VER && (defined _M_IX86 || defined _M_X64)
+
+typedef long shardmap_lock_t;
+
+/* x86 is TSO: aligned volatile accesses are atomic, only reordering by the compiler must be prevented */
+#define shardmap_lock_load_(p)         (*(const volatile long*)(p))
+#define shardmap_lock_xchg_(p, v)      _InterlockedExchange(p, v)
+#define shardmap_lock_release_(p)      (_ReadWriteBarrier(), *(volatile long*)(p) = 0)
+
+#else
+#error "atomic operations are not defined for this compiler"
+#endif
+
+/* shard: a tree and its lock, padded to the cache line */
+struct shardmap_shard {
+	struct prbtree tree;
+	shardmap_lock_t lock; /* non-zero while locked */
+	char pad_[SHARDMAP_CACHE_LINE - sizeof(struct prbtree) - sizeof(shardmap_lock_t)];
+};
+
+struct shardmap {
+	struct shardmap_shard *shards; /* aligned on SHARDMAP_CACHE_LINE, NULL if not allocated */
+	size_t mask;                   /* number of shards - 1, the number is a power of 2 */
+};
+
+/* returns (a - b) difference of keys of the nodes */
+typedef int shardmap_comparator(
+	const struct prbtree_node *a/*!=NULL*/,
+	const struct prbtree_node *b/*!=NULL*/);
+
+/* allocate count shards with empty trees, count is rounded up to a power of 2,
+  returns 0 on success, -1 if out of memory (the map is left without shards) */
+SHARDMAP_EXPORTS int shardmap_alloc(
+	struct shardmap *const m/*!=NULL,out*/,
+	const size_t count);
+
+/* free shards of the map, trees must be empty or their objects must be freed by the application */
+SHARDMAP_EXPORTS void shardmap_destroy(
+	struct shardmap *const m/*!=NULL*/);
+
+static inline size_t shardmap_count(
+	const struct shardmap *const m/*!=NULL*/)
+{
+	SHARDMAP_ASSERT_PTR(m);
+	return m->mask + 1;
+}
+
+/* shard of the key with given hash */
+static inline struct shardmap_shard *shardmap_shard(
+	const struct shardmap *const m/*!=NULL*/,
+	const size_t hash)
+{
+	SHARDMAP_ASSERT_PTR(m);
+	return &m->shards[hash & m->mask];
+}
+
+/* wait until the lock is acquired: spin SHARDMAP_SPIN_COUNT times, then yield the CPU between
+  attempts - a holder preempted by the scheduler gets a chance to run and release the lock */
+SHARDMAP_EXPORTS void shardmap_lock_wait_(
+	struct shardmap_shard *const s/*!=NULL*/);
+
+/* test-and-test-and-set: wait by reading, so waiting threads do not bounce the cache line */
+static inline void shardmap_lock(
+	struct shardmap_shard *const s/*!=NULL*/)
+{
+	SHARDMAP_ASSERT_PTR(s);
+	if (shardmap_lock_xchg_(&s->lock, 1))
+		shardmap_lock_wait_(s);
+}
+
+static inline void shardmap_unlock(
+	struct shardmap_shard *const s/*!=NULL*/)
+{
+	SHARDMAP_ASSERT_PTR(s);
+	SHARDMAP_ASSERT(shardmap_lock_load_(&s->lock));
+	shardmap_lock_release_(&s->lock);
+}
+
+/* lock all shards, in the order of their indices - to not deadlock with other lock_all()'s */
+SHARDMAP_EXPORTS void shardmap_lock_all(
+	struct shardmap *const m/*!=NULL*/);
+
+SHARDMAP_EXPORTS void shardmap_unlock_all(
+	struct shardmap *const m/*!=NULL*/);
+
+/* ordered iterator: binary heap of current nodes of the shards, the least one at the top */
+struct shardmap_iter {
+	struct prbtree_node **heap;       /* array of shardmap_count() entries, provided by the caller */
+	size_t size;                      /* number of shards not walked through yet */
+	shardmap_comparator *comparator;
+};
+
+static inline void shardmap_iter_init(
+	struct shardmap_iter *const it/*!=NULL,out*/,
+	struct prbtree_node **const heap/*!=NULL*/,
+	shardmap_comparator *const comparator/*!=NULL*/)
+{
+	SHARDMAP_ASSERT_PTR(it);
+	SHARDMAP_ASSERT_PTR(heap);
+	SHARDMAP_ASSERT_PTR(comparator);
+	it->heap = heap;
+	it->size = 0;
+	it->comparator = comparator;
+}
+
+/* add the node of a shard to the merge, the node is the first one to walk from in its shard */
+SHARDMAP_EXPORTS void shardmap_iter_push(
+	struct shardmap_iter *const it/*!=NULL*/,
+	struct prbtree_node *const node/*!=NULL*/);
+
+/* returns current node of the iterator, NULL if all shards were walked through */
+static inline struct prbtree_node *shardmap_iter_current(
+	const struct shardmap_iter *const it/*!=NULL*/)
+{
+	SHARDMAP_ASSERT_PTR(it);
+	return it->size ? it->heap[0] : (struct prbtree_node*)0; /* NULL? */
+}
+
+/* start the walk from the leftmost nodes of all shards,
+  heap - array of shardmap_count() entries,
+  returns the least node of the map, NULL if the map is empty */
+SHARDMAP_EXPORTS struct prbtree_node *shardmap_iter_first(
+	struct shardmap_iter *const it/*!=NULL,out*/,
+	const struct shardmap *const m/*!=NULL*/,
+	struct prbtree_node **const heap/*!=NULL*/,
+	shardmap_comparator *const comparator/*!=NULL*/);
+
+/* advance the iterator, returns next node in the order of keys, NULL if there are no more nodes */
+SHARDMAP_EXPORTS struct prbtree_node *shardmap_iter_next(
+	struct shardmap_iter *const it/*!=NULL*/);
+
+/* define type-specialized functions for the map of objects of given type:
+  name       - prefix of names of defined functions,
+  type       - type of objects, e.g. struct my_struct,
+  member     - name of struct prbtree_node member of the type,
+  key_type   - type of keys, keys are passed by value,
+  key_of     - function-like macro returning the key of the object: key_of(const type *o),
+  key_cmp    - function-like macro returning (a - b) difference of keys: key_cmp(key_type a, key_type b),
+  key_hash   - function-like macro returning size_t hash of the key, the low bits select the shard,
+  also defines PRBTREE_DEFINE() functions with the prefix name_tree - for a locked shard,
+  defines next functions (lookups and updates lock the shard of the key):
+   type *name_from_node(const struct prbtree_node *n);                          - NULL if n is NULL
+   struct shardmap_shard *name_shard(const struct shardmap *m, key_type key);  - shard of the key
+   type *name_search(struct shardmap *m, key_type key);                        - NULL if not found
+   type *name_insert(struct shardmap *m, type *o);                             - NULL if inserted, else - existing object
+     (the node of o must be initialized by prbtree_init_node())
+   type *name_remove(struct shardmap *m, key_type key);                        - removed object, NULL if not found
+  and ordered iteration (without concurrent updates, or under shardmap_lock_all()):
+   type *name_iter_first(struct shardmap_iter *it, const struct shardmap *m,
+     struct prbtree_node **heap);                                              - NULL if the map is empty
+   type *name_iter_lower_bound(struct shardmap_iter *it, const struct shardmap *m,
+     struct prbtree_node **heap, key_type key);                                - first object with key >= given one, NULL?
+   type *name_iter_next(struct shardmap_iter *it);                             - NULL if there are no more objects
+  note: <stddef.h> must be included for offsetof() */
+#if 0 /* example */
+struct my_struct {
+	struct prbtree_node n;
+	unsigned key;
+};
+#define MY_KEY_OF(o) (o)->key
+#define MY_KEY_HASH(k) ((size_t)((k)*2654435761u >> 16))
+SHARDMAP_DEFINE(my_map, struct my_struct, n, unsigned, MY_KEY_OF, BTREE_KEY_COMPARATOR, MY_KEY_HASH)
+...
+  struct prbtree_node *heap[64];
+  struct shardmap_iter it;
+  struct my_struct *s;
+  shardmap_alloc(&map, 64);
+  prbtree_init_node(&s->n);
+  my_map_insert(&map, s);
+  ...
+  shardmap_lock_all(&map);
+  for (s = my_map_iter_first(&it, &map, heap); s; s = my_map_iter_next(&it))
+    ...
+  shardmap_unlock_all(&map);
+#endif
+#define SHARDMAP_DEFINE(name, type, member, key_type, key_of, key_cmp, key_hash)               \
+PRBTREE_DEFINE(name##_tree, type, member, key_type, key_of, key_cmp)                           \
+static inline type *name##_from_node(                                                          \
+	const struct prbtree_node *const n/*NULL?*/)                                               \
+{                                                                                              \
+	return name##_tree_from_node(n); /* NULL? */                                               \
+}                                                                                              \
+static inline int name##_comparator_(                                                          \
+	const struct prbtree_node *const a/*!=NULL*/,                                              \
+	const struct prbtree_node *const b/*!=NULL*/)                                              \
+{                                                                                              \
+	return key_cmp(key_of(name##_from_node(a)), key_of(name##_from_node(b))); /* a - b */      \
+}                                                                                              \
+static inline struct shardmap_shard *name##_shard(                                             \
+	const struct shardmap *const m/*!=NULL*/,                                                  \
+	const key_type key)                                                                        \
+{                                                                                              \
+	return shardmap_shard(m, (size_t)(key_hash(key)));                                         \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	struct shardmap *const m/*!=NULL*/,                                                        \
+	const key_type key)                                                                        \
+{                                                                                              \
+	struct shardmap_shard *const s = name##_shard(m, key);                                     \
+	type *o;                                                                                   \
+	shardmap_lock(s);                                                                          \
+	o = name##_tree_search(&s->tree, key);                                                     \
+	shardmap_unlock(s);                                                                        \
+	return o; /* NULL? */                                                                      \
+}                                                                                              \
+static inline type *name##_insert(                                                             \
+	struct shardmap *const m/*!=NULL*/,                                                        \
+	type *const o/*!=NULL*/)                                                                   \
+{                                                                                              \
+	struct shardmap_shard *const s = name##_shard(m, key_of(o));                               \
+	type *x;                                                                                   \
+	shardmap_lock(s);                                                                          \
+	x = name##_tree_insert(&s->tree, o, /*leaf:*/0);                                           \
+	shardmap_unlock(s);                                                                        \
+	return x; /* NULL? */                                                                      \
+}                                                                                              \
+static inline type *name##_remove(                                                             \
+	struct shardmap *const m/*!=NULL*/,                                                        \
+	const key_type key)                                                                        \
+{                                                                                              \
+	struct shardmap_shard *const s = name##_shard(m, key);                                     \
+	type *o;                                                                                   \
+	shardmap_lock(s);                                                                          \
+	o = name##_tree_search(&s->tree, key);                                                     \
+	if (o)                                                                                     \
+		name##_tree_remove(&s->tree, o);                                                       \
+	shardmap_unlock(s);                                                                        \
+	return o; /* NULL? */                                                                      \
+}                                                                                              \
+static inline type *name##_iter_first(                                                         \
+	struct shardmap_iter *const it/*!=NULL,out*/,                                              \
+	const struct shardmap *const m/*!=NULL*/,                                                  \
+	struct prbtree_node **const heap/*!=NULL*/)                                                \
+{                                                                                              \
+	return name##_from_node(shardmap_iter_first(it, m, heap, name##_comparator_));             \
+}                                                                                              \
+static inline type *name##_iter_lower_bound(                                                   \
+	struct shardmap_iter *const it/*!=NULL,out*/,                                              \
+	const struct shardmap *const m/*!=NULL*/,                                                  \
+	struct prbtree_node **const heap/*!=NULL*/,                                                \
+	const key_type key)                                                                        \
+{                                                                                              \
+	size_t i = 0;                                                                              \
+	shardmap_iter_init(it, heap, name##_comparator_);                                          \
+	for (; i <= m->mask; i++) {                                                                \
+		type *const o = name##_tree_lower_bound(&m->shards[i].tree, key);                      \
+		if (o)                                                                                 \
+			shardmap_iter_push(it, &o->member);                                                \
+	}                                                                                          \
+	return name##_from_node(shardmap_iter_current(it));                                        \
+}                                                                                              \
+static inline type *name##_iter_next(                                                          \
+	struct shardmap_iter *const it/*!=NULL*/)                                                  \
+{                                                                                              \
+	return name##_from_node(shardmap_iter_next(it));                                           \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHARDMAP_H_INCLUDED */
@@ -0,0 +1,166 @@
+#ifndef SLAB_H_INCLUDED
+#define SLAB_H_INCLUDED
+
+/**********************************************************************************
+* Slab allocator of fixed-size objects: nodes of embedded trees and lists
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* slab.h */
+
+/* slab - allocator of objects of one size, e.g. of objects with embedded prbtree_node or dlist_entry:
+  objects are carved from big blocks allocated by malloc(), freed objects are linked into a free list
+  and are reused by next allocations, so slab_alloc() and slab_free() are O(1) and usually do not call
+  malloc()/free(), objects allocated one after another are adjacent in memory,
+  all objects may be freed at once, without walking a container: by slab_reset() or slab_destroy(),
+  or returned to the free list one by one, without recursion: by slab_free_tree() or slab_free_dlist(),
+
+  a slab is not synchronized - for multi-threaded use, give each thread its own slab, e.g.:
+
+  static SLAB_THREAD_LOCAL struct slab node_slab;
+
+  then free lists are per-thread and no locking is needed, but an object must be freed to the slab
+  it was allocated from, by the thread owning that slab */
+
+#include <stddef.h> /* for size_t */
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef SLAB_EXPORTS
+#define SLAB_EXPORTS
+#endif
+
+/* storage class of per-thread slabs */
+#ifndef SLAB_THREAD_LOCAL
+#if defined __cplusplus && __cplusplus >= 201103L
+#define SLAB_THREAD_LOCAL thread_local
+#elif defined __STDC_VERSION__ && __STDC_VERSION__ >= 201112L
+#define SLAB_THREAD_LOCAL _Thread_local
+#elif defined _MSC_VER
+#define SLAB_THREAD_LOCAL __declspec(thread)
+#elif defined __GNUC__
+#define SLAB_THREAD_LOCAL __thread
+#endif
+#endif
+
+/* alignment of blocks of objects, objects are aligned on min(SLAB_ALIGNMENT, alignment of their type) */
+#ifndef SLAB_ALIGNMENT
+#define SLAB_ALIGNMENT 16
+#endif
+
+/* default size of a block of objects, in bytes */
+#ifndef SLAB_BLOCK_SIZE
+#define SLAB_BLOCK_SIZE 65536
+#endif
+
+/* check that pointer is not NULL */
+#ifndef SLAB_ASSERT_PTR
+#ifdef ASSERT_PTR
+#define SLAB_ASSERT_PTR(ptr) ASSERT_PTR(ptr)
+#else
+#define SLAB_ASSERT_PTR(ptr) ((void)0)
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct btree_node;
+struct dlist;
+
+/* freed object, the link overlays the beginning of the object */
+struct slab_free_object {
+	struct slab_free_object *next;
+};
+
+/* header of a block of objects, objects follow the header */
+struct slab_block {
+	struct slab_block *next;
+};
+
+struct slab {
+	struct slab_free_object *free_list; /* freed objects, NULL? */
+	char *bump;                         /* next never allocated object of the current block */
+	char *bump_end;                     /* end of the current block */
+	struct slab_block *blocks;          /* blocks in use, the current block is the first one, NULL? */
+	struct slab_block *spare;           /* blocks released by slab_reset(), NULL? */
+	size_t object_size;                 /* rounded up to a multiple of the size of a pointer */
+	size_t block_objects;               /* number of objects in a block */
+};
+
+/* initialize the slab, no memory is allocated until the first slab_alloc(),
+  object_size - size of objects, e.g. sizeof(struct my_object),
+  block_objects - number of objects in a block, 0 - fit in SLAB_BLOCK_SIZE bytes */
+SLAB_EXPORTS void slab_init(
+	struct slab *const s/*!=NULL,out*/,
+	const size_t object_size/*>0*/,
+	const size_t block_objects);
+
+/* free all objects at once and release memory of the slab, the slab may be reused after slab_init() */
+SLAB_EXPORTS void slab_destroy(
+	struct slab *const s/*!=NULL*/);
+
+/* free all objects at once, but keep allocated blocks for reuse */
+SLAB_EXPORTS void slab_reset(
+	struct slab *const s/*!=NULL*/);
+
+/* slow path of slab_alloc(): start a new block,
+  returns NULL if failed to allocate memory */
+SLAB_EXPORTS void *slab_alloc_block_(
+	struct slab *const s/*!=NULL*/);
+
+/* allocate an object, returns NULL if failed to allocate memory */
+static inline void *slab_alloc(
+	struct slab *const s/*!=NULL*/)
+{
+	struct slab_free_object *o;
+	SLAB_ASSERT_PTR(s);
+	o = s->free_list;
+	if (o) {
+		s->free_list = o->next;
+		return o;
+	}
+	if (s->bump != s->bump_end) {
+		void *const p = s->bump;
+		s->bump += s->object_size;
+		return p;
+	}
+	return slab_alloc_block_(s); /* NULL? */
+}
+
+/* return an object to the slab it was allocated from */
+static inline void slab_free(
+	struct slab *const s/*!=NULL*/,
+	void *const obj/*!=NULL*/)
+{
+	struct slab_free_object *const o = (struct slab_free_object*)obj;
+	SLAB_ASSERT_PTR(s);
+	SLAB_ASSERT_PTR(obj);
+	o->next = s->free_list;
+	s->free_list = o;
+}
+
+/* return all objects of a red-black tree (prbtree, pcrbtree, psrbtree, pcitree, etc.) to the slab,
+  tree - root node of the tree (e.g. prbtree_node_to_btree_node_(tree->root)),
+  node_offset - offset of the tree node in the object, e.g. offsetof(struct my_object, node),
+  nodes are visited by btree_delete_stack() - without recursion, the tree must be re-initialized after */
+SLAB_EXPORTS void slab_free_tree(
+	struct slab *const s/*!=NULL*/,
+	struct btree_node *const tree/*NULL?*/,
+	const size_t node_offset);
+
+/* return all objects of a non-circular list to the slab,
+  entry_offset - offset of the list entry in the object, e.g. offsetof(struct my_object, entry),
+  the list must be re-initialized after */
+SLAB_EXPORTS void slab_free_dlist(
+	struct slab *const s/*!=NULL*/,
+	struct dlist *const dl/*!=NULL*/,
+	const size_t entry_offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SLAB_H_INCLUDED */
@@ -0,0 +1,296 @@
+#ifndef TRBTREE_H_INCLUDED
+#define TRBTREE_H_INCLUDED
+
+/**********************************************************************************
+* Embedded red-black binary tree without parent pointers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* trbtree.h */
+
+/* red-black tree of plain btree_node's: a node has no parent pointer,
+  the color of a node is stored in the lowest bit of its left child pointer,
+  so on 64-bit hosts a node takes 16 bytes instead of 24 bytes of struct prbtree_node;
+  insert and remove are single-pass top-down: the tree is rebalanced on the way down from the root,
+  no parent pointers and no stack are needed;
+  there is no O(1) next/prev, iterate with trbtree_walk_stack_forward()/trbtree_walk_stack_backward(),
+  note: because of the color bit, generic functions of btree.h that follow btree_left
+  (btree_search(), btree_walk_stack_forward(), btree_size(), etc.) must not be used with this tree */
+
+#include <stdint.h> /* for uintptr_t */
+#include "btree.h"
+
+/* declaration for exported functions, such as:
+  __declspec(dllexport)/__declspec(dllimport) or __attribute__((visibility("default"))) */
+#ifndef TRBTREE_EXPORTS
+#define TRBTREE_EXPORTS
+#endif
+
+/* expr - do not compares pointers */
+#ifndef TRBTREE_ASSERT
+#define TRBTREE_ASSERT(expr) BTREE_ASSERT(expr)
+#endif
+
+/* check that pointer is not NULL */
+#ifndef TRBTREE_ASSERT_PTR
+#define TRBTREE_ASSERT_PTR(ptr) BTREE_ASSERT_PTR(ptr)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* NOTE: address of struct btree_node must be aligned on at least 2 bytes:
+  lowest bit of btree_left pointer encodes node color */
+struct trbtree {
+	struct btree_node *root; /* NULL if tree is empty */
+};
+
+static inline void trbtree_init(
+	struct trbtree *const tree/*!=NULL,out*/)
+{
+	TRBTREE_ASSERT_PTR(tree);
+	tree->root = (struct btree_node*)0;
+}
+
+static inline void trbtree_init_node(
+	struct btree_node *const e/*!=NULL,out*/)
+{
+	TRBTREE_ASSERT_PTR(e);
+	e->btree_left = (struct btree_node*)0;
+	e->btree_right = (struct btree_node*)0;
+}
+
+/* returns: 0 or 1 */
+static inline unsigned trbtree_get_color_(
+	const struct btree_node *const n/*!=NULL*/)
+{
+	TRBTREE_ASSERT_PTR(n);
+	return (unsigned)((uintptr_t)n->btree_left & 1u);
+}
+
+/* get left child of the node, without the color bit */
+static inline struct btree_node *trbtree_left(
+	const struct btree_node *const n/*!=NULL*/)
+{
+	TRBTREE_ASSERT_PTR(n);
+	return (struct btree_node*)((uintptr_t)n->btree_left & ~(uintptr_t)1); /* NULL? */
+}
+
+static inline struct btree_node *trbtree_right(
+	const struct btree_node *const n/*!=NULL*/)
+{
+	TRBTREE_ASSERT_PTR(n);
+	return n->btree_right; /* NULL? */
+}
+
+/* get child of the node: d = 0 - left, d = 1 - right */
+static inline struct btree_node *trbtree_leaf(
+	const struct btree_node *const n/*!=NULL*/,
+	const unsigned d/*0,1*/)
+{
+	return d ? trbtree_right(n) : trbtree_left(n); /* NULL? */
+}
+
+/* search node in the tree ordered by keys, returns NULL if not found */
+static inline struct btree_node *trbtree_search(
+	const struct trbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/)
+{
+	const struct btree_node *n;
+	TRBTREE_ASSERT_PTR(tree);
+	TRBTREE_ASSERT_PTR(key);
+	TRBTREE_ASSERT_PTR(comparator);
+	for (n = tree->root; n;) {
+		const int c = (*comparator)(n, key); /* c = n - key */
+		if (c == 0)
+			break;
+		n = trbtree_leaf(n, c < 0);
+	}
+	return btree_const_cast(n); /* NULL? */
+}
+
+/* insert new node e (initialized by trbtree_init_node()) into the tree,
+  key - key of e, comparator - compares keys of nodes of the tree with the key,
+  if leaf is zero and there is a node with the same key - do not insert e, return that node,
+  else insert e after nodes with the same key and return NULL */
+TRBTREE_EXPORTS struct btree_node *trbtree_insert(
+	struct trbtree *const tree/*!=NULL*/,
+	struct btree_node *const e/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	const int leaf);
+
+/* remove a node with given key from the tree,
+  returns removed node, re-initialized by trbtree_init_node(), or NULL if not found,
+  note: if there are multiple nodes with the same key - one arbitrary of them is removed */
+TRBTREE_EXPORTS struct btree_node *trbtree_remove(
+	struct trbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/);
+
+/* get the leftmost node of the tree, returns NULL if the tree is empty */
+static inline struct btree_node *trbtree_first(
+	const struct trbtree *const tree/*!=NULL*/)
+{
+	const struct btree_node *n, *l;
+	TRBTREE_ASSERT_PTR(tree);
+	n = tree->root;
+	if (n) {
+		while ((l = trbtree_left(n)) != (struct btree_node*)0)
+			n = l;
+	}
+	return btree_const_cast(n); /* NULL? */
+}
+
+/* get the rightmost node of the tree, returns NULL if the tree is empty */
+static inline struct btree_node *trbtree_last(
+	const struct trbtree *const tree/*!=NULL*/)
+{
+	const struct btree_node *n;
+	TRBTREE_ASSERT_PTR(tree);
+	n = tree->root;
+	if (n) {
+		while (n->btree_right)
+			n = n->btree_right;
+	}
+	return btree_const_cast(n); /* NULL? */
+}
+
+/* same as btree_fill_stack_left(), but skip the color bit of the left pointer */
+static inline struct btree_node *trbtree_fill_stack_left(
+	const struct btree_node *tree/*!=NULL*/,
+	void *const stack/*written*/,
+	size_t *const s)
+{
+	const struct btree_node *l;
+	while ((l = trbtree_left(tree)) != (struct btree_node*)0) {
+		((const struct btree_node**)stack)[(*s)++] = tree;
+		tree = l;
+	}
+	return btree_const_cast(tree);
+}
+
+static inline struct btree_node *trbtree_fill_stack_right(
+	const struct btree_node *tree/*!=NULL*/,
+	void *const stack/*written*/,
+	size_t *const s)
+{
+	while (tree->btree_right) {
+		((const struct btree_node**)stack)[(*s)++] = tree;
+		tree = tree->btree_right;
+	}
+	return btree_const_cast(tree);
+}
+
+/* same as btree_walk_stack_forward(), but for the tree with colored left pointers, e.g.:
+  size_t s;
+  struct btree_node *stack[rbtree_height(32)], *n;
+  trbtree_walk_stack_forward(tree.root, stack, s, n) {
+    process(n);
+  }
+*/
+#define trbtree_walk_stack_forward(tree, stack, s, n) \
+	for (s = 0, n = (tree), n = n ? trbtree_fill_stack_left(n, stack, &s) : NULL; n; n = ( \
+		n->btree_right ? trbtree_fill_stack_left(n->btree_right, stack, &s) : s ? stack[--s] : NULL))
+
+/* same as btree_walk_stack_backward(), but for the tree with colored left pointers */
+#define trbtree_walk_stack_backward(tree, stack, s, n) \
+	for (s = 0, n = (tree), n = n ? trbtree_fill_stack_right(n, stack, &s) : NULL; n; n = ( \
+		trbtree_left(n) ? trbtree_fill_stack_right(trbtree_left(n), stack, &s) : s ? stack[--s] : NULL))
+
+/* same as btree_delete_stack_forward(), but for the tree with colored left pointers:
+  next node is determined before the current one is processed, so it may be freed */
+#define trbtree_delete_stack_forward(tree, stack, s, n, next) \
+	for (s = 0, n = (tree), n = n ? trbtree_fill_stack_left(n, stack, &s) : NULL; n ? next = ( \
+		n->btree_right ? trbtree_fill_stack_left(n->btree_right, stack, &s) : s ? stack[--s] : NULL), n : (next = NULL); n = next)
+
+/* define type-specialized functions for the tree of objects of given type, e.g.:
+   type *name_from_node(const struct btree_node *n);               - NULL for NULL
+   type *name_search(const struct trbtree *tree, key_type key);    - NULL if not found
+   type *name_insert(struct trbtree *tree, type *o, int leaf);     - NULL if inserted, else existing object
+   type *name_remove(struct trbtree *tree, key_type key);          - removed object or NULL if not found
+   type *name_first(const struct trbtree *tree);                   - NULL if the tree is empty
+   type *name_last(const struct trbtree *tree);                    - NULL if the tree is empty
+  objects passed to name_insert() must be initialized by trbtree_init_node(),
+  note: <stddef.h> must be included for offsetof() */
+#if 0 /* example */
+struct my_struct {
+	struct btree_node n;
+	int key;
+};
+#define MY_KEY_OF(o) (o)->key
+TRBTREE_DEFINE(my_tree, struct my_struct, n, int, MY_KEY_OF, BTREE_KEY_COMPARATOR)
+...
+  struct trbtree tree;
+  trbtree_init(&tree);
+  ...
+  struct my_struct *s = my_tree_search(&tree, 10);
+#endif
+#define TRBTREE_DEFINE(name, type, member, key_type, key_of, key_cmp)                          \
+static inline type *name##_from_node(                                                          \
+	const struct btree_node *const n/*NULL?*/)                                                 \
+{                                                                                              \
+	return n ? (type*)((char*)btree_const_cast(n) - offsetof(type, member)) : (type*)0;        \
+}                                                                                              \
+static inline int name##_comparator_(                                                          \
+	const struct btree_node *const n/*!=NULL*/,                                                \
+	const struct btree_key *const k/*!=NULL*/)                                                 \
+{                                                                                              \
+	const void *const key = k;                                                                 \
+	return key_cmp(key_of(name##_from_node(n)), *(const key_type*)key); /* n - key */          \
+}                                                                                              \
+static inline type *name##_search(                                                             \
+	const struct trbtree *const tree/*!=NULL*/,                                                \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const struct btree_node *n;                                                                \
+	TRBTREE_ASSERT_PTR(tree);                                                                  \
+	BTREE_TRACE_(BTREE_TRACE_SEARCH, key);                                                     \
+	for (n = tree->root; n;) {                                                                 \
+		const int c = key_cmp(key_of(name##_from_node(n)), key); /* c = n - key */             \
+		if (c == 0)                                                                            \
+			break;                                                                             \
+		n = trbtree_leaf(n, c < 0);                                                            \
+	}                                                                                          \
+	return name##_from_node(n); /* NULL? */                                                    \
+}                                                                                              \
+static inline type *name##_insert(                                                             \
+	struct trbtree *const tree/*!=NULL*/,                                                      \
+	type *const o/*!=NULL*/,                                                                   \
+	const int leaf)                                                                            \
+{                                                                                              \
+	const key_type key = key_of(o);                                                            \
+	const void *const k = &key;                                                                \
+	TRBTREE_ASSERT_PTR(o);                                                                     \
+	BTREE_TRACE_(BTREE_TRACE_INSERT, key);                                                     \
+	return name##_from_node(trbtree_insert(tree, &o->member,                                   \
+		(const struct btree_key*)k, name##_comparator_, leaf)); /* NULL? */                    \
+}                                                                                              \
+static inline type *name##_remove(                                                             \
+	struct trbtree *const tree/*!=NULL*/,                                                      \
+	const key_type key)                                                                        \
+{                                                                                              \
+	const void *const k = &key;                                                                \
+	BTREE_TRACE_(BTREE_TRACE_REMOVE, key);                                                     \
+	return name##_from_node(trbtree_remove(tree,                                               \
+		(const struct btree_key*)k, name##_comparator_)); /* NULL? */                          \
+}                                                                                              \
+static inline type *name##_first(                                                              \
+	const struct trbtree *const tree/*!=NULL*/)                                                \
+{                                                                                              \
+	return name##_from_node(trbtree_first(tree)); /* NULL? */                                  \
+}                                                                                              \
+static inline type *name##_last(                                                               \
+	const struct trbtree *const tree/*!=NULL*/)                                                \
+{                                                                                              \
+	return name##_from_node(trbtree_last(tree)); /* NULL? */                                   \
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRBTREE_H_INCLUDED */
@@ -0,0 +1,238 @@
+/**********************************************************************************
+* Lock-free embedded skip list
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* lfskiplist.c */
+
+#include "collections_config.h"
+#include "lfskiplist.h"
+
+#if defined __GNUC__ || defined __clang__
+
+#define lfskiplist_load_flag_(p)        __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define lfskiplist_store_flag_(p, v)    __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+#if defined __i386__ || defined __x86_64__
+#define LFSKIPLIST_PAUSE() __builtin_ia32_pause()
+#elif defined __aarch64__ || defined __arm__
+#define LFSKIPLIST_PAUSE() __asm__ __volatile__("yield")
+#else
+#define LFSKIPLIST_PAUSE() ((void)0)
+#endif
+
+#else /* _MSC_VER */
+
+#define lfskiplist_load_flag_(p)        (*(const volatile unsigned*)(p))
+#define lfskiplist_store_flag_(p, v)    (_ReadWriteBarrier(), *(volatile unsigned*)(p) = (v))
+#define LFSKIPLIST_PAUSE()              _mm_pause()
+
+#endif
+
+/* height of a node: 1 + number of trailing pairs of zero bits of a hash of the node address,
+  so a node rises one level up with the probability 1/4 */
+static unsigned lfskiplist_height_(
+	const struct lfskiplist_node *const node/*!=NULL*/)
+{
+	size_t x = (size_t)(uintptr_t)node;
+	unsigned h = 1;
+	x ^= x >> 16;
+	x *= (size_t)0x45d9f3bu;
+	x ^= x >> 16;
+	x *= (size_t)0x45d9f3bu;
+	x ^= x >> 16;
+	for (; h < LFSKIPLIST_MAX_HEIGHT && !(x & 3u); x >>= 2)
+		h++;
+	return h;
+}
+
+/* find predecessors and successors of the key at all levels, unlinking removed nodes on the way:
+  preds[l] - last node with key < given one, succs[l] - next node at level l, NULL?
+  returns non-zero if succs[0] has the key */
+static int lfskiplist_find_(
+	struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/,
+	struct lfskiplist_node *preds[LFSKIPLIST_MAX_HEIGHT]/*out*/,
+	struct lfskiplist_node *succs[LFSKIPLIST_MAX_HEIGHT]/*out*/)
+{
+	int c;
+retry:
+	{
+		struct lfskiplist_node *pred = &list->head;
+		const struct lfskiplist_node *bound = (const struct lfskiplist_node*)0; /* stopped at on upper level */
+		int bc = 1;
+		unsigned l = LFSKIPLIST_MAX_HEIGHT;
+		do {
+			struct lfskiplist_node *curr = lfskiplist_unmark_(
+				(struct lfskiplist_node*)lfskiplist_load_(&pred->next[--l]));
+			for (c = 1; curr;) {
+				struct lfskiplist_node *const succ = (struct lfskiplist_node*)lfskiplist_load_(&curr->next[l]);
+				if (lfskiplist_is_marked_(succ)) {
+					/* curr is removed: unlink it, fails if pred is removed or was changed */
+					struct lfskiplist_node *expected = curr;
+					if (!lfskiplist_cas_(&pred->next[l], &expected, lfskiplist_unmark_(succ)))
+						goto retry;
+					curr = lfskiplist_unmark_(succ);
+					continue;
+				}
+				if (curr == bound) {
+					c = bc; /* already compared */
+					break;
+				}
+				c = (*comparator)(curr, key); /* c = curr - key */
+				if (c >= 0)
+					break;
+				pred = curr;
+				curr = succ;
+			}
+			preds[l] = pred;
+			succs[l] = curr;
+			bound = curr;
+			bc = c;
+		} while (l);
+	}
+	return !c;
+}
+
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_insert(
+	struct lfskiplist *const list/*!=NULL*/,
+	struct lfskiplist_node *const node/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/)
+{
+	struct lfskiplist_node *preds[LFSKIPLIST_MAX_HEIGHT];
+	struct lfskiplist_node *succs[LFSKIPLIST_MAX_HEIGHT];
+	const unsigned height = lfskiplist_height_(node);
+	unsigned l;
+	LFSKIPLIST_ASSERT_PTR(list);
+	LFSKIPLIST_ASSERT_PTR(node);
+	LFSKIPLIST_ASSERT_PTR(key);
+	LFSKIPLIST_ASSERT_PTR(comparator);
+	/* link at the lowest level: the node becomes a member of the list */
+	for (;;) {
+		struct lfskiplist_node *expected;
+		if (lfskiplist_find_(list, key, comparator, preds, succs))
+			return succs[0];
+		node->height = height;
+		node->linked = 0;
+		for (l = 0; l < height; l++)
+			lfskiplist_store_(&node->next[l], succs[l]);
+		expected = succs[0];
+		if (lfskiplist_cas_(&preds[0]->next[0], &expected, node))
+			break;
+	}
+	/* link at upper levels, the node cannot be removed until it is linked at all levels */
+	for (l = 1; l < height; l++) {
+		for (;;) {
+			struct lfskiplist_node *expected = succs[l];
+			if (lfskiplist_cas_(&preds[l]->next[l], &expected, node))
+				break;
+			(void)lfskiplist_find_(list, key, comparator, preds, succs);
+			lfskiplist_store_(&node->next[l], succs[l]);
+		}
+	}
+	lfskiplist_store_flag_(&node->linked, 1u);
+	return (struct lfskiplist_node*)0;
+}
+
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_remove(
+	struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/)
+{
+	struct lfskiplist_node *preds[LFSKIPLIST_MAX_HEIGHT];
+	struct lfskiplist_node *succs[LFSKIPLIST_MAX_HEIGHT];
+	struct lfskiplist_node *victim, *succ;
+	unsigned l;
+	LFSKIPLIST_ASSERT_PTR(list);
+	LFSKIPLIST_ASSERT_PTR(key);
+	LFSKIPLIST_ASSERT_PTR(comparator);
+	if (!lfskiplist_find_(list, key, comparator, preds, succs))
+		return (struct lfskiplist_node*)0;
+	victim = succs[0];
+	/* else the inserting thread may link the node at an upper level after it is unlinked */
+	while (!lfskiplist_load_flag_(&victim->linked))
+		LFSKIPLIST_PAUSE();
+	/* mark upper levels, top-down */
+	for (l = victim->height; --l;) {
+		succ = (struct lfskiplist_node*)lfskiplist_load_(&victim->next[l]);
+		while (!lfskiplist_is_marked_(succ)) {
+			if (lfskiplist_cas_(&victim->next[l], &succ, (struct lfskiplist_node*)((uintptr_t)succ | 1u)))
+				break;
+		}
+	}
+	/* marking of the lowest level removes the node, only one thread may succeed */
+	succ = (struct lfskiplist_node*)lfskiplist_load_(&victim->next[0]);
+	do {
+		if (lfskiplist_is_marked_(succ))
+			return (struct lfskiplist_node*)0; /* removed by another thread */
+	} while (!lfskiplist_cas_(&victim->next[0], &succ, (struct lfskiplist_node*)((uintptr_t)succ | 1u)));
+	/* unlink the node at all levels */
+	(void)lfskiplist_find_(list, key, comparator, preds, succs);
+	return victim;
+}
+
+/* mode: 0 - search, 1 - lower bound, 2 - upper bound */
+static struct lfskiplist_node *lfskiplist_lookup_(
+	const struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/,
+	const int mode)
+{
+	const struct lfskiplist_node *pred = &list->head;
+	struct lfskiplist_node *curr, *bound = (struct lfskiplist_node*)0; /* stopped at on upper level */
+	unsigned l = LFSKIPLIST_MAX_HEIGHT;
+	int c, bc = 1;
+	LFSKIPLIST_ASSERT_PTR(list);
+	LFSKIPLIST_ASSERT_PTR(key);
+	LFSKIPLIST_ASSERT_PTR(comparator);
+	do {
+		curr = lfskiplist_unmark_((const struct lfskiplist_node*)lfskiplist_load_(&pred->next[--l]));
+		for (c = 1; curr;) {
+			/* skip removed nodes, do not unlink them */
+			struct lfskiplist_node *const succ = (struct lfskiplist_node*)lfskiplist_load_(&curr->next[l]);
+			if (lfskiplist_is_marked_(succ)) {
+				curr = lfskiplist_unmark_(succ);
+				continue;
+			}
+			if (curr == bound) {
+				c = bc; /* already compared */
+				break;
+			}
+			c = (*comparator)(curr, key); /* c = curr - key */
+			if (mode == 2 ? c > 0 : c >= 0)
+				break;
+			pred = curr;
+			curr = succ;
+		}
+		bound = curr;
+		bc = c;
+	} while (l);
+	return (mode || !c) ? curr : (struct lfskiplist_node*)0; /* NULL? */
+}
+
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_search(
+	const struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/)
+{
+	return lfskiplist_lookup_(list, key, comparator, 0);
+}
+
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_lower_bound(
+	const struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/)
+{
+	return lfskiplist_lookup_(list, key, comparator, 1);
+}
+
+LFSKIPLIST_EXPORTS struct lfskiplist_node *lfskiplist_upper_bound(
+	const struct lfskiplist *const list/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	lfskiplist_comparator *const comparator/*!=NULL*/)
+{
+	return lfskiplist_lookup_(list, key, comparator, 2);
+}
@@ -0,0 +1,272 @@
+/**********************************************************************************
+* Lock-free embedded skip list
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* test.cpp */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "lfskiplist.h"
+#include "epoch.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define RANGE 3000
+#define OPS 30000
+#define THREADS 8
+#define THREAD_OPS 100000
+#define HOT_KEYS 16  /* keys updated by all threads */
+
+struct obj {
+	struct lfskiplist_node n;
+	unsigned key;
+	unsigned check; /* derived from the key, to detect reading of freed objects */
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+LFSKIPLIST_DEFINE(olist, struct obj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+
+static struct obj objs[RANGE];
+static int inserted[RANGE];
+
+/* check order of nodes at all levels, without concurrent updates:
+  removed nodes must be unlinked, returns number of nodes at the lowest level */
+static size_t check_list(const struct lfskiplist *const list)
+{
+	size_t count = 0;
+	unsigned l = 0;
+	for (; l < LFSKIPLIST_MAX_HEIGHT; l++) {
+		const struct lfskiplist_node *n = list->head.next[l];
+		const struct obj *prev = NULL;
+		for (; n; n = n->next[l]) {
+			const struct obj *const o = olist_from_node(n);
+			if (lfskiplist_is_marked_(n->next[l]) || n->height <= l || !n->linked ||
+				(prev && prev->key >= o->key))
+			{
+				return (size_t)-1;
+			}
+			prev = o;
+			count += !l;
+		}
+	}
+	return count;
+}
+
+static int check_lookups(const struct lfskiplist *const list)
+{
+	unsigned k;
+	const struct obj *lower = NULL;
+	const struct obj *first = NULL;
+	size_t n = 0;
+	/* go backward, remember the nearest object with key >= k */
+	for (k = RANGE; k--;) {
+		const struct obj *const upper = lower;
+		const struct obj *const e = inserted[k] ? &objs[k] : NULL;
+		if (e)
+			first = lower = e;
+		if (olist_search(list, k) != e ||
+			olist_lower_bound(list, k) != lower ||
+			olist_upper_bound(list, k) != upper)
+		{
+			return 0;
+		}
+	}
+	if (olist_first(list) != first)
+		return 0;
+	for (; first; first = olist_next(first))
+		n++;
+	for (k = 0; k < RANGE; k++)
+		n -= (size_t)inserted[k];
+	return !n && check_list(list) != (size_t)-1;
+}
+
+/* concurrent test */
+
+static struct epoch_domain domain;
+static struct lfskiplist clist;
+static std::mutex retire_lock;
+static std::atomic<unsigned long> errors(0);
+static std::atomic<long> hot_balance[HOT_KEYS]; /* successful inserts minus removes */
+
+static void free_obj(void *ptr, void *ctx)
+{
+	(void)ctx;
+	free(ptr);
+}
+
+static struct obj *new_obj(unsigned key)
+{
+	struct obj *const o = (struct obj*)malloc(sizeof(*o));
+	if (!o)
+		abort();
+	o->key = key;
+	o->check = key*2654435761u;
+	return o;
+}
+
+static void retire(std::vector<struct obj*> &removed)
+{
+	std::lock_guard<std::mutex> g(retire_lock);
+	for (size_t i = 0; i < removed.size(); i++)
+		epoch_retire(&domain, removed[i], free_obj, NULL);
+	(void)epoch_reclaim(&domain);
+	removed.clear();
+}
+
+/* thread t owns keys HOT_KEYS + t + THREADS*i and knows their state,
+  all threads insert/remove hot keys 0..HOT_KEYS-1 */
+static void worker(unsigned t, struct epoch_reader *const r)
+{
+	const unsigned own = RANGE/THREADS;
+	std::vector<char> present(own);
+	std::vector<struct obj*> removed;
+	unsigned rnd = t + 1, i;
+	unsigned long e = 0;
+	epoch_register(&domain, r);
+	for (i = 0; i < THREAD_OPS; i++) {
+		unsigned j, key;
+		int hot;
+		rnd = rnd*1103515245u + 12345u;
+		hot = !((rnd >> 20) & 3);
+		j = (rnd >> 8) % (hot ? HOT_KEYS : own);
+		key = hot ? j : HOT_KEYS + t + THREADS*j;
+		epoch_enter(&domain, r);
+		if ((rnd >> 24) & 1) {
+			struct obj *const o = new_obj(key);
+			struct obj *const x = olist_insert(&clist, o);
+			if (x) {
+				e += x->key != key || x->check != key*2654435761u;
+				free(o); /* was not published */
+			}
+			if (hot)
+				hot_balance[j] += !x;
+			else {
+				e += !x == !!present[j];
+				present[j] = 1;
+			}
+		}
+		else {
+			struct obj *const x = olist_remove(&clist, key);
+			if (x) {
+				e += x->key != key;
+				removed.push_back(x);
+			}
+			if (hot)
+				hot_balance[j] -= !!x;
+			else {
+				e += !x == !!present[j];
+				present[j] = 0;
+			}
+		}
+		{
+			/* lookups cross nodes of other threads */
+			const struct obj *const o = olist_lower_bound(&clist, key + 1);
+			e += o && (o->key <= key || o->check != o->key*2654435761u);
+		}
+		epoch_leave(r);
+		if (removed.size() >= 64)
+			retire(removed);
+	}
+	retire(removed);
+	errors.fetch_add(e);
+}
+
+int main(int argc, char *argv[])
+{
+	struct lfskiplist list;
+	unsigned i, seed = 1;
+	int ok = 1;
+
+	(void)argc, (void)argv;
+
+	lfskiplist_init(&list);
+	for (i = 0; i < RANGE; i++)
+		objs[i].key = i;
+	TEST(check_lookups(&list));
+	TEST(!olist_remove(&list, 1));
+
+	/* random updates by one thread */
+	for (i = 0; i < OPS && ok; i++) {
+		const unsigned k = (seed = seed*1103515245u + 12345u, (seed >> 8) % RANGE);
+		if ((seed >> 24) & 1) {
+			struct obj *const x = olist_insert(&list, &objs[k]);
+			ok = inserted[k] ? x == &objs[k] : !x;
+			inserted[k] = 1;
+		}
+		else {
+			ok = olist_remove(&list, k) == (inserted[k] ? &objs[k] : NULL);
+			inserted[k] = 0;
+		}
+		if (!(i % 1000))
+			ok = ok && check_lookups(&list);
+	}
+	TEST(ok);
+	TEST(check_lookups(&list));
+
+	/* nodes are distributed over levels */
+	{
+		size_t levels[LFSKIPLIST_MAX_HEIGHT] = {0}, n = 0;
+		for (i = 0; i < RANGE; i++) {
+			if (inserted[i]) {
+				levels[objs[i].n.height - 1]++;
+				n++;
+			}
+		}
+		TEST(levels[0] > n/2 && levels[1] > n/8 && levels[2] > n/64);
+	}
+
+	/* concurrent inserts/removes */
+	{
+		std::vector<std::thread> threads;
+		std::vector<struct epoch_reader> readers(THREADS);
+		size_t count = 0;
+		epoch_init(&domain);
+		lfskiplist_init(&clist);
+		for (i = 0; i < THREADS; i++)
+			threads.push_back(std::thread(worker, i, &readers[i]));
+		for (i = 0; i < THREADS; i++)
+			threads[i].join();
+		TEST(!errors.load());
+		for (i = 0; i < HOT_KEYS; i++) {
+			const long b = hot_balance[i].load();
+			TEST((b == 0 || b == 1) && !olist_search(&clist, i) == !b);
+			count += (size_t)b;
+		}
+		{
+			struct obj *o;
+			for (o = olist_first(&clist); o; o = olist_next(o))
+				count -= o->key < HOT_KEYS;
+		}
+		TEST(!count);
+		TEST(check_list(&clist) != (size_t)-1);
+		for (i = 0; i < THREADS; i++)
+			epoch_unregister(&domain, &readers[i]);
+		{
+			struct obj *o;
+			while ((o = olist_first(&clist)) != NULL) {
+				ok = ok && olist_remove(&clist, o->key) == o;
+				free(o);
+			}
+		}
+		TEST(ok);
+		epoch_destroy(&domain);
+	}
+
+	printf("all tests OK\n");
+	return 0;
+}
@@ -0,0 +1,215 @@
+/**********************************************************************************
+* Embedded red-black binary tree of nodes linked by 32-bit indices
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* irbtree.c */
+
+#include "collections_config.h"
+#include "irbtree.h"
+
+#define IRB_RED_COLOR   1u
+#define IRB_BLACK_COLOR 0u
+
+#define IRB_NODE(i) irbtree_node(tree, i)
+
+static inline int irbtree_is_red_(
+	const struct irbtree *const tree/*!=NULL*/,
+	const irbtree_index_t i/*IRBTREE_NIL?*/)
+{
+	return IRBTREE_NIL != i && IRB_RED_COLOR == irbtree_get_color_(IRB_NODE(i));
+}
+
+static inline void irbtree_set_color_(
+	struct irbtree_node *const n/*!=NULL*/,
+	const unsigned c/*0,1*/)
+{
+	n->parent_color = (irbtree_index_t)((n->parent_color & ~1u) | c);
+}
+
+static inline void irbtree_set_parent_(
+	struct irbtree_node *const n/*!=NULL*/,
+	const irbtree_index_t p/*IRBTREE_NIL?*/)
+{
+	n->parent_color = irbtree_make_parent_color_(p, irbtree_get_color_(n));
+}
+
+/* link node e to the place of node o at the parent p of o */
+static inline void irbtree_replace_at_parent_(
+	struct irbtree *const tree/*!=NULL*/,
+	const irbtree_index_t p/*IRBTREE_NIL?*/,
+	const irbtree_index_t o/*!=IRBTREE_NIL*/,
+	const irbtree_index_t e/*IRBTREE_NIL?*/)
+{
+	if (IRBTREE_NIL == p)
+		tree->root = e;
+	else {
+		struct irbtree_node *const n = IRB_NODE(p);
+		n->leaves[o != n->irbtree_left] = e;
+	}
+}
+
+/* rotate: child of node x at side !d takes the place of x, x becomes its child at side d,
+  d = 0 - rotate left, d = 1 - rotate right */
+static void irbtree_rotate_(
+	struct irbtree *const tree/*!=NULL*/,
+	const irbtree_index_t x/*!=IRBTREE_NIL*/,
+	const unsigned d/*0,1*/)
+{
+	struct irbtree_node *const xn = IRB_NODE(x);
+	const irbtree_index_t y = xn->leaves[!d];
+	struct irbtree_node *const yn = IRB_NODE(y);
+	const irbtree_index_t b = yn->leaves[d];
+	const irbtree_index_t p = irbtree_get_parent(xn);
+	xn->leaves[!d] = b;
+	if (IRBTREE_NIL != b)
+		irbtree_set_parent_(IRB_NODE(b), x);
+	irbtree_set_parent_(yn, p);
+	irbtree_replace_at_parent_(tree, p, x, y);
+	yn->leaves[d] = x;
+	irbtree_set_parent_(xn, y);
+}
+
+IRBTREE_EXPORTS void irbtree_rebalance(
+	struct irbtree *const tree/*!=NULL*/,
+	irbtree_index_t p/*!=IRBTREE_NIL*/,
+	irbtree_index_t e/*!=IRBTREE_NIL*/)
+{
+	IRBTREE_ASSERT_PTR(tree);
+	IRBTREE_ASSERT(IRBTREE_NIL != p);
+	IRBTREE_ASSERT(IRBTREE_NIL != e);
+	IRB_NODE(e)->parent_color = irbtree_make_parent_color_(p, IRB_RED_COLOR);
+	while (irbtree_is_red_(tree, p)) {
+		/* red parent is not the root */
+		struct irbtree_node *const pn = IRB_NODE(p);
+		const irbtree_index_t g = irbtree_get_parent(pn);
+		struct irbtree_node *const gn = IRB_NODE(g);
+		const unsigned d = (p == gn->irbtree_right); /* side of the parent at the grandparent */
+		const irbtree_index_t u = gn->leaves[!d];
+		if (irbtree_is_red_(tree, u)) {
+			/* recolor and continue from the grandparent */
+			irbtree_set_color_(pn, IRB_BLACK_COLOR);
+			irbtree_set_color_(IRB_NODE(u), IRB_BLACK_COLOR);
+			irbtree_set_color_(gn, IRB_RED_COLOR);
+			e = g;
+			p = irbtree_get_parent(gn);
+			continue;
+		}
+		if (e == pn->leaves[!d]) {
+			/* inner child: rotate it to the outer side */
+			irbtree_rotate_(tree, p, d);
+			p = e;
+		}
+		irbtree_set_color_(IRB_NODE(p), IRB_BLACK_COLOR);
+		irbtree_set_color_(gn, IRB_RED_COLOR);
+		irbtree_rotate_(tree, g, !d);
+		return;
+	}
+	if (IRBTREE_NIL == p)
+		irbtree_set_color_(IRB_NODE(e), IRB_BLACK_COLOR); /* e is the root */
+}
+
+/* restore black height after removal of a black node at side d of the parent p */
+static void irbtree_remove_rebalance_(
+	struct irbtree *const tree/*!=NULL*/,
+	irbtree_index_t p/*IRBTREE_NIL?*/,
+	unsigned d/*0,1*/)
+{
+	irbtree_index_t x = IRBTREE_NIL;
+	while (IRBTREE_NIL != p) {
+		struct irbtree_node *const pn = IRB_NODE(p);
+		irbtree_index_t w;
+		x = pn->leaves[d];
+		if (irbtree_is_red_(tree, x))
+			break;
+		w = pn->leaves[!d]; /* brother of black x always exists */
+		IRBTREE_ASSERT(IRBTREE_NIL != w);
+		if (irbtree_is_red_(tree, w)) {
+			irbtree_set_color_(IRB_NODE(w), IRB_BLACK_COLOR);
+			irbtree_set_color_(pn, IRB_RED_COLOR);
+			irbtree_rotate_(tree, p, d);
+			w = pn->leaves[!d];
+		}
+		{
+			struct irbtree_node *wn = IRB_NODE(w);
+			if (!irbtree_is_red_(tree, wn->irbtree_left) && !irbtree_is_red_(tree, wn->irbtree_right)) {
+				/* recolor and continue from the parent */
+				irbtree_set_color_(wn, IRB_RED_COLOR);
+				x = p;
+				p = irbtree_get_parent(pn);
+				if (IRBTREE_NIL != p)
+					d = (x != IRB_NODE(p)->irbtree_left);
+				continue;
+			}
+			if (!irbtree_is_red_(tree, wn->leaves[!d])) {
+				/* inner red nephew: rotate it to the outer side */
+				irbtree_set_color_(IRB_NODE(wn->leaves[d]), IRB_BLACK_COLOR);
+				irbtree_set_color_(wn, IRB_RED_COLOR);
+				irbtree_rotate_(tree, w, !d);
+				w = pn->leaves[!d];
+				wn = IRB_NODE(w);
+			}
+			irbtree_set_color_(wn, irbtree_get_color_(pn));
+			irbtree_set_color_(pn, IRB_BLACK_COLOR);
+			irbtree_set_color_(IRB_NODE(wn->leaves[!d]), IRB_BLACK_COLOR);
+			irbtree_rotate_(tree, p, d);
+			return;
+		}
+	}
+	if (IRBTREE_NIL != x)
+		irbtree_set_color_(IRB_NODE(x), IRB_BLACK_COLOR); /* red node or the root */
+}
+
+IRBTREE_EXPORTS void irbtree_remove(
+	struct irbtree *const tree/*!=NULL*/,
+	const irbtree_index_t e/*!=IRBTREE_NIL*/)
+{
+	struct irbtree_node *const en = IRB_NODE(e);
+	const irbtree_index_t p = irbtree_get_parent(en);
+	irbtree_index_t x;  /* child that takes the place of removed node */
+	irbtree_index_t xp; /* parent of x */
+	unsigned d;         /* side of x at xp */
+	unsigned c;         /* color of removed node */
+	IRBTREE_ASSERT_PTR(tree);
+	if (IRBTREE_NIL != en->irbtree_left && IRBTREE_NIL != en->irbtree_right) {
+		/* replace e with its successor y, which has no left child */
+		const irbtree_index_t y = irbtree_first(tree, en->irbtree_right);
+		struct irbtree_node *const yn = IRB_NODE(y);
+		x = yn->irbtree_right;
+		c = irbtree_get_color_(yn);
+		if (y != en->irbtree_right) {
+			xp = irbtree_get_parent(yn);
+			d = 0;
+			IRB_NODE(xp)->irbtree_left = x;
+			if (IRBTREE_NIL != x)
+				irbtree_set_parent_(IRB_NODE(x), xp);
+			yn->irbtree_right = en->irbtree_right;
+			irbtree_set_parent_(IRB_NODE(yn->irbtree_right), y);
+		}
+		else {
+			xp = y;
+			d = 1;
+		}
+		yn->irbtree_left = en->irbtree_left;
+		irbtree_set_parent_(IRB_NODE(yn->irbtree_left), y);
+		yn->parent_color = en->parent_color;
+		irbtree_replace_at_parent_(tree, p, e, y);
+	}
+	else {
+		x = IRBTREE_NIL != en->irbtree_left ? en->irbtree_left : en->irbtree_right;
+		xp = p;
+		d = IRBTREE_NIL != p && e != IRB_NODE(p)->irbtree_left;
+		c = irbtree_get_color_(en);
+		if (IRBTREE_NIL != x)
+			irbtree_set_parent_(IRB_NODE(x), p);
+		irbtree_replace_at_parent_(tree, p, e, x);
+	}
+	irbtree_init_node(en);
+	if (IRB_BLACK_COLOR == c) {
+		if (irbtree_is_red_(tree, x))
+			irbtree_set_color_(IRB_NODE(x), IRB_BLACK_COLOR);
+		else
+			irbtree_remove_rebalance_(tree, xp, d);
+	}
+}
@@ -0,0 +1,190 @@
+/**********************************************************************************
+* Embedded red-black binary tree of nodes linked by 32-bit indices
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* irtest.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "irbtree.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define N 2000
+#define RANGE 5000
+
+struct obj {
+	struct irbtree_node n;
+	int key;
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+IRBTREE_DEFINE(otree, struct obj, n, int, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+
+static struct obj pool[N];
+static int inserted[N];
+
+/* check parent links, colors and order of keys,
+  returns black height of the subtree, or -1 on error */
+static int check_subtree(const struct irbtree *const tree, const irbtree_index_t i, const int parent_is_red)
+{
+	const struct irbtree_node *const n = irbtree_node(tree, i);
+	const int red = (int)irbtree_get_color_(n);
+	int bl = 0, br = 0;
+	if (red && parent_is_red)
+		return -1;
+	if (IRBTREE_NIL != n->irbtree_left) {
+		if (irbtree_get_parent(irbtree_node(tree, n->irbtree_left)) != i ||
+			pool[i].key < pool[n->irbtree_left].key)
+		{
+			return -1;
+		}
+		bl = check_subtree(tree, n->irbtree_left, red);
+	}
+	if (IRBTREE_NIL != n->irbtree_right) {
+		if (irbtree_get_parent(irbtree_node(tree, n->irbtree_right)) != i ||
+			pool[n->irbtree_right].key < pool[i].key)
+		{
+			return -1;
+		}
+		br = check_subtree(tree, n->irbtree_right, red);
+	}
+	if (bl < 0 || bl != br)
+		return -1;
+	return bl + !red;
+}
+
+static int check_tree(const struct irbtree *const tree)
+{
+	if (IRBTREE_NIL == tree->root)
+		return 1;
+	return IRBTREE_NIL == irbtree_get_parent(irbtree_node(tree, tree->root)) &&
+		!irbtree_get_color_(irbtree_node(tree, tree->root)) &&
+		check_subtree(tree, tree->root, 1) > 0;
+}
+
+/* iterate forward and backward, compare with brute force count */
+static int check_iterate(const struct irbtree *const tree)
+{
+	unsigned expected = 0, found = 0, i = 0;
+	const struct obj *o, *prev = NULL;
+	for (; i < N; i++)
+		expected += (unsigned)inserted[i];
+	for (o = otree_first(tree); o; o = otree_next(tree, o)) {
+		if (prev && o->key < prev->key)
+			return 0;
+		prev = o;
+		found++;
+	}
+	if (found != expected)
+		return 0;
+	for (o = otree_last(tree); o; o = otree_prev(tree, o))
+		found--;
+	return !found;
+}
+
+int main(int argc, char *argv[])
+{
+	struct irbtree tree;
+	unsigned i;
+	(void)argc, (void)argv;
+	TEST(sizeof(struct irbtree_node) == 12);
+	otree_init(&tree, pool);
+	TEST(!otree_first(&tree));
+	TEST(!otree_search(&tree, 1));
+	{
+		/* small tree */
+		static const int keys[5] = {30, 10, 50, 20, 40};
+		for (i = 0; i < 5; i++) {
+			irbtree_init_node(&pool[i].n);
+			pool[i].key = keys[i];
+			TEST(!otree_insert(&tree, &pool[i], /*leaf:*/0));
+		}
+		TEST(check_tree(&tree));
+		irbtree_init_node(&pool[5].n);
+		pool[5].key = 20;
+		TEST(otree_insert(&tree, &pool[5], /*leaf:*/0) == &pool[3]);
+		TEST(otree_search(&tree, 40) == &pool[4]);
+		TEST(otree_search(&tree, 41) == NULL);
+		TEST(otree_lower_bound(&tree, 21) == &pool[0]);
+		TEST(otree_lower_bound(&tree, 20) == &pool[3]);
+		TEST(otree_upper_bound(&tree, 20) == &pool[0]);
+		TEST(otree_upper_bound(&tree, 50) == NULL);
+		TEST(otree_first(&tree) == &pool[1]);
+		TEST(otree_last(&tree) == &pool[2]);
+		TEST(otree_next(&tree, &pool[3]) == &pool[0]);
+		TEST(otree_prev(&tree, &pool[3]) == &pool[1]);
+		TEST(otree_index_of(&tree, &pool[4]) == 4);
+		TEST(otree_at(&tree, 4) == &pool[4]);
+		TEST(otree_at(&tree, IRBTREE_NIL) == NULL);
+		/* non-unique keys */
+		TEST(!otree_insert(&tree, &pool[5], /*leaf:*/1));
+		TEST(check_tree(&tree));
+		TEST(otree_next(&tree, &pool[3]) == &pool[5]);
+		for (i = 0; i < 6; i++)
+			otree_remove(&tree, &pool[i]);
+		TEST(IRBTREE_NIL == tree.root);
+	}
+	{
+		/* random keys: insert all, then remove or re-insert every second object, several times */
+		int ok = 1;
+		unsigned round = 0;
+		srand(1);
+		for (i = 0; i < N; i++) {
+			irbtree_init_node(&pool[i].n);
+			pool[i].key = rand() % RANGE;
+			inserted[i] = !otree_insert(&tree, &pool[i], /*leaf:*/0);
+			if (!(i % 100) && !check_tree(&tree))
+				ok = 0;
+		}
+		TEST(ok);
+		TEST(check_tree(&tree));
+		TEST(check_iterate(&tree));
+		for (; round < 4; round++) {
+			for (i = round; i < N; i += 2) {
+				if (inserted[i]) {
+					otree_remove(&tree, &pool[i]);
+					inserted[i] = 0;
+				}
+				else {
+					pool[i].key = rand() % RANGE;
+					inserted[i] = !otree_insert(&tree, &pool[i], /*leaf:*/round & 1);
+				}
+				if (!(i % 50) && !check_tree(&tree))
+					ok = 0;
+			}
+			TEST(ok);
+			TEST(check_tree(&tree));
+			TEST(check_iterate(&tree));
+			for (i = 0; i < N && ok; i++) {
+				const struct obj *const o = otree_search(&tree, pool[i].key);
+				if (inserted[i] && (!o || o->key != pool[i].key))
+					ok = 0;
+			}
+			TEST(ok);
+		}
+		for (i = 0; i < N; i++) {
+			if (inserted[i]) {
+				otree_remove(&tree, &pool[i]);
+				inserted[i] = 0;
+				if (!(i % 10) && !check_tree(&tree))
+					ok = 0;
+			}
+		}
+		TEST(ok);
+		TEST(IRBTREE_NIL == tree.root);
+	}
+	printf("all tests OK\n");
+	return 0;
+}
@@ -0,0 +1,160 @@
+/**********************************************************************************
+* Embedded interval tree
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* itest.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pcitree.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define N 1000
+#define RANGE 10000
+
+static struct pcitree_node nodes[N];
+static int inserted[N];
+
+/* check parent links, order of starts and maximum ends of subtrees,
+  returns maximum end of the subtree, or -1 on error */
+static long long check_subtree(const struct pcitree_node *const n)
+{
+	const struct pcitree_node *const l = pcitree_left_(n);
+	const struct pcitree_node *const r = pcitree_right_(n);
+	long long m = n->end;
+	if (l) {
+		const long long lm = check_subtree(l);
+		if (lm < 0 || pcitree_get_parent(l) != n || n->start < l->start)
+			return -1;
+		if (m < lm)
+			m = lm;
+	}
+	if (r) {
+		const long long rm = check_subtree(r);
+		if (rm < 0 || pcitree_get_parent(r) != n || r->start < n->start)
+			return -1;
+		if (m < rm)
+			m = rm;
+	}
+	return m == n->max_end ? m : -1;
+}
+
+static int check_tree(const struct pcitree *const tree)
+{
+	return !tree->root || (!pcitree_get_parent(tree->root) && check_subtree(tree->root) >= 0);
+}
+
+/* compare result of the overlap query with brute force scan */
+static int check_overlap(const struct pcitree *const tree, const long long from, const long long to)
+{
+	unsigned expected = 0, found = 0, i = 0;
+	const struct pcitree_node *prev = NULL;
+	const struct pcitree_node *n = pcitree_first_overlap(tree, from, to);
+	for (; i < N; i++) {
+		if (inserted[i] && nodes[i].start <= to && from <= nodes[i].end)
+			expected++;
+	}
+	for (; n; n = pcitree_next_overlap(n, from, to)) {
+		if (to < n->start || n->end < from)
+			return 0;
+		if (prev && n->start < prev->start)
+			return 0;
+		prev = n;
+		found++;
+	}
+	return found == expected;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pcitree tree;
+	unsigned i;
+	(void)argc, (void)argv;
+	pcitree_init(&tree);
+	TEST(!pcitree_stab(&tree, 0));
+	{
+		/* [1,3] [2,5] [4,4] [6,9] [8,10] */
+		static const long long iv[5][2] = {{6,9},{1,3},{8,10},{4,4},{2,5}};
+		for (i = 0; i < 5; i++) {
+			pcitree_init_node(&nodes[i], iv[i][0], iv[i][1]);
+			pcitree_insert(&tree, &nodes[i]);
+		}
+		TEST(check_tree(&tree));
+		TEST(tree.root->max_end == 10);
+		TEST(pcitree_stab(&tree, 0) == NULL);
+		TEST(pcitree_stab(&tree, 3) == &nodes[1]);
+		TEST(pcitree_next_overlap(&nodes[1], 3, 3) == &nodes[4]);
+		TEST(pcitree_next_overlap(&nodes[4], 3, 3) == NULL);
+		TEST(pcitree_stab(&tree, 4) == &nodes[4]);
+		TEST(pcitree_next_overlap(&nodes[4], 4, 4) == &nodes[3]);
+		TEST(pcitree_next_overlap(&nodes[3], 4, 4) == NULL);
+		TEST(pcitree_stab(&tree, 11) == NULL);
+		TEST(pcitree_first_overlap(&tree, 6, 7) == &nodes[0]);
+		TEST(pcitree_first_overlap(&tree, 5, 8) == &nodes[4]);
+		pcitree_remove(&tree, &nodes[2]);
+		TEST(check_tree(&tree));
+		TEST(tree.root->max_end == 9);
+		TEST(pcitree_stab(&tree, 10) == NULL);
+		for (i = 0; i < 5; i++) {
+			if (i != 2)
+				pcitree_remove(&tree, &nodes[i]);
+		}
+		TEST(!tree.root);
+	}
+	{
+		/* random intervals: insert all, then remove half, then insert them back */
+		int ok = 1;
+		unsigned round = 0;
+		srand(1);
+		for (i = 0; i < N; i++) {
+			const long long start = rand() % RANGE;
+			pcitree_init_node(&nodes[i], start, start + rand() % (i % 10 ? 50 : 1000));
+			pcitree_insert(&tree, &nodes[i]);
+			inserted[i] = 1;
+		}
+		TEST(check_tree(&tree));
+		for (; round < 3; round++) {
+			for (i = 0; i < 200 && ok; i++) {
+				const long long from = rand() % (RANGE + 100) - 50;
+				ok = check_overlap(&tree, from, from + rand() % (i % 3 ? 1 : 200));
+			}
+			TEST(ok);
+			for (i = round; i < N; i += 2) {
+				if (inserted[i]) {
+					pcitree_remove(&tree, &nodes[i]);
+					inserted[i] = 0;
+				}
+				else {
+					const long long start = rand() % RANGE;
+					pcitree_init_node(&nodes[i], start, start + rand() % 100);
+					pcitree_insert(&tree, &nodes[i]);
+					inserted[i] = 1;
+				}
+			}
+			TEST(check_tree(&tree));
+		}
+		for (i = 0; i < N; i++) {
+			if (inserted[i]) {
+				pcitree_remove(&tree, &nodes[i]);
+				inserted[i] = 0;
+				if (!(i % 100) && !check_tree(&tree))
+					ok = 0;
+			}
+		}
+		TEST(ok);
+		TEST(!tree.root);
+	}
+	printf("all tests OK\n");
+	return 0;
+}
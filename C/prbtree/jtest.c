@@ -0,0 +1,605 @@
+/**********************************************************************************
+* Split and join of embedded red-black binary trees
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* jtest.c */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "prbtree.h"
+#include "pcrbtree.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define N 2000
+#define RANGE 1000 /* < N: there are nodes with equal keys */
+
+/* keys of the big case of set operations: a tree of all 2^17 keys has black height >= 9,
+  above the default PRBTREE_PARALLEL_CUTOFF/PCRBTREE_PARALLEL_CUTOFF, so OpenMP tasks are spawned */
+#define SET_RANGE (1 << 17)
+#define SET_MIN_BLACK_HEIGHT 9
+
+union test_key {
+	int k;
+	struct btree_key key;
+};
+
+/* prbtree */
+
+struct pn {
+	struct prbtree_node n;
+	int key;
+};
+
+#define PN_KEY_OF(o) ((o)->key)
+
+PRBTREE_DEFINE(pn_tree, struct pn, n, int, PN_KEY_OF, BTREE_KEY_COMPARATOR)
+
+static struct pn pnodes[N];
+static struct pn pextra[2];
+
+static inline int pn_comparator(
+	const struct btree_node *node/*!=NULL*/,
+	const struct btree_key *key/*!=NULL*/)
+{
+	const void *const k_ = key;
+	const struct pn *const n = pn_tree_from_node(prbtree_node_from_btree_node_(node));
+	const union test_key *const k = (const union test_key*)k_;
+	return BTREE_KEY_COMPARATOR(n->key, k->k);
+}
+
+/* check links, colors and order of nodes of the subtree,
+  returns black height of the subtree or -1 on error */
+static int pn_check_subtree(const struct prbtree_node *const n, int *const count)
+{
+	int hl, hr;
+	const struct prbtree_node *const l = n->prbtree_left;
+	const struct prbtree_node *const r = n->prbtree_right;
+	const int red = 0 != prbtree_get_color_(n);
+	hl = l ? pn_check_subtree(l, count) : 0;
+	hr = r ? pn_check_subtree(r, count) : 0;
+	if (hl < 0 || hl != hr)
+		return -1;
+	if (l && (prbtree_get_parent(l) != n || pn_tree_from_node(n)->key < pn_tree_from_node(l)->key ||
+		(red && 0 != prbtree_get_color_(l))))
+		return -1;
+	if (r && (prbtree_get_parent(r) != n || pn_tree_from_node(r)->key < pn_tree_from_node(n)->key ||
+		(red && 0 != prbtree_get_color_(r))))
+		return -1;
+	(*count)++;
+	return hl + !red;
+}
+
+/* returns number of nodes in the tree or -1 on error */
+static int pn_check_tree(const struct prbtree *const tree)
+{
+	int count = 0;
+	if (!tree->root)
+		return 0;
+	if (prbtree_get_parent(tree->root) || 0 != prbtree_get_color_(tree->root))
+		return -1;
+	return pn_check_subtree(tree->root, &count) < 0 ? -1 : count;
+}
+
+/* check that keys of all nodes of the tree are < (lt != 0) or >= (lt == 0) given key */
+static int pn_check_keys(const struct prbtree *const tree, const int key, const int lt)
+{
+	const struct prbtree_node *n = tree->root ?
+		prbtree_node_from_btree_node_(btree_first(&tree->root->u.n)) : NULL;
+	for (; n; n = prbtree_next(n)) {
+		if (lt != (pn_tree_from_node(n)->key < key))
+			return 0;
+	}
+	return 1;
+}
+
+static int pn_test(void)
+{
+	struct prbtree tree, left, right;
+	union test_key k;
+	int i, count;
+	prbtree_init(&tree);
+	k.k = 0;
+	prbtree_split(&tree, &k.key, pn_comparator, &left, &right);
+	TEST(!left.root && !right.root);
+	for (i = 0; i < N; i++) {
+		prbtree_init_node(&pnodes[i].n);
+		pnodes[i].key = rand() % RANGE;
+		pn_tree_insert(&tree, &pnodes[i], /*leaf:*/1);
+	}
+	TEST(pn_check_tree(&tree) == N);
+	{
+		/* prefetching iterators return the same nodes as plain ones */
+		const struct prbtree_node *n = prbtree_node_from_btree_node_(btree_first(&tree.root->u.n));
+		const struct prbtree_node *last = NULL;
+		int ok = 1;
+		for (; n && ok; n = prbtree_next_prefetch(n)) {
+			ok = prbtree_next(n) == prbtree_next_prefetch(n) && prbtree_prev(n) == prbtree_prev_prefetch(n);
+			last = n;
+		}
+		TEST(ok && last == prbtree_node_from_btree_node_(btree_last(&tree.root->u.n)));
+	}
+	{
+		/* split at random keys and join back */
+		int ok = 1;
+		for (i = 0; i < 300 && ok; i++) {
+			int lc, rc;
+			struct prbtree_node *pivot;
+			k.k = rand() % (RANGE + 20) - 10;
+			prbtree_split(&tree, &k.key, pn_comparator, &left, &right);
+			lc = pn_check_tree(&left);
+			rc = pn_check_tree(&right);
+			ok = lc >= 0 && rc >= 0 && lc + rc == N &&
+				pn_check_keys(&left, k.k, 1) && pn_check_keys(&right, k.k, 0);
+			if (!ok)
+				break;
+			if (i % 2 && right.root) {
+				/* join using the leftmost node of the right tree as the pivot */
+				pivot = prbtree_node_from_btree_node_(btree_first(&right.root->u.n));
+				prbtree_remove(&right, pivot);
+				prbtree_join(&left, pivot, &right);
+			}
+			else
+				prbtree_concat(&left, &right);
+			ok = !right.root && pn_check_tree(&left) == N;
+			tree = left;
+		}
+		TEST(ok);
+	}
+	{
+		/* remove ranges of keys */
+		int ok = 1;
+		count = N;
+		for (i = 0; i < 20 && ok; i++) {
+			struct prbtree mid;
+			int from = rand() % RANGE, mc;
+			k.k = from;
+			prbtree_split(&tree, &k.key, pn_comparator, &tree, &mid);
+			k.k = from + rand() % (RANGE/20);
+			prbtree_split(&mid, &k.key, pn_comparator, &mid, &right);
+			prbtree_concat(&tree, &right);
+			mc = pn_check_tree(&mid);
+			ok = mc >= 0 && pn_check_tree(&tree) == count - mc &&
+				pn_check_keys(&mid, from, 0) && pn_check_keys(&mid, k.k, 1);
+			count -= mc;
+		}
+		TEST(ok);
+		TEST(count < N);
+	}
+	{
+		/* join with empty trees: the pivot is linked to the far end of the spine */
+		prbtree_init(&left);
+		pextra[0].key = -1;
+		prbtree_join(&left, &pextra[0].n, &tree);
+		TEST(!tree.root);
+		TEST(pn_check_tree(&left) == count + 1);
+		pextra[1].key = RANGE;
+		prbtree_join(&left, &pextra[1].n, &tree);
+		TEST(pn_check_tree(&left) == count + 2);
+		TEST(prbtree_node_from_btree_node_(btree_first(&left.root->u.n)) == &pextra[0].n);
+		TEST(prbtree_node_from_btree_node_(btree_last(&left.root->u.n)) == &pextra[1].n);
+	}
+	return 0;
+}
+
+static struct pn pa[SET_RANGE], pb[SET_RANGE];
+
+static inline int pn_node_comparator(
+	const struct btree_node *a/*!=NULL*/,
+	const struct btree_node *b/*!=NULL*/)
+{
+	return BTREE_KEY_COMPARATOR(pn_tree_from_node(prbtree_node_from_btree_node_(a))->key,
+		pn_tree_from_node(prbtree_node_from_btree_node_(b))->key);
+}
+
+static void pn_deleter(struct btree_node *node, struct btree_object *obj)
+{
+	pn_tree_from_node(prbtree_node_from_btree_node_(node))->key = -1; /* mark as deleted */
+	(void)obj;
+}
+
+/* fill tree with nodes of array which keys are set in the mask */
+static void pn_fill(struct prbtree *const tree, struct pn nodes[], const unsigned char mask[], const unsigned bit,
+	const int range)
+{
+	int i;
+	prbtree_init(tree);
+	for (i = 0; i < range; i++) {
+		if (mask[i] & bit) {
+			prbtree_init_node(&nodes[i].n);
+			nodes[i].key = i;
+			pn_tree_insert(tree, &nodes[i], /*leaf:*/0);
+		}
+	}
+}
+
+/* returns black height of the tree */
+static int pn_black_height(const struct prbtree *const tree)
+{
+	int h = 0;
+	const struct prbtree_node *n = tree->root;
+	for (; n; n = n->prbtree_left)
+		h += 0 == prbtree_get_color_(n);
+	return h;
+}
+
+/* op: 0 - union, 1 - intersection, 2 - difference,
+  min_height - minimal expected black height of the first tree */
+static int pn_check_set_op(const int op, const unsigned char mask[], const int range, const int min_height)
+{
+	struct prbtree t1, t2;
+	int i, count = 0;
+	pn_fill(&t1, pa, mask, 1, range);
+	pn_fill(&t2, pb, mask, 2, range);
+	if (pn_black_height(&t1) < min_height)
+		return 0;
+	if (!op)
+		prbtree_union(&t1, &t2, pn_node_comparator, pn_deleter, NULL);
+	else if (op == 1)
+		prbtree_intersection(&t1, &t2, pn_node_comparator, pn_deleter, NULL);
+	else
+		prbtree_difference(&t1, &t2, pn_node_comparator, pn_deleter, NULL);
+	for (i = 0; i < range; i++) {
+		/* expected node in the result, expected deleted node */
+		const struct pn *e = NULL, *d = NULL;
+		const int in_a = mask[i] & 1, in_b = mask[i] & 2;
+		if (!op) {
+			e = in_a ? &pa[i] : in_b ? &pb[i] : NULL;
+			d = in_a && in_b ? &pb[i] : NULL;
+		}
+		else if (op == 1) {
+			e = in_a && in_b ? &pa[i] : NULL;
+			d = in_a && !in_b ? &pa[i] : NULL;
+		}
+		else {
+			e = in_a && !in_b ? &pa[i] : NULL;
+			d = in_a && in_b ? &pa[i] : NULL;
+		}
+		if ((e && e->key != i) || (d && d->key != -1))
+			return 0;
+		if (e)
+			count++;
+	}
+	if (pn_check_tree(&t1) != count || (!op && t2.root) || (op && pn_check_tree(&t2) < 0))
+		return 0;
+	{
+		/* nodes of the result are ordered and are the expected ones */
+		const struct prbtree_node *n = t1.root ? prbtree_node_from_btree_node_(btree_first(&t1.root->u.n)) : NULL;
+		for (i = -1; n; n = prbtree_next(n)) {
+			const struct pn *const x = pn_tree_from_node(n);
+			if (x->key <= i || (x != &pa[x->key] && x != &pb[x->key]))
+				return 0;
+			i = x->key;
+		}
+	}
+	return 1;
+}
+
+static int pn_set_test(void)
+{
+	static unsigned char mask[SET_RANGE];
+	int op, round;
+	for (op = 0; op < 3; op++) {
+		int ok = 1;
+		int i;
+		for (round = 0; round < 12 && ok; round++) {
+			/* vary densities of both sets: from disjoint to nested and from equal sizes to very different */
+			const int da = 1 + round % 4, db = 1 + (round * 7) % 50;
+			for (i = 0; i < RANGE; i++) {
+				mask[i] = (unsigned char)((rand() % da == 0) | (rand() % db == 0) << 1);
+				if (round == 10)
+					mask[i] = (unsigned char)(i < RANGE/2 ? 1 : 2);
+				else if (round == 11)
+					mask[i] = (unsigned char)(mask[i] & 1 ? 3 : 0);
+			}
+			ok = pn_check_set_op(op, mask, RANGE, 0);
+		}
+		TEST(ok);
+		/* big trees: subtrees are processed in parallel if compiled with OpenMP */
+		for (i = 0; i < SET_RANGE; i++)
+			mask[i] = (unsigned char)(1 | (rand() % 3 == 0) << 1);
+		TEST(pn_check_set_op(op, mask, SET_RANGE, SET_MIN_BLACK_HEIGHT));
+	}
+	return 0;
+}
+
+/* pcrbtree */
+
+struct cn {
+	struct pcrbtree_node n;
+	int key;
+};
+
+#define CN_KEY_OF(o) ((o)->key)
+
+PCRBTREE_DEFINE(cn_tree, struct cn, n, int, CN_KEY_OF, BTREE_KEY_COMPARATOR)
+
+static struct cn cnodes[N];
+static struct cn cextra[2];
+
+static inline int cn_comparator(
+	const struct btree_node *node/*!=NULL*/,
+	const struct btree_key *key/*!=NULL*/)
+{
+	const void *const k_ = key;
+	const struct cn *const n = cn_tree_from_node(pcrbtree_node_from_btree_node_(node));
+	const union test_key *const k = (const union test_key*)k_;
+	return BTREE_KEY_COMPARATOR(n->key, k->k);
+}
+
+/* check links, colors and order of nodes of the subtree,
+  returns black height of the subtree or -1 on error */
+static int cn_check_subtree(const struct pcrbtree_node *const n, int *const count)
+{
+	int hl, hr;
+	const struct pcrbtree_node *const l = n->pcrbtree_left;
+	const struct pcrbtree_node *const r = n->pcrbtree_right;
+	const int red = 0 != pcrbtree_get_color_(n);
+	hl = l ? cn_check_subtree(l, count) : 0;
+	hr = r ? cn_check_subtree(r, count) : 0;
+	if (hl < 0 || hl != hr)
+		return -1;
+	if (l && (pcrbtree_get_parent(l) != n || cn_tree_from_node(n)->key < cn_tree_from_node(l)->key ||
+		(red && 0 != pcrbtree_get_color_(l))))
+		return -1;
+	if (r && (pcrbtree_get_parent(r) != n || cn_tree_from_node(r)->key < cn_tree_from_node(n)->key ||
+		(red && 0 != pcrbtree_get_color_(r))))
+		return -1;
+	(*count)++;
+	return hl + !red;
+}
+
+/* returns number of nodes in the tree or -1 on error */
+static int cn_check_tree(const struct pcrbtree *const tree)
+{
+	int count = 0;
+	if (!tree->root)
+		return 0;
+	if (pcrbtree_get_parent(tree->root) || 0 != pcrbtree_get_color_(tree->root))
+		return -1;
+	return cn_check_subtree(tree->root, &count) < 0 ? -1 : count;
+}
+
+/* check that keys of all nodes of the tree are < (lt != 0) or >= (lt == 0) given key */
+static int cn_check_keys(const struct pcrbtree *const tree, const int key, const int lt)
+{
+	const struct pcrbtree_node *n = tree->root ?
+		pcrbtree_node_from_btree_node_(btree_first(&tree->root->u.n)) : NULL;
+	for (; n; n = pcrbtree_next(n)) {
+		if (lt != (cn_tree_from_node(n)->key < key))
+			return 0;
+	}
+	return 1;
+}
+
+static int cn_test(void)
+{
+	struct pcrbtree tree, left, right;
+	union test_key k;
+	int i, count;
+	pcrbtree_init(&tree);
+	k.k = 0;
+	pcrbtree_split(&tree, &k.key, cn_comparator, &left, &right);
+	TEST(!left.root && !right.root);
+	for (i = 0; i < N; i++) {
+		pcrbtree_init_node(&cnodes[i].n);
+		cnodes[i].key = rand() % RANGE;
+		cn_tree_insert(&tree, &cnodes[i], /*leaf:*/1);
+	}
+	TEST(cn_check_tree(&tree) == N);
+	{
+		/* prefetching iterators return the same nodes as plain ones */
+		const struct pcrbtree_node *n = pcrbtree_node_from_btree_node_(btree_first(&tree.root->u.n));
+		const struct pcrbtree_node *last = NULL;
+		int ok = 1;
+		for (; n && ok; n = pcrbtree_next_prefetch(n)) {
+			ok = pcrbtree_next(n) == pcrbtree_next_prefetch(n) && pcrbtree_prev(n) == pcrbtree_prev_prefetch(n);
+			last = n;
+		}
+		TEST(ok && last == pcrbtree_node_from_btree_node_(btree_last(&tree.root->u.n)));
+	}
+	{
+		/* split at random keys and join back */
+		int ok = 1;
+		for (i = 0; i < 300 && ok; i++) {
+			int lc, rc;
+			struct pcrbtree_node *pivot;
+			k.k = rand() % (RANGE + 20) - 10;
+			pcrbtree_split(&tree, &k.key, cn_comparator, &left, &right);
+			lc = cn_check_tree(&left);
+			rc = cn_check_tree(&right);
+			ok = lc >= 0 && rc >= 0 && lc + rc == N &&
+				cn_check_keys(&left, k.k, 1) && cn_check_keys(&right, k.k, 0);
+			if (!ok)
+				break;
+			if (i % 2 && right.root) {
+				/* join using the leftmost node of the right tree as the pivot */
+				pivot = pcrbtree_node_from_btree_node_(btree_first(&right.root->u.n));
+				pcrbtree_remove(&right, pivot);
+				pcrbtree_join(&left, pivot, &right);
+			}
+			else
+				pcrbtree_concat(&left, &right);
+			ok = !right.root && cn_check_tree(&left) == N;
+			tree = left;
+		}
+		TEST(ok);
+	}
+	{
+		/* remove ranges of keys */
+		int ok = 1;
+		count = N;
+		for (i = 0; i < 20 && ok; i++) {
+			struct pcrbtree mid;
+			int from = rand() % RANGE, mc;
+			k.k = from;
+			pcrbtree_split(&tree, &k.key, cn_comparator, &tree, &mid);
+			k.k = from + rand() % (RANGE/20);
+			pcrbtree_split(&mid, &k.key, cn_comparator, &mid, &right);
+			pcrbtree_concat(&tree, &right);
+			mc = cn_check_tree(&mid);
+			ok = mc >= 0 && cn_check_tree(&tree) == count - mc &&
+				cn_check_keys(&mid, from, 0) && cn_check_keys(&mid, k.k, 1);
+			count -= mc;
+		}
+		TEST(ok);
+		TEST(count < N);
+	}
+	{
+		/* join with empty trees: the pivot is linked to the far end of the spine */
+		pcrbtree_init(&left);
+		cextra[0].key = -1;
+		pcrbtree_join(&left, &cextra[0].n, &tree);
+		TEST(!tree.root);
+		TEST(cn_check_tree(&left) == count + 1);
+		cextra[1].key = RANGE;
+		pcrbtree_join(&left, &cextra[1].n, &tree);
+		TEST(cn_check_tree(&left) == count + 2);
+		TEST(pcrbtree_node_from_btree_node_(btree_first(&left.root->u.n)) == &cextra[0].n);
+		TEST(pcrbtree_node_from_btree_node_(btree_last(&left.root->u.n)) == &cextra[1].n);
+	}
+	return 0;
+}
+
+
+static struct cn ca[SET_RANGE], cb[SET_RANGE];
+
+static inline int cn_node_comparator(
+	const struct btree_node *a/*!=NULL*/,
+	const struct btree_node *b/*!=NULL*/)
+{
+	return BTREE_KEY_COMPARATOR(cn_tree_from_node(pcrbtree_node_from_btree_node_(a))->key,
+		cn_tree_from_node(pcrbtree_node_from_btree_node_(b))->key);
+}
+
+static void cn_deleter(struct btree_node *node, struct btree_object *obj)
+{
+	cn_tree_from_node(pcrbtree_node_from_btree_node_(node))->key = -1; /* mark as deleted */
+	(void)obj;
+}
+
+/* fill tree with nodes of array which keys are set in the mask */
+static void cn_fill(struct pcrbtree *const tree, struct cn nodes[], const unsigned char mask[], const unsigned bit,
+	const int range)
+{
+	int i;
+	pcrbtree_init(tree);
+	for (i = 0; i < range; i++) {
+		if (mask[i] & bit) {
+			pcrbtree_init_node(&nodes[i].n);
+			nodes[i].key = i;
+			cn_tree_insert(tree, &nodes[i], /*leaf:*/0);
+		}
+	}
+}
+
+/* returns black height of the tree */
+static int cn_black_height(const struct pcrbtree *const tree)
+{
+	int h = 0;
+	const struct pcrbtree_node *n = tree->root;
+	for (; n; n = n->pcrbtree_left)
+		h += 0 == pcrbtree_get_color_(n);
+	return h;
+}
+
+/* op: 0 - union, 1 - intersection, 2 - difference,
+  min_height - minimal expected black height of the first tree */
+static int cn_check_set_op(const int op, const unsigned char mask[], const int range, const int min_height)
+{
+	struct pcrbtree t1, t2;
+	int i, count = 0;
+	cn_fill(&t1, ca, mask, 1, range);
+	cn_fill(&t2, cb, mask, 2, range);
+	if (cn_black_height(&t1) < min_height)
+		return 0;
+	if (!op)
+		pcrbtree_union(&t1, &t2, cn_node_comparator, cn_deleter, NULL);
+	else if (op == 1)
+		pcrbtree_intersection(&t1, &t2, cn_node_comparator, cn_deleter, NULL);
+	else
+		pcrbtree_difference(&t1, &t2, cn_node_comparator, cn_deleter, NULL);
+	for (i = 0; i < range; i++) {
+		/* expected node in the result, expected deleted node */
+		const struct cn *e = NULL, *d = NULL;
+		const int in_a = mask[i] & 1, in_b = mask[i] & 2;
+		if (!op) {
+			e = in_a ? &ca[i] : in_b ? &cb[i] : NULL;
+			d = in_a && in_b ? &cb[i] : NULL;
+		}
+		else if (op == 1) {
+			e = in_a && in_b ? &ca[i] : NULL;
+			d = in_a && !in_b ? &ca[i] : NULL;
+		}
+		else {
+			e = in_a && !in_b ? &ca[i] : NULL;
+			d = in_a && in_b ? &ca[i] : NULL;
+		}
+		if ((e && e->key != i) || (d && d->key != -1))
+			return 0;
+		if (e)
+			count++;
+	}
+	if (cn_check_tree(&t1) != count || (!op && t2.root) || (op && cn_check_tree(&t2) < 0))
+		return 0;
+	{
+		/* nodes of the result are ordered and are the expected ones */
+		const struct pcrbtree_node *n = t1.root ? pcrbtree_node_from_btree_node_(btree_first(&t1.root->u.n)) : NULL;
+		for (i = -1; n; n = pcrbtree_next(n)) {
+			const struct cn *const x = cn_tree_from_node(n);
+			if (x->key <= i || (x != &ca[x->key] && x != &cb[x->key]))
+				return 0;
+			i = x->key;
+		}
+	}
+	return 1;
+}
+
+static int cn_set_test(void)
+{
+	static unsigned char mask[SET_RANGE];
+	int op, round;
+	for (op = 0; op < 3; op++) {
+		int ok = 1;
+		int i;
+		for (round = 0; round < 12 && ok; round++) {
+			/* vary densities of both sets: from disjoint to nested and from equal sizes to very different */
+			const int da = 1 + round % 4, db = 1 + (round * 7) % 50;
+			for (i = 0; i < RANGE; i++) {
+				mask[i] = (unsigned char)((rand() % da == 0) | (rand() % db == 0) << 1);
+				if (round == 10)
+					mask[i] = (unsigned char)(i < RANGE/2 ? 1 : 2);
+				else if (round == 11)
+					mask[i] = (unsigned char)(mask[i] & 1 ? 3 : 0);
+			}
+			ok = cn_check_set_op(op, mask, RANGE, 0);
+		}
+		TEST(ok);
+		/* big trees: subtrees are processed in parallel if compiled with OpenMP */
+		for (i = 0; i < SET_RANGE; i++)
+			mask[i] = (unsigned char)(1 | (rand() % 3 == 0) << 1);
+		TEST(cn_check_set_op(op, mask, SET_RANGE, SET_MIN_BLACK_HEIGHT));
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	(void)argc, (void)argv;
+	srand(1);
+	if (pn_test() || cn_test() || pn_set_test() || cn_set_test())
+		return 1;
+	printf("all tests OK\n");
+	return 0;
+}
@@ -8,6 +8,7 @@
 
 #include "collections_config.h"
 #include "pcrbtree.h"
+#include "pcitree.h"
 
 /* node left/right child flag is stored in the lowest bit of parent pointer */
 #define PCRB_RIGHT_CHILD 1u
@@ -17,6 +18,10 @@
 #define PCRB_RED_COLOR   2u
 #define PCRB_BLACK_COLOR 0u
 
+/* count rebalancing statistics, see btree_stats.h */
+#define PCRB_STATS_INC(field)    BTREE_STATS_INC_(BTREE_STATS_PCRBTREE, field)
+#define PCRB_STATS_ADD(field, n) BTREE_STATS_ADD_(BTREE_STATS_PCRBTREE, field, n)
+
 static inline void *pcrbtree_recolor_to_red(void *const parent_color)
 {
 #ifdef _MSC_VER
@@ -66,21 +71,25 @@ static inline void *pcrbtree_recolor_to_black(void *const parent_color)
 #define pcrbtree_make_parent_color_right(p, c) pcrbtree_make_parent_color_(p, c | PCRB_RIGHT_CHILD)
 #define pcrbtree_make_parent_color_left(p, c)  pcrbtree_make_parent_color_(p, c | PCRB_LEFT_CHILD)
 
-PCRBTREE_EXPORTS void pcrbtree_rebalance(
+static inline void pcrbtree_rebalance_a_(
 	struct pcrbtree *const tree/*!=NULL*/,
 	struct pcrbtree_node *PCRBTREE_RESTRICT p/*!=NULL*/,
 	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/,
-	const int c)
+	const int c,
+	const struct pcrbtree_augment *const aug/*NULL?*/)
 {
-	/* insert red node e */
+	/* insert red node e, aug - NULL for not augmented tree */
 	unsigned is_right = (unsigned)(c < 0);
 	PCRBTREE_ASSERT_PTR(tree);
 	PCRBTREE_ASSERT_PTR(p);
 	PCRBTREE_ASSERT_PTR(e);
 	PCRBTREE_ASSERT_PTRS(p != e);
+	PCRB_STATS_INC(inserts);
 	p->u.leaves[is_right] = e;
 	(void)sizeof(int[1-2*(PCRB_RIGHT_CHILD != 1 || PCRB_LEFT_CHILD != 0)]);
 	e->parent_color = pcrbtree_make_parent_color_(p, is_right | PCRB_RED_COLOR);
+	if (aug)
+		(*aug->propagate)(e, (struct pcrbtree_node*)0);
 	while (PCRB_BLACK_COLOR != pcrbtree_get_color_(p)) {
 		/* there are 4 cases with red parent: (inserted node marked as * - push it up splitting the parent if necessary):
 		1)
@@ -133,11 +142,15 @@ PCRBTREE_EXPORTS void pcrbtree_rebalance(
 				if (t && PCRB_BLACK_COLOR != pcrbtree_get_color_(t)) {
 					t->parent_color = pcrbtree_make_parent_color_left(g, PCRB_BLACK_COLOR); /* recolor t: red -> black */
 					p->parent_color = pcrbtree_make_parent_color_right(g, PCRB_BLACK_COLOR); /* recolor p: red -> black */
+					PCRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_3_4]);
+					PCRB_STATS_ADD(insert_recolors, 2);
 					break; /* case 3,4 */
 				}
 				/* cases 1,2 */
 				if (!pcrbtree_is_right_(e)) {
 					/* case 2 */
+					PCRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_2]);
+					PCRB_STATS_INC(insert_rotations);
 					t = e->pcrbtree_right;
 					PCRBTREE_ASSERT_PTRS(t != e);
 					PCRBTREE_ASSERT_PTRS(t != g);
@@ -147,8 +160,12 @@ PCRBTREE_EXPORTS void pcrbtree_rebalance(
 					p->pcrbtree_left = t;
 					p->parent_color = pcrbtree_make_parent_color_right(e, PCRB_RED_COLOR);
 					e->pcrbtree_right = p;
+					if (aug)
+						(*aug->rotate)(p, e);
 					p = e;
 				}
+				else
+					PCRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_1]);
 				/* case 1 */
 				t = p->pcrbtree_left;
 				PCRBTREE_ASSERT_PTRS(t != e);
@@ -169,11 +186,15 @@ PCRBTREE_EXPORTS void pcrbtree_rebalance(
 				if (t && PCRB_BLACK_COLOR != pcrbtree_get_color_(t)) {
 					t->parent_color = pcrbtree_make_parent_color_right(g, PCRB_BLACK_COLOR); /* recolor t: red -> black */
 					p->parent_color = pcrbtree_make_parent_color_left(g, PCRB_BLACK_COLOR); /* recolor p: red -> black */
+					PCRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_3_4]);
+					PCRB_STATS_ADD(insert_recolors, 2);
 					break; /* case 3,4 */
 				}
 				/* cases 1,2 */
 				if (pcrbtree_is_right_(e)) {
 					/* case 2 */
+					PCRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_2]);
+					PCRB_STATS_INC(insert_rotations);
 					t = e->pcrbtree_left;
 					PCRBTREE_ASSERT_PTRS(t != e);
 					PCRBTREE_ASSERT_PTRS(t != g);
@@ -183,8 +204,12 @@ PCRBTREE_EXPORTS void pcrbtree_rebalance(
 					p->pcrbtree_right = t;
 					p->parent_color = pcrbtree_make_parent_color_left(e, PCRB_RED_COLOR);
 					e->pcrbtree_left = p;
+					if (aug)
+						(*aug->rotate)(p, e);
 					p = e;
 				}
+				else
+					PCRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_1]);
 				/* case 1 */
 				t = p->pcrbtree_right;
 				PCRBTREE_ASSERT_PTRS(t != e);
@@ -204,6 +229,10 @@ PCRBTREE_EXPORTS void pcrbtree_rebalance(
 			*pcrbtree_slot_at_parent_(tree, t, is_right) = p;
 			(void)sizeof(int[1-2*(PCRB_RIGHT_CHILD != 1 || PCRB_LEFT_CHILD != 0)]);
 			p->parent_color = pcrbtree_make_parent_color_(t, is_right | PCRB_BLACK_COLOR);
+			if (aug)
+				(*aug->rotate)(g, p);
+			PCRB_STATS_INC(insert_rotations);
+			PCRB_STATS_ADD(insert_recolors, 2);
 			return; /* (final) */
 		}
 		/* cases 3,4 */
@@ -211,6 +240,7 @@ PCRBTREE_EXPORTS void pcrbtree_rebalance(
 		if (!pc)
 			return;
 		g->parent_color = pcrbtree_recolor_to_red(pc); /* recolor g: black -> red */
+		PCRB_STATS_INC(insert_recolors);
 		p = pcrbtree_get_parent_(pc);
 		PCRBTREE_ASSERT_PTR(p);
 		PCRBTREE_ASSERT_PTRS(p != g);
@@ -218,6 +248,17 @@ PCRBTREE_EXPORTS void pcrbtree_rebalance(
 	}
 }
 
+PCRBTREE_EXPORTS void pcrbtree_rebalance(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT p/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/,
+	const int c)
+{
+	BTREE_PERF_BEGIN_(s);
+	pcrbtree_rebalance_a_(tree, p, e, c, (const struct pcrbtree_augment*)0);
+	BTREE_PERF_END_(BTREE_PERF_PCRBTREE_REBALANCE, s);
+}
+
 static inline void pcrbtree_replace_child(
 	struct pcrbtree *tree/*!=NULL*/,
 	void *pc,
@@ -231,10 +272,11 @@ static inline void pcrbtree_replace_child(
 	*pcrbtree_slot_at_parent_(tree, p, pcrbtree_is_right_1(pc)) = e;
 }
 
-static void pcrbtree_remove_(
+static inline void pcrbtree_remove_(
 	struct pcrbtree *const tree/*!=NULL*/,
 	struct pcrbtree_node *PCRBTREE_RESTRICT p/*!=NULL*/,
-	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/)
+	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/,
+	const struct pcrbtree_augment *const aug/*NULL?*/)
 {
 	/* after removing leaf black node, tree is disbalanced - balance the tree by moving black node from sibling side:
 
@@ -400,12 +442,17 @@ static void pcrbtree_remove_(
 						PCRBTREE_ASSERT_PTRS(b != e);
 						if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) { /* red on first iteration */
 							/* case 3 */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_3]);
+							PCRB_STATS_ADD(remove_recolors, 3);
 							b->parent_color = pcrbtree_make_parent_color_right(t, PCRB_BLACK_COLOR);
 							e->parent_color = pcrbtree_make_parent_color_left(t, PCRB_BLACK_COLOR);
 							p->parent_color = pcrbtree_make_parent_color_left(e, PCRB_RED_COLOR);
 						}
 						else {
 							/* case 2 */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+							PCRB_STATS_INC(remove_recolors);
+							PCRB_STATS_INC(remove_rotations);
 							b = e->pcrbtree_right; /* NULL on first iteration */
 							PCRBTREE_ASSERT_PTRS(b != p);
 							PCRBTREE_ASSERT_PTRS(b != t);
@@ -415,12 +462,16 @@ static void pcrbtree_remove_(
 							t->pcrbtree_left = b;
 							e->pcrbtree_right = t;
 							t->parent_color = pcrbtree_make_parent_color_right(e, PCRB_BLACK_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 							p->parent_color = pcrbtree_make_parent_color_left(e, PCRB_BLACK_COLOR);
 						}
 					}
 					else if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) { /* red on first iteration */
 						/* case 2 */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+						PCRB_STATS_INC(remove_recolors);
 						PCRBTREE_ASSERT_PTRS(b != e);
 						b->parent_color = pcrbtree_make_parent_color_right(t, PCRB_BLACK_COLOR); /* recolor: red -> black */
 						e = t;
@@ -428,6 +479,8 @@ static void pcrbtree_remove_(
 					}
 					else {
 						/* case 1 */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_1]);
+						PCRB_STATS_INC(remove_recolors);
 						e = p;
 						p = pcrbtree_get_parent_(pc); /* may be NULL */
 						PCRBTREE_ASSERT_PTRS(p != e);
@@ -441,6 +494,7 @@ static void pcrbtree_remove_(
 				}
 				else {
 					/* cases 4,5,6 with black parent */
+					PCRB_STATS_ADD(remove_recolors, 2);
 					PCRBTREE_ASSERT_PTR(e);
 #ifdef _MSC_VER
 					__assume(e);
@@ -459,12 +513,17 @@ static void pcrbtree_remove_(
 							PCRBTREE_ASSERT_PTRS(d != c);
 							if (d && PCRB_BLACK_COLOR != pcrbtree_get_color_(d)) { /* red on first iteration */
 								/* case 6 */
+								PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6]);
+								PCRB_STATS_ADD(remove_recolors, 3);
 								e->parent_color = pcrbtree_make_parent_color_left(t, PCRB_RED_COLOR);
 								d->parent_color = pcrbtree_make_parent_color_right(e, PCRB_BLACK_COLOR);
 								c->parent_color = pcrbtree_make_parent_color_left(e, PCRB_BLACK_COLOR);
 							}
 							else {
 								/* case 5 */
+								PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5]);
+								PCRB_STATS_ADD(remove_recolors, 2);
+								PCRB_STATS_INC(remove_rotations);
 								d = c->pcrbtree_right; /* NULL on first iteration */
 								PCRBTREE_ASSERT_PTRS(d != p);
 								PCRBTREE_ASSERT_PTRS(d != t);
@@ -477,20 +536,36 @@ static void pcrbtree_remove_(
 								t->pcrbtree_left = c;
 								e->parent_color = pcrbtree_make_parent_color_right(c, PCRB_RED_COLOR);
 								c->parent_color = pcrbtree_make_parent_color_left(t, PCRB_BLACK_COLOR);
+								if (aug)
+									(*aug->rotate)(e, c);
 							}
 							e = c;
 						}
+						else {
+							/* case 4 */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4]);
+						}
 					}
 					p->parent_color = pcrbtree_make_parent_color_left(e, PCRB_RED_COLOR);
 				}
 				pcrbtree_replace_child(tree, pc, t);
-				t = e->pcrbtree_left; /* NULL on first iteration */
-				PCRBTREE_ASSERT_PTRS(t != p);
-				PCRBTREE_ASSERT_PTRS(t != e);
-				if (t)
-					t->parent_color = pcrbtree_make_parent_color_right(p, PCRB_BLACK_COLOR);
-				p->pcrbtree_right = t;
-				e->pcrbtree_left = p; /* cases 4,5 */
+				{
+					struct pcrbtree_node *PCRBTREE_RESTRICT const q = e->pcrbtree_left; /* NULL on first iteration */
+					PCRBTREE_ASSERT_PTRS(q != p);
+					PCRBTREE_ASSERT_PTRS(q != t);
+					PCRBTREE_ASSERT_PTRS(q != e);
+					if (q)
+						q->parent_color = pcrbtree_make_parent_color_right(p, PCRB_BLACK_COLOR);
+					p->pcrbtree_right = q;
+					e->pcrbtree_left = p; /* cases 4,5 */
+				}
+				PCRB_STATS_INC(remove_rotations);
+				if (aug) {
+					/* t has replaced p, e - is the parent of p */
+					(*aug->rotate)(p, t);
+					if (t != e)
+						(*aug->propagate)(e, t);
+				}
 			}
 			else {
 				struct pcrbtree_node *PCRBTREE_RESTRICT t = p->pcrbtree_left;
@@ -510,12 +585,17 @@ static void pcrbtree_remove_(
 						PCRBTREE_ASSERT_PTRS(b != e);
 						if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) { /* red on first iteration */
 							/* case 3 */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_3]);
+							PCRB_STATS_ADD(remove_recolors, 3);
 							b->parent_color = pcrbtree_make_parent_color_left(t, PCRB_BLACK_COLOR);
 							e->parent_color = pcrbtree_make_parent_color_right(t, PCRB_BLACK_COLOR);
 							p->parent_color = pcrbtree_make_parent_color_right(e, PCRB_RED_COLOR);
 						}
 						else {
 							/* case 2 */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+							PCRB_STATS_INC(remove_recolors);
+							PCRB_STATS_INC(remove_rotations);
 							b = e->pcrbtree_left; /* NULL on first iteration */
 							PCRBTREE_ASSERT_PTRS(b != p);
 							PCRBTREE_ASSERT_PTRS(b != t);
@@ -525,12 +605,16 @@ static void pcrbtree_remove_(
 							t->pcrbtree_right = b;
 							e->pcrbtree_left = t;
 							t->parent_color = pcrbtree_make_parent_color_left(e, PCRB_BLACK_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 							p->parent_color = pcrbtree_make_parent_color_right(e, PCRB_BLACK_COLOR);
 						}
 					}
 					else if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) { /* red on first iteration */
 						/* case 2 */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+						PCRB_STATS_INC(remove_recolors);
 						PCRBTREE_ASSERT_PTRS(b != e);
 						b->parent_color = pcrbtree_make_parent_color_left(t, PCRB_BLACK_COLOR); /* recolor: red -> black */
 						e = t;
@@ -538,6 +622,8 @@ static void pcrbtree_remove_(
 					}
 					else {
 						/* case 1 */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_1]);
+						PCRB_STATS_INC(remove_recolors);
 						e = p;
 						p = pcrbtree_get_parent_(pc); /* may be NULL */
 						PCRBTREE_ASSERT_PTRS(p != e);
@@ -551,6 +637,7 @@ static void pcrbtree_remove_(
 				}
 				else {
 					/* cases 4,5,6 with black parent */
+					PCRB_STATS_ADD(remove_recolors, 2);
 					PCRBTREE_ASSERT_PTR(e);
 #ifdef _MSC_VER
 					__assume(e);
@@ -569,12 +656,17 @@ static void pcrbtree_remove_(
 							PCRBTREE_ASSERT_PTRS(d != c);
 							if (d && PCRB_BLACK_COLOR != pcrbtree_get_color_(d)) { /* red on first iteration */
 								/* case 6 */
+								PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6]);
+								PCRB_STATS_ADD(remove_recolors, 3);
 								e->parent_color = pcrbtree_make_parent_color_right(t, PCRB_RED_COLOR);
 								d->parent_color = pcrbtree_make_parent_color_left(e, PCRB_BLACK_COLOR);
 								c->parent_color = pcrbtree_make_parent_color_right(e, PCRB_BLACK_COLOR);
 							}
 							else {
 								/* case 5 */
+								PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5]);
+								PCRB_STATS_ADD(remove_recolors, 2);
+								PCRB_STATS_INC(remove_rotations);
 								d = c->pcrbtree_left; /* NULL on first iteration */
 								PCRBTREE_ASSERT_PTRS(d != p);
 								PCRBTREE_ASSERT_PTRS(d != t);
@@ -587,20 +679,36 @@ static void pcrbtree_remove_(
 								t->pcrbtree_right = c;
 								e->parent_color = pcrbtree_make_parent_color_left(c, PCRB_RED_COLOR);
 								c->parent_color = pcrbtree_make_parent_color_right(t, PCRB_BLACK_COLOR);
+								if (aug)
+									(*aug->rotate)(e, c);
 							}
 							e = c;
 						}
+						else {
+							/* case 4 */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4]);
+						}
 					}
 					p->parent_color = pcrbtree_make_parent_color_right(e, PCRB_RED_COLOR);
 				}
 				pcrbtree_replace_child(tree, pc, t);
-				t = e->pcrbtree_right; /* NULL on first iteration */
-				PCRBTREE_ASSERT_PTRS(t != p);
-				PCRBTREE_ASSERT_PTRS(t != e);
-				if (t)
-					t->parent_color = pcrbtree_make_parent_color_left(p, PCRB_BLACK_COLOR);
-				p->pcrbtree_left = t;
-				e->pcrbtree_right = p; /* cases 4,5 */
+				{
+					struct pcrbtree_node *PCRBTREE_RESTRICT const q = e->pcrbtree_right; /* NULL on first iteration */
+					PCRBTREE_ASSERT_PTRS(q != p);
+					PCRBTREE_ASSERT_PTRS(q != t);
+					PCRBTREE_ASSERT_PTRS(q != e);
+					if (q)
+						q->parent_color = pcrbtree_make_parent_color_left(p, PCRB_BLACK_COLOR);
+					p->pcrbtree_left = q;
+					e->pcrbtree_right = p; /* cases 4,5 */
+				}
+				PCRB_STATS_INC(remove_rotations);
+				if (aug) {
+					/* t has replaced p, e - is the parent of p */
+					(*aug->rotate)(p, t);
+					if (t != e)
+						(*aug->propagate)(e, t);
+				}
 			}
 		}
 		else {
@@ -629,12 +737,17 @@ static void pcrbtree_remove_(
 						PCRBTREE_ASSERT_PTRS(b != e);
 						if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) {
 							/* cases 6,9 (12:6,15:9) */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6_9]);
+							PCRB_STATS_ADD(remove_recolors, 3);
 							t->parent_color = pc;
 							b->parent_color = pcrbtree_make_parent_color_right(t, PCRB_BLACK_COLOR);
 							e->parent_color = pcrbtree_make_parent_color_left(t, PCRB_BLACK_COLOR);
 						}
 						else {
 							/* cases 5,8 (11:5,14:8) */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
+							PCRB_STATS_ADD(remove_recolors, 2);
+							PCRB_STATS_INC(remove_rotations);
 							b = e->pcrbtree_right; /* NULL on first iteration */
 							PCRBTREE_ASSERT_PTRS(b != p);
 							PCRBTREE_ASSERT_PTRS(b != g);
@@ -645,33 +758,48 @@ static void pcrbtree_remove_(
 							t->pcrbtree_left = b;
 							e->pcrbtree_right = t;
 							t->parent_color = pcrbtree_make_parent_color_right(e, PCRB_RED_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 							e->parent_color = pcrbtree_recolor_to_black(pc); /* recolor: red -> black */
 						}
 					}
 					else if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) {
 						/* cases 5,8 (11:5,14:8) */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
 						PCRBTREE_ASSERT_PTRS(b != e);
 						e = t;
 						e->parent_color = pcrbtree_recolor_to_black(pc); /* recolor: red -> black */
 					}
 					else {
 						/* cases 4,7 (10:4,13:7) */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4_7]);
+						PCRB_STATS_ADD(remove_recolors, 2);
 						t->parent_color = pcrbtree_make_parent_color_right(p, PCRB_RED_COLOR); /* recolor: black -> red */
 						p->parent_color = pcrbtree_recolor_to_black(pc); /* recolor: red -> black */
 						return;
 					}
 				}
 				g->u.leaves[pcrbtree_is_right_1(pc)] = t;
-				t = e->pcrbtree_left; /* NULL on first iteration */
-				PCRBTREE_ASSERT_PTRS(t != p);
-				PCRBTREE_ASSERT_PTRS(t != g);
-				PCRBTREE_ASSERT_PTRS(t != e);
-				if (t)
-					t->parent_color = pcrbtree_make_parent_color_right(p, PCRB_BLACK_COLOR);
-				p->pcrbtree_right = t;
-				p->parent_color = pcrbtree_make_parent_color_left(e, PCRB_RED_COLOR);
-				e->pcrbtree_left = p;
+				{
+					struct pcrbtree_node *PCRBTREE_RESTRICT const q = e->pcrbtree_left; /* NULL on first iteration */
+					PCRBTREE_ASSERT_PTRS(q != p);
+					PCRBTREE_ASSERT_PTRS(q != g);
+					PCRBTREE_ASSERT_PTRS(q != t);
+					PCRBTREE_ASSERT_PTRS(q != e);
+					if (q)
+						q->parent_color = pcrbtree_make_parent_color_right(p, PCRB_BLACK_COLOR);
+					p->pcrbtree_right = q;
+					p->parent_color = pcrbtree_make_parent_color_left(e, PCRB_RED_COLOR);
+					e->pcrbtree_left = p;
+				}
+				PCRB_STATS_INC(remove_rotations);
+				if (aug) {
+					/* t has replaced p, e - is the parent of p */
+					(*aug->rotate)(p, t);
+					if (t != e)
+						(*aug->propagate)(e, t);
+				}
 			}
 			else {
 				struct pcrbtree_node *PCRBTREE_RESTRICT t = p->pcrbtree_left;
@@ -694,12 +822,17 @@ static void pcrbtree_remove_(
 						PCRBTREE_ASSERT_PTRS(b != e);
 						if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) {
 							/* cases 6,9 (12:6,15:9) */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6_9]);
+							PCRB_STATS_ADD(remove_recolors, 3);
 							t->parent_color = pc;
 							b->parent_color = pcrbtree_make_parent_color_left(t, PCRB_BLACK_COLOR);
 							e->parent_color = pcrbtree_make_parent_color_right(t, PCRB_BLACK_COLOR);
 						}
 						else {
 							/* cases 5,8 (11:5,14:8) */
+							PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
+							PCRB_STATS_ADD(remove_recolors, 2);
+							PCRB_STATS_INC(remove_rotations);
 							b = e->pcrbtree_left; /* NULL on first iteration */
 							PCRBTREE_ASSERT_PTRS(b != p);
 							PCRBTREE_ASSERT_PTRS(b != g);
@@ -710,45 +843,64 @@ static void pcrbtree_remove_(
 							t->pcrbtree_right = b;
 							e->pcrbtree_left = t;
 							t->parent_color = pcrbtree_make_parent_color_left(e, PCRB_RED_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 							e->parent_color = pcrbtree_recolor_to_black(pc); /* recolor: red -> black */
 						}
 					}
 					else if (b && PCRB_BLACK_COLOR != pcrbtree_get_color_(b)) {
 						/* cases 5,8 (11:5,14:8) */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
 						PCRBTREE_ASSERT_PTRS(b != e);
 						e = t;
 						e->parent_color = pcrbtree_recolor_to_black(pc); /* recolor: red -> black */
 					}
 					else {
 						/* cases 4,7 (10:4,13:7) */
+						PCRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4_7]);
+						PCRB_STATS_ADD(remove_recolors, 2);
 						t->parent_color = pcrbtree_make_parent_color_left(p, PCRB_RED_COLOR); /* recolor: black -> red */
 						p->parent_color = pcrbtree_recolor_to_black(pc); /* recolor: red -> black */
 						return;
 					}
 				}
 				g->u.leaves[pcrbtree_is_right_1(pc)] = t;
-				t = e->pcrbtree_right; /* NULL on first iteration */
-				PCRBTREE_ASSERT_PTRS(t != p);
-				PCRBTREE_ASSERT_PTRS(t != g);
-				PCRBTREE_ASSERT_PTRS(t != e);
-				if (t)
-					t->parent_color = pcrbtree_make_parent_color_left(p, PCRB_BLACK_COLOR);
-				p->pcrbtree_left = t;
-				p->parent_color = pcrbtree_make_parent_color_right(e, PCRB_RED_COLOR);
-				e->pcrbtree_right = p;
+				{
+					struct pcrbtree_node *PCRBTREE_RESTRICT const q = e->pcrbtree_right; /* NULL on first iteration */
+					PCRBTREE_ASSERT_PTRS(q != p);
+					PCRBTREE_ASSERT_PTRS(q != g);
+					PCRBTREE_ASSERT_PTRS(q != t);
+					PCRBTREE_ASSERT_PTRS(q != e);
+					if (q)
+						q->parent_color = pcrbtree_make_parent_color_left(p, PCRB_BLACK_COLOR);
+					p->pcrbtree_left = q;
+					p->parent_color = pcrbtree_make_parent_color_right(e, PCRB_RED_COLOR);
+					e->pcrbtree_right = p;
+				}
+				PCRB_STATS_INC(remove_rotations);
+				if (aug) {
+					/* t has replaced p, e - is the parent of p */
+					(*aug->rotate)(p, t);
+					if (t != e)
+						(*aug->propagate)(e, t);
+				}
 			}
 		}
 		return;
 	}
 }
 
-PCRBTREE_EXPORTS void pcrbtree_remove(
+static inline void pcrbtree_remove_a_(
 	struct pcrbtree *const tree/*!=NULL*/,
-	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/)
+	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/,
+	const struct pcrbtree_augment *const aug/*NULL?*/)
 {
+	/* aug - NULL for not augmented tree */
+	struct pcrbtree_node *PCRBTREE_RESTRICT s; /* augmented data must be updated starting from this node */
 	struct pcrbtree_node *PCRBTREE_RESTRICT t = e->pcrbtree_right;
 	PCRBTREE_ASSERT_PTRS(t != e);
+	PCRB_STATS_INC(removes);
 	if (t) {
 		if (t->pcrbtree_left) {
 			do {
@@ -774,6 +926,7 @@ PCRBTREE_EXPORTS void pcrbtree_remove(
 				PCRBTREE_ASSERT_PTRS(r != p);
 				r->parent_color = pcrbtree_make_parent_color_left(p, PCRB_BLACK_COLOR); /* change parent & recolor node: red -> black */
 				p->pcrbtree_left = r;
+				s = p;
 				goto replace_;
 			}
 		}
@@ -792,6 +945,7 @@ PCRBTREE_EXPORTS void pcrbtree_remove(
 			PCRBTREE_ASSERT_PTRS(r != t);
 			r->parent_color = pcrbtree_make_parent_color_right(e, PCRB_BLACK_COLOR); /* change parent & recolor node: red -> black */
 			e->pcrbtree_right = r;
+			s = t;
 			goto replace_;
 		}
 	}
@@ -805,6 +959,7 @@ PCRBTREE_EXPORTS void pcrbtree_remove(
 			 |2,R*   |
 			 --------- */
 			e->pcrbtree_left = (struct pcrbtree_node*)0;
+			s = t;
 			goto replace_;
 		}
 		t = e;
@@ -820,11 +975,900 @@ PCRBTREE_EXPORTS void pcrbtree_remove(
 		}
 		p->u.leaves[pcrbtree_is_right_(t)] = (struct pcrbtree_node*)0;
 		if (PCRB_BLACK_COLOR == pcrbtree_get_color_(t))
-			pcrbtree_remove_(tree, p, t); /* t - leaf black node */
+			pcrbtree_remove_(tree, p, t, aug); /* t - leaf black node */
+		s = (p != e) ? p : t;
 	}
 	if (e) {
 replace_:
 		PCRBTREE_ASSERT_PTRS(t != e);
 		pcrbtree_replace(tree, e, t); /* replace e with t */
+		if (aug)
+			(*aug->copy)(e, t);
+	}
+	if (aug)
+		(*aug->propagate)(s, (struct pcrbtree_node*)0);
+}
+
+PCRBTREE_EXPORTS void pcrbtree_remove(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/)
+{
+	BTREE_PERF_BEGIN_(s);
+	pcrbtree_remove_a_(tree, e, (const struct pcrbtree_augment*)0);
+	BTREE_PERF_END_(BTREE_PERF_PCRBTREE_REMOVE, s);
+}
+
+PCRBTREE_EXPORTS void pcrbtree_insert_augmented(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const p/*NULL?*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const e/*!=NULL*/,
+	const int c,
+	const struct pcrbtree_augment *const aug/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(tree);
+	PCRBTREE_ASSERT_PTR(e);
+	PCRBTREE_ASSERT_PTR(aug);
+	PCRBTREE_ASSERT_PTRS(p != e);
+	pcrbtree_check_new_node(e); /* new node must have NULL children and parent */
+	if (p) {
+		PCRBTREE_ASSERT(!p->u.leaves[c < 0]);
+		pcrbtree_rebalance_a_(tree, p, e, c, aug);
+	}
+	else {
+		PCRBTREE_ASSERT(!tree->root);
+		PCRB_STATS_INC(inserts);
+		tree->root = e; /* black node */
+		(*aug->propagate)(e, (struct pcrbtree_node*)0);
+	}
+}
+
+PCRBTREE_EXPORTS void pcrbtree_remove_augmented(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT e/*!=NULL*/,
+	const struct pcrbtree_augment *const aug/*!=NULL*/)
+{
+	PCRBTREE_ASSERT_PTR(aug);
+	pcrbtree_remove_a_(tree, e, aug);
+}
+
+/* link nodes of sorted array into a subtree, returns the root of the subtree,
+  red_depth - depth of red nodes relative to the root of the subtree (1 - the root itself) */
+static struct pcrbtree_node *pcrbtree_build_sorted_(
+	struct pcrbtree_node *const p/*NULL?*/,
+	const unsigned is_right/*0,1*/,
+	struct pcrbtree_node *const nodes[]/*!=NULL*/,
+	const size_t count/*>0*/,
+	const size_t red_depth)
+{
+	/* left subtree gets count/2 nodes, right one - (count - 1)/2 nodes,
+	  so all NULL leaves are at two adjacent levels, nodes of the last
+	  (incomplete) level are colored red, all others - black */
+	const size_t m = count/2;
+	struct pcrbtree_node *const e = nodes[m];
+	PCRBTREE_ASSERT(count);
+	PCRBTREE_ASSERT_PTR(e);
+	e->parent_color = pcrbtree_make_parent_color_(p,
+		is_right | (1 == red_depth ? PCRB_RED_COLOR : PCRB_BLACK_COLOR));
+	e->pcrbtree_left = m ?
+		pcrbtree_build_sorted_(e, PCRB_LEFT_CHILD, nodes, m, red_depth - 1) : (struct pcrbtree_node*)0;
+	e->pcrbtree_right = count - m - 1 ?
+		pcrbtree_build_sorted_(e, PCRB_RIGHT_CHILD, nodes + m + 1, count - m - 1, red_depth - 1) : (struct pcrbtree_node*)0;
+	return e;
+}
+
+PCRBTREE_EXPORTS void pcrbtree_build_sorted(
+	struct pcrbtree *const tree/*!=NULL,out*/,
+	struct pcrbtree_node *const nodes[]/*!=NULL if count>0*/,
+	const size_t count)
+{
+	PCRBTREE_ASSERT_PTR(tree);
+	if (count) {
+		/* compute number of complete levels: floor(log2(count + 1)) */
+		size_t levels = 0;
+		while ((count + 1) >> (levels + 1))
+			levels++;
+		PCRBTREE_ASSERT_PTR(nodes);
+		/* levels >= 1, so the root is black */
+		tree->root = pcrbtree_build_sorted_((struct pcrbtree_node*)0, PCRB_LEFT_CHILD, nodes, count, levels + 1);
+	}
+	else
+		tree->root = (struct pcrbtree_node*)0;
+}
+
+/* find the parent for node e descending from node n,
+  parent - in: parent of n, out: parent for e,
+  c - side of n at the parent: < 0 - at right, > 0 - at left,
+  lohi - in/out: left and right in-order neighbours of the place of e,
+  returns 0 if found a node with the same key as e and leaf == 0,
+  else - side of e at the parent */
+static int pcrbtree_batch_descend_(
+	struct pcrbtree_node *n/*NULL?*/,
+	const struct pcrbtree_node *const e/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	const int leaf,
+	struct pcrbtree_node **const parent/*in,out*/,
+	int c,
+	struct pcrbtree_node *lohi[2]/*in,out*/)
+{
+	struct pcrbtree_node *p = *parent; /* NULL? */
+	while (n) {
+		c = (*comparator)(&n->u.n, &e->u.n); /* c = n - e */
+		if (!c) {
+			if (!leaf) {
+				*parent = n;
+				return 0;
+			}
+			c = 1; /* insert e before n */
+		}
+		p = n;
+		lohi[c > 0] = n;
+		n = n->u.leaves[c < 0];
+	}
+	*parent = p;
+	return c;
+}
+
+/* find the parent for node e which must be placed after (d == 1) or before (d == 0) node v,
+  climbing up from v until the first node which key is greater than (d == 1) or less than (d == 0)
+  the key of e, then descending, see pcrbtree_batch_descend_() */
+static int pcrbtree_batch_climb_(
+	struct pcrbtree_node *v/*!=NULL*/,
+	const struct pcrbtree_node *const e/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	const int leaf,
+	const unsigned d/*0,1*/,
+	struct pcrbtree_node **const parent/*out*/,
+	struct pcrbtree_node *lohi[2]/*out*/)
+{
+	struct pcrbtree_node *q;
+	for (;;) {
+		/* skip parents which are before (d == 1) or after (d == 0) v */
+		const struct pcrbtree_node *w = v;
+		for (;;) {
+			q = pcrbtree_get_parent(w);
+			if (!q || d != pcrbtree_is_right_(w))
+				break;
+			w = q;
+		}
+		if (!q)
+			break;
+		{
+			const int c = (*comparator)(&q->u.n, &e->u.n); /* c = q - e */
+			if (!c) {
+				if (!leaf) {
+					*parent = q;
+					return 0;
+				}
+				break; /* insert e between v and q */
+			}
+			if (d ? c > 0 : c < 0)
+				break; /* e is between v and q */
+		}
+		v = q;
+	}
+	lohi[!d] = v;
+	lohi[d] = q; /* NULL? */
+	*parent = v;
+	return pcrbtree_batch_descend_(v->u.leaves[d], e, comparator, leaf, parent, d ? -1 : 1, lohi);
+}
+
+PCRBTREE_EXPORTS size_t pcrbtree_insert_batch(
+	struct pcrbtree *const tree/*!=NULL*/,
+	struct pcrbtree_node *const nodes[]/*!=NULL if count>0*/,
+	const size_t count,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	const int leaf)
+{
+	struct pcrbtree_node *f = (struct pcrbtree_node*)0; /* finger - the last inserted node */
+	struct pcrbtree_node *lohi[2]; /* in-order neighbours of the finger */
+	size_t i = 0;
+	PCRBTREE_ASSERT_PTR(tree);
+	PCRBTREE_ASSERT(!count || nodes);
+	PCRBTREE_ASSERT_PTR(comparator);
+	for (; i < count; i++) {
+		struct pcrbtree_node *const e = nodes[i];
+		struct pcrbtree_node *p;
+		int c;
+		PCRBTREE_ASSERT_PTR(e);
+		if (!f) {
+			/* the first node: search from the root */
+			lohi[0] = lohi[1] = (struct pcrbtree_node*)0;
+			p = (struct pcrbtree_node*)0;
+			c = pcrbtree_batch_descend_(tree->root, e, comparator, leaf, &p, 1, lohi);
+		}
+		else {
+			c = (*comparator)(&f->u.n, &e->u.n); /* c = f - e */
+			if (!c && !leaf)
+				return i; /* duplicate */
+			{
+				/* d == 1 - e is after the finger, d == 0 - e is before the finger */
+				const unsigned d = c <= 0;
+				p = lohi[d]; /* NULL? */
+				if (p) {
+					c = (*comparator)(&p->u.n, &e->u.n); /* c = p - e */
+					if (!c && !leaf)
+						return i; /* duplicate */
+					if (d ? c < 0 : c > 0) {
+						/* e is not between the finger and its neighbour */
+						c = pcrbtree_batch_climb_(p, e, comparator, leaf, d, &p, lohi);
+						goto insert_;
+					}
+				}
+				/* e is between the finger and its neighbour */
+				if (f->u.leaves[d]) {
+					/* neighbour is the leftmost (d == 1) or the rightmost (d == 0) node
+					  of the finger's subtree, it has no left (d == 1) or right (d == 0) child */
+					PCRBTREE_ASSERT_PTR(p);
+					PCRBTREE_ASSERT(!p->u.leaves[!d]);
+					c = d ? 1 : -1;
+				}
+				else {
+					p = f;
+					c = d ? -1 : 1;
+				}
+				lohi[!d] = f;
+			}
+		}
+insert_:
+		if (!c)
+			return i; /* duplicate */
+		pcrbtree_insert(tree, p, e, c);
+		f = e;
+	}
+	return count;
+}
+
+/* split/join: black height of a subtree - number of black nodes on any path
+  from the root of the subtree down to a NULL leaf, including the root */
+
+#ifdef _OPENMP
+/* set operations: subtrees with black height <= cutoff are processed by one thread */
+#ifndef PCRBTREE_PARALLEL_CUTOFF
+#define PCRBTREE_PARALLEL_CUTOFF 8
+#endif
+#endif
+
+static inline int pcrbtree_is_red_(
+	const struct pcrbtree_node *const n/*NULL?*/)
+{
+	return n && PCRB_BLACK_COLOR != pcrbtree_get_color_(n);
+}
+
+/* compute black height of the tree walking down its left spine */
+static size_t pcrbtree_black_height_(
+	const struct pcrbtree_node *n/*NULL?*/)
+{
+	size_t h = 0;
+	for (; n; n = n->pcrbtree_left)
+		h += !pcrbtree_is_red_(n);
+	return h;
+}
+
+/* join subtrees l and r using pivot node k: l < k < r,
+  l, r - detached subtrees with black roots (parent == NULL), hl, hr - their black heights,
+  h - out: black height of the resulting tree, returns the root of the resulting tree */
+static struct pcrbtree_node *pcrbtree_join_(
+	struct pcrbtree_node *const l/*NULL?*/,
+	const size_t hl,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const k/*!=NULL*/,
+	struct pcrbtree_node *const r/*NULL?*/,
+	const size_t hr,
+	size_t *const h/*!=NULL,out*/)
+{
+	PCRBTREE_ASSERT_PTR(k);
+	PCRBTREE_ASSERT_PTRS(k != l);
+	PCRBTREE_ASSERT_PTRS(k != r);
+	PCRBTREE_ASSERT(!pcrbtree_is_red_(l) && !pcrbtree_is_red_(r));
+	if (hl == hr) {
+		/* k becomes the black root */
+		k->pcrbtree_left = l;
+		k->pcrbtree_right = r;
+		k->parent_color = pcrbtree_make_parent_color_((struct pcrbtree_node*)0, PCRB_BLACK_COLOR);
+		if (l)
+			l->parent_color = pcrbtree_make_parent_color_left(k, PCRB_BLACK_COLOR);
+		if (r)
+			r->parent_color = pcrbtree_make_parent_color_right(k, PCRB_BLACK_COLOR);
+		*h = hl + 1;
+		return k;
+	}
+	{
+		/* descend the spine of the taller subtree: right spine of l (d == 1) or left spine of r (d == 0)
+		  until a black node (or NULL) with the same black height as the shorter subtree */
+		const unsigned d = hl > hr;
+		struct pcrbtree tree;
+		struct pcrbtree_node *const s = d ? r : l; /* shorter subtree, NULL? */
+		const size_t hs = d ? hr : hl;
+		const size_t ht = d ? hl : hr;
+		size_t hx = ht;
+		struct pcrbtree_node *p = (struct pcrbtree_node*)0;
+		struct pcrbtree_node *x = d ? l : r;
+		int both_red;
+		tree.root = x;
+		while (hx > hs || pcrbtree_is_red_(x)) {
+			PCRBTREE_ASSERT_PTR(x);
+			hx -= !pcrbtree_is_red_(x);
+			p = x;
+			x = x->u.leaves[d];
+		}
+		PCRBTREE_ASSERT_PTR(p);
+		/* black height of the tree grows only if both children of the root are red and
+		  rebalancing recolors them black without rotation at the root (cases 3,4),
+		  check them before k is linked - k has no color yet: if p is the root, x (black or NULL)
+		  is checked in place of k, which is right - rebalancing stops at the black root */
+		both_red = pcrbtree_is_red_(tree.root->pcrbtree_left) && pcrbtree_is_red_(tree.root->pcrbtree_right);
+		/* link k in place of x as a red node with children x and s,
+		  note: pcrbtree_rebalance() re-links k to p */
+		k->u.leaves[!d] = x;
+		k->u.leaves[d] = s;
+		if (x)
+			x->parent_color = pcrbtree_make_parent_color_(k, (unsigned)!d | PCRB_BLACK_COLOR);
+		if (s)
+			s->parent_color = pcrbtree_make_parent_color_(k, d | PCRB_BLACK_COLOR);
+		p->u.leaves[d] = k;
+		pcrbtree_rebalance(&tree, p, k, d ? -1 : 1);
+		*h = ht + (both_red && tree.root == (d ? l : r) && !pcrbtree_is_red_(tree.root->pcrbtree_left));
+		return tree.root;
+	}
+}
+
+PCRBTREE_EXPORTS void pcrbtree_join(
+	struct pcrbtree *const left/*!=NULL,in,out*/,
+	struct pcrbtree_node *PCRBTREE_RESTRICT const pivot/*!=NULL*/,
+	struct pcrbtree *const right/*!=NULL,in,out*/)
+{
+	size_t h;
+	PCRBTREE_ASSERT_PTR(left);
+	PCRBTREE_ASSERT_PTR(pivot);
+	PCRBTREE_ASSERT_PTR(right);
+	PCRBTREE_ASSERT_PTRS(left != right);
+	left->root = pcrbtree_join_(left->root, pcrbtree_black_height_(left->root),
+		pivot, right->root, pcrbtree_black_height_(right->root), &h);
+	right->root = (struct pcrbtree_node*)0;
+}
+
+/* detached subtree and its black height */
+struct pcrbtree_part_ {
+	struct pcrbtree_node *root; /* NULL? */
+	size_t h;
+};
+
+/* detach subtree n from its parent, h - black height of the subtree,
+  if the root of the subtree is red, it becomes black */
+static inline struct pcrbtree_part_ pcrbtree_detach_(
+	struct pcrbtree_node *const n/*NULL?*/,
+	const size_t h)
+{
+	struct pcrbtree_part_ part;
+	part.root = n;
+	part.h = h;
+	if (n) {
+		part.h += pcrbtree_is_red_(n);
+		n->parent_color = pcrbtree_make_parent_color_((struct pcrbtree_node*)0, PCRB_BLACK_COLOR);
+	}
+	return part;
+}
+
+/* join parts l and r without pivot: the leftmost node of r is used as the pivot */
+static struct pcrbtree_part_ pcrbtree_concat_(
+	struct pcrbtree_part_ l,
+	struct pcrbtree_part_ r)
+{
+	if (!r.root)
+		return l;
+	if (l.root) {
+		struct pcrbtree tree;
+		struct pcrbtree_node *const m = pcrbtree_node_from_btree_node_(btree_first(&r.root->u.n));
+		tree.root = r.root;
+		pcrbtree_remove(&tree, m);
+		l.root = pcrbtree_join_(l.root, l.h, m, tree.root, pcrbtree_black_height_(tree.root), &l.h);
+		return l;
+	}
+	return r;
+}
+
+PCRBTREE_EXPORTS void pcrbtree_concat(
+	struct pcrbtree *const left/*!=NULL,in,out*/,
+	struct pcrbtree *const right/*!=NULL,in,out*/)
+{
+	struct pcrbtree_part_ l, r;
+	PCRBTREE_ASSERT_PTR(left);
+	PCRBTREE_ASSERT_PTR(right);
+	PCRBTREE_ASSERT_PTRS(left != right);
+	l.root = left->root;
+	l.h = pcrbtree_black_height_(l.root);
+	r.root = right->root;
+	r.h = pcrbtree_black_height_(r.root);
+	left->root = pcrbtree_concat_(l, r).root;
+	right->root = (struct pcrbtree_node*)0;
+}
+
+/* split: join subtrees hanging off the search path bottom-up, nodes of the path are used as pivots,
+  x - node of the search path to start from,
+  d - 1 if x goes to the left part (search path continues to the right of x), 0 - to the right part,
+  h - black height of the subtree of x on the search path,
+  parts - in/out: left and right parts built so far */
+static void pcrbtree_split_up_(
+	struct pcrbtree_node *x/*NULL?*/,
+	unsigned d,
+	size_t h,
+	struct pcrbtree_part_ parts[2]/*in,out*/)
+{
+	while (x) {
+		/* read links of x before it is re-linked as a pivot */
+		struct pcrbtree_node *const p = pcrbtree_get_parent(x); /* NULL? */
+		const unsigned pd = p && pcrbtree_is_right_(x);
+		const struct pcrbtree_part_ s = pcrbtree_detach_(x->u.leaves[!d], h);
+		h += !pcrbtree_is_red_(x);
+		if (d)
+			parts[0].root = pcrbtree_join_(s.root, s.h, x, parts[0].root, parts[0].h, &parts[0].h);
+		else
+			parts[1].root = pcrbtree_join_(parts[1].root, parts[1].h, x, s.root, s.h, &parts[1].h);
+		x = p;
+		d = pd;
+	}
+}
+
+PCRBTREE_EXPORTS void pcrbtree_split(
+	struct pcrbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	struct pcrbtree *const left/*!=NULL,out*/,
+	struct pcrbtree *const right/*!=NULL,out*/)
+{
+	struct pcrbtree_part_ parts[2] = {{(struct pcrbtree_node*)0, 0}, {(struct pcrbtree_node*)0, 0}};
+	struct pcrbtree_node *x;
+	PCRBTREE_ASSERT_PTR(tree);
+	PCRBTREE_ASSERT_PTR(key);
+	PCRBTREE_ASSERT_PTR(comparator);
+	PCRBTREE_ASSERT_PTR(left);
+	PCRBTREE_ASSERT_PTR(right);
+	x = tree->root;
+	if (x) {
+		for (;;) {
+			const int c = (*comparator)(&x->u.n, key); /* c = x - key */
+			struct pcrbtree_node *const n = x->u.leaves[c < 0]; /* NULL? */
+			if (!n) {
+				pcrbtree_split_up_(x, c < 0, 0, parts);
+				break;
+			}
+			x = n;
+		}
+	}
+	left->root = parts[0].root;
+	right->root = parts[1].root;
+}
+
+/* split detached subtree t by the key of node k: nodes with keys < key of k go to parts[0],
+  nodes with keys > key of k - to parts[1], returns the node with key equal to the key of k,
+  or NULL if there is no such node, keys in the subtree must be unique */
+static struct pcrbtree_node *pcrbtree_split3_(
+	struct pcrbtree_node *x/*NULL?*/,
+	const struct pcrbtree_node *const k/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	struct pcrbtree_part_ parts[2]/*out*/)
+{
+	parts[0].root = parts[1].root = (struct pcrbtree_node*)0;
+	parts[0].h = parts[1].h = 0;
+	if (x) {
+		for (;;) {
+			const int c = (*comparator)(&x->u.n, &k->u.n); /* c = x - k */
+			if (!c) {
+				/* x is excluded, its subtrees are the initial parts */
+				struct pcrbtree_node *const p = pcrbtree_get_parent(x); /* NULL? */
+				const unsigned pd = p && pcrbtree_is_right_(x);
+				const size_t h = pcrbtree_black_height_(x->pcrbtree_left);
+				parts[0] = pcrbtree_detach_(x->pcrbtree_left, h);
+				parts[1] = pcrbtree_detach_(x->pcrbtree_right, h);
+				pcrbtree_split_up_(p, pd, h + !pcrbtree_is_red_(x), parts);
+				return x;
+			}
+			{
+				struct pcrbtree_node *const n = x->u.leaves[c < 0]; /* NULL? */
+				if (!n) {
+					pcrbtree_split_up_(x, c < 0, 0, parts);
+					break;
+				}
+				x = n;
+			}
+		}
+	}
+	return (struct pcrbtree_node*)0;
+}
+
+/* union of parts a and b, nodes of b which keys are in a are deleted */
+static struct pcrbtree_part_ pcrbtree_union_(
+	struct pcrbtree_part_ a,
+	const struct pcrbtree_part_ b,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	if (!a.root)
+		return b;
+	if (b.root) {
+		/* root of a is the pivot, split b by its key */
+		struct pcrbtree_node *const k = a.root;
+		struct pcrbtree_part_ l = pcrbtree_detach_(k->pcrbtree_left, a.h - 1);
+		struct pcrbtree_part_ r = pcrbtree_detach_(k->pcrbtree_right, a.h - 1);
+		struct pcrbtree_part_ parts[2];
+		struct pcrbtree_node *const e = pcrbtree_split3_(b.root, k, comparator, parts);
+		PCRBTREE_ASSERT(!pcrbtree_is_red_(k));
+		if (e && deleter)
+			(*deleter)(&e->u.n, obj);
+#ifdef _OPENMP
+		if (a.h > PCRBTREE_PARALLEL_CUTOFF) {
+#pragma omp task shared(l, parts) firstprivate(comparator, deleter, obj)
+			l = pcrbtree_union_(l, parts[0], comparator, deleter, obj);
+			r = pcrbtree_union_(r, parts[1], comparator, deleter, obj);
+#pragma omp taskwait
+		}
+		else
+#endif
+		{
+			l = pcrbtree_union_(l, parts[0], comparator, deleter, obj);
+			r = pcrbtree_union_(r, parts[1], comparator, deleter, obj);
+		}
+		a.root = pcrbtree_join_(l.root, l.h, k, r.root, r.h, &a.h);
+	}
+	return a;
+}
+
+/* intersection of part a and read-only subtree b, nodes of a which keys are not in b are deleted */
+static struct pcrbtree_part_ pcrbtree_intersection_(
+	struct pcrbtree_part_ a,
+	const struct pcrbtree_node *const b/*NULL?*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	if (a.root) {
+		struct pcrbtree_part_ parts[2];
+		struct pcrbtree_node *e;
+		if (!b) {
+			if (deleter)
+				btree_delete_recursive(&a.root->u.n, obj, deleter);
+			a.root = (struct pcrbtree_node*)0;
+			a.h = 0;
+			return a;
+		}
+		/* node of b is the pivot, split a by its key */
+		e = pcrbtree_split3_(a.root, b, comparator, parts);
+#ifdef _OPENMP
+		if (a.h > PCRBTREE_PARALLEL_CUTOFF) {
+#pragma omp task shared(parts) firstprivate(b, comparator, deleter, obj)
+			parts[0] = pcrbtree_intersection_(parts[0], b->pcrbtree_left, comparator, deleter, obj);
+			parts[1] = pcrbtree_intersection_(parts[1], b->pcrbtree_right, comparator, deleter, obj);
+#pragma omp taskwait
+		}
+		else
+#endif
+		{
+			parts[0] = pcrbtree_intersection_(parts[0], b->pcrbtree_left, comparator, deleter, obj);
+			parts[1] = pcrbtree_intersection_(parts[1], b->pcrbtree_right, comparator, deleter, obj);
+		}
+		if (!e)
+			return pcrbtree_concat_(parts[0], parts[1]);
+		a.root = pcrbtree_join_(parts[0].root, parts[0].h, e, parts[1].root, parts[1].h, &a.h);
+	}
+	return a;
+}
+
+/* difference of part a and read-only subtree b, nodes of a which keys are in b are deleted */
+static struct pcrbtree_part_ pcrbtree_difference_(
+	struct pcrbtree_part_ a,
+	const struct pcrbtree_node *const b/*NULL?*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	if (a.root && b) {
+		/* node of b is the pivot, split a by its key */
+		struct pcrbtree_part_ parts[2];
+		struct pcrbtree_node *const e = pcrbtree_split3_(a.root, b, comparator, parts);
+		if (e && deleter)
+			(*deleter)(&e->u.n, obj);
+#ifdef _OPENMP
+		if (a.h > PCRBTREE_PARALLEL_CUTOFF) {
+#pragma omp task shared(parts) firstprivate(b, comparator, deleter, obj)
+			parts[0] = pcrbtree_difference_(parts[0], b->pcrbtree_left, comparator, deleter, obj);
+			parts[1] = pcrbtree_difference_(parts[1], b->pcrbtree_right, comparator, deleter, obj);
+#pragma omp taskwait
+		}
+		else
+#endif
+		{
+			parts[0] = pcrbtree_difference_(parts[0], b->pcrbtree_left, comparator, deleter, obj);
+			parts[1] = pcrbtree_difference_(parts[1], b->pcrbtree_right, comparator, deleter, obj);
+		}
+		return pcrbtree_concat_(parts[0], parts[1]);
 	}
+	return a;
+}
+
+/* make a part from the tree */
+static inline struct pcrbtree_part_ pcrbtree_part_(
+	struct pcrbtree_node *const root/*NULL?*/)
+{
+	struct pcrbtree_part_ part;
+	part.root = root;
+	part.h = pcrbtree_black_height_(root);
+	return part;
+}
+
+PCRBTREE_EXPORTS void pcrbtree_union(
+	struct pcrbtree *const tree1/*!=NULL,in,out*/,
+	struct pcrbtree *const tree2/*!=NULL,in,out*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	struct pcrbtree_part_ a;
+	PCRBTREE_ASSERT_PTR(tree1);
+	PCRBTREE_ASSERT_PTR(tree2);
+	PCRBTREE_ASSERT_PTR(comparator);
+	PCRBTREE_ASSERT_PTRS(tree1 != tree2);
+	a = pcrbtree_part_(tree1->root);
+#ifdef _OPENMP
+#pragma omp parallel shared(a) firstprivate(tree2, comparator, deleter, obj)
+#pragma omp single
+#endif
+	a = pcrbtree_union_(a, pcrbtree_part_(tree2->root), comparator, deleter, obj);
+	tree1->root = a.root;
+	tree2->root = (struct pcrbtree_node*)0;
+}
+
+PCRBTREE_EXPORTS void pcrbtree_intersection(
+	struct pcrbtree *const tree1/*!=NULL,in,out*/,
+	const struct pcrbtree *const tree2/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	struct pcrbtree_part_ a;
+	PCRBTREE_ASSERT_PTR(tree1);
+	PCRBTREE_ASSERT_PTR(tree2);
+	PCRBTREE_ASSERT_PTR(comparator);
+	PCRBTREE_ASSERT_PTRS(tree1 != tree2);
+	a = pcrbtree_part_(tree1->root);
+#ifdef _OPENMP
+#pragma omp parallel shared(a) firstprivate(tree2, comparator, deleter, obj)
+#pragma omp single
+#endif
+	a = pcrbtree_intersection_(a, tree2->root, comparator, deleter, obj);
+	tree1->root = a.root;
+}
+
+PCRBTREE_EXPORTS void pcrbtree_difference(
+	struct pcrbtree *const tree1/*!=NULL,in,out*/,
+	const struct pcrbtree *const tree2/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	struct pcrbtree_part_ a;
+	PCRBTREE_ASSERT_PTR(tree1);
+	PCRBTREE_ASSERT_PTR(tree2);
+	PCRBTREE_ASSERT_PTR(comparator);
+	PCRBTREE_ASSERT_PTRS(tree1 != tree2);
+	a = pcrbtree_part_(tree1->root);
+#ifdef _OPENMP
+#pragma omp parallel shared(a) firstprivate(tree2, comparator, deleter, obj)
+#pragma omp single
+#endif
+	a = pcrbtree_difference_(a, tree2->root, comparator, deleter, obj);
+	tree1->root = a.root;
+}
+
+/* relocation of nodes */
+
+struct pcrbtree_relocation_ {
+	char *buf;
+	size_t object_size;
+	size_t node_offset;
+	size_t placed;      /* number of nodes moved to the buffer */
+	btree_mover *mover;
+	struct btree_object *obj;
+};
+
+static inline struct pcrbtree_node *pcrbtree_relocated_(
+	const struct pcrbtree_relocation_ *const r/*!=NULL*/,
+	const size_t i)
+{
+	void *const n = r->buf + i*r->object_size + r->node_offset;
+	return (struct pcrbtree_node*)n;
+}
+
+/* move node e to the next place of the buffer, link it to the moved parent p via the slot,
+  children of the moved node still reference old nodes, returns the moved node */
+static struct pcrbtree_node *pcrbtree_relocate_node_(
+	struct pcrbtree_relocation_ *const r/*!=NULL*/,
+	struct pcrbtree_node *const e/*!=NULL*/,
+	struct pcrbtree_node **const slot/*!=NULL*/,
+	struct pcrbtree_node *const p/*NULL?*/)
+{
+	struct pcrbtree_node *const d = pcrbtree_relocated_(r, r->placed++);
+	struct pcrbtree_node *const left = e->pcrbtree_left;
+	struct pcrbtree_node *const right = e->pcrbtree_right;
+	const unsigned bits = pcrbtree_get_bits_(e);
+	PCRBTREE_ASSERT_PTRS(d != e);
+	(*r->mover)(&d->u.n, &e->u.n, r->obj);
+	d->pcrbtree_left = left;
+	d->pcrbtree_right = right;
+	d->parent_color = pcrbtree_make_parent_color_(p, bits);
+	*slot = d;
+	return d;
+}
+
+static void pcrbtree_relocate_veb_(
+	struct pcrbtree_relocation_ *const r/*!=NULL*/,
+	struct pcrbtree_node *const e/*!=NULL*/,
+	struct pcrbtree_node **const slot/*!=NULL*/,
+	struct pcrbtree_node *const p/*NULL?*/,
+	const size_t height/*>0*/);
+
+/* walk moved nodes of the top part of a subtree down to given depth,
+  move subtrees of old children of nodes at that depth */
+static void pcrbtree_relocate_bottoms_(
+	struct pcrbtree_relocation_ *const r/*!=NULL*/,
+	struct pcrbtree_node *const n/*!=NULL*/,
+	const size_t depth,
+	const size_t height/*>0*/)
+{
+	if (depth) {
+		if (n->pcrbtree_left)
+			pcrbtree_relocate_bottoms_(r, n->pcrbtree_left, depth - 1, height);
+		if (n->pcrbtree_right)
+			pcrbtree_relocate_bottoms_(r, n->pcrbtree_right, depth - 1, height);
+	}
+	else {
+		if (n->pcrbtree_left)
+			pcrbtree_relocate_veb_(r, n->pcrbtree_left, &n->pcrbtree_left, n, height);
+		if (n->pcrbtree_right)
+			pcrbtree_relocate_veb_(r, n->pcrbtree_right, &n->pcrbtree_right, n, height);
+	}
+}
+
+/* move nodes of the subtree at depths < height in van Emde Boas order:
+  first the top half of levels, then subtrees below it, from left to right */
+static void pcrbtree_relocate_veb_(
+	struct pcrbtree_relocation_ *const r/*!=NULL*/,
+	struct pcrbtree_node *const e/*!=NULL*/,
+	struct pcrbtree_node **const slot/*!=NULL*/,
+	struct pcrbtree_node *const p/*NULL?*/,
+	const size_t height/*>0*/)
+{
+	if (1 == height)
+		(void)pcrbtree_relocate_node_(r, e, slot, p);
+	else {
+		const size_t top = height/2;
+		pcrbtree_relocate_veb_(r, e, slot, p, top);
+		pcrbtree_relocate_bottoms_(r, *slot, top - 1, height - top);
+	}
+}
+
+PCRBTREE_EXPORTS size_t pcrbtree_relocate(
+	struct pcrbtree *const tree/*!=NULL,in,out*/,
+	void *const buf/*!=NULL if capacity>0*/,
+	const size_t capacity,
+	const size_t object_size,
+	const size_t node_offset,
+	const enum btree_layout layout,
+	btree_mover *const mover/*!=NULL*/,
+	struct btree_object *const obj)
+{
+	struct pcrbtree_relocation_ r;
+	size_t count;
+	PCRBTREE_ASSERT_PTR(tree);
+	PCRBTREE_ASSERT_PTR(mover);
+	count = btree_size(pcrbtree_node_to_btree_node_(tree->root));
+	if (!count || count > capacity)
+		return 0;
+	PCRBTREE_ASSERT_PTR(buf);
+	PCRBTREE_ASSERT(node_offset < object_size);
+	r.buf = (char*)buf;
+	r.object_size = object_size;
+	r.node_offset = node_offset;
+	r.placed = 0;
+	r.mover = mover;
+	r.obj = obj;
+	if (BTREE_LAYOUT_VEB == layout) {
+		pcrbtree_relocate_veb_(&r, tree->root, &tree->root, (struct pcrbtree_node*)0,
+			btree_height(pcrbtree_node_to_btree_node_(tree->root)));
+	}
+	else {
+		/* moved nodes form the queue of breadth-first traversal */
+		size_t i = 0;
+		(void)pcrbtree_relocate_node_(&r, tree->root, &tree->root, (struct pcrbtree_node*)0);
+		for (; i < r.placed; i++) {
+			struct pcrbtree_node *const n = pcrbtree_relocated_(&r, i);
+			if (n->pcrbtree_left)
+				(void)pcrbtree_relocate_node_(&r, n->pcrbtree_left, &n->pcrbtree_left, n);
+			if (n->pcrbtree_right)
+				(void)pcrbtree_relocate_node_(&r, n->pcrbtree_right, &n->pcrbtree_right, n);
+		}
+	}
+	PCRBTREE_ASSERT(r.placed == count);
+	return count;
+}
+
+/* pcitree: maintain maximum interval ends of subtrees */
+
+static inline void pcitree_update_max_end_(
+	struct pcrbtree_node *const n/*!=NULL*/)
+{
+	struct pcitree_node *const x = pcitree_node_from_pcrbtree_node_(n);
+	const struct pcitree_node *const l = pcitree_left_(x);
+	const struct pcitree_node *const r = pcitree_right_(x);
+	pcitree_point_t m = x->end;
+	if (l && m < l->max_end)
+		m = l->max_end;
+	if (r && m < r->max_end)
+		m = r->max_end;
+	x->max_end = m;
+}
+
+static void pcitree_propagate_(
+	struct pcrbtree_node *n/*!=NULL*/,
+	const struct pcrbtree_node *const stop/*NULL?*/)
+{
+	for (; n != stop; n = pcrbtree_get_parent(n))
+		pcitree_update_max_end_(n);
+}
+
+static void pcitree_rotate_(
+	struct pcrbtree_node *const o/*!=NULL*/,
+	struct pcrbtree_node *const n/*!=NULL*/)
+{
+	pcitree_node_from_pcrbtree_node_(n)->max_end = pcitree_node_from_pcrbtree_node_(o)->max_end;
+	pcitree_update_max_end_(o);
+}
+
+static void pcitree_copy_(
+	const struct pcrbtree_node *const o/*!=NULL*/,
+	struct pcrbtree_node *const n/*!=NULL*/)
+{
+	pcitree_node_from_pcrbtree_node_(n)->max_end = pcitree_node_from_pcrbtree_node_(o)->max_end;
+}
+
+static const struct pcrbtree_augment pcitree_augment_ = {
+	pcitree_propagate_,
+	pcitree_rotate_,
+	pcitree_copy_
+};
+
+PCRBTREE_EXPORTS void pcitree_insert(
+	struct pcitree *const tree/*!=NULL*/,
+	struct pcitree_node *PCRBTREE_RESTRICT const e/*!=NULL*/)
+{
+	struct pcrbtree t;
+	struct pcrbtree_node *p = (struct pcrbtree_node*)0;
+	int c = 0;
+	PCRBTREE_ASSERT_PTR(tree);
+	PCRBTREE_ASSERT_PTR(e);
+	PCRBTREE_ASSERT(!(e->end < e->start));
+	t.root = tree->root ? &tree->root->n : (struct pcrbtree_node*)0;
+	{
+		/* find the parent, c < 0: insert e at right of the parent, c > 0: at left */
+		struct pcrbtree_node *n = t.root;
+		while (n) {
+			p = n;
+			c = (e->start < pcitree_node_from_pcrbtree_node_(n)->start) ? 1 : -1;
+			n = n->u.leaves[c < 0];
+		}
+	}
+	pcrbtree_insert_augmented(&t, p, &e->n, c, &pcitree_augment_);
+	tree->root = pcitree_node_from_pcrbtree_node_(t.root);
+}
+
+PCRBTREE_EXPORTS void pcitree_remove(
+	struct pcitree *const tree/*!=NULL*/,
+	struct pcitree_node *PCRBTREE_RESTRICT e/*!=NULL*/)
+{
+	struct pcrbtree t;
+	PCRBTREE_ASSERT_PTR(tree);
+	PCRBTREE_ASSERT_PTR(tree->root);
+	PCRBTREE_ASSERT_PTR(e);
+	t.root = &tree->root->n;
+	pcrbtree_remove_augmented(&t, &e->n, &pcitree_augment_);
+	tree->root = pcitree_node_from_pcrbtree_node_(t.root); /* NULL? */
 }
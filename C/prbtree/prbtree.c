@@ -8,22 +8,31 @@
 
 #include "collections_config.h"
 #include "prbtree.h"
+#include "psrbtree.h"
 
 /* node color is stored in the lowest bit of parent pointer */
 #define PRB_RED_COLOR   1u
 #define PRB_BLACK_COLOR 0u
 
-PRBTREE_EXPORTS void prbtree_rebalance(
+/* count rebalancing statistics, see btree_stats.h */
+#define PRB_STATS_INC(field)    BTREE_STATS_INC_(BTREE_STATS_PRBTREE, field)
+#define PRB_STATS_ADD(field, n) BTREE_STATS_ADD_(BTREE_STATS_PRBTREE, field, n)
+
+static inline void prbtree_rebalance_a_(
 	struct prbtree *const tree/*!=NULL*/,
 	struct prbtree_node *PRBTREE_RESTRICT p/*!=NULL*/,
-	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/)
+	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/,
+	const struct prbtree_augment *const aug/*NULL?*/)
 {
-	/* insert red node e */
+	/* insert red node e, aug - NULL for not augmented tree */
 	PRBTREE_ASSERT_PTR(tree);
 	PRBTREE_ASSERT_PTR(p);
 	PRBTREE_ASSERT_PTR(e);
 	PRBTREE_ASSERT_PTRS(p != e);
+	PRB_STATS_INC(inserts);
 	e->parent_color = prbtree_make_parent_color_(p, PRB_RED_COLOR);
+	if (aug)
+		(*aug->propagate)(e, (struct prbtree_node*)0);
 	while (PRB_BLACK_COLOR != prbtree_get_color_(p)) {
 		/* there are 4 cases with red parent: (inserted node marked as * - push it up splitting the parent if necessary):
 		1)
@@ -76,6 +85,8 @@ PRBTREE_EXPORTS void prbtree_rebalance(
 				/* cases 1,2 */
 				if (p->prbtree_left == e) {
 					/* case 2 */
+					PRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_2]);
+					PRB_STATS_INC(insert_rotations);
 					t = e->prbtree_right;
 					PRBTREE_ASSERT_PTRS(t != e);
 					PRBTREE_ASSERT_PTRS(t != g);
@@ -85,8 +96,12 @@ PRBTREE_EXPORTS void prbtree_rebalance(
 					p->prbtree_left = t;
 					p->parent_color = prbtree_make_parent_color_(e, PRB_RED_COLOR);
 					e->prbtree_right = p;
+					if (aug)
+						(*aug->rotate)(p, e);
 					p = e;
 				}
+				else
+					PRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_1]);
 				/* case 1 */
 				t = p->prbtree_left;
 				PRBTREE_ASSERT_PTRS(t != e);
@@ -105,6 +120,8 @@ PRBTREE_EXPORTS void prbtree_rebalance(
 				/* cases 1,2 */
 				if (p->prbtree_left != e) {
 					/* case 2 */
+					PRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_2]);
+					PRB_STATS_INC(insert_rotations);
 					t = e->prbtree_left;
 					PRBTREE_ASSERT_PTRS(t != e);
 					PRBTREE_ASSERT_PTRS(t != g);
@@ -114,8 +131,12 @@ PRBTREE_EXPORTS void prbtree_rebalance(
 					p->prbtree_right = t;
 					p->parent_color = prbtree_make_parent_color_(e, PRB_RED_COLOR);
 					e->prbtree_left = p;
+					if (aug)
+						(*aug->rotate)(p, e);
 					p = e;
 				}
+				else
+					PRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_1]);
 				/* case 1 */
 				t = p->prbtree_right;
 				PRBTREE_ASSERT_PTRS(t != e);
@@ -132,25 +153,43 @@ PRBTREE_EXPORTS void prbtree_rebalance(
 			*prbtree_slot_at_parent_(tree, t, g) = p;
 			p->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 			g->parent_color = prbtree_make_parent_color_(p, PRB_RED_COLOR);
+			if (aug)
+				(*aug->rotate)(g, p);
+			PRB_STATS_INC(insert_rotations);
+			PRB_STATS_ADD(insert_recolors, 2);
 			return; /* (final) */
 		}
 		/* cases 3,4 */
 		PRBTREE_ASSERT_PTRS(t != p); /* note: duplicate check */
 		t->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR); /* recolor t: red -> black */
 		p->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR); /* recolor p: red -> black */
+		PRB_STATS_INC(insert_cases[BTREE_STATS_INSERT_3_4]);
+		PRB_STATS_ADD(insert_recolors, 2);
 		p = prbtree_black_node_parent_(g);
 		if (!p)
 			return;
 		PRBTREE_ASSERT_PTRS(p != g);
 		g->parent_color = prbtree_make_parent_color_(p, PRB_RED_COLOR); /* recolor g: black -> red */
+		PRB_STATS_INC(insert_recolors);
 		e = g;
 	}
 }
 
-static void prbtree_remove_(
+PRBTREE_EXPORTS void prbtree_rebalance(
 	struct prbtree *const tree/*!=NULL*/,
 	struct prbtree_node *PRBTREE_RESTRICT p/*!=NULL*/,
 	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/)
+{
+	BTREE_PERF_BEGIN_(s);
+	prbtree_rebalance_a_(tree, p, e, (const struct prbtree_augment*)0);
+	BTREE_PERF_END_(BTREE_PERF_PRBTREE_REBALANCE, s);
+}
+
+static inline void prbtree_remove_(
+	struct prbtree *const tree/*!=NULL*/,
+	struct prbtree_node *PRBTREE_RESTRICT p/*!=NULL*/,
+	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/,
+	const struct prbtree_augment *const aug/*NULL?*/)
 {
 	/* after removing leaf black node, tree is disbalanced - balance the tree by moving black node from sibling side:
 
@@ -317,11 +356,16 @@ static void prbtree_remove_(
 						PRBTREE_ASSERT_PTRS(b != e);
 						if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) { /* red on first iteration */
 							/* case 3 */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_3]);
+							PRB_STATS_ADD(remove_recolors, 2);
 							b->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 							e->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 						}
 						else {
 							/* case 2 */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+							PRB_STATS_INC(remove_recolors);
+							PRB_STATS_INC(remove_rotations);
 							b = e->prbtree_right; /* NULL on first iteration */
 							PRBTREE_ASSERT_PTRS(b != p);
 							PRBTREE_ASSERT_PTRS(b != t);
@@ -331,17 +375,23 @@ static void prbtree_remove_(
 							t->prbtree_left = b;
 							e->prbtree_right = t;
 							t->parent_color = prbtree_make_parent_color_(e, PRB_BLACK_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 						}
 					}
 					else if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) { /* red on first iteration */
 						/* case 2 */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+						PRB_STATS_INC(remove_recolors);
 						PRBTREE_ASSERT_PTRS(b != e);
 						b->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR); /* recolor: red -> black */
 						e = t;
 					}
 					else {
 						/* case 1 */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_1]);
+						PRB_STATS_INC(remove_recolors);
 						e = p;
 						p = prbtree_black_node_parent_(p); /* may be NULL */
 						PRBTREE_ASSERT_PTRS(p != e);
@@ -354,6 +404,7 @@ static void prbtree_remove_(
 				}
 				else {
 					/* cases 4,5,6 with black parent */
+					PRB_STATS_INC(remove_recolors);
 					PRBTREE_ASSERT_PTR(e);
 #ifdef _MSC_VER
 					__assume(e);
@@ -372,12 +423,17 @@ static void prbtree_remove_(
 							PRBTREE_ASSERT_PTRS(d != c);
 							if (d && PRB_BLACK_COLOR != prbtree_get_color_(d)) { /* red on first iteration */
 								/* case 6 */
+								PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6]);
+								PRB_STATS_ADD(remove_recolors, 3);
 								e->parent_color = prbtree_make_parent_color_(t, PRB_RED_COLOR);
 								d->parent_color = prbtree_make_parent_color_(e, PRB_BLACK_COLOR);
 								c->parent_color = prbtree_make_parent_color_(e, PRB_BLACK_COLOR);
 							}
 							else {
 								/* case 5 */
+								PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5]);
+								PRB_STATS_ADD(remove_recolors, 2);
+								PRB_STATS_INC(remove_rotations);
 								d = c->prbtree_right; /* NULL on first iteration */
 								PRBTREE_ASSERT_PTRS(d != p);
 								PRBTREE_ASSERT_PTRS(d != t);
@@ -390,9 +446,15 @@ static void prbtree_remove_(
 								t->prbtree_left = c;
 								e->parent_color = prbtree_make_parent_color_(c, PRB_RED_COLOR);
 								c->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
+								if (aug)
+									(*aug->rotate)(e, c);
 							}
 							e = c;
 						}
+						else {
+							/* case 4 */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4]);
+						}
 					}
 				}
 				{
@@ -420,11 +482,16 @@ static void prbtree_remove_(
 						PRBTREE_ASSERT_PTRS(b != e);
 						if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) { /* red on first iteration */
 							/* case 3 */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_3]);
+							PRB_STATS_ADD(remove_recolors, 2);
 							b->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 							e->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 						}
 						else {
 							/* case 2 */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+							PRB_STATS_INC(remove_recolors);
+							PRB_STATS_INC(remove_rotations);
 							b = e->prbtree_left; /* NULL on first iteration */
 							PRBTREE_ASSERT_PTRS(b != p);
 							PRBTREE_ASSERT_PTRS(b != t);
@@ -434,17 +501,23 @@ static void prbtree_remove_(
 							t->prbtree_right = b;
 							e->prbtree_left = t;
 							t->parent_color = prbtree_make_parent_color_(e, PRB_BLACK_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 						}
 					}
 					else if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) { /* red on first iteration */
 						/* case 2 */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_2]);
+						PRB_STATS_INC(remove_recolors);
 						PRBTREE_ASSERT_PTRS(b != e);
 						b->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR); /* recolor: red -> black */
 						e = t;
 					}
 					else {
 						/* case 1 */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_1]);
+						PRB_STATS_INC(remove_recolors);
 						e = p;
 						p = prbtree_black_node_parent_(p); /* may be NULL */
 						PRBTREE_ASSERT_PTRS(p != e);
@@ -457,6 +530,7 @@ static void prbtree_remove_(
 				}
 				else {
 					/* cases 4,5,6 with black parent */
+					PRB_STATS_INC(remove_recolors);
 					PRBTREE_ASSERT_PTR(e);
 #ifdef _MSC_VER
 					__assume(e);
@@ -475,12 +549,17 @@ static void prbtree_remove_(
 							PRBTREE_ASSERT_PTRS(d != c);
 							if (d && PRB_BLACK_COLOR != prbtree_get_color_(d)) { /* red on first iteration */
 								/* case 6 */
+								PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6]);
+								PRB_STATS_ADD(remove_recolors, 3);
 								e->parent_color = prbtree_make_parent_color_(t, PRB_RED_COLOR);
 								d->parent_color = prbtree_make_parent_color_(e, PRB_BLACK_COLOR);
 								c->parent_color = prbtree_make_parent_color_(e, PRB_BLACK_COLOR);
 							}
 							else {
 								/* case 5 */
+								PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5]);
+								PRB_STATS_ADD(remove_recolors, 2);
+								PRB_STATS_INC(remove_rotations);
 								d = c->prbtree_left; /* NULL on first iteration */
 								PRBTREE_ASSERT_PTRS(d != p);
 								PRBTREE_ASSERT_PTRS(d != t);
@@ -493,9 +572,15 @@ static void prbtree_remove_(
 								t->prbtree_right = c;
 								e->parent_color = prbtree_make_parent_color_(c, PRB_RED_COLOR);
 								c->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
+								if (aug)
+									(*aug->rotate)(e, c);
 							}
 							e = c;
 						}
+						else {
+							/* case 4 */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4]);
+						}
 					}
 				}
 				{
@@ -517,6 +602,7 @@ static void prbtree_remove_(
 				t->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR);
 				*prbtree_slot_at_parent_(tree, g, p) = t;
 			}
+			PRB_STATS_ADD(remove_recolors, t != e);
 			p_ = prbtree_make_parent_color_(e, t != e ? PRB_RED_COLOR : PRB_BLACK_COLOR);
 		}
 		else {
@@ -546,12 +632,17 @@ static void prbtree_remove_(
 						PRBTREE_ASSERT_PTRS(b != e);
 						if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) {
 							/* cases 6,9 (12:6,15:9) */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6_9]);
+							PRB_STATS_ADD(remove_recolors, 3);
 							t->parent_color = prbtree_make_parent_color_(g, PRB_RED_COLOR);
 							b->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 							e->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 						}
 						else {
 							/* cases 5,8 (11:5,14:8) */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
+							PRB_STATS_ADD(remove_recolors, 2);
+							PRB_STATS_INC(remove_rotations);
 							b = e->prbtree_right; /* NULL on first iteration */
 							PRBTREE_ASSERT_PTRS(b != p);
 							PRBTREE_ASSERT_PTRS(b != g);
@@ -562,18 +653,23 @@ static void prbtree_remove_(
 							t->prbtree_left = b;
 							e->prbtree_right = t;
 							t->parent_color = prbtree_make_parent_color_(e, PRB_RED_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 							e->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR);
 						}
 					}
 					else if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) {
 						/* cases 5,8 (11:5,14:8) */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
 						PRBTREE_ASSERT_PTRS(b != e);
 						e = t;
 						e->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR);
 					}
 					else {
 						/* cases 4,7 (10:4,13:7) */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4_7]);
+						PRB_STATS_ADD(remove_recolors, 2);
 						t->parent_color = prbtree_make_parent_color_(p, PRB_RED_COLOR);   /* recolor: black -> red */
 						p->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR); /* recolor: red -> black */
 						return;
@@ -607,12 +703,17 @@ static void prbtree_remove_(
 						PRBTREE_ASSERT_PTRS(b != e);
 						if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) {
 							/* cases 6,9 (12:6,15:9) */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_6_9]);
+							PRB_STATS_ADD(remove_recolors, 3);
 							t->parent_color = prbtree_make_parent_color_(g, PRB_RED_COLOR);
 							b->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 							e->parent_color = prbtree_make_parent_color_(t, PRB_BLACK_COLOR);
 						}
 						else {
 							/* cases 5,8 (11:5,14:8) */
+							PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
+							PRB_STATS_ADD(remove_recolors, 2);
+							PRB_STATS_INC(remove_rotations);
 							b = e->prbtree_left; /* NULL on first iteration */
 							PRBTREE_ASSERT_PTRS(b != p);
 							PRBTREE_ASSERT_PTRS(b != g);
@@ -623,18 +724,23 @@ static void prbtree_remove_(
 							t->prbtree_right = b;
 							e->prbtree_left = t;
 							t->parent_color = prbtree_make_parent_color_(e, PRB_RED_COLOR);
+							if (aug)
+								(*aug->rotate)(t, e);
 							t = e;
 							e->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR);
 						}
 					}
 					else if (b && PRB_BLACK_COLOR != prbtree_get_color_(b)) {
 						/* cases 5,8 (11:5,14:8) */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_5_8]);
 						PRBTREE_ASSERT_PTRS(b != e);
 						e = t;
 						e->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR);
 					}
 					else {
 						/* cases 4,7 (10:4,13:7) */
+						PRB_STATS_INC(remove_cases[BTREE_STATS_REMOVE_4_7]);
+						PRB_STATS_ADD(remove_recolors, 2);
 						t->parent_color = prbtree_make_parent_color_(p, PRB_RED_COLOR);   /* recolor: black -> red */
 						p->parent_color = prbtree_make_parent_color_(g, PRB_BLACK_COLOR); /* recolor: red -> black */
 						return;
@@ -658,17 +764,28 @@ static void prbtree_remove_(
 				g->prbtree_right = t; /* case 8,9 (14:8,15:9) */
 			p_ = prbtree_make_parent_color_(e, PRB_RED_COLOR);
 		}
+		PRB_STATS_INC(remove_rotations);
 		p->parent_color = p_;
+		if (aug) {
+			/* t has replaced p, e - is the parent of p */
+			(*aug->rotate)(p, t);
+			if (t != e)
+				(*aug->propagate)(e, t);
+		}
 		return;
 	}
 }
 
-PRBTREE_EXPORTS void prbtree_remove(
+static inline void prbtree_remove_a_(
 	struct prbtree *const tree/*!=NULL*/,
-	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/)
+	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/,
+	const struct prbtree_augment *const aug/*NULL?*/)
 {
+	/* aug - NULL for not augmented tree */
+	struct prbtree_node *PRBTREE_RESTRICT s; /* augmented data must be updated starting from this node */
 	struct prbtree_node *PRBTREE_RESTRICT t = e->prbtree_right;
 	PRBTREE_ASSERT_PTRS(t != e);
+	PRB_STATS_INC(removes);
 	if (t) {
 		if (t->prbtree_left) {
 			do {
@@ -694,6 +811,7 @@ PRBTREE_EXPORTS void prbtree_remove(
 				PRBTREE_ASSERT_PTRS(r != p);
 				r->parent_color = prbtree_make_parent_color_(p, PRB_BLACK_COLOR); /* change parent & recolor node: red -> black */
 				p->prbtree_left = r;
+				s = p;
 				goto replace_;
 			}
 		}
@@ -712,6 +830,7 @@ PRBTREE_EXPORTS void prbtree_remove(
 			PRBTREE_ASSERT_PTRS(r != t);
 			r->parent_color = prbtree_make_parent_color_(e, PRB_BLACK_COLOR); /* change parent & recolor node: red -> black */
 			e->prbtree_right = r;
+			s = t;
 			goto replace_;
 		}
 	}
@@ -725,6 +844,7 @@ PRBTREE_EXPORTS void prbtree_remove(
 			 |2,R*   |
 			 --------- */
 			e->prbtree_left = (struct prbtree_node*)0;
+			s = t;
 			goto replace_;
 		}
 		t = e;
@@ -738,12 +858,896 @@ PRBTREE_EXPORTS void prbtree_remove(
 			return;
 		}
 		if (PRB_BLACK_COLOR == prbtree_get_color_(t))
-			prbtree_remove_(tree, p, t); /* t - leaf black node */
+			prbtree_remove_(tree, p, t, aug); /* t - leaf black node */
 		p->u.leaves[t != p->prbtree_left] = (struct prbtree_node*)0;
+		s = (p != e) ? p : t;
 	}
 	if (t != e) {
 replace_:
 		PRBTREE_ASSERT_PTRS(t != e);
 		prbtree_replace(tree, e, t); /* replace e with t */
+		if (aug)
+			(*aug->copy)(e, t);
+	}
+	if (aug)
+		(*aug->propagate)(s, (struct prbtree_node*)0);
+}
+
+PRBTREE_EXPORTS void prbtree_remove(
+	struct prbtree *const tree/*!=NULL*/,
+	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/)
+{
+	BTREE_PERF_BEGIN_(s);
+	prbtree_remove_a_(tree, e, (const struct prbtree_augment*)0);
+	BTREE_PERF_END_(BTREE_PERF_PRBTREE_REMOVE, s);
+}
+
+PRBTREE_EXPORTS void prbtree_insert_augmented(
+	struct prbtree *const tree/*!=NULL*/,
+	struct prbtree_node *PRBTREE_RESTRICT const p/*NULL?*/,
+	struct prbtree_node *PRBTREE_RESTRICT const e/*!=NULL*/,
+	const int c,
+	const struct prbtree_augment *const aug/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT_PTR(e);
+	PRBTREE_ASSERT_PTR(aug);
+	PRBTREE_ASSERT_PTRS(p != e);
+	prbtree_check_new_node(e); /* new node must have NULL children and parent */
+	if (p) {
+		PRBTREE_ASSERT(!p->u.leaves[c < 0]);
+		p->u.leaves[c < 0] = e;
+		prbtree_rebalance_a_(tree, p, e, aug);
+	}
+	else {
+		PRBTREE_ASSERT(!tree->root);
+		PRB_STATS_INC(inserts);
+		tree->root = e; /* black node */
+		(*aug->propagate)(e, (struct prbtree_node*)0);
+	}
+}
+
+PRBTREE_EXPORTS void prbtree_remove_augmented(
+	struct prbtree *const tree/*!=NULL*/,
+	struct prbtree_node *PRBTREE_RESTRICT e/*!=NULL*/,
+	const struct prbtree_augment *const aug/*!=NULL*/)
+{
+	PRBTREE_ASSERT_PTR(aug);
+	prbtree_remove_a_(tree, e, aug);
+}
+
+/* link nodes of sorted array into a subtree, returns the root of the subtree,
+  red_depth - depth of red nodes relative to the root of the subtree (1 - the root itself) */
+static struct prbtree_node *prbtree_build_sorted_(
+	struct prbtree_node *const p/*NULL?*/,
+	struct prbtree_node *const nodes[]/*!=NULL*/,
+	const size_t count/*>0*/,
+	const size_t red_depth)
+{
+	/* left subtree gets count/2 nodes, right one - (count - 1)/2 nodes,
+	  so all NULL leaves are at two adjacent levels, nodes of the last
+	  (incomplete) level are colored red, all others - black */
+	const size_t m = count/2;
+	struct prbtree_node *const e = nodes[m];
+	PRBTREE_ASSERT(count);
+	PRBTREE_ASSERT_PTR(e);
+	PRBTREE_ASSERT_PTRS(p != e);
+	e->parent_color = prbtree_make_parent_color_(p, 1 == red_depth ? PRB_RED_COLOR : PRB_BLACK_COLOR);
+	e->prbtree_left = m ?
+		prbtree_build_sorted_(e, nodes, m, red_depth - 1) : (struct prbtree_node*)0;
+	e->prbtree_right = count - m - 1 ?
+		prbtree_build_sorted_(e, nodes + m + 1, count - m - 1, red_depth - 1) : (struct prbtree_node*)0;
+	return e;
+}
+
+PRBTREE_EXPORTS void prbtree_build_sorted(
+	struct prbtree *const tree/*!=NULL,out*/,
+	struct prbtree_node *const nodes[]/*!=NULL if count>0*/,
+	const size_t count)
+{
+	PRBTREE_ASSERT_PTR(tree);
+	if (count) {
+		/* compute number of complete levels: floor(log2(count + 1)) */
+		size_t levels = 0;
+		while ((count + 1) >> (levels + 1))
+			levels++;
+		PRBTREE_ASSERT_PTR(nodes);
+		/* levels >= 1, so the root is black */
+		tree->root = prbtree_build_sorted_((struct prbtree_node*)0, nodes, count, levels + 1);
+	}
+	else
+		tree->root = (struct prbtree_node*)0;
+}
+
+/* find the parent for node e descending from node n,
+  parent - in: parent of n, out: parent for e,
+  c - side of n at the parent: < 0 - at right, > 0 - at left,
+  lohi - in/out: left and right in-order neighbours of the place of e,
+  returns 0 if found a node with the same key as e and leaf == 0,
+  else - side of e at the parent */
+static int prbtree_batch_descend_(
+	struct prbtree_node *n/*NULL?*/,
+	const struct prbtree_node *const e/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	const int leaf,
+	struct prbtree_node **const parent/*in,out*/,
+	int c,
+	struct prbtree_node *lohi[2]/*in,out*/)
+{
+	struct prbtree_node *p = *parent; /* NULL? */
+	while (n) {
+		c = (*comparator)(&n->u.n, &e->u.n); /* c = n - e */
+		if (!c) {
+			if (!leaf) {
+				*parent = n;
+				return 0;
+			}
+			c = 1; /* insert e before n */
+		}
+		p = n;
+		lohi[c > 0] = n;
+		n = n->u.leaves[c < 0];
+	}
+	*parent = p;
+	return c;
+}
+
+/* find the parent for node e which must be placed after (d == 1) or before (d == 0) node v,
+  climbing up from v until the first node which key is greater than (d == 1) or less than (d == 0)
+  the key of e, then descending, see prbtree_batch_descend_() */
+static int prbtree_batch_climb_(
+	struct prbtree_node *v/*!=NULL*/,
+	const struct prbtree_node *const e/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	const int leaf,
+	const unsigned d/*0,1*/,
+	struct prbtree_node **const parent/*out*/,
+	struct prbtree_node *lohi[2]/*out*/)
+{
+	struct prbtree_node *q;
+	for (;;) {
+		/* skip parents which are before (d == 1) or after (d == 0) v */
+		const struct prbtree_node *w = v;
+		for (;;) {
+			q = prbtree_get_parent(w);
+			if (!q || w != q->u.leaves[d])
+				break;
+			w = q;
+		}
+		if (!q)
+			break;
+		{
+			const int c = (*comparator)(&q->u.n, &e->u.n); /* c = q - e */
+			if (!c) {
+				if (!leaf) {
+					*parent = q;
+					return 0;
+				}
+				break; /* insert e between v and q */
+			}
+			if (d ? c > 0 : c < 0)
+				break; /* e is between v and q */
+		}
+		v = q;
+	}
+	lohi[!d] = v;
+	lohi[d] = q; /* NULL? */
+	*parent = v;
+	return prbtree_batch_descend_(v->u.leaves[d], e, comparator, leaf, parent, d ? -1 : 1, lohi);
+}
+
+PRBTREE_EXPORTS size_t prbtree_insert_batch(
+	struct prbtree *const tree/*!=NULL*/,
+	struct prbtree_node *const nodes[]/*!=NULL if count>0*/,
+	const size_t count,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	const int leaf)
+{
+	struct prbtree_node *f = (struct prbtree_node*)0; /* finger - the last inserted node */
+	struct prbtree_node *lohi[2]; /* in-order neighbours of the finger */
+	size_t i = 0;
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT(!count || nodes);
+	PRBTREE_ASSERT_PTR(comparator);
+	for (; i < count; i++) {
+		struct prbtree_node *const e = nodes[i];
+		struct prbtree_node *p;
+		int c;
+		PRBTREE_ASSERT_PTR(e);
+		if (!f) {
+			/* the first node: search from the root */
+			lohi[0] = lohi[1] = (struct prbtree_node*)0;
+			p = (struct prbtree_node*)0;
+			c = prbtree_batch_descend_(tree->root, e, comparator, leaf, &p, 1, lohi);
+		}
+		else {
+			c = (*comparator)(&f->u.n, &e->u.n); /* c = f - e */
+			if (!c && !leaf)
+				return i; /* duplicate */
+			{
+				/* d == 1 - e is after the finger, d == 0 - e is before the finger */
+				const unsigned d = c <= 0;
+				p = lohi[d]; /* NULL? */
+				if (p) {
+					c = (*comparator)(&p->u.n, &e->u.n); /* c = p - e */
+					if (!c && !leaf)
+						return i; /* duplicate */
+					if (d ? c < 0 : c > 0) {
+						/* e is not between the finger and its neighbour */
+						c = prbtree_batch_climb_(p, e, comparator, leaf, d, &p, lohi);
+						goto insert_;
+					}
+				}
+				/* e is between the finger and its neighbour */
+				if (f->u.leaves[d]) {
+					/* neighbour is the leftmost (d == 1) or the rightmost (d == 0) node
+					  of the finger's subtree, it has no left (d == 1) or right (d == 0) child */
+					PRBTREE_ASSERT_PTR(p);
+					PRBTREE_ASSERT(!p->u.leaves[!d]);
+					c = d ? 1 : -1;
+				}
+				else {
+					p = f;
+					c = d ? -1 : 1;
+				}
+				lohi[!d] = f;
+			}
+		}
+insert_:
+		if (!c)
+			return i; /* duplicate */
+		prbtree_insert(tree, p, e, c);
+		f = e;
+	}
+	return count;
+}
+
+/* split/join: black height of a subtree - number of black nodes on any path
+  from the root of the subtree down to a NULL leaf, including the root */
+
+#ifdef _OPENMP
+/* set operations: subtrees with black height <= cutoff are processed by one thread */
+#ifndef PRBTREE_PARALLEL_CUTOFF
+#define PRBTREE_PARALLEL_CUTOFF 8
+#endif
+#endif
+
+static inline int prbtree_is_red_(
+	const struct prbtree_node *const n/*NULL?*/)
+{
+	return n && PRB_BLACK_COLOR != prbtree_get_color_(n);
+}
+
+/* compute black height of the tree walking down its left spine */
+static size_t prbtree_black_height_(
+	const struct prbtree_node *n/*NULL?*/)
+{
+	size_t h = 0;
+	for (; n; n = n->prbtree_left)
+		h += !prbtree_is_red_(n);
+	return h;
+}
+
+/* join subtrees l and r using pivot node k: l < k < r,
+  l, r - detached subtrees with black roots (parent == NULL), hl, hr - their black heights,
+  h - out: black height of the resulting tree, returns the root of the resulting tree */
+static struct prbtree_node *prbtree_join_(
+	struct prbtree_node *const l/*NULL?*/,
+	const size_t hl,
+	struct prbtree_node *PRBTREE_RESTRICT const k/*!=NULL*/,
+	struct prbtree_node *const r/*NULL?*/,
+	const size_t hr,
+	size_t *const h/*!=NULL,out*/)
+{
+	PRBTREE_ASSERT_PTR(k);
+	PRBTREE_ASSERT_PTRS(k != l);
+	PRBTREE_ASSERT_PTRS(k != r);
+	PRBTREE_ASSERT(!prbtree_is_red_(l) && !prbtree_is_red_(r));
+	if (hl == hr) {
+		/* k becomes the black root */
+		k->prbtree_left = l;
+		k->prbtree_right = r;
+		k->parent_color = prbtree_make_parent_color_((struct prbtree_node*)0, PRB_BLACK_COLOR);
+		if (l)
+			l->parent_color = prbtree_make_parent_color_(k, PRB_BLACK_COLOR);
+		if (r)
+			r->parent_color = prbtree_make_parent_color_(k, PRB_BLACK_COLOR);
+		*h = hl + 1;
+		return k;
+	}
+	{
+		/* descend the spine of the taller subtree: right spine of l (d == 1) or left spine of r (d == 0)
+		  until a black node (or NULL) with the same black height as the shorter subtree */
+		const unsigned d = hl > hr;
+		struct prbtree tree;
+		struct prbtree_node *const s = d ? r : l; /* shorter subtree, NULL? */
+		const size_t hs = d ? hr : hl;
+		const size_t ht = d ? hl : hr;
+		size_t hx = ht;
+		struct prbtree_node *p = (struct prbtree_node*)0;
+		struct prbtree_node *x = d ? l : r;
+		int both_red;
+		tree.root = x;
+		while (hx > hs || prbtree_is_red_(x)) {
+			PRBTREE_ASSERT_PTR(x);
+			hx -= !prbtree_is_red_(x);
+			p = x;
+			x = x->u.leaves[d];
+		}
+		PRBTREE_ASSERT_PTR(p);
+		/* black height of the tree grows only if both children of the root are red and
+		  rebalancing recolors them black without rotation at the root (cases 3,4),
+		  check them before k is linked - k has no color yet: if p is the root, x (black or NULL)
+		  is checked in place of k, which is right - rebalancing stops at the black root */
+		both_red = prbtree_is_red_(tree.root->prbtree_left) && prbtree_is_red_(tree.root->prbtree_right);
+		/* link k in place of x as a red node with children x and s */
+		k->u.leaves[!d] = x;
+		k->u.leaves[d] = s;
+		if (x)
+			x->parent_color = prbtree_make_parent_color_(k, PRB_BLACK_COLOR);
+		if (s)
+			s->parent_color = prbtree_make_parent_color_(k, PRB_BLACK_COLOR);
+		p->u.leaves[d] = k;
+		prbtree_rebalance(&tree, p, k);
+		*h = ht + (both_red && tree.root == (d ? l : r) && !prbtree_is_red_(tree.root->prbtree_left));
+		return tree.root;
+	}
+}
+
+PRBTREE_EXPORTS void prbtree_join(
+	struct prbtree *const left/*!=NULL,in,out*/,
+	struct prbtree_node *PRBTREE_RESTRICT const pivot/*!=NULL*/,
+	struct prbtree *const right/*!=NULL,in,out*/)
+{
+	size_t h;
+	PRBTREE_ASSERT_PTR(left);
+	PRBTREE_ASSERT_PTR(pivot);
+	PRBTREE_ASSERT_PTR(right);
+	PRBTREE_ASSERT_PTRS(left != right);
+	left->root = prbtree_join_(left->root, prbtree_black_height_(left->root),
+		pivot, right->root, prbtree_black_height_(right->root), &h);
+	right->root = (struct prbtree_node*)0;
+}
+
+/* detached subtree and its black height */
+struct prbtree_part_ {
+	struct prbtree_node *root; /* NULL? */
+	size_t h;
+};
+
+/* detach subtree n from its parent, h - black height of the subtree,
+  if the root of the subtree is red, it becomes black */
+static inline struct prbtree_part_ prbtree_detach_(
+	struct prbtree_node *const n/*NULL?*/,
+	const size_t h)
+{
+	struct prbtree_part_ part;
+	part.root = n;
+	part.h = h;
+	if (n) {
+		part.h += prbtree_is_red_(n);
+		n->parent_color = prbtree_make_parent_color_((struct prbtree_node*)0, PRB_BLACK_COLOR);
+	}
+	return part;
+}
+
+/* join parts l and r without pivot: the leftmost node of r is used as the pivot */
+static struct prbtree_part_ prbtree_concat_(
+	struct prbtree_part_ l,
+	struct prbtree_part_ r)
+{
+	if (!r.root)
+		return l;
+	if (l.root) {
+		struct prbtree tree;
+		struct prbtree_node *const m = prbtree_node_from_btree_node_(btree_first(&r.root->u.n));
+		tree.root = r.root;
+		prbtree_remove(&tree, m);
+		l.root = prbtree_join_(l.root, l.h, m, tree.root, prbtree_black_height_(tree.root), &l.h);
+		return l;
+	}
+	return r;
+}
+
+PRBTREE_EXPORTS void prbtree_concat(
+	struct prbtree *const left/*!=NULL,in,out*/,
+	struct prbtree *const right/*!=NULL,in,out*/)
+{
+	struct prbtree_part_ l, r;
+	PRBTREE_ASSERT_PTR(left);
+	PRBTREE_ASSERT_PTR(right);
+	PRBTREE_ASSERT_PTRS(left != right);
+	l.root = left->root;
+	l.h = prbtree_black_height_(l.root);
+	r.root = right->root;
+	r.h = prbtree_black_height_(r.root);
+	left->root = prbtree_concat_(l, r).root;
+	right->root = (struct prbtree_node*)0;
+}
+
+/* split: join subtrees hanging off the search path bottom-up, nodes of the path are used as pivots,
+  x - node of the search path to start from,
+  d - 1 if x goes to the left part (search path continues to the right of x), 0 - to the right part,
+  h - black height of the subtree of x on the search path,
+  parts - in/out: left and right parts built so far */
+static void prbtree_split_up_(
+	struct prbtree_node *x/*NULL?*/,
+	unsigned d,
+	size_t h,
+	struct prbtree_part_ parts[2]/*in,out*/)
+{
+	while (x) {
+		/* read links of x before it is re-linked as a pivot */
+		struct prbtree_node *const p = prbtree_get_parent(x); /* NULL? */
+		const unsigned pd = p && x != p->prbtree_left;
+		const struct prbtree_part_ s = prbtree_detach_(x->u.leaves[!d], h);
+		h += !prbtree_is_red_(x);
+		if (d)
+			parts[0].root = prbtree_join_(s.root, s.h, x, parts[0].root, parts[0].h, &parts[0].h);
+		else
+			parts[1].root = prbtree_join_(parts[1].root, parts[1].h, x, s.root, s.h, &parts[1].h);
+		x = p;
+		d = pd;
 	}
 }
+
+PRBTREE_EXPORTS void prbtree_split(
+	struct prbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	struct prbtree *const left/*!=NULL,out*/,
+	struct prbtree *const right/*!=NULL,out*/)
+{
+	struct prbtree_part_ parts[2] = {{(struct prbtree_node*)0, 0}, {(struct prbtree_node*)0, 0}};
+	struct prbtree_node *x;
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT_PTR(key);
+	PRBTREE_ASSERT_PTR(comparator);
+	PRBTREE_ASSERT_PTR(left);
+	PRBTREE_ASSERT_PTR(right);
+	x = tree->root;
+	if (x) {
+		for (;;) {
+			const int c = (*comparator)(&x->u.n, key); /* c = x - key */
+			struct prbtree_node *const n = x->u.leaves[c < 0]; /* NULL? */
+			if (!n) {
+				prbtree_split_up_(x, c < 0, 0, parts);
+				break;
+			}
+			x = n;
+		}
+	}
+	left->root = parts[0].root;
+	right->root = parts[1].root;
+}
+
+/* split detached subtree t by the key of node k: nodes with keys < key of k go to parts[0],
+  nodes with keys > key of k - to parts[1], returns the node with key equal to the key of k,
+  or NULL if there is no such node, keys in the subtree must be unique */
+static struct prbtree_node *prbtree_split3_(
+	struct prbtree_node *x/*NULL?*/,
+	const struct prbtree_node *const k/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	struct prbtree_part_ parts[2]/*out*/)
+{
+	parts[0].root = parts[1].root = (struct prbtree_node*)0;
+	parts[0].h = parts[1].h = 0;
+	if (x) {
+		for (;;) {
+			const int c = (*comparator)(&x->u.n, &k->u.n); /* c = x - k */
+			if (!c) {
+				/* x is excluded, its subtrees are the initial parts */
+				struct prbtree_node *const p = prbtree_get_parent(x); /* NULL? */
+				const unsigned pd = p && x != p->prbtree_left;
+				const size_t h = prbtree_black_height_(x->prbtree_left);
+				parts[0] = prbtree_detach_(x->prbtree_left, h);
+				parts[1] = prbtree_detach_(x->prbtree_right, h);
+				prbtree_split_up_(p, pd, h + !prbtree_is_red_(x), parts);
+				return x;
+			}
+			{
+				struct prbtree_node *const n = x->u.leaves[c < 0]; /* NULL? */
+				if (!n) {
+					prbtree_split_up_(x, c < 0, 0, parts);
+					break;
+				}
+				x = n;
+			}
+		}
+	}
+	return (struct prbtree_node*)0;
+}
+
+/* union of parts a and b, nodes of b which keys are in a are deleted */
+static struct prbtree_part_ prbtree_union_(
+	struct prbtree_part_ a,
+	const struct prbtree_part_ b,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	if (!a.root)
+		return b;
+	if (b.root) {
+		/* root of a is the pivot, split b by its key */
+		struct prbtree_node *const k = a.root;
+		struct prbtree_part_ l = prbtree_detach_(k->prbtree_left, a.h - 1);
+		struct prbtree_part_ r = prbtree_detach_(k->prbtree_right, a.h - 1);
+		struct prbtree_part_ parts[2];
+		struct prbtree_node *const e = prbtree_split3_(b.root, k, comparator, parts);
+		PRBTREE_ASSERT(!prbtree_is_red_(k));
+		if (e && deleter)
+			(*deleter)(&e->u.n, obj);
+#ifdef _OPENMP
+		if (a.h > PRBTREE_PARALLEL_CUTOFF) {
+#pragma omp task shared(l, parts) firstprivate(comparator, deleter, obj)
+			l = prbtree_union_(l, parts[0], comparator, deleter, obj);
+			r = prbtree_union_(r, parts[1], comparator, deleter, obj);
+#pragma omp taskwait
+		}
+		else
+#endif
+		{
+			l = prbtree_union_(l, parts[0], comparator, deleter, obj);
+			r = prbtree_union_(r, parts[1], comparator, deleter, obj);
+		}
+		a.root = prbtree_join_(l.root, l.h, k, r.root, r.h, &a.h);
+	}
+	return a;
+}
+
+/* intersection of part a and read-only subtree b, nodes of a which keys are not in b are deleted */
+static struct prbtree_part_ prbtree_intersection_(
+	struct prbtree_part_ a,
+	const struct prbtree_node *const b/*NULL?*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	if (a.root) {
+		struct prbtree_part_ parts[2];
+		struct prbtree_node *e;
+		if (!b) {
+			if (deleter)
+				btree_delete_recursive(&a.root->u.n, obj, deleter);
+			a.root = (struct prbtree_node*)0;
+			a.h = 0;
+			return a;
+		}
+		/* node of b is the pivot, split a by its key */
+		e = prbtree_split3_(a.root, b, comparator, parts);
+#ifdef _OPENMP
+		if (a.h > PRBTREE_PARALLEL_CUTOFF) {
+#pragma omp task shared(parts) firstprivate(b, comparator, deleter, obj)
+			parts[0] = prbtree_intersection_(parts[0], b->prbtree_left, comparator, deleter, obj);
+			parts[1] = prbtree_intersection_(parts[1], b->prbtree_right, comparator, deleter, obj);
+#pragma omp taskwait
+		}
+		else
+#endif
+		{
+			parts[0] = prbtree_intersection_(parts[0], b->prbtree_left, comparator, deleter, obj);
+			parts[1] = prbtree_intersection_(parts[1], b->prbtree_right, comparator, deleter, obj);
+		}
+		if (!e)
+			return prbtree_concat_(parts[0], parts[1]);
+		a.root = prbtree_join_(parts[0].root, parts[0].h, e, parts[1].root, parts[1].h, &a.h);
+	}
+	return a;
+}
+
+/* difference of part a and read-only subtree b, nodes of a which keys are in b are deleted */
+static struct prbtree_part_ prbtree_difference_(
+	struct prbtree_part_ a,
+	const struct prbtree_node *const b/*NULL?*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	if (a.root && b) {
+		/* node of b is the pivot, split a by its key */
+		struct prbtree_part_ parts[2];
+		struct prbtree_node *const e = prbtree_split3_(a.root, b, comparator, parts);
+		if (e && deleter)
+			(*deleter)(&e->u.n, obj);
+#ifdef _OPENMP
+		if (a.h > PRBTREE_PARALLEL_CUTOFF) {
+#pragma omp task shared(parts) firstprivate(b, comparator, deleter, obj)
+			parts[0] = prbtree_difference_(parts[0], b->prbtree_left, comparator, deleter, obj);
+			parts[1] = prbtree_difference_(parts[1], b->prbtree_right, comparator, deleter, obj);
+#pragma omp taskwait
+		}
+		else
+#endif
+		{
+			parts[0] = prbtree_difference_(parts[0], b->prbtree_left, comparator, deleter, obj);
+			parts[1] = prbtree_difference_(parts[1], b->prbtree_right, comparator, deleter, obj);
+		}
+		return prbtree_concat_(parts[0], parts[1]);
+	}
+	return a;
+}
+
+/* make a part from the tree */
+static inline struct prbtree_part_ prbtree_part_(
+	struct prbtree_node *const root/*NULL?*/)
+{
+	struct prbtree_part_ part;
+	part.root = root;
+	part.h = prbtree_black_height_(root);
+	return part;
+}
+
+PRBTREE_EXPORTS void prbtree_union(
+	struct prbtree *const tree1/*!=NULL,in,out*/,
+	struct prbtree *const tree2/*!=NULL,in,out*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	struct prbtree_part_ a;
+	PRBTREE_ASSERT_PTR(tree1);
+	PRBTREE_ASSERT_PTR(tree2);
+	PRBTREE_ASSERT_PTR(comparator);
+	PRBTREE_ASSERT_PTRS(tree1 != tree2);
+	a = prbtree_part_(tree1->root);
+#ifdef _OPENMP
+#pragma omp parallel shared(a) firstprivate(tree2, comparator, deleter, obj)
+#pragma omp single
+#endif
+	a = prbtree_union_(a, prbtree_part_(tree2->root), comparator, deleter, obj);
+	tree1->root = a.root;
+	tree2->root = (struct prbtree_node*)0;
+}
+
+PRBTREE_EXPORTS void prbtree_intersection(
+	struct prbtree *const tree1/*!=NULL,in,out*/,
+	const struct prbtree *const tree2/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	struct prbtree_part_ a;
+	PRBTREE_ASSERT_PTR(tree1);
+	PRBTREE_ASSERT_PTR(tree2);
+	PRBTREE_ASSERT_PTR(comparator);
+	PRBTREE_ASSERT_PTRS(tree1 != tree2);
+	a = prbtree_part_(tree1->root);
+#ifdef _OPENMP
+#pragma omp parallel shared(a) firstprivate(tree2, comparator, deleter, obj)
+#pragma omp single
+#endif
+	a = prbtree_intersection_(a, tree2->root, comparator, deleter, obj);
+	tree1->root = a.root;
+}
+
+PRBTREE_EXPORTS void prbtree_difference(
+	struct prbtree *const tree1/*!=NULL,in,out*/,
+	const struct prbtree *const tree2/*!=NULL*/,
+	btree_node_comparator *const comparator/*!=NULL*/,
+	btree_deleter *const deleter/*NULL?*/,
+	struct btree_object *const obj)
+{
+	struct prbtree_part_ a;
+	PRBTREE_ASSERT_PTR(tree1);
+	PRBTREE_ASSERT_PTR(tree2);
+	PRBTREE_ASSERT_PTR(comparator);
+	PRBTREE_ASSERT_PTRS(tree1 != tree2);
+	a = prbtree_part_(tree1->root);
+#ifdef _OPENMP
+#pragma omp parallel shared(a) firstprivate(tree2, comparator, deleter, obj)
+#pragma omp single
+#endif
+	a = prbtree_difference_(a, tree2->root, comparator, deleter, obj);
+	tree1->root = a.root;
+}
+
+/* relocation of nodes */
+
+struct prbtree_relocation_ {
+	char *buf;
+	size_t object_size;
+	size_t node_offset;
+	size_t placed;      /* number of nodes moved to the buffer */
+	btree_mover *mover;
+	struct btree_object *obj;
+};
+
+static inline struct prbtree_node *prbtree_relocated_(
+	const struct prbtree_relocation_ *const r/*!=NULL*/,
+	const size_t i)
+{
+	void *const n = r->buf + i*r->object_size + r->node_offset;
+	return (struct prbtree_node*)n;
+}
+
+/* move node e to the next place of the buffer, link it to the moved parent p via the slot,
+  children of the moved node still reference old nodes, returns the moved node */
+static struct prbtree_node *prbtree_relocate_node_(
+	struct prbtree_relocation_ *const r/*!=NULL*/,
+	struct prbtree_node *const e/*!=NULL*/,
+	struct prbtree_node **const slot/*!=NULL*/,
+	struct prbtree_node *const p/*NULL?*/)
+{
+	struct prbtree_node *const d = prbtree_relocated_(r, r->placed++);
+	struct prbtree_node *const left = e->prbtree_left;
+	struct prbtree_node *const right = e->prbtree_right;
+	const unsigned bits = prbtree_get_color_(e);
+	PRBTREE_ASSERT_PTRS(d != e);
+	(*r->mover)(&d->u.n, &e->u.n, r->obj);
+	d->prbtree_left = left;
+	d->prbtree_right = right;
+	d->parent_color = prbtree_make_parent_color_(p, bits);
+	*slot = d;
+	return d;
+}
+
+static void prbtree_relocate_veb_(
+	struct prbtree_relocation_ *const r/*!=NULL*/,
+	struct prbtree_node *const e/*!=NULL*/,
+	struct prbtree_node **const slot/*!=NULL*/,
+	struct prbtree_node *const p/*NULL?*/,
+	const size_t height/*>0*/);
+
+/* walk moved nodes of the top part of a subtree down to given depth,
+  move subtrees of old children of nodes at that depth */
+static void prbtree_relocate_bottoms_(
+	struct prbtree_relocation_ *const r/*!=NULL*/,
+	struct prbtree_node *const n/*!=NULL*/,
+	const size_t depth,
+	const size_t height/*>0*/)
+{
+	if (depth) {
+		if (n->prbtree_left)
+			prbtree_relocate_bottoms_(r, n->prbtree_left, depth - 1, height);
+		if (n->prbtree_right)
+			prbtree_relocate_bottoms_(r, n->prbtree_right, depth - 1, height);
+	}
+	else {
+		if (n->prbtree_left)
+			prbtree_relocate_veb_(r, n->prbtree_left, &n->prbtree_left, n, height);
+		if (n->prbtree_right)
+			prbtree_relocate_veb_(r, n->prbtree_right, &n->prbtree_right, n, height);
+	}
+}
+
+/* move nodes of the subtree at depths < height in van Emde Boas order:
+  first the top half of levels, then subtrees below it, from left to right */
+static void prbtree_relocate_veb_(
+	struct prbtree_relocation_ *const r/*!=NULL*/,
+	struct prbtree_node *const e/*!=NULL*/,
+	struct prbtree_node **const slot/*!=NULL*/,
+	struct prbtree_node *const p/*NULL?*/,
+	const size_t height/*>0*/)
+{
+	if (1 == height)
+		(void)prbtree_relocate_node_(r, e, slot, p);
+	else {
+		const size_t top = height/2;
+		prbtree_relocate_veb_(r, e, slot, p, top);
+		prbtree_relocate_bottoms_(r, *slot, top - 1, height - top);
+	}
+}
+
+PRBTREE_EXPORTS size_t prbtree_relocate(
+	struct prbtree *const tree/*!=NULL,in,out*/,
+	void *const buf/*!=NULL if capacity>0*/,
+	const size_t capacity,
+	const size_t object_size,
+	const size_t node_offset,
+	const enum btree_layout layout,
+	btree_mover *const mover/*!=NULL*/,
+	struct btree_object *const obj)
+{
+	struct prbtree_relocation_ r;
+	size_t count;
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT_PTR(mover);
+	count = btree_size(prbtree_node_to_btree_node_(tree->root));
+	if (!count || count > capacity)
+		return 0;
+	PRBTREE_ASSERT_PTR(buf);
+	PRBTREE_ASSERT(node_offset < object_size);
+	r.buf = (char*)buf;
+	r.object_size = object_size;
+	r.node_offset = node_offset;
+	r.placed = 0;
+	r.mover = mover;
+	r.obj = obj;
+	if (BTREE_LAYOUT_VEB == layout) {
+		prbtree_relocate_veb_(&r, tree->root, &tree->root, (struct prbtree_node*)0,
+			btree_height(prbtree_node_to_btree_node_(tree->root)));
+	}
+	else {
+		/* moved nodes form the queue of breadth-first traversal */
+		size_t i = 0;
+		(void)prbtree_relocate_node_(&r, tree->root, &tree->root, (struct prbtree_node*)0);
+		for (; i < r.placed; i++) {
+			struct prbtree_node *const n = prbtree_relocated_(&r, i);
+			if (n->prbtree_left)
+				(void)prbtree_relocate_node_(&r, n->prbtree_left, &n->prbtree_left, n);
+			if (n->prbtree_right)
+				(void)prbtree_relocate_node_(&r, n->prbtree_right, &n->prbtree_right, n);
+		}
+	}
+	PRBTREE_ASSERT(r.placed == count);
+	return count;
+}
+
+/* psrbtree: maintain sizes of subtrees */
+
+static inline void psrbtree_update_size_(
+	struct prbtree_node *const n/*!=NULL*/)
+{
+	psrbtree_node_from_prbtree_node_(n)->size =
+		psrbtree_size_(n->prbtree_left) + psrbtree_size_(n->prbtree_right) + 1;
+}
+
+static void psrbtree_propagate_(
+	struct prbtree_node *n/*!=NULL*/,
+	const struct prbtree_node *const stop/*NULL?*/)
+{
+	for (; n != stop; n = prbtree_get_parent(n))
+		psrbtree_update_size_(n);
+}
+
+static void psrbtree_rotate_(
+	struct prbtree_node *const o/*!=NULL*/,
+	struct prbtree_node *const n/*!=NULL*/)
+{
+	psrbtree_node_from_prbtree_node_(n)->size = psrbtree_node_from_prbtree_node_(o)->size;
+	psrbtree_update_size_(o);
+}
+
+static void psrbtree_copy_(
+	const struct prbtree_node *const o/*!=NULL*/,
+	struct prbtree_node *const n/*!=NULL*/)
+{
+	psrbtree_node_from_prbtree_node_(n)->size = psrbtree_node_from_prbtree_node_(o)->size;
+}
+
+static const struct prbtree_augment psrbtree_augment_ = {
+	psrbtree_propagate_,
+	psrbtree_rotate_,
+	psrbtree_copy_
+};
+
+PRBTREE_EXPORTS void psrbtree_insert(
+	struct psrbtree *const tree/*!=NULL*/,
+	struct psrbtree_node *PRBTREE_RESTRICT const p/*NULL?*/,
+	struct psrbtree_node *PRBTREE_RESTRICT const e/*!=NULL*/,
+	int c)
+{
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT_PTR(e);
+	PRBTREE_ASSERT_PTRS(p != e);
+	prbtree_check_new_node(&e->n); /* new node must have NULL children and parent */
+	e->size = 1;
+	if (p) {
+		struct prbtree t;
+		PRBTREE_ASSERT_PTR(tree->root);
+		PRBTREE_ASSERT(!p->n.u.leaves[c < 0]);
+		t.root = &tree->root->n;
+		p->n.u.leaves[c < 0] = &e->n;
+		prbtree_rebalance_a_(&t, &p->n, &e->n, &psrbtree_augment_);
+		tree->root = psrbtree_node_from_prbtree_node_(t.root);
+	}
+	else {
+		PRBTREE_ASSERT(!tree->root);
+		PRB_STATS_INC(inserts);
+		tree->root = e; /* black node */
+	}
+}
+
+PRBTREE_EXPORTS void psrbtree_remove(
+	struct psrbtree *const tree/*!=NULL*/,
+	struct psrbtree_node *PRBTREE_RESTRICT e/*!=NULL*/)
+{
+	struct prbtree t;
+	PRBTREE_ASSERT_PTR(tree);
+	PRBTREE_ASSERT_PTR(tree->root);
+	PRBTREE_ASSERT_PTR(e);
+	t.root = &tree->root->n;
+	prbtree_remove_a_(&t, &e->n, &psrbtree_augment_);
+	tree->root = psrbtree_node_from_prbtree_node_(t.root); /* NULL? */
+}
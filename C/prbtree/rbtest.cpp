@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <assert.h>
+#include <chrono>
 #include <map>
 
 #ifdef _MSC_VER
@@ -29,7 +30,28 @@
 #endif
 #endif
 
-#ifdef USE_PCRBTREE
+/* with -DBTREE_TRACE: pack components of struct tree_key_t into 64 bits, preserving order of keys:
+  a - high 32 bits (sign bit flipped), b - next 24 bits, c - low 8 bits,
+  keys of this test fit (0 <= b < 7, c == 0), for other values of b and c the trace would be lossy */
+#define BTREE_TRACE_KEY(key) ( \
+	((unsigned long long)((unsigned)(key).a ^ 0x80000000u) << 32) | \
+	((unsigned long long)((unsigned)(key).b & 0xFFFFFFu) << 8) | \
+	(unsigned long long)((unsigned)(key).c & 0xFFu))
+
+#ifdef USE_PSRBTREE
+#include "psrbtree.h"
+#define PRBTREE psrbtree
+#define PRBTREE_INIT psrbtree_init
+#define PRBTREE_NODE psrbtree_node
+#define PRBTREE_INIT_NODE psrbtree_init_node
+#define PRBTREE_GET_COLOR_ psrbtree_get_color_
+#define PRBTREE_GET_PARENT psrbtree_get_parent
+#define PRBTREE_NODE_FROM_BTREE_NODE_ psrbtree_node_from_btree_node_
+#define PRBTREE_NEXT psrbtree_next
+#define PRBTREE_NODE_TO_BTREE_NODE_ psrbtree_node_to_btree_node_
+#define PRBTREE_INSERT psrbtree_insert
+#define PRBTREE_REMOVE psrbtree_remove
+#elif defined USE_PCRBTREE
 #include "pcrbtree.h"
 #define PRBTREE pcrbtree
 #define PRBTREE_INIT pcrbtree_init
@@ -39,9 +61,17 @@
 #define PRBTREE_GET_PARENT pcrbtree_get_parent
 #define PRBTREE_NODE_FROM_BTREE_NODE_ pcrbtree_node_from_btree_node_
 #define PRBTREE_NEXT pcrbtree_next
+#define PRBTREE_NEXT_PREFETCH pcrbtree_next_prefetch
 #define PRBTREE_NODE_TO_BTREE_NODE_ pcrbtree_node_to_btree_node_
 #define PRBTREE_INSERT pcrbtree_insert
 #define PRBTREE_REMOVE pcrbtree_remove
+#define PRBTREE_BUILD_SORTED pcrbtree_build_sorted
+#define PRBTREE_INSERT_BATCH pcrbtree_insert_batch
+#define PRBTREE_RELOCATE pcrbtree_relocate
+#define PRBTREE_AUGMENT pcrbtree_augment
+#define PRBTREE_INSERT_AUGMENTED pcrbtree_insert_augmented
+#define PRBTREE_REMOVE_AUGMENTED pcrbtree_remove_augmented
+#define PRBTREE_DEFINE_ PCRBTREE_DEFINE
 #else
 #include "prbtree.h"
 #define PRBTREE prbtree
@@ -52,9 +82,21 @@
 #define PRBTREE_GET_PARENT prbtree_get_parent
 #define PRBTREE_NODE_FROM_BTREE_NODE_ prbtree_node_from_btree_node_
 #define PRBTREE_NEXT prbtree_next
+#define PRBTREE_NEXT_PREFETCH prbtree_next_prefetch
 #define PRBTREE_NODE_TO_BTREE_NODE_ prbtree_node_to_btree_node_
 #define PRBTREE_INSERT prbtree_insert
 #define PRBTREE_REMOVE prbtree_remove
+#define PRBTREE_BUILD_SORTED prbtree_build_sorted
+#define PRBTREE_INSERT_BATCH prbtree_insert_batch
+#define PRBTREE_RELOCATE prbtree_relocate
+#define PRBTREE_AUGMENT prbtree_augment
+#define PRBTREE_INSERT_AUGMENTED prbtree_insert_augmented
+#define PRBTREE_REMOVE_AUGMENTED prbtree_remove_augmented
+#define PRBTREE_DEFINE_ PRBTREE_DEFINE
+#endif
+
+#ifdef RBTREE_SLAB
+#include "slab.h"
 #endif
 
 #ifndef ASSERT
@@ -80,6 +122,10 @@
 //#define RBTREE_CHECK
 //#define RBTREE_PRINT
 //#define RBTREE_PRINT_REMOVE_NOT_FOUND
+//#define RBTREE_AUGMENTED /* maintain sum of key.a over subtree, not for USE_PSRBTREE */
+//#define RBTREE_SPECIALIZED /* use functions defined by PRBTREE_DEFINE(), not for USE_PSRBTREE */
+//#define RBTREE_SCAN /* measure throughput of in-order iteration over a big tree, not for USE_STDMAP/USE_PSRBTREE */
+//#define RBTREE_SLAB /* allocate objects from a slab instead of malloc(), not for USE_STDMAP */
 
 static FILE *out = NULL;
 
@@ -106,11 +152,23 @@ struct A {
 #ifndef USE_STDMAP
 	struct PRBTREE_NODE n;
 	tree_key_t key;
+#ifdef RBTREE_AUGMENTED
+	long long sum; /* sum of key.a over the subtree */
+#endif
 #endif
 	char c;
 };
 
 #ifndef USE_STDMAP
+#ifdef RBTREE_SLAB
+static struct slab a_slab;
+#define A_ALLOC()  ((struct A*)slab_alloc(&a_slab))
+#define A_FREE(a)  slab_free(&a_slab, a)
+#else
+#define A_ALLOC()  ((struct A*)malloc(sizeof(struct A)))
+#define A_FREE(a)  free(a)
+#endif
+
 static inline struct A *node_to_A(const struct btree_node *node)
 {
 	void *n = btree_const_cast(node);
@@ -136,6 +194,47 @@ static inline int key_comparator(const struct btree_node *node, const struct btr
 	return BTREE_KEY_COMPARATOR(a->key.a, k->a, a->key.b, k->b, a->key.c, k->c);
 }
 
+#ifdef RBTREE_SPECIALIZED
+#if defined USE_PSRBTREE || defined RBTREE_AUGMENTED
+#error RBTREE_SPECIALIZED cannot be combined with USE_PSRBTREE or RBTREE_AUGMENTED
+#endif
+#define A_KEY_OF(o) (o)->key
+#define A_KEY_CMP(x, y) BTREE_KEY_COMPARATOR((x).a, (y).a, (x).b, (y).b, (x).c, (y).c)
+PRBTREE_DEFINE_(a_tree, struct A, n, tree_key_t, A_KEY_OF, A_KEY_CMP)
+#endif
+
+#ifdef RBTREE_AUGMENTED
+static inline long long subtree_sum(const struct btree_node *node/*NULL?*/)
+{
+	return node ? node_to_A(node)->sum : 0;
+}
+
+static inline void sum_update(struct PRBTREE_NODE *n)
+{
+	struct btree_node *const node = PRBTREE_NODE_TO_BTREE_NODE_(n);
+	node_to_A(node)->sum = node_to_A(node)->key.a + subtree_sum(node->btree_left) + subtree_sum(node->btree_right);
+}
+
+static void sum_propagate(struct PRBTREE_NODE *n, const struct PRBTREE_NODE *stop)
+{
+	for (; n != stop; n = PRBTREE_GET_PARENT(n))
+		sum_update(n);
+}
+
+static void sum_rotate(struct PRBTREE_NODE *o, struct PRBTREE_NODE *n)
+{
+	node_to_A(PRBTREE_NODE_TO_BTREE_NODE_(n))->sum = node_to_A(PRBTREE_NODE_TO_BTREE_NODE_(o))->sum;
+	sum_update(o);
+}
+
+static void sum_copy(const struct PRBTREE_NODE *o, struct PRBTREE_NODE *n)
+{
+	node_to_A(PRBTREE_NODE_TO_BTREE_NODE_(n))->sum = node_to_A(PRBTREE_NODE_TO_BTREE_NODE_(o))->sum;
+}
+
+static const struct PRBTREE_AUGMENT sum_augment = {sum_propagate, sum_rotate, sum_copy};
+#endif /* RBTREE_AUGMENTED */
+
 #ifdef RBTREE_PRINT
 
 static void print_offs(unsigned offs)
@@ -208,12 +307,12 @@ static unsigned check_tree(struct btree_node *tree, int parent_is_red)
 		ASSERT(PRB_BLACK_COLOR == PRBTREE_GET_COLOR_(PRBTREE_NODE_FROM_BTREE_NODE_(tree)) || (!!tree->btree_left == !!tree->btree_right));
 		if (tree->btree_left) {
 			PRBTREE_NODE *const p = PRBTREE_GET_PARENT(PRBTREE_NODE_FROM_BTREE_NODE_(tree->btree_left));
-			ASSERT(p && tree == &p->u.n);
+			ASSERT(p && tree == PRBTREE_NODE_TO_BTREE_NODE_(p));
 			check_right_order(tree->btree_left, tree);
 		}
 		if (tree->btree_right) {
 			PRBTREE_NODE *const p = PRBTREE_GET_PARENT(PRBTREE_NODE_FROM_BTREE_NODE_(tree->btree_right));
-			ASSERT(p && tree == &p->u.n);
+			ASSERT(p && tree == PRBTREE_NODE_TO_BTREE_NODE_(p));
 			check_right_order(tree, tree->btree_right);
 		}
 		if (tree->btree_left && tree->btree_right)
@@ -228,6 +327,17 @@ static unsigned check_tree(struct btree_node *tree, int parent_is_red)
 					bc_left, bc_right);
 			}
 			ASSERT(bc_left == bc_right);
+#ifdef USE_PSRBTREE
+			/* check subtree size */
+			ASSERT(psrbtree_size(PRBTREE_NODE_FROM_BTREE_NODE_(tree)) == 1 +
+				psrbtree_size(PRBTREE_NODE_FROM_BTREE_NODE_(tree->btree_left)) +
+				psrbtree_size(PRBTREE_NODE_FROM_BTREE_NODE_(tree->btree_right)));
+#endif
+#ifdef RBTREE_AUGMENTED
+			/* check subtree sum */
+			ASSERT(node_to_A(tree)->sum == node_to_A(tree)->key.a +
+				subtree_sum(tree->btree_left) + subtree_sum(tree->btree_right));
+#endif
 			return bc_left + (PRB_BLACK_COLOR == PRBTREE_GET_COLOR_(PRBTREE_NODE_FROM_BTREE_NODE_(tree)));
 		}
 	}
@@ -236,20 +346,211 @@ static unsigned check_tree(struct btree_node *tree, int parent_is_red)
 }
 #endif /* RBTREE_CHECK */
 
+#if defined RBTREE_CHECK && !defined USE_PSRBTREE && !defined RBTREE_AUGMENTED
+/* build trees of different sizes from sorted arrays, check them, then remove all nodes */
+static void check_build_sorted(void)
+{
+	unsigned n = 0;
+	for (; n < 1200; n += 1 + n/64) {
+		struct A *const arr = (struct A*)malloc(sizeof(*arr)*(n + 1));
+		struct PRBTREE_NODE **const nodes = (struct PRBTREE_NODE**)malloc(sizeof(*nodes)*(n + 1));
+		struct PRBTREE tree;
+		unsigned i = 0;
+		if (!arr || !nodes) {
+			fprintf(stderr, "failed to alloc nodes!\n");
+			exit(-1);
+		}
+		for (; i < n; i++) {
+			arr[i].key.a = (v_t)(i/7);
+			arr[i].key.b = (v_t)(i%7);
+			arr[i].key.c = 0;
+			nodes[i] = &arr[i].n;
+		}
+		PRBTREE_INIT(&tree);
+		PRBTREE_BUILD_SORTED(&tree, nodes, n);
+		ASSERT(!tree.root || PRB_BLACK_COLOR == PRBTREE_GET_COLOR_(tree.root)); /* root must be black */
+		check_tree(PRBTREE_NODE_TO_BTREE_NODE_(tree.root), /*parent_is_red:*/1);
+		{
+			/* iterate using parent links */
+			struct PRBTREE_NODE *e = n ? PRBTREE_NODE_FROM_BTREE_NODE_(btree_first(PRBTREE_NODE_TO_BTREE_NODE_(tree.root))) : NULL;
+			for (i = 0; e; e = PRBTREE_NEXT(e), i++)
+				ASSERT(e == nodes[i]);
+			ASSERT(i == n);
+		}
+		/* tree must remain valid after removals: remove nodes at odd positions, then at even ones */
+		for (i = 0; i < n; i++) {
+			PRBTREE_REMOVE(&tree, nodes[i < n/2 ? 2*i + 1 : 2*(i - n/2)]);
+			ASSERT(!tree.root || PRB_BLACK_COLOR == PRBTREE_GET_COLOR_(tree.root));
+			check_tree(PRBTREE_NODE_TO_BTREE_NODE_(tree.root), /*parent_is_red:*/1);
+		}
+		ASSERT(!tree.root);
+		free(nodes);
+		free(arr);
+	}
+}
+
+static int node_comparator(const struct btree_node *node, const struct btree_node *node2)
+{
+	return key_comparator(node, key_to_btree_key(&node_to_A(node2)->key));
+}
+
+/* insert nearly sorted batches of nodes, check the tree after each batch */
+static void check_insert_batch(void)
+{
+	const unsigned n = 20000;
+	struct A *const arr = (struct A*)malloc(sizeof(*arr)*n);
+	struct PRBTREE_NODE **const nodes = (struct PRBTREE_NODE**)malloc(sizeof(*nodes)*n);
+	struct PRBTREE tree;
+	unsigned i = 0, k = 0;
+	if (!arr || !nodes) {
+		fprintf(stderr, "failed to alloc nodes!\n");
+		exit(-1);
+	}
+	for (; i < n; i++) {
+		PRBTREE_INIT_NODE(&arr[i].n);
+		arr[i].key.a = (v_t)i;
+		arr[i].key.b = 0;
+		arr[i].key.c = 0;
+	}
+	PRBTREE_INIT(&tree);
+	/* 1) every third node, sorted */
+	for (i = 0; i < n; i += 3)
+		nodes[k++] = &arr[i].n;
+	ASSERT(k == PRBTREE_INSERT_BATCH(&tree, nodes, k, node_comparator, /*leaf:*/0));
+	check_tree(PRBTREE_NODE_TO_BTREE_NODE_(tree.root), /*parent_is_red:*/1);
+	/* 2) other nodes: ascending runs with swapped neighbours, then descending runs */
+	for (k = 0, i = 0; i < n; i++) {
+		if (i % 3) {
+			nodes[k++] = &arr[i].n;
+			if (!(k % 5) && (k % 10)) {
+				struct PRBTREE_NODE *t = nodes[k - 1];
+				nodes[k - 1] = nodes[k - 2];
+				nodes[k - 2] = t;
+			}
+		}
+	}
+	for (i = k/2; i + 100 <= k; i += 100) {
+		unsigned j = 0;
+		for (; j < 50; j++) {
+			struct PRBTREE_NODE *t = nodes[i + j];
+			nodes[i + j] = nodes[i + 99 - j];
+			nodes[i + 99 - j] = t;
+		}
+	}
+	{
+		/* insertion must stop at a node with the key of already inserted one */
+		struct PRBTREE_NODE *const t = nodes[k - 7];
+		struct PRBTREE_NODE *dup_ptr;
+		struct A dup;
+		PRBTREE_INIT_NODE(&dup.n);
+		dup.key = arr[3].key;
+		nodes[k - 7] = &dup.n;
+		ASSERT(k - 7 == PRBTREE_INSERT_BATCH(&tree, nodes, k, node_comparator, /*leaf:*/0));
+		check_tree(PRBTREE_NODE_TO_BTREE_NODE_(tree.root), /*parent_is_red:*/1);
+		nodes[k - 7] = t;
+		ASSERT(7 == PRBTREE_INSERT_BATCH(&tree, nodes + k - 7, 7, node_comparator, /*leaf:*/0));
+		dup_ptr = &dup.n;
+		ASSERT(!PRBTREE_INSERT_BATCH(&tree, &dup_ptr, 1, node_comparator, /*leaf:*/0));
+		(void)dup_ptr;
+	}
+	ASSERT(!tree.root || PRB_BLACK_COLOR == PRBTREE_GET_COLOR_(tree.root)); /* root must be black */
+	check_tree(PRBTREE_NODE_TO_BTREE_NODE_(tree.root), /*parent_is_red:*/1);
+	{
+		struct PRBTREE_NODE *e = PRBTREE_NODE_FROM_BTREE_NODE_(btree_first(PRBTREE_NODE_TO_BTREE_NODE_(tree.root)));
+		for (i = 0; e; e = PRBTREE_NEXT(e), i++)
+			ASSERT(e == &arr[i].n);
+		ASSERT(i == n);
+	}
+	free(nodes);
+	free(arr);
+}
+
+static size_t moved_count = 0;
+
+static void move_A(struct btree_node *to, struct btree_node *from, struct btree_object *obj)
+{
+	*node_to_A(to) = *node_to_A(from);
+	node_to_A(from)->c = 'x'; /* old object must not be accessed after the move */
+	moved_count++;
+	(void)obj;
+}
+
+/* relocate a tree built from shuffled nodes, check that the tree is the same and parents precede children */
+static void check_relocate(void)
+{
+	const unsigned n = 5000;
+	struct A *const arr = (struct A*)malloc(sizeof(*arr)*n);
+	struct A *const buf1 = (struct A*)malloc(sizeof(*buf1)*n);
+	struct A *const buf2 = (struct A*)malloc(sizeof(*buf2)*n);
+	struct PRBTREE_NODE **const nodes = (struct PRBTREE_NODE**)malloc(sizeof(*nodes)*n);
+	struct PRBTREE tree;
+	unsigned i = 0, pass = 0;
+	if (!arr || !buf1 || !buf2 || !nodes) {
+		fprintf(stderr, "failed to alloc nodes!\n");
+		exit(-1);
+	}
+	for (; i < n; i++) {
+		PRBTREE_INIT_NODE(&arr[i].n);
+		arr[i].key.a = (v_t)((i*7919u) % n);
+		arr[i].key.b = 0;
+		arr[i].key.c = 0;
+		arr[i].c = 'a';
+		nodes[i] = &arr[i].n;
+	}
+	PRBTREE_INIT(&tree);
+	ASSERT(n == PRBTREE_INSERT_BATCH(&tree, nodes, n, node_comparator, /*leaf:*/0));
+	ASSERT(!PRBTREE_RELOCATE(&tree, buf1, n - 1, sizeof(struct A), offsetof(struct A, n),
+		BTREE_LAYOUT_BFS, move_A, NULL));
+	ASSERT(!moved_count);
+	for (; pass < 2; pass++) {
+		struct A *const buf = pass ? buf2 : buf1;
+		moved_count = 0;
+		ASSERT(n == PRBTREE_RELOCATE(&tree, buf, n, sizeof(struct A), offsetof(struct A, n),
+			pass ? BTREE_LAYOUT_VEB : BTREE_LAYOUT_BFS, move_A, NULL));
+		ASSERT(n == moved_count);
+		ASSERT(tree.root == &buf[0].n);
+		ASSERT(PRB_BLACK_COLOR == PRBTREE_GET_COLOR_(tree.root)); /* root must be black */
+		check_tree(PRBTREE_NODE_TO_BTREE_NODE_(tree.root), /*parent_is_red:*/1);
+		{
+			struct PRBTREE_NODE *e = PRBTREE_NODE_FROM_BTREE_NODE_(btree_first(PRBTREE_NODE_TO_BTREE_NODE_(tree.root)));
+			for (i = 0; e; e = PRBTREE_NEXT(e), i++) {
+				const struct A *const a = node_to_A(PRBTREE_NODE_TO_BTREE_NODE_(e));
+				ASSERT(a->key.a == (v_t)i);
+				ASSERT(a->c == 'a');
+				ASSERT(a >= buf && a < buf + n);
+				if (PRBTREE_GET_PARENT(e))
+					ASSERT(node_to_A(PRBTREE_NODE_TO_BTREE_NODE_(PRBTREE_GET_PARENT(e))) < a);
+				(void)a;
+			}
+			ASSERT(i == n);
+		}
+	}
+	free(nodes);
+	free(buf2);
+	free(buf1);
+	free(arr);
+}
+#endif /* RBTREE_CHECK && !USE_PSRBTREE && !RBTREE_AUGMENTED */
+
 static void clear_tree(struct btree_node *tree)
 {
+#ifdef RBTREE_SLAB
+	(void)tree; /* all nodes are freed with their blocks */
+	slab_destroy(&a_slab);
+#else
 	if (tree) {
 		clear_tree(tree->btree_left);
 		clear_tree(tree->btree_right);
 		free(node_to_A(tree));
 	}
+#endif
 }
 #endif /* !USE_STDMAP */
 
 #ifndef USE_STDMAP
 static inline int rb_insert(struct PRBTREE *tree, const tree_key_t *key, unsigned count)
 {
-	struct A *a = (struct A*)malloc(sizeof(*a));
+	struct A *a = A_ALLOC();
 	if (!a) {
 #ifdef RBTREE_PRINT
 		fprintf(out, "----------------------------------------------failed to alloc node!\n");
@@ -264,12 +565,23 @@ static inline int rb_insert(struct PRBTREE *tree, const tree_key_t *key, unsigne
 #ifdef RBTREE_PRINT
 		unsigned height = 0;
 #endif
+#ifdef RBTREE_SPECIALIZED
+		struct A *const existing = a_tree_insert(tree, a, /*leaf:*/0);
+		struct btree_node *parent = existing ? PRBTREE_NODE_TO_BTREE_NODE_(&existing->n) : NULL;
+		int parent_found = !existing;
+		(void)parent;
+#else
 		struct btree_node *parent = PRBTREE_NODE_TO_BTREE_NODE_(tree->root); /* NULL? */
 		int parent_found = btree_search_parent(&parent, key_to_btree_key(&a->key), key_comparator, /*allow_duplicates:*/0);
+#endif
 		if (parent_found) {
+#ifdef RBTREE_AUGMENTED
+			PRBTREE_INSERT_AUGMENTED(tree, PRBTREE_NODE_FROM_BTREE_NODE_(parent/*NULL?*/), &a->n, parent_found, &sum_augment);
+#elif !defined RBTREE_SPECIALIZED
 			PRBTREE_INSERT(tree, PRBTREE_NODE_FROM_BTREE_NODE_(parent/*NULL?*/), &a->n, parent_found);
+#endif
 #ifdef RBTREE_PRINT
-			height = print_tree(&tree->root->u.n);
+			height = print_tree(PRBTREE_NODE_TO_BTREE_NODE_(tree->root));
 #endif
 		}
 #ifdef RBTREE_CHECK
@@ -283,7 +595,7 @@ static inline int rb_insert(struct PRBTREE *tree, const tree_key_t *key, unsigne
 			fprintf(out, "------------------found existing! key={%d,%d,%d}, n={%u:%x}\n", key->a, key->b, key->c,
 				PRBTREE_GET_COLOR_(PRBTREE_NODE_FROM_BTREE_NODE_(parent)), (unsigned)(0xFFFFu & (uintptr_t)parent));
 #endif
-			free(a);
+			A_FREE(a);
 			return 0;
 		}
 		else {
@@ -303,14 +615,35 @@ static inline int rb_remove(struct PRBTREE *tree, const tree_key_t *key, unsigne
 #ifdef RBTREE_PRINT
 		unsigned height = 0;
 #endif
+#ifdef RBTREE_SPECIALIZED
+		struct A *const x = a_tree_search(tree, *key);
+		struct btree_node *n = x ? PRBTREE_NODE_TO_BTREE_NODE_(&x->n) : NULL;
+#else
 		struct btree_node *n = btree_search(
 			PRBTREE_NODE_TO_BTREE_NODE_(tree->root/*NULL?*/), key_to_btree_key(key), key_comparator);
+#endif
 		if (n) {
 #ifdef RBTREE_PRINT
 			fprintf(out, "--------------------removing key={%d,%d,%d}, n={%u:%x}, count=%u\n", key->a, key->b, key->c,
 				PRBTREE_GET_COLOR_(PRBTREE_NODE_FROM_BTREE_NODE_(n)), (unsigned)(0xFFFFu & (uintptr_t)n), count);
 #endif
+#if defined RBTREE_CHECK && defined USE_PSRBTREE
+			{
+				const size_t rank = psrbtree_rank(PRBTREE_NODE_FROM_BTREE_NODE_(n));
+				ASSERT(psrbtree_select(tree, rank) == PRBTREE_NODE_FROM_BTREE_NODE_(n));
+				ASSERT(psrbtree_count_less(tree, key_to_btree_key(key), key_comparator, /*or_equal:*/0) == rank);
+				ASSERT(psrbtree_count_less(tree, key_to_btree_key(key), key_comparator, /*or_equal:*/1) == rank + 1);
+				ASSERT(psrbtree_count_range(tree, key_to_btree_key(key), key_to_btree_key(key), key_comparator) == 0);
+				(void)rank;
+			}
+#endif
+#ifdef RBTREE_SPECIALIZED
+			a_tree_remove(tree, x);
+#elif defined RBTREE_AUGMENTED
+			PRBTREE_REMOVE_AUGMENTED(tree, PRBTREE_NODE_FROM_BTREE_NODE_(n), &sum_augment);
+#else
 			PRBTREE_REMOVE(tree, PRBTREE_NODE_FROM_BTREE_NODE_(n));
+#endif
 		}
 #ifdef RBTREE_PRINT
 #ifndef RBTREE_PRINT_REMOVE_NOT_FOUND
@@ -330,7 +663,7 @@ static inline int rb_remove(struct PRBTREE *tree, const tree_key_t *key, unsigne
 			fprintf(out, "--------------------height=%u, removed key={%d,%d,%d}, n={%u:%x}, count=%u\n", height,
 				key->a, key->b, key->c, PRBTREE_GET_COLOR_(&a->n), (unsigned)(0xFFFFu & (uintptr_t)&a->n), count);
 #endif
-			free(a);
+			A_FREE(a);
 			return 1;
 		}
 		else {
@@ -350,6 +683,92 @@ static int rrr(void)
 	return rand();
 }
 
+#ifdef RBTREE_SCAN
+#if defined USE_STDMAP || defined USE_PSRBTREE
+#error RBTREE_SCAN is not supported for USE_STDMAP or USE_PSRBTREE
+#endif
+
+/* number of nodes of the tree, the tree should not fit into the L3 cache (2^24 nodes - ~800MB) */
+#ifndef SCAN_NODES
+#define SCAN_NODES (1u << 24)
+#endif
+
+#define SCAN_PASSES 4
+
+/* monotonic clock, as in bench.cpp: clock() measures CPU time of the process on POSIX, but
+  wall time on Windows, and may have coarse resolution */
+typedef std::chrono::steady_clock scan_clock;
+
+static void scan_report(const char *name, scan_clock::time_point start, unsigned long long sum)
+{
+	const double secs = std::chrono::duration<double>(scan_clock::now() - start).count();
+	fprintf(out, "%-24s %8.1f Mnodes/sec (sum=%llu)\n", name,
+		secs > 0 ? (double)SCAN_NODES*SCAN_PASSES/secs/1e6 : 0.0, sum);
+}
+
+/* iterate over the tree which nodes are placed in memory in random order */
+static void scan_benchmark(void)
+{
+	struct PRBTREE tree;
+	struct A *const nodes = (struct A*)malloc(sizeof(struct A)*SCAN_NODES);
+	struct PRBTREE_NODE **const sorted = (struct PRBTREE_NODE**)malloc(sizeof(*sorted)*SCAN_NODES);
+	unsigned i, pass;
+	if (!nodes || !sorted) {
+		fprintf(stderr, "failed to allocate %u nodes\n", SCAN_NODES);
+		exit(1);
+	}
+	for (i = 0; i < SCAN_NODES; i++)
+		sorted[i] = &nodes[i].n;
+	for (i = SCAN_NODES - 1; i; i--) {
+		const unsigned j = ((unsigned)rrr() << 15 ^ (unsigned)rrr()) % (i + 1);
+		struct PRBTREE_NODE *const t = sorted[i];
+		sorted[i] = sorted[j];
+		sorted[j] = t;
+	}
+	for (i = 0; i < SCAN_NODES; i++) {
+		struct A *const a = node_to_A(PRBTREE_NODE_TO_BTREE_NODE_(sorted[i]));
+		a->key.a = (v_t)i;
+		a->key.b = 0;
+		a->key.c = 0;
+	}
+	PRBTREE_BUILD_SORTED(&tree, sorted, SCAN_NODES);
+	free(sorted);
+	fprintf(out, "scan of %u nodes:\n", SCAN_NODES);
+	{
+		unsigned long long sum = 0;
+		const scan_clock::time_point start = scan_clock::now();
+		for (pass = 0; pass < SCAN_PASSES; pass++) {
+			const struct btree_node *n = btree_first(PRBTREE_NODE_TO_BTREE_NODE_(tree.root));
+			for (; n; n = PRBTREE_NODE_TO_BTREE_NODE_(PRBTREE_NEXT(PRBTREE_NODE_FROM_BTREE_NODE_(n))))
+				sum += (unsigned)node_to_A(n)->key.a;
+		}
+		scan_report("next", start, sum);
+	}
+	{
+		unsigned long long sum = 0;
+		const scan_clock::time_point start = scan_clock::now();
+		for (pass = 0; pass < SCAN_PASSES; pass++) {
+			const struct btree_node *n = btree_first(PRBTREE_NODE_TO_BTREE_NODE_(tree.root));
+			for (; n; n = PRBTREE_NODE_TO_BTREE_NODE_(PRBTREE_NEXT_PREFETCH(PRBTREE_NODE_FROM_BTREE_NODE_(n))))
+				sum += (unsigned)node_to_A(n)->key.a;
+		}
+		scan_report("next_prefetch", start, sum);
+	}
+	{
+		unsigned long long sum = 0;
+		const scan_clock::time_point start = scan_clock::now();
+		for (pass = 0; pass < SCAN_PASSES; pass++) {
+			size_t s;
+			struct btree_node *stack[rbtree_height(32)], *n;
+			btree_walk_stack_forward(PRBTREE_NODE_TO_BTREE_NODE_(tree.root), stack, s, n)
+				sum += (unsigned)node_to_A(n)->key.a;
+		}
+		scan_report("btree_walk_stack_forward", start, sum);
+	}
+	free(nodes);
+}
+#endif /* RBTREE_SCAN */
+
 int main(int argc, char *argv[])
 {
 	unsigned insert_count = 0;
@@ -368,15 +787,40 @@ int main(int argc, char *argv[])
 #else
 	struct PRBTREE tree;
 	PRBTREE_INIT(&tree);
+#ifdef RBTREE_SLAB
+	slab_init(&a_slab, sizeof(struct A), 0);
+#endif
+#endif
+#if defined RBTREE_CHECK && !defined USE_STDMAP && !defined USE_PSRBTREE && !defined RBTREE_AUGMENTED
+	check_build_sorted();
+	check_insert_batch();
+	check_relocate();
 #endif
 	srand(0);
 #ifdef USE_STDMAP
 	fprintf(out, "stdmap\n");
+#elif defined USE_PSRBTREE
+	fprintf(out, "psrbtree\n");
+#elif defined USE_PCRBTREE && defined RBTREE_AUGMENTED
+	fprintf(out, "pcrbtree augmented\n");
+#elif defined USE_PCRBTREE && defined RBTREE_SPECIALIZED
+	fprintf(out, "pcrbtree specialized\n");
 #elif defined USE_PCRBTREE
 	fprintf(out, "pcrbtree\n");
+#elif defined RBTREE_AUGMENTED
+	fprintf(out, "prbtree augmented\n");
+#elif defined RBTREE_SPECIALIZED
+	fprintf(out, "prbtree specialized\n");
 #else
 	fprintf(out, "prbtree\n");
 #endif
+#ifdef RBTREE_SCAN
+	scan_benchmark();
+	(void)insert_count, (void)remove_count;
+	if (out != stdout)
+		fclose(out);
+	return 0;
+#else
 	{
 		unsigned i = 0;
 		unsigned count = 0;
@@ -434,11 +878,15 @@ int main(int argc, char *argv[])
 						key.b = it->first.b;
 						key.c = it->first.c;
 #else
-						struct btree_node *n = btree_first(&tree.root->u.n);
+#ifdef USE_PSRBTREE
+						struct btree_node *n = PRBTREE_NODE_TO_BTREE_NODE_(psrbtree_select(&tree, pos));
+#else
+						struct btree_node *n = btree_first(PRBTREE_NODE_TO_BTREE_NODE_(tree.root));
 						while (pos) {
-							n = &PRBTREE_NEXT(&node_to_A(n)->n)->u.n;
+							n = PRBTREE_NODE_TO_BTREE_NODE_(PRBTREE_NEXT(&node_to_A(n)->n));
 							pos--;
 						}
+#endif
 						{
 							struct A *a = node_to_A(n);
 							key.a = a->key.a;
@@ -475,4 +923,5 @@ int main(int argc, char *argv[])
 	printf("insert_count=%u\n", insert_count);
 	printf("remove_count=%u\n", remove_count);
 	return 0;
+#endif /* !RBTREE_SCAN */
 }
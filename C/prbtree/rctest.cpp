@@ -0,0 +1,311 @@
+/**********************************************************************************
+* Persistent red-black tree of pointers to objects for lock-free readers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* rctest.cpp */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "rcurbtree.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define RANGE 3000
+#define OPS 30000
+#define WINDOW 256   /* keys in the tree during concurrent test */
+#define READERS 4
+#define SCANS 2000   /* scans by each reader */
+
+struct obj {
+	unsigned key;
+	unsigned check; /* derived from the key, to detect reading of freed objects */
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+RCURBTREE_DEFINE(otree, struct obj, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+
+static struct obj objs[RANGE];
+static struct obj alts[RANGE]; /* replacements of objs */
+static const struct obj *expected[RANGE]; /* objects in the tree */
+
+/* check colors and order of keys,
+  returns black height of the subtree, or -1 on error */
+static int check_subtree(const struct rcurbtree_node *const n, const int parent_is_red, size_t *const count)
+{
+	const struct rcurbtree_node *const l = n->rcurbtree_left;
+	const struct rcurbtree_node *const r = n->rcurbtree_right;
+	const unsigned key = ((const struct obj*)n->obj)->key;
+	int bl = 0, br = 0;
+	if ((n->color && parent_is_red) || n->fresh)
+		return -1;
+	if (l) {
+		if (((const struct obj*)l->obj)->key >= key)
+			return -1;
+		bl = check_subtree(l, n->color, count);
+	}
+	if (r) {
+		if (((const struct obj*)r->obj)->key <= key)
+			return -1;
+		br = check_subtree(r, n->color, count);
+	}
+	if (bl < 0 || bl != br)
+		return -1;
+	++*count;
+	return bl + !n->color;
+}
+
+static int check_tree(const struct rcurbtree *const tree)
+{
+	size_t count = 0;
+	unsigned k = 0, n = 0;
+	if (tree->root && (tree->root->color || check_subtree(tree->root, 1, &count) <= 0))
+		return 0;
+	for (; k < RANGE; k++)
+		n += (expected[k] != NULL);
+	return count == n && count == tree->count;
+}
+
+/* compare a snapshot with saved contents of the tree */
+static int check_snapshot(const struct rcurbtree_node *const snap, const std::vector<const struct obj*> &saved)
+{
+	struct btree_node *stack[rbtree_height(8*sizeof(size_t))], *n;
+	size_t s, i = 0;
+	btree_walk_stack_forward(rcurbtree_node_to_btree_node_(snap), stack, s, n) {
+		if (i == saved.size() || otree_from_node(n) != saved[i])
+			return 0;
+		i++;
+	}
+	return i == saved.size();
+}
+
+static void save_tree(std::vector<const struct obj*> &saved)
+{
+	unsigned k = 0;
+	saved.clear();
+	for (; k < RANGE; k++) {
+		if (expected[k])
+			saved.push_back(expected[k]);
+	}
+}
+
+static int check_lookups(const struct rcurbtree_node *const snap)
+{
+	unsigned k = 0;
+	const struct obj *lower = NULL;
+	const struct obj *first = NULL, *last = NULL;
+	/* go backward, remember the nearest object with key >= k */
+	for (k = RANGE; k--;) {
+		const struct obj *const upper = lower;
+		if (expected[k])
+			lower = expected[k];
+		if (otree_search(snap, k) != expected[k] ||
+			otree_lower_bound(snap, k) != lower ||
+			otree_upper_bound(snap, k) != upper)
+		{
+			return 0;
+		}
+		if (expected[k]) {
+			first = expected[k];
+			if (!last)
+				last = expected[k];
+		}
+	}
+	return otree_first(snap) == first && otree_last(snap) == last;
+}
+
+static void free_obj(void *ptr, void *ctx)
+{
+	(void)ctx;
+	free(ptr);
+}
+
+static struct epoch_domain domain;
+static struct rcurbtree ctree;
+static std::atomic<int> stop(0);
+static std::atomic<unsigned long> errors(0);
+
+static struct obj *new_obj(unsigned key)
+{
+	struct obj *const o = (struct obj*)malloc(sizeof(*o));
+	if (!o)
+		abort();
+	o->key = key;
+	o->check = key*2654435761u;
+	return o;
+}
+
+/* slide the window of keys: insert the next key, remove the oldest one */
+static unsigned long writer(void)
+{
+	unsigned long k = WINDOW;
+	for (; !stop.load(std::memory_order_relaxed); k++) {
+		struct obj *o = new_obj((unsigned)k);
+		struct obj *x;
+		if (otree_insert(&ctree, o, &x) != 1)
+			abort();
+		if (otree_remove(&ctree, (unsigned)(k - WINDOW), &x) != 1)
+			abort();
+		epoch_retire(&domain, x, free_obj, NULL);
+	}
+	return k;
+}
+
+/* scan snapshots: each must be a sorted run of WINDOW or WINDOW + 1 contiguous keys */
+static void reader(struct epoch_reader *const r)
+{
+	unsigned i = 0;
+	unsigned long e = 0;
+	epoch_register(&domain, r);
+	for (; i < SCANS; i++) {
+		struct btree_node *stack[rbtree_height(8*sizeof(size_t))], *n;
+		size_t s, count = 0;
+		unsigned prev = 0;
+		epoch_enter(&domain, r);
+		btree_walk_stack_forward(rcurbtree_node_to_btree_node_(rcurbtree_snapshot(&ctree)), stack, s, n) {
+			const struct obj *const o = otree_from_node(n);
+			e += o->check != o->key*2654435761u;
+			e += count && o->key != prev + 1;
+			prev = o->key;
+			count++;
+		}
+		epoch_leave(r);
+		e += count != WINDOW && count != WINDOW + 1;
+	}
+	errors.fetch_add(e);
+}
+
+int main(int argc, char *argv[])
+{
+	struct rcurbtree tree;
+	struct epoch_reader r;
+	std::vector<const struct obj*> saved;
+	const struct rcurbtree_node *snap = NULL;
+	unsigned i, seed = 1;
+	int ok = 1;
+
+	(void)argc, (void)argv;
+
+	epoch_init(&domain);
+	rcurbtree_init(&tree, &domain);
+	epoch_register(&domain, &r);
+
+	for (i = 0; i < RANGE; i++) {
+		objs[i].key = i;
+		alts[i].key = i;
+		expected[i] = NULL;
+	}
+	TEST(check_tree(&tree));
+	TEST(check_lookups(tree.root));
+
+	/* random updates, each 1000-th update - hold a snapshot during next 1000 updates */
+	for (i = 0; i < OPS && ok; i++) {
+		const unsigned k = (seed = seed*1103515245u + 12345u, (seed >> 8) % RANGE);
+		const unsigned op = (seed >> 24) % 3;
+		struct obj *x;
+		if (!(i % 1000)) {
+			if (i) {
+				ok = check_snapshot(snap, saved);
+				epoch_leave(&r);
+			}
+			epoch_enter(&domain, &r);
+			snap = rcurbtree_snapshot(&tree);
+			save_tree(saved);
+		}
+		if (op == 0) {
+			const int res = otree_insert(&tree, &objs[k], &x);
+			ok = ok && res == !expected[k] && x == expected[k];
+			if (!expected[k])
+				expected[k] = &objs[k];
+		}
+		else if (op == 1) {
+			struct obj *const o = (expected[k] == &objs[k]) ? &alts[k] : &objs[k];
+			const int res = otree_replace(&tree, o, &x);
+			ok = ok && res == !expected[k] && x == expected[k];
+			expected[k] = o;
+		}
+		else {
+			const int res = otree_remove(&tree, k, &x);
+			ok = ok && res == (expected[k] != NULL) && x == expected[k];
+			expected[k] = NULL;
+		}
+		if (!(i % 100))
+			ok = ok && check_tree(&tree);
+	}
+	TEST(ok);
+	TEST(check_snapshot(snap, saved));
+	epoch_leave(&r);
+	TEST(check_tree(&tree));
+	TEST(check_lookups(rcurbtree_snapshot(&tree)));
+
+	/* retired nodes are freed when there are no readers */
+	TEST(!epoch_reclaim(&domain));
+
+	/* remove all */
+	for (i = 0; i < RANGE; i++) {
+		struct obj *x;
+		ok = ok && otree_remove(&tree, i, &x) == (expected[i] != NULL) && x == expected[i];
+		expected[i] = NULL;
+	}
+	TEST(ok);
+	TEST(!tree.root && !tree.count);
+	TEST(check_lookups(tree.root));
+	rcurbtree_destroy(&tree);
+
+	/* readers scan snapshots while the writer updates the tree */
+	{
+		std::vector<std::thread> threads;
+		std::vector<struct epoch_reader> readers(READERS);
+		unsigned long updates;
+		rcurbtree_init(&ctree, &domain);
+		for (i = 0; i < WINDOW; i++) {
+			struct obj *x;
+			TEST(otree_insert(&ctree, new_obj(i), &x) == 1);
+		}
+		for (i = 0; i < READERS; i++)
+			threads.push_back(std::thread(reader, &readers[i]));
+		{
+			std::thread w([&updates] { updates = writer(); });
+			for (i = 0; i < READERS; i++)
+				threads[i].join();
+			stop.store(1);
+			w.join();
+		}
+		printf("%lu updates during scans\n", updates - WINDOW);
+		TEST(!errors.load());
+		TEST(ctree.count == WINDOW);
+		for (i = 0; i < READERS; i++)
+			epoch_unregister(&domain, &readers[i]);
+		{
+			struct obj *o = otree_first(ctree.root);
+			while (o) {
+				struct obj *x;
+				TEST(otree_remove(&ctree, o->key, &x) == 1 && x == o);
+				epoch_retire(&domain, x, free_obj, NULL);
+				o = otree_first(ctree.root);
+			}
+		}
+		epoch_synchronize(&domain);
+		TEST(!epoch_reclaim(&domain));
+		rcurbtree_destroy(&ctree);
+	}
+
+	epoch_unregister(&domain, &r);
+	epoch_destroy(&domain);
+
+	printf("all tests OK\n");
+	return 0;
+}
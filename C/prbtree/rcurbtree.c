@@ -0,0 +1,362 @@
+/**********************************************************************************
+* Persistent red-black tree of pointers to objects for lock-free readers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* rcurbtree.c */
+
+/* insert and remove are single-pass top-down, as in trbtree.c, but every node is copied before
+  it is modified: the copy replaces the node in its (already copied) parent, so the published
+  version of the tree is not changed until the new root is stored */
+
+#include <stdlib.h> /* for malloc() */
+#include "collections_config.h"
+#include "rcurbtree.h"
+
+#define RCU_RED_COLOR   1u
+#define RCU_BLACK_COLOR 0u
+
+/* maximum number of nodes copied by one update: up to 3 nodes per level of the tree,
+  the height of a red-black tree is <= 2*log2(n + 1) */
+#define RCURBTREE_MAX_COPIES_ (3*2*8*sizeof(size_t) + 4)
+
+/* copies made by the current update */
+struct rcurbtree_update_ {
+	struct rcurbtree *tree;
+	size_t count;
+	struct rcurbtree_node *copies[RCURBTREE_MAX_COPIES_];
+	struct rcurbtree_node *originals[RCURBTREE_MAX_COPIES_]; /* NULL for new nodes */
+};
+
+static inline int rcurbtree_is_red_(
+	const struct rcurbtree_node *const n/*NULL?*/)
+{
+	return n && RCU_RED_COLOR == n->color;
+}
+
+/* number of nodes an update of the tree of count objects may copy */
+static size_t rcurbtree_max_copies_(
+	size_t count)
+{
+	size_t h = 0;
+	for (count++; count; count >>= 1)
+		h += 2;
+	return 3*h + 4;
+}
+
+/* make sure the update will not run out of spare nodes, returns 0 on success, -1 if out of memory */
+static int rcurbtree_reserve_(
+	struct rcurbtree *const tree/*!=NULL*/,
+	const size_t need)
+{
+	while (tree->reserved < need) {
+		struct rcurbtree_node *const n = (struct rcurbtree_node*)malloc(sizeof(*n));
+		if (!n)
+			return -1;
+		n->rcurbtree_left = tree->reserve;
+		tree->reserve = n;
+		tree->reserved++;
+	}
+	return 0;
+}
+
+static inline struct rcurbtree_node *rcurbtree_take_(
+	struct rcurbtree_update_ *const u/*!=NULL*/,
+	struct rcurbtree_node *const original/*NULL?*/)
+{
+	struct rcurbtree_node *const n = u->tree->reserve;
+	RCURBTREE_ASSERT_PTR(n);
+	RCURBTREE_ASSERT(u->count < RCURBTREE_MAX_COPIES_);
+	u->tree->reserve = n->rcurbtree_left;
+	u->tree->reserved--;
+	u->copies[u->count] = n;
+	u->originals[u->count++] = original;
+	return n;
+}
+
+/* get the child of a copied node, copying the child if it is published */
+static struct rcurbtree_node *rcurbtree_own_(
+	struct rcurbtree_update_ *const u/*!=NULL*/,
+	struct rcurbtree_node **const link/*!=NULL, in a copied node*/)
+{
+	struct rcurbtree_node *const c = *link;
+	if (c && !c->fresh) {
+		struct rcurbtree_node *const n = rcurbtree_take_(u, c);
+		*n = *c;
+		n->fresh = 1;
+		*link = n;
+		return n;
+	}
+	return c; /* NULL? */
+}
+
+/* rotate: child of node x at side !d takes the place of x, x becomes its child at side d,
+  x becomes red, the child - black, returns the child */
+static struct rcurbtree_node *rcurbtree_rotate_(
+	struct rcurbtree_update_ *const u/*!=NULL*/,
+	struct rcurbtree_node *const x/*!=NULL, copied*/,
+	const unsigned d/*0,1*/)
+{
+	struct rcurbtree_node *const y = rcurbtree_own_(u, &x->u.leaves[!d]);
+	x->u.leaves[!d] = y->u.leaves[d];
+	y->u.leaves[d] = x;
+	x->color = RCU_RED_COLOR;
+	y->color = RCU_BLACK_COLOR;
+	return y;
+}
+
+/* rotate the child of x at side !d to the side !d of its child, then rotate x */
+static struct rcurbtree_node *rcurbtree_rotate2_(
+	struct rcurbtree_update_ *const u/*!=NULL*/,
+	struct rcurbtree_node *const x/*!=NULL, copied*/,
+	const unsigned d/*0,1*/)
+{
+	x->u.leaves[!d] = rcurbtree_rotate_(u, rcurbtree_own_(u, &x->u.leaves[!d]), !d);
+	return rcurbtree_rotate_(u, x, d);
+}
+
+/* drop copies of the update, the published tree is not changed */
+static void rcurbtree_discard_(
+	struct rcurbtree_update_ *const u/*!=NULL*/)
+{
+	size_t i = 0;
+	for (; i < u->count; i++) {
+		u->copies[i]->rcurbtree_left = u->tree->reserve;
+		u->tree->reserve = u->copies[i];
+	}
+	u->tree->reserved += u->count;
+}
+
+static void rcurbtree_free_node_(
+	void *const ptr,
+	void *const ctx)
+{
+	(void)ctx;
+	free(ptr);
+}
+
+/* publish new version of the tree, retire replaced nodes */
+static void rcurbtree_commit_(
+	struct rcurbtree_update_ *const u/*!=NULL*/,
+	struct rcurbtree_node *const root/*NULL?*/)
+{
+	struct rcurbtree *const tree = u->tree;
+	size_t i = 0;
+	for (; i < u->count; i++)
+		u->copies[i]->fresh = 0;
+	/* nodes of the new version must be visible to readers before the root */
+#if defined __GNUC__ || defined __clang__
+	__atomic_store_n(&tree->root, root, __ATOMIC_RELEASE);
+#else
+	_ReadWriteBarrier();
+	*(struct rcurbtree_node *volatile*)&tree->root = root;
+#endif
+	for (i = 0; i < u->count; i++) {
+		if (u->originals[i])
+			epoch_retire(tree->epoch, u->originals[i], rcurbtree_free_node_, (void*)0);
+	}
+	(void)epoch_reclaim(tree->epoch);
+}
+
+RCURBTREE_EXPORTS int rcurbtree_insert(
+	struct rcurbtree *const tree/*!=NULL*/,
+	void *const obj,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	const int replace,
+	void **const existing/*!=NULL,out*/)
+{
+	struct rcurbtree_update_ u;
+	struct rcurbtree_node head;      /* false root: the root is its right child */
+	struct rcurbtree_node *t = &head; /* great-grandparent */
+	struct rcurbtree_node *g = (struct rcurbtree_node*)0; /* grandparent */
+	struct rcurbtree_node *p = (struct rcurbtree_node*)0; /* parent */
+	struct rcurbtree_node *q;        /* current node */
+	struct rcurbtree_node *e = (struct rcurbtree_node*)0; /* new node */
+	struct rcurbtree_node *found = (struct rcurbtree_node*)0;
+	unsigned d = 1, last = 1;
+	RCURBTREE_ASSERT_PTR(tree);
+	RCURBTREE_ASSERT_PTR(key);
+	RCURBTREE_ASSERT_PTR(comparator);
+	RCURBTREE_ASSERT_PTR(existing);
+	*existing = (void*)0;
+	if (rcurbtree_reserve_(tree, rcurbtree_max_copies_(tree->count + 1)))
+		return -1;
+	u.tree = tree;
+	u.count = 0;
+	if (!tree->root) {
+		q = rcurbtree_take_(&u, (struct rcurbtree_node*)0);
+		q->rcurbtree_left = (struct rcurbtree_node*)0;
+		q->rcurbtree_right = (struct rcurbtree_node*)0;
+		q->obj = obj;
+		q->color = RCU_BLACK_COLOR;
+		tree->count++;
+		rcurbtree_commit_(&u, q);
+		return 1;
+	}
+	head.rcurbtree_left = (struct rcurbtree_node*)0;
+	head.rcurbtree_right = tree->root;
+	head.color = RCU_BLACK_COLOR;
+	head.fresh = 1;
+	for (q = rcurbtree_own_(&u, &head.rcurbtree_right);;) {
+		if (!q) {
+			/* insert new red node at the bottom */
+			q = e = rcurbtree_take_(&u, (struct rcurbtree_node*)0);
+			q->rcurbtree_left = (struct rcurbtree_node*)0;
+			q->rcurbtree_right = (struct rcurbtree_node*)0;
+			q->obj = obj;
+			q->color = RCU_RED_COLOR;
+			q->fresh = 1;
+			p->u.leaves[d] = q;
+		}
+		else if (rcurbtree_is_red_(q->rcurbtree_left) && rcurbtree_is_red_(q->rcurbtree_right)) {
+			/* push the red color up */
+			q->color = RCU_RED_COLOR;
+			rcurbtree_own_(&u, &q->rcurbtree_left)->color = RCU_BLACK_COLOR;
+			rcurbtree_own_(&u, &q->rcurbtree_right)->color = RCU_BLACK_COLOR;
+		}
+		if (rcurbtree_is_red_(q) && rcurbtree_is_red_(p)) {
+			/* two red nodes in a row: rotate the grandparent */
+			const unsigned d2 = (t->rcurbtree_right == g);
+			t->u.leaves[d2] = (q == p->u.leaves[last]) ?
+				rcurbtree_rotate_(&u, g, !last) : rcurbtree_rotate2_(&u, g, !last);
+		}
+		if (q == e)
+			break;
+		{
+			const int c = (*comparator)(&q->u.n, key); /* c = q - key */
+			if (c == 0) {
+				found = q;
+				break;
+			}
+			last = d;
+			d = (c < 0);
+		}
+		if (g)
+			t = g;
+		g = p;
+		p = q;
+		q = rcurbtree_own_(&u, &q->u.leaves[d]);
+	}
+	if (found) {
+		*existing = found->obj;
+		if (!replace) {
+			rcurbtree_discard_(&u);
+			return 0;
+		}
+		found->obj = obj;
+	}
+	else
+		tree->count++;
+	head.rcurbtree_right->color = RCU_BLACK_COLOR;
+	rcurbtree_commit_(&u, head.rcurbtree_right);
+	return !found;
+}
+
+RCURBTREE_EXPORTS int rcurbtree_remove(
+	struct rcurbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	void **const removed/*!=NULL,out*/)
+{
+	struct rcurbtree_update_ u;
+	struct rcurbtree_node head;       /* false root: the root is its right child */
+	struct rcurbtree_node *q = &head; /* current node */
+	struct rcurbtree_node *p = (struct rcurbtree_node*)0; /* parent */
+	struct rcurbtree_node *g = (struct rcurbtree_node*)0; /* grandparent */
+	struct rcurbtree_node *f = (struct rcurbtree_node*)0; /* found node */
+	unsigned d = 1;
+	RCURBTREE_ASSERT_PTR(tree);
+	RCURBTREE_ASSERT_PTR(key);
+	RCURBTREE_ASSERT_PTR(comparator);
+	RCURBTREE_ASSERT_PTR(removed);
+	*removed = (void*)0;
+	if (!tree->root)
+		return 0;
+	if (rcurbtree_reserve_(tree, rcurbtree_max_copies_(tree->count)))
+		return -1;
+	u.tree = tree;
+	u.count = 0;
+	head.rcurbtree_left = (struct rcurbtree_node*)0;
+	head.rcurbtree_right = tree->root;
+	head.color = RCU_BLACK_COLOR;
+	head.fresh = 1;
+	/* descend to the bottom, pushing the red color down, so the node at the bottom is red */
+	while (q->u.leaves[d]) {
+		const unsigned last = d;
+		g = p;
+		p = q;
+		q = rcurbtree_own_(&u, &q->u.leaves[d]);
+		{
+			const int c = (*comparator)(&q->u.n, key); /* c = q - key */
+			if (c == 0)
+				f = q;
+			d = (c < 0); /* after the found node, go to its predecessor */
+		}
+		if (!rcurbtree_is_red_(q) && !rcurbtree_is_red_(q->u.leaves[d])) {
+			if (rcurbtree_is_red_(q->u.leaves[!d])) {
+				/* rotate the red child of q to the place of q */
+				p = p->u.leaves[last] = rcurbtree_rotate_(&u, q, d);
+			}
+			else {
+				const struct rcurbtree_node *const s = p->u.leaves[!last]; /* sibling of q */
+				if (s) {
+					if (!rcurbtree_is_red_(s->u.leaves[!last]) && !rcurbtree_is_red_(s->u.leaves[last])) {
+						/* push the red color of the parent down */
+						p->color = RCU_BLACK_COLOR;
+						rcurbtree_own_(&u, &p->u.leaves[!last])->color = RCU_RED_COLOR;
+						q->color = RCU_RED_COLOR;
+					}
+					else {
+						/* borrow a red nephew: rotate the parent */
+						const unsigned d2 = (g->rcurbtree_right == p);
+						struct rcurbtree_node *const r = rcurbtree_is_red_(s->u.leaves[last]) ?
+							rcurbtree_rotate2_(&u, p, last) : rcurbtree_rotate_(&u, p, last);
+						g->u.leaves[d2] = r;
+						q->color = RCU_RED_COLOR;
+						r->color = RCU_RED_COLOR;
+						rcurbtree_own_(&u, &r->rcurbtree_left)->color = RCU_BLACK_COLOR;
+						rcurbtree_own_(&u, &r->rcurbtree_right)->color = RCU_BLACK_COLOR;
+					}
+				}
+			}
+		}
+	}
+	if (!f) {
+		rcurbtree_discard_(&u);
+		return 0;
+	}
+	/* unlink q from the bottom of the tree, its object takes the place of the found one */
+	*removed = f->obj;
+	p->u.leaves[p->rcurbtree_right == q] = q->u.leaves[!q->rcurbtree_left];
+	f->obj = q->obj;
+	if (head.rcurbtree_right)
+		head.rcurbtree_right->color = RCU_BLACK_COLOR;
+	tree->count--;
+	rcurbtree_commit_(&u, head.rcurbtree_right);
+	/* the copy of q is not reachable from the published root */
+	q->rcurbtree_left = tree->reserve;
+	tree->reserve = q;
+	tree->reserved++;
+	return 1;
+}
+
+RCURBTREE_EXPORTS void rcurbtree_destroy(
+	struct rcurbtree *const tree/*!=NULL*/)
+{
+	struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n, *next;
+	size_t s;
+	RCURBTREE_ASSERT_PTR(tree);
+	btree_delete_stack(rcurbtree_node_to_btree_node_(tree->root), stack, s, n, next) {
+		free(n);
+	}
+	while (tree->reserve) {
+		struct rcurbtree_node *const x = tree->reserve;
+		tree->reserve = x->rcurbtree_left;
+		free(x);
+	}
+	tree->root = (struct rcurbtree_node*)0;
+	tree->count = 0;
+	tree->reserved = 0;
+}
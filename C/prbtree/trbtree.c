@@ -0,0 +1,213 @@
+/**********************************************************************************
+* Embedded red-black binary tree without parent pointers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* trbtree.c */
+
+/* top-down insert and remove: while descending from the root, colors are flipped and nodes
+  are rotated so that the node at the bottom of the path may be linked/unlinked without
+  going back up, see "Red-Black Trees" by Julienne Walker (Eternally Confuzzled) */
+
+#include "collections_config.h"
+#include "trbtree.h"
+
+#define TRB_RED_COLOR   1u
+#define TRB_BLACK_COLOR 0u
+
+static inline int trbtree_is_red_(
+	const struct btree_node *const n/*NULL?*/)
+{
+	return n && TRB_RED_COLOR == trbtree_get_color_(n);
+}
+
+static inline void trbtree_set_color_(
+	struct btree_node *const n/*!=NULL*/,
+	const unsigned c/*0,1*/)
+{
+	n->btree_left = (struct btree_node*)(((uintptr_t)n->btree_left & ~(uintptr_t)1) | c);
+}
+
+/* set child of the node, preserving the color of the node */
+static inline void trbtree_set_leaf_(
+	struct btree_node *const n/*!=NULL*/,
+	const unsigned d/*0,1*/,
+	struct btree_node *const x/*NULL?*/)
+{
+	if (d)
+		n->btree_right = x;
+	else
+		n->btree_left = (struct btree_node*)((uintptr_t)x | trbtree_get_color_(n));
+}
+
+/* rotate: child of node x at side !d takes the place of x, x becomes its child at side d,
+  x becomes red, the child - black, returns the child */
+static struct btree_node *trbtree_rotate_(
+	struct btree_node *const x/*!=NULL*/,
+	const unsigned d/*0,1*/)
+{
+	struct btree_node *const y = trbtree_leaf(x, !d);
+	trbtree_set_leaf_(x, !d, trbtree_leaf(y, d));
+	trbtree_set_leaf_(y, d, x);
+	trbtree_set_color_(x, TRB_RED_COLOR);
+	trbtree_set_color_(y, TRB_BLACK_COLOR);
+	return y;
+}
+
+/* rotate the child of x at side !d to the side !d of its child, then rotate x */
+static struct btree_node *trbtree_rotate2_(
+	struct btree_node *const x/*!=NULL*/,
+	const unsigned d/*0,1*/)
+{
+	trbtree_set_leaf_(x, !d, trbtree_rotate_(trbtree_leaf(x, !d), !d));
+	return trbtree_rotate_(x, d);
+}
+
+TRBTREE_EXPORTS struct btree_node *trbtree_insert(
+	struct trbtree *const tree/*!=NULL*/,
+	struct btree_node *const e/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/,
+	const int leaf)
+{
+	struct btree_node head;      /* false root: tree->root is its right child */
+	struct btree_node *t = &head; /* great-grandparent */
+	struct btree_node *g = (struct btree_node*)0; /* grandparent */
+	struct btree_node *p = (struct btree_node*)0; /* parent */
+	struct btree_node *q;        /* current node */
+	struct btree_node *found = (struct btree_node*)0;
+	unsigned d = 1, last = 1;
+	TRBTREE_ASSERT_PTR(tree);
+	TRBTREE_ASSERT_PTR(e);
+	TRBTREE_ASSERT_PTR(key);
+	TRBTREE_ASSERT_PTR(comparator);
+	TRBTREE_ASSERT(!e->btree_left && !e->btree_right); /* new node must have no children */
+	if (!tree->root) {
+		tree->root = e; /* black node */
+		return (struct btree_node*)0;
+	}
+	head.btree_left = (struct btree_node*)0;
+	head.btree_right = tree->root;
+	for (q = tree->root;;) {
+		if (!q) {
+			/* insert new red node at the bottom */
+			q = e;
+			trbtree_set_color_(q, TRB_RED_COLOR);
+			trbtree_set_leaf_(p, d, q);
+		}
+		else if (trbtree_is_red_(trbtree_left(q)) && trbtree_is_red_(q->btree_right)) {
+			/* push the red color up */
+			trbtree_set_color_(q, TRB_RED_COLOR);
+			trbtree_set_color_(trbtree_left(q), TRB_BLACK_COLOR);
+			trbtree_set_color_(q->btree_right, TRB_BLACK_COLOR);
+		}
+		if (trbtree_is_red_(q) && trbtree_is_red_(p)) {
+			/* two red nodes in a row: rotate the grandparent */
+			const unsigned d2 = (t->btree_right == g);
+			trbtree_set_leaf_(t, d2, q == trbtree_leaf(p, last) ?
+				trbtree_rotate_(g, !last) : trbtree_rotate2_(g, !last));
+		}
+		if (q == e)
+			break;
+		{
+			const int c = (*comparator)(q, key); /* c = q - key */
+			if (c == 0 && !leaf) {
+				found = q;
+				break;
+			}
+			last = d;
+			d = (c <= 0); /* insert after nodes with the same key */
+		}
+		if (g)
+			t = g;
+		g = p;
+		p = q;
+		q = trbtree_leaf(q, d);
+	}
+	tree->root = head.btree_right;
+	trbtree_set_color_(tree->root, TRB_BLACK_COLOR);
+	return found; /* NULL? */
+}
+
+TRBTREE_EXPORTS struct btree_node *trbtree_remove(
+	struct trbtree *const tree/*!=NULL*/,
+	const struct btree_key *const key/*!=NULL*/,
+	btree_comparator *const comparator/*!=NULL*/)
+{
+	struct btree_node head;       /* false root: tree->root is its right child */
+	struct btree_node *q = &head; /* current node */
+	struct btree_node *p = (struct btree_node*)0; /* parent */
+	struct btree_node *g;         /* grandparent */
+	struct btree_node *f = (struct btree_node*)0;  /* found node */
+	struct btree_node *fp = (struct btree_node*)0; /* parent of the found node */
+	unsigned d = 1;
+	TRBTREE_ASSERT_PTR(tree);
+	TRBTREE_ASSERT_PTR(key);
+	TRBTREE_ASSERT_PTR(comparator);
+	head.btree_left = (struct btree_node*)0;
+	head.btree_right = tree->root;
+	/* descend to the bottom, pushing the red color down, so the node at the bottom is red */
+	while (trbtree_leaf(q, d)) {
+		const unsigned last = d;
+		g = p;
+		p = q;
+		q = trbtree_leaf(q, d);
+		{
+			const int c = (*comparator)(q, key); /* c = q - key */
+			if (c == 0) {
+				f = q;
+				fp = p;
+			}
+			d = (c < 0); /* after the found node, go to its predecessor */
+		}
+		if (!trbtree_is_red_(q) && !trbtree_is_red_(trbtree_leaf(q, d))) {
+			if (trbtree_is_red_(trbtree_leaf(q, !d))) {
+				/* rotate the red child of q to the place of q */
+				struct btree_node *const r = trbtree_rotate_(q, d);
+				trbtree_set_leaf_(p, last, r);
+				if (q == f)
+					fp = r;
+				p = r;
+			}
+			else {
+				struct btree_node *const s = trbtree_leaf(p, !last); /* sibling of q */
+				if (s) {
+					if (!trbtree_is_red_(trbtree_leaf(s, !last)) && !trbtree_is_red_(trbtree_leaf(s, last))) {
+						/* push the red color of the parent down */
+						trbtree_set_color_(p, TRB_BLACK_COLOR);
+						trbtree_set_color_(s, TRB_RED_COLOR);
+						trbtree_set_color_(q, TRB_RED_COLOR);
+					}
+					else {
+						/* borrow a red nephew: rotate the parent */
+						const unsigned d2 = (g->btree_right == p);
+						struct btree_node *const r = trbtree_is_red_(trbtree_leaf(s, last)) ?
+							trbtree_rotate2_(p, last) : trbtree_rotate_(p, last);
+						trbtree_set_leaf_(g, d2, r);
+						if (p == f)
+							fp = r;
+						trbtree_set_color_(q, TRB_RED_COLOR);
+						trbtree_set_color_(r, TRB_RED_COLOR);
+						trbtree_set_color_(trbtree_left(r), TRB_BLACK_COLOR);
+						trbtree_set_color_(r->btree_right, TRB_BLACK_COLOR);
+					}
+				}
+			}
+		}
+	}
+	if (f) {
+		/* unlink q from the bottom of the tree, then put it to the place of f */
+		trbtree_set_leaf_(p, p->btree_right == q, trbtree_leaf(q, !trbtree_left(q)));
+		if (q != f) {
+			q->btree_left = f->btree_left; /* with the color of f */
+			q->btree_right = f->btree_right;
+			trbtree_set_leaf_(fp, fp->btree_right == f, q);
+		}
+		trbtree_init_node(f);
+	}
+	tree->root = head.btree_right;
+	if (tree->root)
+		trbtree_set_color_(tree->root, TRB_BLACK_COLOR);
+	return f; /* NULL? */
+}
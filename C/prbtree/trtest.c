@@ -0,0 +1,201 @@
+/**********************************************************************************
+* Embedded red-black binary tree without parent pointers
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* trtest.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include "trbtree.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define N 2000
+#define RANGE 5000
+
+struct obj {
+	int key;
+	struct btree_node n;
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+TRBTREE_DEFINE(otree, struct obj, n, int, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+
+static struct obj pool[N];
+static int inserted[N];
+
+/* check colors and order of keys,
+  returns black height of the subtree, or -1 on error */
+static int check_subtree(const struct btree_node *const n, const int parent_is_red)
+{
+	const struct btree_node *const l = trbtree_left(n);
+	const struct btree_node *const r = trbtree_right(n);
+	const int red = (int)trbtree_get_color_(n);
+	int bl = 0, br = 0;
+	if (red && parent_is_red)
+		return -1;
+	if (l) {
+		if (otree_from_node(n)->key < otree_from_node(l)->key)
+			return -1;
+		bl = check_subtree(l, red);
+	}
+	if (r) {
+		if (otree_from_node(r)->key < otree_from_node(n)->key)
+			return -1;
+		br = check_subtree(r, red);
+	}
+	if (bl < 0 || bl != br)
+		return -1;
+	return bl + !red;
+}
+
+static int check_tree(const struct trbtree *const tree)
+{
+	if (!tree->root)
+		return 1;
+	return !trbtree_get_color_(tree->root) && check_subtree(tree->root, 1) > 0;
+}
+
+/* iterate forward and backward, compare with brute force count */
+static int check_iterate(const struct trbtree *const tree)
+{
+	struct btree_node *stack[rbtree_height(32)], *n;
+	size_t s;
+	unsigned expected = 0, found = 0, i = 0;
+	const struct obj *prev = NULL;
+	for (; i < N; i++)
+		expected += (unsigned)inserted[i];
+	trbtree_walk_stack_forward(tree->root, stack, s, n) {
+		const struct obj *const o = otree_from_node(n);
+		if (prev && o->key < prev->key)
+			return 0;
+		prev = o;
+		found++;
+	}
+	if (found != expected)
+		return 0;
+	trbtree_walk_stack_backward(tree->root, stack, s, n) {
+		const struct obj *const o = otree_from_node(n);
+		if (prev->key < o->key)
+			return 0;
+		prev = o;
+		found--;
+	}
+	return !found;
+}
+
+int main(int argc, char *argv[])
+{
+	struct trbtree tree;
+	unsigned i;
+	(void)argc, (void)argv;
+	TEST(sizeof(struct btree_node) == 2*sizeof(void*));
+	trbtree_init(&tree);
+	TEST(!otree_first(&tree));
+	TEST(!otree_search(&tree, 1));
+	TEST(!otree_remove(&tree, 1));
+	{
+		/* small tree */
+		static const int keys[5] = {30, 10, 50, 20, 40};
+		for (i = 0; i < 5; i++) {
+			trbtree_init_node(&pool[i].n);
+			pool[i].key = keys[i];
+			TEST(!otree_insert(&tree, &pool[i], /*leaf:*/0));
+		}
+		TEST(check_tree(&tree));
+		trbtree_init_node(&pool[5].n);
+		pool[5].key = 20;
+		TEST(otree_insert(&tree, &pool[5], /*leaf:*/0) == &pool[3]);
+		TEST(check_tree(&tree));
+		TEST(otree_search(&tree, 40) == &pool[4]);
+		TEST(otree_search(&tree, 41) == NULL);
+		TEST(otree_first(&tree) == &pool[1]);
+		TEST(otree_last(&tree) == &pool[2]);
+		/* non-unique keys */
+		TEST(!otree_insert(&tree, &pool[5], /*leaf:*/1));
+		TEST(check_tree(&tree));
+		TEST(otree_remove(&tree, 41) == NULL);
+		TEST(otree_remove(&tree, 30) == &pool[0]);
+		TEST(!pool[0].n.btree_left && !pool[0].n.btree_right);
+		TEST(check_tree(&tree));
+		{
+			struct obj *const a = otree_remove(&tree, 20);
+			struct obj *const b = otree_remove(&tree, 20);
+			TEST(a && b && a != b && (a == &pool[3] || a == &pool[5]) && (b == &pool[3] || b == &pool[5]));
+		}
+		TEST(otree_remove(&tree, 10) == &pool[1]);
+		TEST(otree_remove(&tree, 50) == &pool[2]);
+		TEST(otree_remove(&tree, 40) == &pool[4]);
+		TEST(!tree.root);
+	}
+	{
+		/* random keys: insert all, then remove or re-insert every second object, several times */
+		int ok = 1;
+		unsigned round = 0;
+		srand(1);
+		for (i = 0; i < N; i++) {
+			trbtree_init_node(&pool[i].n);
+			pool[i].key = rand() % RANGE;
+			inserted[i] = !otree_insert(&tree, &pool[i], /*leaf:*/0);
+			if (!(i % 100) && !check_tree(&tree))
+				ok = 0;
+		}
+		TEST(ok);
+		TEST(check_tree(&tree));
+		TEST(check_iterate(&tree));
+		for (; round < 4; round++) {
+			for (i = round; i < N; i += 2) {
+				if (inserted[i]) {
+					/* with non-unique keys, another object with the same key may be removed */
+					struct obj *const o = otree_remove(&tree, pool[i].key);
+					if (!o || o->key != pool[i].key || !inserted[o - pool])
+						ok = 0;
+					else
+						inserted[o - pool] = 0;
+				}
+				else {
+					pool[i].key = rand() % RANGE;
+					inserted[i] = !otree_insert(&tree, &pool[i], /*leaf:*/round & 1);
+				}
+				if (!(i % 50) && !check_tree(&tree))
+					ok = 0;
+			}
+			TEST(ok);
+			TEST(check_tree(&tree));
+			TEST(check_iterate(&tree));
+			for (i = 0; i < N && ok; i++) {
+				const struct obj *const o = otree_search(&tree, pool[i].key);
+				if (inserted[i] && (!o || o->key != pool[i].key))
+					ok = 0;
+			}
+			TEST(ok);
+		}
+		for (i = 0; i < N; i++) {
+			/* the object may be still in the tree if another one with the same key was removed */
+			while (ok && inserted[i]) {
+				struct obj *const o = otree_remove(&tree, pool[i].key);
+				if (!o || !inserted[o - pool])
+					ok = 0;
+				else
+					inserted[o - pool] = 0;
+				if (!(i % 10) && !check_tree(&tree))
+					ok = 0;
+			}
+		}
+		TEST(ok);
+		TEST(!tree.root);
+	}
+	printf("all tests OK\n");
+	return 0;
+}
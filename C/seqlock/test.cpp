@@ -0,0 +1,176 @@
+/**********************************************************************************
+* Sequence lock: optimistic concurrent reads of prbtree/pcrbtree
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* test.cpp */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "prbtree.h"
+#include "pcrbtree.h"
+#include "seqlock.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define N 4096       /* keys 0..N-1: even keys are always in the tree, odd - are inserted/removed */
+#define READERS 4
+#define WRITERS 2
+#define READS 200000 /* lookups by each reader */
+
+struct obj {
+	struct prbtree_node n;
+	unsigned key;
+	int inserted;
+};
+
+struct cobj {
+	struct pcrbtree_node n;
+	unsigned key;
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+PRBTREE_DEFINE(otree, struct obj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+SEQLOCK_TREE_DEFINE(oseq, struct prbtree, struct obj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+PCRBTREE_DEFINE(ctree, struct cobj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+SEQLOCK_TREE_DEFINE(cseq, struct pcrbtree, struct cobj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR)
+
+/* objects are never freed: readers may reach removed ones */
+static struct obj objs[N];
+static struct cobj cobjs[N];
+
+static struct seqlock lock;
+static struct prbtree tree;
+static std::atomic<int> stop(0);
+static std::atomic<unsigned long> errors(0);
+static std::atomic<unsigned long> updates(0);
+
+static void writer(unsigned w)
+{
+	unsigned r = w + 1;
+	while (!stop.load(std::memory_order_relaxed)) {
+		/* odd keys of this writer */
+		struct obj *o;
+		r = r*1103515245u + 12345u;
+		o = &objs[((r >> 8) % (N/2/WRITERS)*WRITERS + w)*2 + 1];
+		seqlock_write_lock(&lock);
+		if (o->inserted)
+			otree_remove(&tree, o);
+		else {
+			prbtree_init_node(&o->n);
+			(void)otree_insert(&tree, o, /*leaf:*/0);
+		}
+		seqlock_write_unlock(&lock);
+		o->inserted = !o->inserted;
+		updates.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+static void reader(unsigned t)
+{
+	unsigned r = t + 1000, i;
+	unsigned long e = 0;
+	for (i = 0; i < READS; i++) {
+		const struct obj *o;
+		unsigned k;
+		r = r*1103515245u + 12345u;
+		k = (r >> 8) % N;
+		o = oseq_search(&lock, &tree, k);
+		if (k & 1)
+			e += o && o != &objs[k];
+		else
+			e += o != &objs[k];
+		/* the next even key is always in the tree */
+		o = oseq_lower_bound(&lock, &tree, k);
+		e += o ? o != &objs[k] && (!(k & 1) || o != &objs[k + 1]) : k != N - 1;
+		o = oseq_upper_bound(&lock, &tree, k);
+		e += (k + 2 < N) && (!o || (o != &objs[k + 1] && o != &objs[(k + 2) & ~1u]));
+	}
+	errors.fetch_add(e);
+}
+
+/* compare optimistic lookups with usual ones, without concurrent writers */
+static int check_lookups(const struct prbtree *const t, const struct pcrbtree *const c)
+{
+	unsigned k;
+	for (k = 0; k <= N; k++) {
+		if (oseq_search(&lock, t, k) != otree_search(t, k) ||
+			oseq_lower_bound(&lock, t, k) != otree_lower_bound(t, k) ||
+			oseq_upper_bound(&lock, t, k) != otree_upper_bound(t, k) ||
+			cseq_search(&lock, c, k) != ctree_search(c, k) ||
+			cseq_lower_bound(&lock, c, k) != ctree_lower_bound(c, k) ||
+			cseq_upper_bound(&lock, c, k) != ctree_upper_bound(c, k))
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pcrbtree ctree;
+	std::vector<std::thread> threads;
+	unsigned i;
+
+	(void)argc, (void)argv;
+
+	seqlock_init(&lock);
+	prbtree_init(&tree);
+	pcrbtree_init(&ctree);
+
+	TEST(check_lookups(&tree, &ctree));
+
+	for (i = 0; i < N; i++) {
+		objs[i].key = i;
+		cobjs[i].key = i;
+		pcrbtree_init_node(&cobjs[i].n);
+		if (!(i % 3))
+			(void)ctree_insert(&ctree, &cobjs[i], /*leaf:*/0);
+		if (!(i & 1) || !(i % 3)) {
+			prbtree_init_node(&objs[i].n);
+			(void)otree_insert(&tree, &objs[i], /*leaf:*/0);
+			objs[i].inserted = 1;
+		}
+	}
+	TEST(check_lookups(&tree, &ctree));
+
+	/* counter is even outside of write sections */
+	{
+		const seqlock_seq_t s = seqlock_read_begin(&lock);
+		TEST(!(s & 1) && !seqlock_read_retry(&lock, s));
+		seqlock_write_lock(&lock);
+		seqlock_write_unlock(&lock);
+		TEST(seqlock_read_retry(&lock, s));
+	}
+
+	/* readers must always find even keys, while writers insert/remove odd ones */
+	for (i = 0; i < WRITERS; i++)
+		threads.push_back(std::thread(writer, i));
+	for (i = 0; i < READERS; i++)
+		threads.push_back(std::thread(reader, i));
+	for (i = WRITERS; i < WRITERS + READERS; i++)
+		threads[i].join();
+	stop.store(1);
+	for (i = 0; i < WRITERS; i++)
+		threads[i].join();
+	printf("%lu updates during reads\n", updates.load());
+	TEST(!errors.load());
+	TEST(check_lookups(&tree, &ctree));
+
+	printf("all tests OK\n");
+	return 0;
+}
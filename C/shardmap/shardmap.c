@@ -0,0 +1,173 @@
+/**********************************************************************************
+* Sharded ordered map: prbtrees with per-shard spinlocks
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* shardmap.c */
+
+#include <stdlib.h> /* for malloc() */
+#include <stdint.h> /* for uintptr_t */
+#include "collections_config.h"
+#include "shardmap.h"
+
+#ifdef _WIN32
+#include <windows.h> /* for SwitchToThread() */
+#define SHARDMAP_YIELD() ((void)SwitchToThread())
+#else
+#include <sched.h> /* for sched_yield() */
+#define SHARDMAP_YIELD() ((void)sched_yield())
+#endif
+
+/* one block: pointer returned by malloc(), padding, aligned shards */
+SHARDMAP_EXPORTS int shardmap_alloc(
+	struct shardmap *const m/*!=NULL,out*/,
+	const size_t count)
+{
+	const size_t extra = SHARDMAP_CACHE_LINE - 1 + sizeof(void*);
+	size_t n = 1, i;
+	char *p = (char*)0;
+	SHARDMAP_ASSERT_PTR(m);
+	m->shards = (struct shardmap_shard*)0;
+	m->mask = 0;
+	while (n < count && n <= ((size_t)-1 >> 1))
+		n <<= 1;
+	if (n >= count && n < ((size_t)-1 - extra)/sizeof(struct shardmap_shard))
+		p = (char*)malloc(extra + n*sizeof(struct shardmap_shard));
+	if (!p)
+		return -1;
+	{
+		const size_t a = (size_t)((uintptr_t)(p + sizeof(void*)) % SHARDMAP_CACHE_LINE);
+		char *const shards = p + sizeof(void*) + (a ? SHARDMAP_CACHE_LINE - a : 0);
+		((void**)shards)[-1] = p;
+		m->shards = (struct shardmap_shard*)shards;
+		m->mask = n - 1;
+	}
+	for (i = 0; i < n; i++) {
+		prbtree_init(&m->shards[i].tree);
+		m->shards[i].lock = 0;
+	}
+	return 0;
+}
+
+SHARDMAP_EXPORTS void shardmap_destroy(
+	struct shardmap *const m/*!=NULL*/)
+{
+	SHARDMAP_ASSERT_PTR(m);
+	if (m->shards)
+		free(((void**)m->shards)[-1]);
+	m->shards = (struct shardmap_shard*)0;
+	m->mask = 0;
+}
+
+SHARDMAP_EXPORTS void shardmap_lock_wait_(
+	struct shardmap_shard *const s/*!=NULL*/)
+{
+	unsigned spins = 0;
+	SHARDMAP_ASSERT_PTR(s);
+	do {
+		do {
+			if (spins < SHARDMAP_SPIN_COUNT) {
+				spins++;
+				SHARDMAP_PAUSE();
+			}
+			else
+				SHARDMAP_YIELD();
+		} while (shardmap_lock_load_(&s->lock));
+	} while (shardmap_lock_xchg_(&s->lock, 1));
+}
+
+SHARDMAP_EXPORTS void shardmap_lock_all(
+	struct shardmap *const m/*!=NULL*/)
+{
+	size_t i = 0;
+	SHARDMAP_ASSERT_PTR(m);
+	for (; i <= m->mask; i++)
+		shardmap_lock(&m->shards[i]);
+}
+
+SHARDMAP_EXPORTS void shardmap_unlock_all(
+	struct shardmap *const m/*!=NULL*/)
+{
+	size_t i = 0;
+	SHARDMAP_ASSERT_PTR(m);
+	for (; i <= m->mask; i++)
+		shardmap_unlock(&m->shards[i]);
+}
+
+/* move the node at position i down the heap until it is not greater than its children */
+static void shardmap_sift_down_(
+	struct shardmap_iter *const it/*!=NULL*/,
+	size_t i)
+{
+	struct prbtree_node **const heap = it->heap;
+	struct prbtree_node *const node = heap[i];
+	for (;;) {
+		size_t c = 2*i + 1;
+		if (c >= it->size)
+			break;
+		if (c + 1 < it->size && (*it->comparator)(heap[c + 1], heap[c]) < 0)
+			c++;
+		if ((*it->comparator)(node, heap[c]) <= 0)
+			break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = node;
+}
+
+SHARDMAP_EXPORTS void shardmap_iter_push(
+	struct shardmap_iter *const it/*!=NULL*/,
+	struct prbtree_node *const node/*!=NULL*/)
+{
+	struct prbtree_node **heap;
+	size_t i;
+	SHARDMAP_ASSERT_PTR(it);
+	SHARDMAP_ASSERT_PTR(node);
+	heap = it->heap;
+	/* sift up */
+	for (i = it->size++; i; ) {
+		const size_t p = (i - 1)/2;
+		if ((*it->comparator)(heap[p], node) <= 0)
+			break;
+		heap[i] = heap[p];
+		i = p;
+	}
+	heap[i] = node;
+}
+
+SHARDMAP_EXPORTS struct prbtree_node *shardmap_iter_first(
+	struct shardmap_iter *const it/*!=NULL,out*/,
+	const struct shardmap *const m/*!=NULL*/,
+	struct prbtree_node **const heap/*!=NULL*/,
+	shardmap_comparator *const comparator/*!=NULL*/)
+{
+	size_t i = 0;
+	SHARDMAP_ASSERT_PTR(m);
+	shardmap_iter_init(it, heap, comparator);
+	for (; i <= m->mask; i++) {
+		const struct prbtree_node *const root = m->shards[i].tree.root;
+		if (root)
+			shardmap_iter_push(it, prbtree_node_from_btree_node_(btree_first(&root->u.n)));
+	}
+	return shardmap_iter_current(it); /* NULL? */
+}
+
+SHARDMAP_EXPORTS struct prbtree_node *shardmap_iter_next(
+	struct shardmap_iter *const it/*!=NULL*/)
+{
+	SHARDMAP_ASSERT_PTR(it);
+	if (it->size) {
+		/* replace the least node by the next one of its shard */
+		struct prbtree_node *const next = prbtree_next(it->heap[0]);
+		if (next)
+			it->heap[0] = next;
+		else if (--it->size)
+			it->heap[0] = it->heap[it->size];
+		else
+			return (struct prbtree_node*)0;
+		shardmap_sift_down_(it, 0);
+		return it->heap[0];
+	}
+	return (struct prbtree_node*)0;
+}
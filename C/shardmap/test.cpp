@@ -0,0 +1,262 @@
+/**********************************************************************************
+* Sharded ordered map: prbtrees with per-shard spinlocks
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* test.cpp */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "shardmap.h"
+
+static unsigned test_number = 0;
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+#define SHARDS 16
+#define RANGE 3000
+#define OPS 30000
+#define THREADS 8
+#define THREAD_OPS 100000
+#define HOT_KEYS 16  /* keys updated by all threads */
+#define SCANS 50     /* ordered walks under shardmap_lock_all() */
+
+struct obj {
+	struct prbtree_node n;
+	unsigned key;
+};
+
+#define OBJ_KEY_OF(o) ((o)->key)
+#define OBJ_KEY_HASH(k) ((size_t)((k)*2654435761u >> 8))
+SHARDMAP_DEFINE(omap, struct obj, n, unsigned, OBJ_KEY_OF, BTREE_KEY_COMPARATOR, OBJ_KEY_HASH)
+
+static struct obj objs[RANGE];
+static int inserted[RANGE];
+
+/* walk the map in order, returns number of objects, (size_t)-1 if the order is wrong */
+static size_t walk(const struct shardmap *const m)
+{
+	struct prbtree_node *heap[SHARDS];
+	struct shardmap_iter it;
+	const struct obj *o = omap_iter_first(&it, m, heap), *prev = NULL;
+	size_t n = 0;
+	for (; o; o = omap_iter_next(&it), n++) {
+		if (prev && prev->key >= o->key)
+			return (size_t)-1;
+		prev = o;
+	}
+	return n;
+}
+
+static int check_lookups(struct shardmap *const m)
+{
+	struct prbtree_node *heap[SHARDS];
+	struct shardmap_iter it;
+	const struct obj *lower = NULL, *after = NULL;
+	size_t n = 0;
+	unsigned k;
+	/* go backward, remember the nearest object with key >= k and the one following it */
+	for (k = RANGE; k--;) {
+		const struct obj *const e = inserted[k] ? &objs[k] : NULL;
+		if (e) {
+			after = lower;
+			lower = e;
+		}
+		if (omap_search(m, k) != e ||
+			omap_iter_lower_bound(&it, m, heap, k) != lower ||
+			(lower && omap_iter_next(&it) != after))
+		{
+			return 0;
+		}
+		n += (size_t)inserted[k];
+	}
+	return walk(m) == n;
+}
+
+/* concurrent test */
+
+static struct shardmap cmap;
+static std::atomic<unsigned long> errors(0);
+static std::atomic<long> hot_balance[HOT_KEYS]; /* successful inserts minus removes */
+static std::atomic<int> done(0);
+
+static struct obj *new_obj(unsigned key)
+{
+	struct obj *const o = (struct obj*)malloc(sizeof(*o));
+	if (!o)
+		abort();
+	prbtree_init_node(&o->n);
+	o->key = key;
+	return o;
+}
+
+/* thread t owns keys HOT_KEYS + t + THREADS*i and knows their state,
+  all threads insert/remove hot keys 0..HOT_KEYS-1,
+  removed objects are freed after all threads finish */
+static void worker(unsigned t, std::vector<struct obj*> *const removed)
+{
+	const unsigned own = RANGE/THREADS;
+	std::vector<char> present(own);
+	unsigned rnd = t + 1, i;
+	unsigned long e = 0;
+	for (i = 0; i < THREAD_OPS; i++) {
+		unsigned j, key;
+		int hot;
+		rnd = rnd*1103515245u + 12345u;
+		hot = !((rnd >> 20) & 3);
+		j = (rnd >> 8) % (hot ? HOT_KEYS : own);
+		key = hot ? j : HOT_KEYS + t + THREADS*j;
+		if ((rnd >> 24) & 1) {
+			struct obj *const o = new_obj(key);
+			struct obj *const x = omap_insert(&cmap, o);
+			if (x) {
+				e += x->key != key;
+				free(o); /* was not inserted */
+			}
+			if (hot)
+				hot_balance[j] += !x;
+			else {
+				e += !x == !!present[j];
+				present[j] = 1;
+			}
+		}
+		else {
+			struct obj *const x = omap_remove(&cmap, key);
+			if (x) {
+				e += x->key != key;
+				removed->push_back(x);
+			}
+			if (hot)
+				hot_balance[j] -= !!x;
+			else {
+				e += !x == !!present[j];
+				present[j] = 0;
+			}
+		}
+		if (!hot) {
+			const struct obj *const o = omap_search(&cmap, key);
+			e += !o != !present[j];
+		}
+	}
+	errors.fetch_add(e);
+}
+
+/* ordered walks of the whole map while other threads update it */
+static void scanner()
+{
+	unsigned i;
+	unsigned long e = 0;
+	for (i = 0; i < SCANS && !done.load(); i++) {
+		shardmap_lock_all(&cmap);
+		e += walk(&cmap) == (size_t)-1;
+		shardmap_unlock_all(&cmap);
+		std::this_thread::yield();
+	}
+	errors.fetch_add(e);
+}
+
+int main(int argc, char *argv[])
+{
+	struct shardmap map;
+	unsigned i, seed = 1;
+	int ok = 1;
+
+	(void)argc, (void)argv;
+
+	TEST(!shardmap_alloc(&map, SHARDS - 1));
+	TEST(shardmap_count(&map) == SHARDS);
+	TEST(!((size_t)map.shards % SHARDMAP_CACHE_LINE));
+	for (i = 0; i < RANGE; i++)
+		objs[i].key = i;
+	TEST(check_lookups(&map));
+	TEST(!omap_remove(&map, 1));
+
+	/* random updates by one thread */
+	for (i = 0; i < OPS && ok; i++) {
+		const unsigned k = (seed = seed*1103515245u + 12345u, (seed >> 8) % RANGE);
+		if ((seed >> 24) & 1) {
+			struct obj *x;
+			if (!inserted[k])
+				prbtree_init_node(&objs[k].n);
+			x = omap_insert(&map, &objs[k]);
+			ok = inserted[k] ? x == &objs[k] : !x;
+			inserted[k] = 1;
+		}
+		else {
+			ok = omap_remove(&map, k) == (inserted[k] ? &objs[k] : NULL);
+			inserted[k] = 0;
+		}
+		if (!(i % 1000))
+			ok = ok && check_lookups(&map);
+	}
+	TEST(ok);
+	TEST(check_lookups(&map));
+
+	/* objects are distributed over all shards */
+	for (i = 0; i < SHARDS; i++)
+		ok = ok && map.shards[i].tree.root;
+	TEST(ok);
+	shardmap_destroy(&map);
+	TEST(!map.shards);
+
+	/* concurrent inserts/removes */
+	{
+		std::vector<std::thread> threads;
+		std::vector<std::vector<struct obj*> > removed(THREADS);
+		size_t count = 0;
+		TEST(!shardmap_alloc(&cmap, SHARDS));
+		for (i = 0; i < THREADS; i++)
+			threads.push_back(std::thread(worker, i, &removed[i]));
+		{
+			std::thread s(scanner);
+			for (i = 0; i < THREADS; i++)
+				threads[i].join();
+			done.store(1);
+			s.join();
+		}
+		TEST(!errors.load());
+		for (i = 0; i < HOT_KEYS; i++) {
+			const long b = hot_balance[i].load();
+			TEST((b == 0 || b == 1) && !omap_search(&cmap, i) == !b);
+			count += (size_t)b;
+		}
+		{
+			struct prbtree_node *heap[SHARDS];
+			struct shardmap_iter it;
+			struct obj *o;
+			for (o = omap_iter_first(&it, &cmap, heap); o; o = omap_iter_next(&it))
+				count -= o->key < HOT_KEYS;
+		}
+		TEST(!count);
+		TEST(walk(&cmap) != (size_t)-1);
+		for (i = 0; i < THREADS; i++) {
+			for (size_t j = 0; j < removed[i].size(); j++)
+				free(removed[i][j]);
+		}
+		{
+			struct prbtree_node *heap[SHARDS];
+			struct shardmap_iter it;
+			struct obj *o;
+			while ((o = omap_iter_first(&it, &cmap, heap)) != NULL) {
+				ok = ok && omap_remove(&cmap, o->key) == o;
+				free(o);
+			}
+		}
+		TEST(ok);
+		shardmap_destroy(&cmap);
+	}
+
+	printf("all tests OK\n");
+	return 0;
+}
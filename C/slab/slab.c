@@ -0,0 +1,129 @@
+/**********************************************************************************
+* Slab allocator of fixed-size objects: nodes of embedded trees and lists
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+* Licensed under LGPL version 3 or any later version, see COPYING
+**********************************************************************************/
+
+/* slab.c */
+
+#include <stdlib.h> /* for malloc() */
+#include "collections_config.h"
+#include "btree.h"
+#include "dlist.h"
+#include "slab.h"
+
+/* objects follow the header of a block */
+#define SLAB_BLOCK_HEADER_SIZE \
+	((sizeof(struct slab_block) + SLAB_ALIGNMENT - 1) & ~(size_t)(SLAB_ALIGNMENT - 1))
+
+SLAB_EXPORTS void slab_init(
+	struct slab *const s/*!=NULL,out*/,
+	const size_t object_size/*>0*/,
+	const size_t block_objects)
+{
+	/* a freed object must hold a link of the free list, also keep links aligned */
+	const size_t sz = object_size < sizeof(struct slab_free_object) ?
+		sizeof(struct slab_free_object) :
+		(object_size + sizeof(struct slab_free_object) - 1) & ~(sizeof(struct slab_free_object) - 1);
+	s->free_list = NULL;
+	s->bump = NULL;
+	s->bump_end = NULL;
+	s->blocks = NULL;
+	s->spare = NULL;
+	s->object_size = sz;
+	if (block_objects)
+		s->block_objects = block_objects;
+	else {
+		const size_t n = (SLAB_BLOCK_SIZE - SLAB_BLOCK_HEADER_SIZE)/sz;
+		s->block_objects = n ? n : 1;
+	}
+}
+
+static void slab_free_blocks_(
+	struct slab_block *b/*NULL?*/)
+{
+	while (b) {
+		struct slab_block *const next = b->next;
+		free(b);
+		b = next;
+	}
+}
+
+SLAB_EXPORTS void slab_destroy(
+	struct slab *const s/*!=NULL*/)
+{
+	slab_free_blocks_(s->blocks);
+	slab_free_blocks_(s->spare);
+	s->free_list = NULL;
+	s->bump = NULL;
+	s->bump_end = NULL;
+	s->blocks = NULL;
+	s->spare = NULL;
+}
+
+SLAB_EXPORTS void slab_reset(
+	struct slab *const s/*!=NULL*/)
+{
+	/* move blocks in use to the list of spare blocks */
+	while (s->blocks) {
+		struct slab_block *const b = s->blocks;
+		s->blocks = b->next;
+		b->next = s->spare;
+		s->spare = b;
+	}
+	s->free_list = NULL;
+	s->bump = NULL;
+	s->bump_end = NULL;
+}
+
+SLAB_EXPORTS void *slab_alloc_block_(
+	struct slab *const s/*!=NULL*/)
+{
+	const size_t objects_size = s->object_size*s->block_objects;
+	struct slab_block *b = s->spare;
+	if (b)
+		s->spare = b->next;
+	else {
+		if (objects_size/s->object_size != s->block_objects ||
+			objects_size > (size_t)-1 - SLAB_BLOCK_HEADER_SIZE)
+		{
+			return NULL; /* integer overflow */
+		}
+		b = (struct slab_block*)malloc(SLAB_BLOCK_HEADER_SIZE + objects_size);
+		if (!b)
+			return NULL;
+	}
+	b->next = s->blocks;
+	s->blocks = b;
+	{
+		char *const objects = (char*)b + SLAB_BLOCK_HEADER_SIZE;
+		s->bump = objects + s->object_size;
+		s->bump_end = objects + objects_size;
+		return objects;
+	}
+}
+
+SLAB_EXPORTS void slab_free_tree(
+	struct slab *const s/*!=NULL*/,
+	struct btree_node *const tree/*NULL?*/,
+	const size_t node_offset)
+{
+	/* tree height cannot exceed the height of a red-black tree with the maximum number of nodes */
+	struct btree_node *stack[rbtree_height(sizeof(size_t)*8)], *n, *next;
+	size_t sp;
+	/* next node is determined before the current one is freed */
+	btree_delete_stack(tree, stack, sp, n, next) {
+		slab_free(s, (char*)n - node_offset);
+	}
+}
+
+SLAB_EXPORTS void slab_free_dlist(
+	struct slab *const s/*!=NULL*/,
+	struct dlist *const dl/*!=NULL*/,
+	const size_t entry_offset)
+{
+	struct dlist_entry *e, *n;
+	dlist_iterate_delete(dl, e, n) {
+		slab_free(s, (char*)e - entry_offset);
+	}
+}
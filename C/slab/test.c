@@ -0,0 +1,131 @@
+/**********************************************************************************
+* Slab allocator of fixed-size objects
+* Copyright (C) 2022 Michael M. Builov, https://github.com/mbuilov/collections
+**********************************************************************************/
+
+/* test.c */
+
+#include <stdio.h>
+#include <stddef.h>
+#include "prbtree.h"
+#include "dlist.h"
+#include "slab.h"
+
+#define TEST(expr) do { \
+	if (!(expr)) { \
+		printf("test %u failed (at line = %d)\n", test_number, __LINE__); \
+		return 1; \
+	} \
+	printf("test %u ok\n", test_number); \
+	test_number++; \
+} while (0)
+
+struct object {
+	struct dlist_entry entry;
+	struct prbtree_node node;
+	unsigned key;
+};
+
+#define OBJECT_KEY_OF(o) ((o)->key)
+#define OBJECT_KEY_CMP(x, y) ((x) < (y) ? -1 : (x) > (y))
+PRBTREE_DEFINE(otree, struct object, node, unsigned, OBJECT_KEY_OF, OBJECT_KEY_CMP)
+
+#define BLOCK_OBJECTS 8
+#define OBJECTS 100
+
+static unsigned count_blocks(const struct slab_block *b)
+{
+	unsigned n = 0;
+	for (; b; b = b->next)
+		n++;
+	return n;
+}
+
+static unsigned count_free(const struct slab *s)
+{
+	unsigned n = 0;
+	const struct slab_free_object *o = s->free_list;
+	for (; o; o = o->next)
+		n++;
+	return n;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned test_number = 0;
+	struct slab s;
+	struct object *o;
+	unsigned i;
+	(void)argc, (void)argv;
+	slab_init(&s, sizeof(struct object), BLOCK_OBJECTS);
+	TEST(s.object_size >= sizeof(struct object));
+	TEST(!s.blocks);
+	{
+		/* objects of a block are adjacent */
+		struct object *const a = (struct object*)slab_alloc(&s);
+		struct object *const b = (struct object*)slab_alloc(&s);
+		TEST(a && b);
+		TEST((char*)b == (char*)a + s.object_size);
+		TEST(0 == (size_t)a % sizeof(void*));
+		/* freed objects are reused in LIFO order */
+		slab_free(&s, a);
+		slab_free(&s, b);
+		TEST(slab_alloc(&s) == b);
+		TEST(slab_alloc(&s) == a);
+		TEST(!s.free_list);
+	}
+	{
+		/* fill more than one block */
+		struct prbtree tree;
+		prbtree_init(&tree);
+		for (i = 2; i < OBJECTS; i++) {
+			o = (struct object*)slab_alloc(&s);
+			TEST(o);
+			prbtree_init_node(&o->node);
+			o->key = i;
+			TEST(!otree_insert(&tree, o, /*leaf:*/0));
+		}
+		TEST(s.blocks && s.blocks->next);
+		TEST(prbtree_node_to_btree_node_(tree.root) && btree_size(prbtree_node_to_btree_node_(tree.root)) == OBJECTS - 2);
+		/* free all nodes of the tree at once */
+		slab_free_tree(&s, prbtree_node_to_btree_node_(tree.root), offsetof(struct object, node));
+		prbtree_init(&tree);
+		TEST(count_free(&s) == OBJECTS - 2);
+	}
+	{
+		/* free all entries of the list at once */
+		DLIST_DECLARE(dl);
+		for (i = 0; i < OBJECTS; i++) {
+			o = (struct object*)slab_alloc(&s);
+			TEST(o);
+			o->key = i;
+			dlist_add_back(&dl, &o->entry);
+		}
+		TEST(!s.free_list);
+		slab_free_dlist(&s, &dl, offsetof(struct object, entry));
+		dlist_init(&dl);
+		TEST(count_free(&s) == OBJECTS);
+	}
+	{
+		/* after reset, blocks are reused */
+		const unsigned blocks = count_blocks(s.blocks);
+		slab_reset(&s);
+		TEST(!s.blocks && count_blocks(s.spare) == blocks);
+		TEST(!s.free_list);
+		for (i = 0; i < OBJECTS; i++)
+			TEST(slab_alloc(&s));
+		TEST(count_blocks(s.blocks) + count_blocks(s.spare) == blocks);
+	}
+	slab_destroy(&s);
+	TEST(!s.blocks && !s.spare);
+	{
+		/* tiny objects are enlarged to hold a link of the free list */
+		slab_init(&s, 1, 0);
+		TEST(s.object_size == sizeof(void*));
+		TEST(s.block_objects > 1);
+		TEST(slab_alloc(&s) != NULL);
+		slab_destroy(&s);
+	}
+	printf("all tests OK\n");
+	return 0;
+}